@@ -26,6 +26,7 @@
 #include "StudioModelRenderer.h"
 #include "GameStudioModelRenderer.h"
 #include "Exports.h"
+#include "profiler.h"
 
 //
 // Override the StudioModelRender virtual member functions here to implement custom bone
@@ -59,6 +60,7 @@ R_StudioDrawPlayer
 */
 int R_StudioDrawPlayer(int flags, entity_state_t* pplayer)
 {
+	PROFILE_SCOPE(PROF_STUDIO_PLAYER);
 	return static_cast<int>(g_StudioRenderer.StudioDrawPlayer(flags, pplayer));
 }
 
@@ -70,6 +72,7 @@ R_StudioDrawModel
 */
 int R_StudioDrawModel(int flags)
 {
+	PROFILE_SCOPE(PROF_STUDIO_MODEL);
 	return static_cast<int>(g_StudioRenderer.StudioDrawModel(flags));
 }
 
@@ -14,6 +14,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <memory.h>
+#include <chrono>
 
 #include "studio_util.h"
 #include "r_studioint.h"
@@ -51,6 +52,9 @@ void CStudioModelRenderer::Init()
 	m_pCvarHiModels = IEngineStudio.GetCvar("cl_himodels");
 	m_pCvarDeveloper = IEngineStudio.GetCvar("developer");
 	m_pCvarDrawEntities = IEngineStudio.GetCvar("r_drawentities");
+	m_pCvarBoneCache = CVAR_CREATE("r_bonecache", "1", FCVAR_ARCHIVE); // 2 = show hit rate
+	m_pCvarAnimCache = CVAR_CREATE("r_animcache", "1", FCVAR_ARCHIVE); // 2 = show usage
+	m_pCvarAnimCacheSize = CVAR_CREATE("r_animcache_mb", "32", FCVAR_ARCHIVE);
 
 	m_pChromeSprite = IEngineStudio.GetChromeSprite();
 
@@ -77,6 +81,9 @@ CStudioModelRenderer::CStudioModelRenderer()
 	m_pCvarHiModels = NULL;
 	m_pCvarDeveloper = NULL;
 	m_pCvarDrawEntities = NULL;
+	m_pCvarBoneCache = NULL;
+	m_pCvarAnimCache = NULL;
+	m_pCvarAnimCacheSize = NULL;
 	m_pChromeSprite = NULL;
 	m_pStudioModelCount = NULL;
 	m_pModelsDrawn = NULL;
@@ -89,6 +96,18 @@ CStudioModelRenderer::CStudioModelRenderer()
 	m_pSubModel = NULL;
 	m_pPlayerInfo = NULL;
 	m_pRenderModel = NULL;
+
+	memset(m_pBoneCache, 0, sizeof(m_pBoneCache));
+	m_szBoneCacheLevel[0] = '\0';
+	m_nCacheFrame = 0;
+	m_nBoneCacheHits = m_nBoneCachePartialHits = m_nBoneCacheMisses = 0;
+	m_flBoneSetupTime = 0;
+	m_flBoneCacheSaved = 0;
+
+	memset(m_pAnimTrackHash, 0, sizeof(m_pAnimTrackHash));
+	m_pAnimTrackNewest = m_pAnimTrackOldest = NULL;
+	m_nAnimTracks = m_nAnimTrackBytes = 0;
+	m_nAnimTracksDecoded = m_nAnimTracksEvicted = 0;
 }
 
 /*
@@ -99,6 +118,107 @@ CStudioModelRenderer::CStudioModelRenderer()
 */
 CStudioModelRenderer::~CStudioModelRenderer()
 {
+	StudioFlushBoneCache();
+	StudioFlushAnimTracks();
+}
+
+/*
+====================
+StudioCacheFrame
+
+====================
+*/
+void CStudioModelRenderer::StudioCacheFrame()
+{
+	if (m_nCacheFrame == m_nFrameCount)
+		return;
+
+	// report on the last frame
+	if (m_pCvarBoneCache && m_pCvarBoneCache->value == 2)
+	{
+		int total = m_nBoneCacheHits + m_nBoneCachePartialHits + m_nBoneCacheMisses;
+		gEngfuncs.Con_NPrintf(23, "Bone cache: %d hits, %d bones only, %d misses (%d%%)", m_nBoneCacheHits, m_nBoneCachePartialHits, m_nBoneCacheMisses,
+			0 != total ? (m_nBoneCacheHits + m_nBoneCachePartialHits) * 100 / total : 0);
+		gEngfuncs.Con_NPrintf(24, "Bone cache: %.3f ms saved, %.2f us per bone", m_flBoneCacheSaved * 1000, m_flBoneSetupTime * 1000000);
+	}
+	if (m_pCvarAnimCache && m_pCvarAnimCache->value == 2)
+	{
+		gEngfuncs.Con_NPrintf(25, "Anim cache: %d tracks, %.2f MB, %d decoded, %d evicted", m_nAnimTracks, m_nAnimTrackBytes / (1024.0f * 1024.0f),
+			m_nAnimTracksDecoded, m_nAnimTracksEvicted);
+	}
+	m_nCacheFrame = m_nFrameCount;
+	m_nBoneCacheHits = m_nBoneCachePartialHits = m_nBoneCacheMisses = 0;
+	m_flBoneCacheSaved = 0;
+	m_nAnimTracksDecoded = m_nAnimTracksEvicted = 0;
+
+	// the models will be in different places on a new level
+	const char* level = gEngfuncs.pfnGetLevelName();
+	if (0 != strcmp(level, m_szBoneCacheLevel))
+	{
+		StudioFlushBoneCache();
+		StudioFlushAnimTracks();
+		strncpy(m_szBoneCacheLevel, level, sizeof(m_szBoneCacheLevel) - 1);
+		m_szBoneCacheLevel[sizeof(m_szBoneCacheLevel) - 1] = '\0';
+	}
+}
+
+/*
+====================
+StudioFlushBoneCache
+
+====================
+*/
+void CStudioModelRenderer::StudioFlushBoneCache()
+{
+	for (int i = 0; i < MAX_EDICTS; i++)
+	{
+		if (m_pBoneCache[i])
+		{
+			delete[] m_pBoneCache[i]->bonematrix;
+			delete[] m_pBoneCache[i]->bonetransform;
+			delete[] m_pBoneCache[i]->lighttransform;
+			delete m_pBoneCache[i];
+			m_pBoneCache[i] = NULL;
+		}
+	}
+}
+
+/*
+====================
+StudioGetBoneCache
+
+====================
+*/
+studio_bone_cache_t* CStudioModelRenderer::StudioGetBoneCache()
+{
+	if (!m_pCvarBoneCache || m_pCvarBoneCache->value == 0)
+		return NULL;
+
+	// only real entities; not temporary ones, or copies
+	int index = m_pCurrentEntity->index;
+	if (index <= 0 || index >= MAX_EDICTS || gEngfuncs.GetEntityByIndex(index) != m_pCurrentEntity)
+		return NULL;
+
+	studio_bone_cache_t* pCache = m_pBoneCache[index];
+	if (!pCache)
+	{
+		pCache = m_pBoneCache[index] = new studio_bone_cache_t;
+		memset(pCache, 0, sizeof(studio_bone_cache_t));
+	}
+
+	if (pCache->maxbones < m_pStudioHeader->numbones)
+	{
+		delete[] pCache->bonematrix;
+		delete[] pCache->bonetransform;
+		delete[] pCache->lighttransform;
+		pCache->maxbones = m_pStudioHeader->numbones;
+		pCache->bonematrix = new float[pCache->maxbones][3][4];
+		pCache->bonetransform = new float[pCache->maxbones][3][4];
+		pCache->lighttransform = new float[pCache->maxbones][3][4];
+		pCache->valid = false;
+	}
+
+	return pCache;
 }
 
 /*
@@ -179,64 +299,132 @@ StudioCalcBoneQuaterion
 */
 void CStudioModelRenderer::StudioCalcBoneQuaterion(int frame, float s, mstudiobone_t* pbone, mstudioanim_t* panim, float* adj, float* q)
 {
-	int j, k;
-	vec4_t q1, q2;
-	Vector angle1, angle2;
-	mstudioanimvalue_t* panimvalue;
+	studio_anim_frame_t animframe;
 
-	for (j = 0; j < 3; j++)
+	StudioDecodeBoneFrame(frame, panim, &animframe);
+	StudioCalcBoneQuaterion(s, pbone, &animframe, adj, q);
+}
+
+/*
+====================
+StudioDecodeAnimValue
+
+Finds frame k's value in a run-length encoded channel, and the value it's heading for.
+panimvalue can be any span along the way, as long as k is counted from its start.
+====================
+*/
+static void StudioDecodeAnimValue(mstudioanimvalue_t* panimvalue, int k, bool position, short* value1, short* value2)
+{
+	// DEBUG
+	if (panimvalue->num.total < panimvalue->num.valid)
+		k = 0;
+	// find span of values that includes the frame we want
+	while (panimvalue->num.total <= k)
 	{
-		if (panim->offset[j + 3] == 0)
+		k -= panimvalue->num.total;
+		panimvalue += panimvalue->num.valid + 1;
+		// DEBUG
+		if (panimvalue->num.total < panimvalue->num.valid)
+			k = 0;
+	}
+
+	if (position)
+	{
+		// if we're inside the span
+		if (panimvalue->num.valid > k)
 		{
-			angle2[j] = angle1[j] = pbone->value[j + 3]; // default;
+			*value1 = panimvalue[k + 1].value;
+
+			// and there's more data in the span
+			if (panimvalue->num.valid > k + 1)
+				*value2 = panimvalue[k + 2].value;
+			else
+				*value2 = *value1;
 		}
 		else
 		{
-			panimvalue = (mstudioanimvalue_t*)((byte*)panim + panim->offset[j + 3]);
-			k = frame;
-			// DEBUG
-			if (panimvalue->num.total < panimvalue->num.valid)
-				k = 0;
-			while (panimvalue->num.total <= k)
+			*value1 = panimvalue[panimvalue->num.valid].value;
+
+			// are we at the end of the repeating values section and there's another section with data?
+			if (panimvalue->num.total <= k + 1)
+				*value2 = panimvalue[panimvalue->num.valid + 2].value;
+			else
+				*value2 = *value1;
+		}
+	}
+	else
+	{
+		// Bah, missing blend!
+		if (panimvalue->num.valid > k)
+		{
+			*value1 = panimvalue[k + 1].value;
+
+			if (panimvalue->num.valid > k + 1)
 			{
-				k -= panimvalue->num.total;
-				panimvalue += panimvalue->num.valid + 1;
-				// DEBUG
-				if (panimvalue->num.total < panimvalue->num.valid)
-					k = 0;
+				*value2 = panimvalue[k + 2].value;
 			}
-			// Bah, missing blend!
-			if (panimvalue->num.valid > k)
+			else
 			{
-				angle1[j] = panimvalue[k + 1].value;
-
-				if (panimvalue->num.valid > k + 1)
-				{
-					angle2[j] = panimvalue[k + 2].value;
-				}
+				if (panimvalue->num.total > k + 1)
+					*value2 = *value1;
 				else
-				{
-					if (panimvalue->num.total > k + 1)
-						angle2[j] = angle1[j];
-					else
-						angle2[j] = panimvalue[panimvalue->num.valid + 2].value;
-				}
+					*value2 = panimvalue[panimvalue->num.valid + 2].value;
+			}
+		}
+		else
+		{
+			*value1 = panimvalue[panimvalue->num.valid].value;
+			if (panimvalue->num.total > k + 1)
+			{
+				*value2 = *value1;
 			}
 			else
 			{
-				angle1[j] = panimvalue[panimvalue->num.valid].value;
-				if (panimvalue->num.total > k + 1)
-				{
-					angle2[j] = angle1[j];
-				}
-				else
-				{
-					angle2[j] = panimvalue[panimvalue->num.valid + 2].value;
-				}
+				*value2 = panimvalue[panimvalue->num.valid + 2].value;
 			}
-			angle1[j] = pbone->value[j + 3] + angle1[j] * pbone->scale[j + 3];
-			angle2[j] = pbone->value[j + 3] + angle2[j] * pbone->scale[j + 3];
 		}
+	}
+}
+
+/*
+====================
+StudioDecodeBoneFrame
+
+====================
+*/
+void CStudioModelRenderer::StudioDecodeBoneFrame(int frame, mstudioanim_t* panim, studio_anim_frame_t* pframe)
+{
+	int j;
+
+	for (j = 0; j < 6; j++)
+	{
+		if (panim->offset[j] == 0)
+		{
+			pframe->value1[j] = pframe->value2[j] = 0; // default;
+		}
+		else
+		{
+			StudioDecodeAnimValue((mstudioanimvalue_t*)((byte*)panim + panim->offset[j]), frame, j < 3, &pframe->value1[j], &pframe->value2[j]);
+		}
+	}
+}
+
+/*
+====================
+StudioCalcBoneQuaterion
+
+====================
+*/
+void CStudioModelRenderer::StudioCalcBoneQuaterion(float s, mstudiobone_t* pbone, const studio_anim_frame_t* pframe, float* adj, float* q)
+{
+	int j;
+	vec4_t q1, q2;
+	Vector angle1, angle2;
+
+	for (j = 0; j < 3; j++)
+	{
+		angle1[j] = pbone->value[j + 3] + pframe->value1[j + 3] * pbone->scale[j + 3];
+		angle2[j] = pbone->value[j + 3] + pframe->value2[j + 3] * pbone->scale[j + 3];
 
 		if (pbone->bonecontroller[j + 3] != -1)
 		{
@@ -265,64 +453,192 @@ StudioCalcBonePosition
 */
 void CStudioModelRenderer::StudioCalcBonePosition(int frame, float s, mstudiobone_t* pbone, mstudioanim_t* panim, float* adj, float* pos)
 {
-	int j, k;
-	mstudioanimvalue_t* panimvalue;
+	studio_anim_frame_t animframe;
+
+	StudioDecodeBoneFrame(frame, panim, &animframe);
+	StudioCalcBonePosition(s, pbone, &animframe, adj, pos);
+}
+
+/*
+====================
+StudioCalcBonePosition
+
+====================
+*/
+void CStudioModelRenderer::StudioCalcBonePosition(float s, mstudiobone_t* pbone, const studio_anim_frame_t* pframe, float* adj, float* pos)
+{
+	int j;
 
 	for (j = 0; j < 3; j++)
 	{
 		pos[j] = pbone->value[j]; // default;
-		if (panim->offset[j] != 0)
+		if (pframe->value1[j] != pframe->value2[j])
 		{
-			panimvalue = (mstudioanimvalue_t*)((byte*)panim + panim->offset[j]);
-			/*
-			if (i == 0 && j == 0)
-				Con_DPrintf("%d  %d:%d  %f\n", frame, panimvalue->num.valid, panimvalue->num.total, s );
-			*/
-
-			k = frame;
-			// DEBUG
-			if (panimvalue->num.total < panimvalue->num.valid)
-				k = 0;
-			// find span of values that includes the frame we want
-			while (panimvalue->num.total <= k)
-			{
-				k -= panimvalue->num.total;
-				panimvalue += panimvalue->num.valid + 1;
-				// DEBUG
-				if (panimvalue->num.total < panimvalue->num.valid)
-					k = 0;
-			}
-			// if we're inside the span
-			if (panimvalue->num.valid > k)
+			pos[j] += (pframe->value1[j] * (1.0 - s) + s * pframe->value2[j]) * pbone->scale[j];
+		}
+		else if (pframe->value1[j] != 0)
+		{
+			pos[j] += pframe->value1[j] * pbone->scale[j];
+		}
+		if (pbone->bonecontroller[j] != -1 && adj)
+		{
+			pos[j] += adj[pbone->bonecontroller[j]];
+		}
+	}
+}
+
+/*
+====================
+StudioGetAnimTrack
+
+====================
+*/
+studio_anim_track_t* CStudioModelRenderer::StudioGetAnimTrack(mstudioseqdesc_t* pseqdesc, mstudioanim_t* panim)
+{
+	int i, j, frame;
+	studio_anim_track_t* ptrack;
+
+	if (!m_pCvarAnimCache || m_pCvarAnimCache->value == 0 || pseqdesc->numframes < 1)
+		return NULL;
+
+	int hash = ((size_t)panim / sizeof(mstudioanim_t)) & (ANIM_TRACK_HASH - 1);
+
+	for (ptrack = m_pAnimTrackHash[hash]; ptrack; ptrack = ptrack->hashnext)
+	{
+		if (ptrack->panim == panim && ptrack->pseqdesc == pseqdesc && ptrack->numbones == m_pStudioHeader->numbones && ptrack->numframes == pseqdesc->numframes)
+			break;
+	}
+
+	if (ptrack)
+	{
+		// move it to the front of the queue
+		if (ptrack != m_pAnimTrackNewest)
+		{
+			ptrack->lrunewer->lruolder = ptrack->lruolder;
+			if (ptrack->lruolder)
+				ptrack->lruolder->lrunewer = ptrack->lrunewer;
+			else
+				m_pAnimTrackOldest = ptrack->lrunewer;
+
+			ptrack->lrunewer = NULL;
+			ptrack->lruolder = m_pAnimTrackNewest;
+			m_pAnimTrackNewest->lrunewer = ptrack;
+			m_pAnimTrackNewest = ptrack;
+		}
+		return ptrack;
+	}
+
+	int size = pseqdesc->numframes * m_pStudioHeader->numbones * sizeof(studio_anim_frame_t);
+	int maxsize = (int)(V_max(0.0f, V_min(1024.0f, m_pCvarAnimCacheSize->value)) * 1024 * 1024);
+	if (size > maxsize)
+		return NULL;
+
+	// make room, starting with whatever's gone unused the longest
+	while (m_pAnimTrackOldest && m_nAnimTrackBytes + size > maxsize)
+	{
+		StudioFreeAnimTrack(m_pAnimTrackOldest);
+		m_nAnimTracksEvicted++;
+	}
+
+	ptrack = new studio_anim_track_t;
+	ptrack->panim = panim;
+	ptrack->pseqdesc = pseqdesc;
+	ptrack->numbones = m_pStudioHeader->numbones;
+	ptrack->numframes = pseqdesc->numframes;
+	ptrack->frames = new studio_anim_frame_t[ptrack->numframes * ptrack->numbones];
+	ptrack->size = size;
+
+	// decode each channel in one pass, rather than from the start for every frame
+	for (i = 0; i < ptrack->numbones; i++)
+	{
+		for (j = 0; j < 6; j++)
+		{
+			studio_anim_frame_t* pframe = &ptrack->frames[i];
+
+			if (panim[i].offset[j] == 0)
 			{
-				// and there's more data in the span
-				if (panimvalue->num.valid > k + 1)
-				{
-					pos[j] += (panimvalue[k + 1].value * (1.0 - s) + s * panimvalue[k + 2].value) * pbone->scale[j];
-				}
-				else
-				{
-					pos[j] += panimvalue[k + 1].value * pbone->scale[j];
-				}
+				for (frame = 0; frame < ptrack->numframes; frame++, pframe += ptrack->numbones)
+					pframe->value1[j] = pframe->value2[j] = 0;
+				continue;
 			}
-			else
+
+			mstudioanimvalue_t* panimvalue = (mstudioanimvalue_t*)((byte*)&panim[i] + panim[i].offset[j]);
+			int spanstart = 0;
+
+			for (frame = 0; frame < ptrack->numframes; frame++, pframe += ptrack->numbones)
 			{
-				// are we at the end of the repeating values section and there's another section with data?
-				if (panimvalue->num.total <= k + 1)
-				{
-					pos[j] += (panimvalue[panimvalue->num.valid].value * (1.0 - s) + s * panimvalue[panimvalue->num.valid + 2].value) * pbone->scale[j];
-				}
-				else
+				// skip the spans that are behind us, as StudioDecodeAnimValue would
+				// (but not a bad one, it restarts from those)
+				while (panimvalue->num.total >= panimvalue->num.valid && panimvalue->num.total <= frame - spanstart)
 				{
-					pos[j] += panimvalue[panimvalue->num.valid].value * pbone->scale[j];
+					spanstart += panimvalue->num.total;
+					panimvalue += panimvalue->num.valid + 1;
 				}
+
+				StudioDecodeAnimValue(panimvalue, frame - spanstart, j < 3, &pframe->value1[j], &pframe->value2[j]);
 			}
 		}
-		if (pbone->bonecontroller[j] != -1 && adj)
-		{
-			pos[j] += adj[pbone->bonecontroller[j]];
-		}
 	}
+
+	ptrack->hashnext = m_pAnimTrackHash[hash];
+	m_pAnimTrackHash[hash] = ptrack;
+
+	ptrack->lrunewer = NULL;
+	ptrack->lruolder = m_pAnimTrackNewest;
+	if (m_pAnimTrackNewest)
+		m_pAnimTrackNewest->lrunewer = ptrack;
+	else
+		m_pAnimTrackOldest = ptrack;
+	m_pAnimTrackNewest = ptrack;
+
+	m_nAnimTracks++;
+	m_nAnimTrackBytes += size;
+	m_nAnimTracksDecoded++;
+
+	return ptrack;
+}
+
+/*
+====================
+StudioFreeAnimTrack
+
+====================
+*/
+void CStudioModelRenderer::StudioFreeAnimTrack(studio_anim_track_t* ptrack)
+{
+	int hash = ((size_t)ptrack->panim / sizeof(mstudioanim_t)) & (ANIM_TRACK_HASH - 1);
+
+	studio_anim_track_t** pplink = &m_pAnimTrackHash[hash];
+	while (*pplink != ptrack)
+		pplink = &(*pplink)->hashnext;
+	*pplink = ptrack->hashnext;
+
+	if (ptrack->lrunewer)
+		ptrack->lrunewer->lruolder = ptrack->lruolder;
+	else
+		m_pAnimTrackNewest = ptrack->lruolder;
+	if (ptrack->lruolder)
+		ptrack->lruolder->lrunewer = ptrack->lrunewer;
+	else
+		m_pAnimTrackOldest = ptrack->lrunewer;
+
+	m_nAnimTracks--;
+	m_nAnimTrackBytes -= ptrack->size;
+
+	delete[] ptrack->frames;
+	delete ptrack;
+}
+
+/*
+====================
+StudioFlushAnimTracks
+
+====================
+*/
+void CStudioModelRenderer::StudioFlushAnimTracks()
+{
+	while (m_pAnimTrackOldest)
+		StudioFreeAnimTrack(m_pAnimTrackOldest);
 }
 
 /*
@@ -333,28 +649,12 @@ StudioSlerpBones
 */
 void CStudioModelRenderer::StudioSlerpBones(vec4_t q1[], float pos1[][3], vec4_t q2[], float pos2[][3], float s)
 {
-	int i;
-	vec4_t q3;
-	float s1;
-
 	if (s < 0)
 		s = 0;
 	else if (s > 1.0)
 		s = 1.0;
 
-	s1 = 1.0 - s;
-
-	for (i = 0; i < m_pStudioHeader->numbones; i++)
-	{
-		QuaternionSlerp(q1[i], q2[i], s, q3);
-		q1[i][0] = q3[0];
-		q1[i][1] = q3[1];
-		q1[i][2] = q3[2];
-		q1[i][3] = q3[3];
-		pos1[i][0] = pos1[i][0] * s1 + pos2[i][0] * s;
-		pos1[i][1] = pos1[i][1] * s1 + pos2[i][1] * s;
-		pos1[i][2] = pos1[i][2] * s1 + pos2[i][2] * s;
-	}
+	QuaternionSlerpBones(q1, pos1, q2, pos2, s, m_pStudioHeader->numbones);
 }
 
 /*
@@ -638,13 +938,28 @@ void CStudioModelRenderer::StudioCalcRotations(float pos[][3], vec4_t* q, mstudi
 
 	StudioCalcBoneAdj(dadt, adj, m_pCurrentEntity->curstate.controller, m_pCurrentEntity->latched.prevcontroller, m_pCurrentEntity->mouth.mouthopen);
 
-	for (i = 0; i < m_pStudioHeader->numbones; i++, pbone++, panim++)
+	// already decoded? then there's no need to go looking for the frame
+	studio_anim_track_t* ptrack = StudioGetAnimTrack(pseqdesc, panim);
+	if (ptrack && frame >= 0 && frame < ptrack->numframes)
+	{
+		studio_anim_frame_t* pframe = &ptrack->frames[frame * ptrack->numbones];
+
+		for (i = 0; i < m_pStudioHeader->numbones; i++, pbone++, pframe++)
+		{
+			StudioCalcBoneQuaterion(s, pbone, pframe, adj, q[i]);
+			StudioCalcBonePosition(s, pbone, pframe, adj, pos[i]);
+		}
+	}
+	else
 	{
-		StudioCalcBoneQuaterion(frame, s, pbone, panim, adj, q[i]);
+		for (i = 0; i < m_pStudioHeader->numbones; i++, pbone++, panim++)
+		{
+			StudioCalcBoneQuaterion(frame, s, pbone, panim, adj, q[i]);
 
-		StudioCalcBonePosition(frame, s, pbone, panim, adj, pos[i]);
-		// if (0 && i == 0)
-		//	Con_DPrintf("%d %d %d %d\n", m_pCurrentEntity->curstate.sequence, frame, j, k );
+			StudioCalcBonePosition(frame, s, pbone, panim, adj, pos[i]);
+			// if (0 && i == 0)
+			//	Con_DPrintf("%d %d %d %d\n", m_pCurrentEntity->curstate.sequence, frame, j, k );
+		}
 	}
 
 	if ((pseqdesc->motiontype & STUDIO_X) != 0)
@@ -797,16 +1112,17 @@ void CStudioModelRenderer::StudioSetupBones()
 	mstudioseqdesc_t* pseqdesc;
 	mstudioanim_t* panim;
 
-	static float pos[MAXSTUDIOBONES][3];
-	static vec4_t q[MAXSTUDIOBONES];
-	float bonematrix[3][4];
+	alignas(16) static float pos[MAXSTUDIOBONES][3];
+	alignas(16) static vec4_t q[MAXSTUDIOBONES];
 
-	static float pos2[MAXSTUDIOBONES][3];
-	static vec4_t q2[MAXSTUDIOBONES];
-	static float pos3[MAXSTUDIOBONES][3];
-	static vec4_t q3[MAXSTUDIOBONES];
-	static float pos4[MAXSTUDIOBONES][3];
-	static vec4_t q4[MAXSTUDIOBONES];
+	alignas(16) static float pos2[MAXSTUDIOBONES][3];
+	alignas(16) static vec4_t q2[MAXSTUDIOBONES];
+	alignas(16) static float pos3[MAXSTUDIOBONES][3];
+	alignas(16) static vec4_t q3[MAXSTUDIOBONES];
+	alignas(16) static float pos4[MAXSTUDIOBONES][3];
+	alignas(16) static vec4_t q4[MAXSTUDIOBONES];
+
+	alignas(16) static float bonematrices[MAXSTUDIOBONES][3][4];
 
 	if (m_pCurrentEntity->curstate.sequence >= m_pStudioHeader->numseq)
 	{
@@ -815,6 +1131,15 @@ void CStudioModelRenderer::StudioSetupBones()
 
 	pseqdesc = (mstudioseqdesc_t*)((byte*)m_pStudioHeader + m_pStudioHeader->seqindex) + m_pCurrentEntity->curstate.sequence;
 
+	// bounds checking
+	if (m_pPlayerInfo)
+	{
+		if (m_pPlayerInfo->gaitsequence >= m_pStudioHeader->numseq)
+		{
+			m_pPlayerInfo->gaitsequence = 0;
+		}
+	}
+
 	// always want new gait sequences to start on frame zero
 	/*	if ( m_pPlayerInfo )
 	{
@@ -838,6 +1163,66 @@ void CStudioModelRenderer::StudioSetupBones()
 		//Con_DPrintf("%f %f\n", m_pCurrentEntity->prevframe, f );
 	}
 
+	bool blendprev = m_fDoInterp &&
+					 0 != m_pCurrentEntity->latched.sequencetime &&
+					 (m_pCurrentEntity->latched.sequencetime + 0.2 > m_clTime) &&
+					 (m_pCurrentEntity->latched.prevsequence < m_pStudioHeader->numseq);
+
+	// the effects change the final transforms every time
+	bool fx = m_pCurrentEntity->curstate.renderfx == kRenderFxDistort || m_pCurrentEntity->curstate.renderfx == kRenderFxHologram || m_pCurrentEntity->curstate.renderfx == kRenderFxExplode;
+
+	// if nothing's changed since last time, neither have the bones.
+	// (not while blending out of the last sequence though, that changes every frame)
+	studio_bone_cache_t* pCache = NULL;
+	studio_bone_key_t key;
+	if (!blendprev)
+		pCache = StudioGetBoneCache();
+
+	if (pCache)
+	{
+		memset(&key, 0, sizeof(key));
+		key.model = m_pRenderModel;
+		key.sequence = m_pCurrentEntity->curstate.sequence;
+		key.frame = f;
+		key.dadt = StudioEstimateInterpolant();
+		memcpy(key.controller, m_pCurrentEntity->curstate.controller, sizeof(key.controller));
+		memcpy(key.prevcontroller, m_pCurrentEntity->latched.prevcontroller, sizeof(key.prevcontroller));
+		memcpy(key.blending, m_pCurrentEntity->curstate.blending, sizeof(key.blending));
+		memcpy(key.prevblending, m_pCurrentEntity->latched.prevblending, sizeof(key.prevblending));
+		key.mouthopen = m_pCurrentEntity->mouth.mouthopen;
+		key.gaitsequence = m_pPlayerInfo ? m_pPlayerInfo->gaitsequence : -1;
+		key.gaitframe = m_pPlayerInfo ? m_pPlayerInfo->gaitframe : 0;
+
+		if (pCache->valid && pCache->numbones == m_pStudioHeader->numbones && 0 == memcmp(&key, &pCache->key, sizeof(key)))
+		{
+			m_pCurrentEntity->latched.prevframe = f;
+
+			if (pCache->transformsvalid && !fx && 0 != IEngineStudio.IsHardware() && 0 == memcmp(pCache->rotationmatrix, (*m_protationmatrix), sizeof(pCache->rotationmatrix)))
+			{
+				// hasn't moved either
+				memcpy((*m_pbonetransform), pCache->bonetransform, pCache->numbones * sizeof(pCache->bonetransform[0]));
+				memcpy((*m_plighttransform), pCache->lighttransform, pCache->numbones * sizeof(pCache->lighttransform[0]));
+				m_nBoneCacheHits++;
+				m_flBoneCacheSaved += m_flBoneSetupTime * pCache->numbones;
+				return;
+			}
+
+			StudioConcatBones(pCache->bonematrix);
+
+			pCache->transformsvalid = !fx && 0 != IEngineStudio.IsHardware();
+			if (pCache->transformsvalid)
+			{
+				memcpy(pCache->rotationmatrix, (*m_protationmatrix), sizeof(pCache->rotationmatrix));
+				memcpy(pCache->bonetransform, (*m_pbonetransform), pCache->numbones * sizeof(pCache->bonetransform[0]));
+				memcpy(pCache->lighttransform, (*m_plighttransform), pCache->numbones * sizeof(pCache->lighttransform[0]));
+			}
+			m_nBoneCachePartialHits++;
+			return;
+		}
+	}
+
+	auto starttime = std::chrono::steady_clock::now();
+
 	panim = StudioGetAnim(m_pRenderModel, pseqdesc);
 	StudioCalcRotations(pos, q, pseqdesc, panim, f);
 
@@ -870,14 +1255,11 @@ void CStudioModelRenderer::StudioSetupBones()
 		}
 	}
 
-	if (m_fDoInterp &&
-		0 != m_pCurrentEntity->latched.sequencetime &&
-		(m_pCurrentEntity->latched.sequencetime + 0.2 > m_clTime) &&
-		(m_pCurrentEntity->latched.prevsequence < m_pStudioHeader->numseq))
+	if (blendprev)
 	{
 		// blend from last sequence
-		static float pos1b[MAXSTUDIOBONES][3];
-		static vec4_t q1b[MAXSTUDIOBONES];
+		alignas(16) static float pos1b[MAXSTUDIOBONES][3];
+		alignas(16) static vec4_t q1b[MAXSTUDIOBONES];
 		float s;
 
 		if (m_pCurrentEntity->latched.prevsequence >= m_pStudioHeader->numseq)
@@ -925,15 +1307,6 @@ void CStudioModelRenderer::StudioSetupBones()
 
 	pbones = (mstudiobone_t*)((byte*)m_pStudioHeader + m_pStudioHeader->boneindex);
 
-	// bounds checking
-	if (m_pPlayerInfo)
-	{
-		if (m_pPlayerInfo->gaitsequence >= m_pStudioHeader->numseq)
-		{
-			m_pPlayerInfo->gaitsequence = 0;
-		}
-	}
-
 	// calc gait animation
 	if (m_pPlayerInfo && m_pPlayerInfo->gaitsequence != 0)
 	{
@@ -968,28 +1341,61 @@ void CStudioModelRenderer::StudioSetupBones()
 		}
 	}
 
-	for (i = 0; i < m_pStudioHeader->numbones; i++)
+	QuaternionMatrixBones(q, pos, bonematrices, m_pStudioHeader->numbones);
+
+	StudioConcatBones(bonematrices);
+
+	if (pCache)
 	{
-		QuaternionMatrix(q[i], bonematrix);
+		double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - starttime).count();
+		if (m_pStudioHeader->numbones > 0)
+			m_flBoneSetupTime = m_flBoneSetupTime * 0.99 + (time / m_pStudioHeader->numbones) * 0.01;
 
-		bonematrix[0][3] = pos[i][0];
-		bonematrix[1][3] = pos[i][1];
-		bonematrix[2][3] = pos[i][2];
+		memcpy(&pCache->key, &key, sizeof(key));
+		pCache->valid = true;
+		pCache->numbones = m_pStudioHeader->numbones;
+		memcpy(pCache->bonematrix, bonematrices, pCache->numbones * sizeof(pCache->bonematrix[0]));
 
+		pCache->transformsvalid = !fx && 0 != IEngineStudio.IsHardware();
+		if (pCache->transformsvalid)
+		{
+			memcpy(pCache->rotationmatrix, (*m_protationmatrix), sizeof(pCache->rotationmatrix));
+			memcpy(pCache->bonetransform, (*m_pbonetransform), pCache->numbones * sizeof(pCache->bonetransform[0]));
+			memcpy(pCache->lighttransform, (*m_plighttransform), pCache->numbones * sizeof(pCache->lighttransform[0]));
+		}
+		m_nBoneCacheMisses++;
+	}
+}
+
+/*
+====================
+StudioConcatBones
+
+====================
+*/
+void CStudioModelRenderer::StudioConcatBones(float bonematrix[][3][4])
+{
+	int i;
+	mstudiobone_t* pbones;
+
+	pbones = (mstudiobone_t*)((byte*)m_pStudioHeader + m_pStudioHeader->boneindex);
+
+	for (i = 0; i < m_pStudioHeader->numbones; i++)
+	{
 		if (pbones[i].parent == -1)
 		{
 			if (0 != IEngineStudio.IsHardware())
 			{
-				ConcatTransforms((*m_protationmatrix), bonematrix, (*m_pbonetransform)[i]);
+				ConcatTransformsSIMD((*m_protationmatrix), bonematrix[i], (*m_pbonetransform)[i]);
 
 				// MatrixCopy should be faster...
-				//ConcatTransforms ((*m_protationmatrix), bonematrix, (*m_plighttransform)[i]);
+				//ConcatTransforms ((*m_protationmatrix), bonematrix[i], (*m_plighttransform)[i]);
 				MatrixCopy((*m_pbonetransform)[i], (*m_plighttransform)[i]);
 			}
 			else
 			{
-				ConcatTransforms((*m_paliastransform), bonematrix, (*m_pbonetransform)[i]);
-				ConcatTransforms((*m_protationmatrix), bonematrix, (*m_plighttransform)[i]);
+				ConcatTransformsSIMD((*m_paliastransform), bonematrix[i], (*m_pbonetransform)[i]);
+				ConcatTransformsSIMD((*m_protationmatrix), bonematrix[i], (*m_plighttransform)[i]);
 			}
 
 			// Apply client-side effects to the transformation matrix
@@ -997,8 +1403,8 @@ void CStudioModelRenderer::StudioSetupBones()
 		}
 		else
 		{
-			ConcatTransforms((*m_pbonetransform)[pbones[i].parent], bonematrix, (*m_pbonetransform)[i]);
-			ConcatTransforms((*m_plighttransform)[pbones[i].parent], bonematrix, (*m_plighttransform)[i]);
+			ConcatTransformsSIMD((*m_pbonetransform)[pbones[i].parent], bonematrix[i], (*m_pbonetransform)[i]);
+			ConcatTransformsSIMD((*m_plighttransform)[pbones[i].parent], bonematrix[i], (*m_plighttransform)[i]);
 		}
 	}
 }
@@ -1043,9 +1449,9 @@ void CStudioModelRenderer::StudioMergeBones(model_t* m_pSubModel)
 	mstudioseqdesc_t* pseqdesc;
 	mstudioanim_t* panim;
 
-	static float pos[MAXSTUDIOBONES][3];
-	float bonematrix[3][4];
-	static vec4_t q[MAXSTUDIOBONES];
+	alignas(16) static float pos[MAXSTUDIOBONES][3];
+	alignas(16) static vec4_t q[MAXSTUDIOBONES];
+	alignas(16) static float bonematrices[MAXSTUDIOBONES][3][4];
 
 	if (m_pCurrentEntity->curstate.sequence >= m_pStudioHeader->numseq)
 	{
@@ -1063,6 +1469,7 @@ void CStudioModelRenderer::StudioMergeBones(model_t* m_pSubModel)
 
 	panim = StudioGetAnim(m_pSubModel, pseqdesc);
 	StudioCalcRotations(pos, q, pseqdesc, panim, f);
+	QuaternionMatrixBones(q, pos, bonematrices, m_pStudioHeader->numbones);
 
 	pbones = (mstudiobone_t*)((byte*)m_pStudioHeader + m_pStudioHeader->boneindex);
 
@@ -1080,26 +1487,20 @@ void CStudioModelRenderer::StudioMergeBones(model_t* m_pSubModel)
 		}
 		if (j >= m_nCachedBones)
 		{
-			QuaternionMatrix(q[i], bonematrix);
-
-			bonematrix[0][3] = pos[i][0];
-			bonematrix[1][3] = pos[i][1];
-			bonematrix[2][3] = pos[i][2];
-
 			if (pbones[i].parent == -1)
 			{
 				if (0 != IEngineStudio.IsHardware())
 				{
-					ConcatTransforms((*m_protationmatrix), bonematrix, (*m_pbonetransform)[i]);
+					ConcatTransformsSIMD((*m_protationmatrix), bonematrices[i], (*m_pbonetransform)[i]);
 
 					// MatrixCopy should be faster...
-					//ConcatTransforms ((*m_protationmatrix), bonematrix, (*m_plighttransform)[i]);
+					//ConcatTransforms ((*m_protationmatrix), bonematrices[i], (*m_plighttransform)[i]);
 					MatrixCopy((*m_pbonetransform)[i], (*m_plighttransform)[i]);
 				}
 				else
 				{
-					ConcatTransforms((*m_paliastransform), bonematrix, (*m_pbonetransform)[i]);
-					ConcatTransforms((*m_protationmatrix), bonematrix, (*m_plighttransform)[i]);
+					ConcatTransformsSIMD((*m_paliastransform), bonematrices[i], (*m_pbonetransform)[i]);
+					ConcatTransformsSIMD((*m_protationmatrix), bonematrices[i], (*m_plighttransform)[i]);
 				}
 
 				// Apply client-side effects to the transformation matrix
@@ -1107,8 +1508,8 @@ void CStudioModelRenderer::StudioMergeBones(model_t* m_pSubModel)
 			}
 			else
 			{
-				ConcatTransforms((*m_pbonetransform)[pbones[i].parent], bonematrix, (*m_pbonetransform)[i]);
-				ConcatTransforms((*m_plighttransform)[pbones[i].parent], bonematrix, (*m_plighttransform)[i]);
+				ConcatTransformsSIMD((*m_pbonetransform)[pbones[i].parent], bonematrices[i], (*m_pbonetransform)[i]);
+				ConcatTransformsSIMD((*m_plighttransform)[pbones[i].parent], bonematrices[i], (*m_plighttransform)[i]);
 			}
 		}
 	}
@@ -1128,6 +1529,7 @@ bool CStudioModelRenderer::StudioDrawModel(int flags)
 
 	m_pCurrentEntity = IEngineStudio.GetCurrentEntity();
 	IEngineStudio.GetTimes(&m_nFrameCount, &m_clTime, &m_clOldTime);
+	StudioCacheFrame();
 	IEngineStudio.GetViewInfo(m_vRenderOrigin, m_vUp, m_vRight, m_vNormal);
 	IEngineStudio.GetAliasScale(&m_fSoftwareXScale, &m_fSoftwareYScale);
 
@@ -1484,6 +1886,7 @@ bool CStudioModelRenderer::StudioDrawPlayer(int flags, entity_state_t* pplayer)
 
 	m_pCurrentEntity = IEngineStudio.GetCurrentEntity();
 	IEngineStudio.GetTimes(&m_nFrameCount, &m_clTime, &m_clOldTime);
+	StudioCacheFrame();
 	IEngineStudio.GetViewInfo(m_vRenderOrigin, m_vUp, m_vRight, m_vNormal);
 	IEngineStudio.GetAliasScale(&m_fSoftwareXScale, &m_fSoftwareYScale);
 
@@ -7,6 +7,67 @@
 
 #pragma once
 
+// Everything StudioSetupBones' result depends on, apart from the entity's own transform.
+// Compared with memcmp, so always memset it before filling it in.
+struct studio_bone_key_t
+{
+	model_t* model;
+	int sequence;
+	float frame;
+	float dadt;
+	byte controller[4];
+	byte prevcontroller[4];
+	byte blending[2];
+	byte prevblending[2];
+	byte mouthopen;
+	int gaitsequence;
+	float gaitframe;
+};
+
+// The last bones worked out for one entity
+struct studio_bone_cache_t
+{
+	studio_bone_key_t key;
+	bool valid;
+
+	int maxbones; // the size of the arrays below
+	int numbones;
+
+	// Bone matrices relative to their parents, from the key
+	float (*bonematrix)[3][4];
+
+	// Final transforms, from bonematrix and this rotation matrix (hardware only)
+	bool transformsvalid;
+	float rotationmatrix[3][4];
+	float (*bonetransform)[3][4];
+	float (*lighttransform)[3][4];
+};
+
+// A bone's six animation channels (position, then rotation) for one frame, and for the next frame,
+// still quantised. A channel with no animation is 0.
+struct studio_anim_frame_t
+{
+	short value1[6];
+	short value2[6];
+};
+
+// One sequence blend's animation, decoded from its run-length encoding so any frame can be looked up directly
+struct studio_anim_track_t
+{
+	mstudioanim_t* panim; // what it was decoded from
+	mstudioseqdesc_t* pseqdesc;
+	int numbones;
+	int numframes;
+	studio_anim_frame_t* frames; // numframes * numbones, by frame then bone
+	int size;					 // in bytes
+
+	studio_anim_track_t* hashnext;
+	studio_anim_track_t* lrunewer;
+	studio_anim_track_t* lruolder;
+};
+
+#define ANIM_TRACK_HASH 256
+
 /*
 ====================
 CStudioModelRenderer
@@ -41,6 +102,23 @@ public:
 	// Set up model bone positions
 	virtual void StudioSetupBones();
 
+	// Concatenate the bones' own matrices with their parents' to get the final transforms
+	virtual void StudioConcatBones(float bonematrix[][3][4]);
+
+	// Find the entity's bone cache entry, if it can have one
+	virtual studio_bone_cache_t* StudioGetBoneCache();
+
+	// Forget all the cached bones
+	virtual void StudioFlushBoneCache();
+
+	// Per-frame housekeeping for the caches
+	virtual void StudioCacheFrame();
+
+	// Find or make the decoded version of an animation
+	virtual studio_anim_track_t* StudioGetAnimTrack(mstudioseqdesc_t* pseqdesc, mstudioanim_t* panim);
+	virtual void StudioFreeAnimTrack(studio_anim_track_t* ptrack);
+	virtual void StudioFlushAnimTracks();
+
 	// Find final attachment points
 	virtual void StudioCalcAttachments();
 
@@ -67,9 +145,14 @@ public:
 
 	// Get bone quaternions
 	virtual void StudioCalcBoneQuaterion(int frame, float s, mstudiobone_t* pbone, mstudioanim_t* panim, float* adj, float* q);
+	virtual void StudioCalcBoneQuaterion(float s, mstudiobone_t* pbone, const studio_anim_frame_t* pframe, float* adj, float* q);
 
 	// Get bone positions
 	virtual void StudioCalcBonePosition(int frame, float s, mstudiobone_t* pbone, mstudioanim_t* panim, float* adj, float* pos);
+	virtual void StudioCalcBonePosition(float s, mstudiobone_t* pbone, const studio_anim_frame_t* pframe, float* adj, float* pos);
+
+	// Get a bone's animation values for a frame
+	virtual void StudioDecodeBoneFrame(int frame, mstudioanim_t* panim, studio_anim_frame_t* pframe);
 
 	// Compute rotations
 	virtual void StudioCalcRotations(float pos[][3], vec4_t* q, mstudioseqdesc_t* pseqdesc, mstudioanim_t* panim, float f);
@@ -116,6 +199,12 @@ public:
 	cvar_t* m_pCvarDeveloper;
 	// Draw entities bone hit boxes, etc?
 	cvar_t* m_pCvarDrawEntities;
+	// Reuse the bones of entities whose animation hasn't changed?
+	cvar_t* m_pCvarBoneCache;
+	// Decode animations once, rather than every time a frame's needed?
+	cvar_t* m_pCvarAnimCache;
+	// ...using no more than this many megabytes
+	cvar_t* m_pCvarAnimCacheSize;
 
 	// The entity which we are currently rendering.
 	cl_entity_t* m_pCurrentEntity;
@@ -156,6 +245,26 @@ public:
 	float m_rgCachedBoneTransform[MAXSTUDIOBONES][3][4];
 	float m_rgCachedLightTransform[MAXSTUDIOBONES][3][4];
 
+	// Per-entity bone cache, allocated as entities need it
+	studio_bone_cache_t* m_pBoneCache[MAX_EDICTS];
+	// The level the cache was filled on
+	char m_szBoneCacheLevel[64];
+	// This frame's bone cache results, for r_bonecache 2
+	int m_nCacheFrame;
+	int m_nBoneCacheHits, m_nBoneCachePartialHits, m_nBoneCacheMisses;
+	// Average time to set up one bone from scratch, in seconds
+	double m_flBoneSetupTime;
+	double m_flBoneCacheSaved;
+
+	// Decoded animations, hashed on panim, and in order of use
+	studio_anim_track_t* m_pAnimTrackHash[ANIM_TRACK_HASH];
+	studio_anim_track_t* m_pAnimTrackNewest;
+	studio_anim_track_t* m_pAnimTrackOldest;
+	int m_nAnimTracks;
+	int m_nAnimTrackBytes;
+	// This frame's, for r_animcache 2
+	int m_nAnimTracksDecoded, m_nAnimTracksEvicted;
+
 	// Software renderer scale factors
 	float m_fSoftwareXScale, m_fSoftwareYScale;
 
@@ -92,8 +92,16 @@ void WeaponsResource::LoadWeaponSprites(WEAPON* pWeapon)
 	pWeapon->hAmmo = 0;
 	pWeapon->hAmmo2 = 0;
 
-	sprintf(sz, "sprites/%s.txt", pWeapon->szName);
-	client_sprite_t* pList = SPR_GetList(sz, &i);
+	WEAPON_SPRITES* pSprites = &rgSpriteLists[pWeapon->iId];
+	if (0 != strncmp(pSprites->szName, pWeapon->szName, MAX_WEAPON_NAME))
+	{
+		sprintf(sz, "sprites/%s.txt", pWeapon->szName);
+		pSprites->pList = SPR_GetList(sz, &pSprites->iCount);
+		strncpy(pSprites->szName, pWeapon->szName, MAX_WEAPON_NAME);
+	}
+
+	client_sprite_t* pList = pSprites->pList;
+	i = pSprites->iCount;
 
 	if (!pList)
 		return;
@@ -31,6 +31,16 @@ private:
 	WEAPON* rgSlots[MAX_WEAPON_SLOTS + 1][MAX_WEAPON_POSITIONS + 1]; // The slots currently in use by weapons.  The value is a pointer to the weapon;  if it's NULL, no weapon is there
 	int riAmmo[MAX_AMMO_TYPES];										 // count of each ammo type
 
+	// parsed sprites/<weapon>.txt lists, by weapon id. these are kept across VidInit, so
+	// reconnects and resolution changes don't have to parse them again.
+	struct WEAPON_SPRITES
+	{
+		char szName[MAX_WEAPON_NAME]; // the weapon the list was parsed for
+		client_sprite_t* pList;
+		int iCount;
+	};
+	WEAPON_SPRITES rgSpriteLists[MAX_WEAPONS];
+
 public:
 	void Init()
 	{
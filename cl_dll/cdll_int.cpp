@@ -35,6 +35,7 @@
 #include "tri.h"
 #include "vgui_TeamFortressViewport.h"
 #include "filesystem_utils.h"
+#include "profiler.h"
 
 cl_enginefunc_t gEngfuncs;
 CHud gHUD;
@@ -170,7 +171,12 @@ redraw the HUD.
 
 int DLLEXPORT HUD_Redraw(float time, int intermission)
 {
-	gHUD.Redraw(time, 0 != intermission);
+	{
+		PROFILE_SCOPE(PROF_REDRAW);
+		gHUD.Redraw(time, 0 != intermission);
+	}
+
+	g_FrameProfiler.Draw(gHUD.m_scrinfo);
 
 	return 1;
 }
@@ -219,6 +225,8 @@ Called by engine every frame that client .dll is loaded
 
 void DLLEXPORT HUD_Frame(double time)
 {
+	g_FrameProfiler.Frame();
+
 	GetClientVoiceMgr()->Frame(time);
 }
 
@@ -15,6 +15,7 @@
 #include "Exports.h"
 
 #include "particleman.h"
+#include "profiler.h"
 extern IParticleMan* g_pParticleMan;
 
 void Game_AddObjects();
@@ -221,6 +222,8 @@ Gives us a chance to add additional entities to the render this frame
 */
 void DLLEXPORT HUD_CreateEntities()
 {
+	PROFILE_SCOPE(PROF_CREATEENTITIES);
+
 	// Add in any game specific objects
 	Game_AddObjects();
 
@@ -264,6 +267,281 @@ void DLLEXPORT HUD_StudioEvent(const struct mstudioevent_s* event, const struct
 	}
 }
 
+// tempents whose speed is under this only trace the world every few frames
+#define TENT_SLOW_SPEED 64
+// how far ahead (in seconds) one of those traces looks. short enough that the
+// curve of a falling tempent stays well within a unit of the traced chord.
+#define TENT_TRACE_AHEAD 0.05f
+// for slow tempents, the client time their path has been traced clear until.
+// kept here by tempent slot, since everything in the tempent is the engine's.
+#define TENT_CLEAR_UNTIL(pTemp) (g_rgflTempEntClearUntil[(pTemp)-g_pTempEntPool])
+#define TENT_IN_POOL(pTemp) ((pTemp) >= g_pTempEntPool && (pTemp) < g_pTempEntPool + g_iTempEntPoolSize)
+
+// movement types that can't be predicted by TempEntWorldClear
+#define FTENT_UNPREDICTABLE (FTENT_PLYRATTACHMENT | FTENT_SINEWAVE | FTENT_SPIRAL | FTENT_CLIENTCUSTOM | FTENT_COLLIDEALL)
+
+// the live tempents for this update, in list order, and sorted by behaviour
+// (as indices into that list) so that each kind runs through its own loop.
+// rebuilt every update.
+enum
+{
+	TENT_BUCKET_SPARKSHOWER,
+	TENT_BUCKET_ATTACHED,
+	TENT_BUCKET_SINEWAVE,
+	TENT_BUCKET_SPIRAL,
+	TENT_BUCKET_LINEAR,
+	TENT_BUCKET_ANIMATE,
+	TENT_BUCKET_CYCLE,
+	TENT_BUCKET_COLLIDE,
+	TENT_NUM_BUCKETS
+};
+
+static TEMPENTITY** g_rgpTempEnts = NULL; // a slot is NULLed if its tempent is done for this update
+static int g_iTempEntCount = 0;
+static int* g_rgiTempEntBuckets[TENT_NUM_BUCKETS];
+static int g_rgiTempEntBucketCount[TENT_NUM_BUCKETS];
+static int g_iTempEntBucketMax = 0;
+
+// the engine keeps its tempents in one array; this is where it is
+static TEMPENTITY* g_pTempEntPool = NULL;
+static int g_iTempEntPoolSize = 0;
+static float* g_rgflTempEntClearUntil = NULL;
+
+cvar_t* cl_tempent_amortize = nullptr;
+
+static inline void TempEntBucketAdd(int iBucket, int iIndex)
+{
+	g_rgiTempEntBuckets[iBucket][g_rgiTempEntBucketCount[iBucket]++] = iIndex;
+}
+
+static void TempEntGrowBuckets()
+{
+	// the engine's pool is 500, so this only happens a few times
+	const int iMax = V_max(64, g_iTempEntBucketMax * 2);
+
+	TEMPENTITY** rgpTempEnts = new TEMPENTITY*[iMax];
+	if (g_iTempEntCount > 0)
+		memcpy(rgpTempEnts, g_rgpTempEnts, g_iTempEntCount * sizeof(TEMPENTITY*));
+	delete[] g_rgpTempEnts;
+	g_rgpTempEnts = rgpTempEnts;
+
+	for (int i = 0; i < TENT_NUM_BUCKETS; i++)
+	{
+		int* rgiBucket = new int[iMax];
+		if (g_rgiTempEntBucketCount[i] > 0)
+			memcpy(rgiBucket, g_rgiTempEntBuckets[i], g_rgiTempEntBucketCount[i] * sizeof(int));
+		delete[] g_rgiTempEntBuckets[i];
+		g_rgiTempEntBuckets[i] = rgiBucket;
+	}
+
+	g_iTempEntBucketMax = iMax;
+}
+
+// between them, the free and active lists hold every tempent the engine has
+static void TempEntFindPool(TEMPENTITY* pFree, TEMPENTITY* pActive)
+{
+	TEMPENTITY* pFirst = pActive;
+	TEMPENTITY* pLast = pActive;
+
+	for (TEMPENTITY* pTemp = pFree; pTemp; pTemp = pTemp->next)
+	{
+		pFirst = V_min(pFirst, pTemp);
+		pLast = V_max(pLast, pTemp);
+	}
+	for (TEMPENTITY* pTemp = pActive; pTemp; pTemp = pTemp->next)
+	{
+		pFirst = V_min(pFirst, pTemp);
+		pLast = V_max(pLast, pTemp);
+	}
+
+	delete[] g_rgflTempEntClearUntil;
+	g_pTempEntPool = pFirst;
+	g_iTempEntPoolSize = pLast - pFirst + 1;
+	g_rgflTempEntClearUntil = new float[g_iTempEntPoolSize];
+	memset(g_rgflTempEntClearUntil, 0, g_iTempEntPoolSize * sizeof(float));
+}
+
+/*
+=================
+TempEntWorldClear
+
+Amortised world collision for slow tempents. Traces TENT_TRACE_AHEAD seconds
+of movement from where the tempent started this frame, and if nothing's in
+the way, skips its traces until it's used that time up.
+Returns true if the tempent can't have hit anything this frame.
+=================
+*/
+static bool TempEntWorldClear(TEMPENTITY* pTemp, float frametime, double client_time, float gravity)
+{
+	// (after a map change, the slot can still have a time from the last one)
+	const float flClearUntil = TENT_CLEAR_UNTIL(pTemp);
+	if (client_time <= flClearUntil && flClearUntil < client_time + TENT_TRACE_AHEAD)
+		return true;
+
+	if (frametime >= TENT_TRACE_AHEAD)
+		return false;
+
+	// the chord of its path, assuming nothing changes its velocity but gravity
+	// (gravity here is per-frame, like the velocity change in HUD_TempEntUpdate)
+	float flAccel = 0;
+	if ((pTemp->flags & FTENT_GRAVITY) != 0)
+		flAccel = gravity / frametime;
+	else if ((pTemp->flags & FTENT_SLOWGRAVITY) != 0)
+		flAccel = gravity * 0.5 / frametime;
+
+	Vector vecEnd;
+	VectorMA(pTemp->entity.prevstate.origin, TENT_TRACE_AHEAD, pTemp->entity.baseline.origin, vecEnd);
+	vecEnd[2] += 0.5 * flAccel * TENT_TRACE_AHEAD * TENT_TRACE_AHEAD;
+
+	pmtrace_t pmtrace;
+	gEngfuncs.pEventAPI->EV_SetTraceHull(2);
+	gEngfuncs.pEventAPI->EV_PlayerTrace(pTemp->entity.prevstate.origin, vecEnd, PM_STUDIO_BOX | PM_WORLD_ONLY, -1, &pmtrace);
+
+	if (pmtrace.fraction == 1)
+	{
+		TENT_CLEAR_UNTIL(pTemp) = client_time - frametime + TENT_TRACE_AHEAD;
+		return true;
+	}
+
+	// it'll hit something, but maybe not yet
+	return 0 == pmtrace.startsolid && pmtrace.fraction * TENT_TRACE_AHEAD > frametime;
+}
+
+/*
+=================
+TempEntCollide
+
+Collision and bounce for one COLLIDEALL or COLLIDEWORLD tempent
+=================
+*/
+static void TempEntCollide(TEMPENTITY* pTemp, double frametime, double client_time, float gravity, bool bAmortize,
+	void (*Callback_TempEntPlaySound)(TEMPENTITY* pTemp, float damp))
+{
+	Vector traceNormal;
+	float traceFraction = 1;
+
+	if ((pTemp->flags & FTENT_COLLIDEALL) != 0)
+	{
+		pmtrace_t pmtrace;
+		physent_t* pe;
+
+		gEngfuncs.pEventAPI->EV_SetTraceHull(2);
+
+		gEngfuncs.pEventAPI->EV_PlayerTrace(pTemp->entity.prevstate.origin, pTemp->entity.origin, PM_STUDIO_BOX, -1, &pmtrace);
+
+
+		if (pmtrace.fraction != 1)
+		{
+			pe = gEngfuncs.pEventAPI->EV_GetPhysent(pmtrace.ent);
+
+			if (0 == pmtrace.ent || (pe->info != pTemp->clientIndex))
+			{
+				traceFraction = pmtrace.fraction;
+				VectorCopy(pmtrace.plane.normal, traceNormal);
+
+				if (pTemp->hitcallback)
+				{
+					(*pTemp->hitcallback)(pTemp, &pmtrace);
+				}
+			}
+		}
+	}
+	else if ((pTemp->flags & FTENT_COLLIDEWORLD) != 0)
+	{
+		if (bAmortize && (pTemp->flags & FTENT_UNPREDICTABLE) == 0 &&
+			DotProduct(pTemp->entity.baseline.origin, pTemp->entity.baseline.origin) < TENT_SLOW_SPEED * TENT_SLOW_SPEED &&
+			TempEntWorldClear(pTemp, frametime, client_time, gravity))
+			return;
+
+		pmtrace_t pmtrace;
+
+		gEngfuncs.pEventAPI->EV_SetTraceHull(2);
+
+		gEngfuncs.pEventAPI->EV_PlayerTrace(pTemp->entity.prevstate.origin, pTemp->entity.origin, PM_STUDIO_BOX | PM_WORLD_ONLY, -1, &pmtrace);
+
+		if (pmtrace.fraction != 1)
+		{
+			traceFraction = pmtrace.fraction;
+			VectorCopy(pmtrace.plane.normal, traceNormal);
+
+			if ((pTemp->flags & FTENT_SPARKSHOWER) != 0)
+			{
+				// Chop spark speeds a bit more
+				//
+				VectorScale(pTemp->entity.baseline.origin, 0.6, pTemp->entity.baseline.origin);
+
+				if (Length(pTemp->entity.baseline.origin) < 10)
+				{
+					pTemp->entity.baseline.framerate = 0.0;
+				}
+			}
+
+			if (pTemp->hitcallback)
+			{
+				(*pTemp->hitcallback)(pTemp, &pmtrace);
+			}
+		}
+	}
+
+	if (traceFraction != 1) // Decent collision now, and damping works
+	{
+		float proj, damp;
+
+		// its velocity is about to change, so any path traced ahead is no good
+		TENT_CLEAR_UNTIL(pTemp) = 0;
+
+		// Place at contact point
+		VectorMA(pTemp->entity.prevstate.origin, traceFraction * frametime, pTemp->entity.baseline.origin, pTemp->entity.origin);
+		// Damp velocity
+		damp = pTemp->bounceFactor;
+		if ((pTemp->flags & (FTENT_GRAVITY | FTENT_SLOWGRAVITY)) != 0)
+		{
+			damp *= 0.5;
+			if (traceNormal[2] > 0.9) // Hit floor?
+			{
+				if (pTemp->entity.baseline.origin[2] <= 0 && pTemp->entity.baseline.origin[2] >= gravity * 3)
+				{
+					damp = 0; // Stop
+					pTemp->flags &= ~(FTENT_ROTATE | FTENT_GRAVITY | FTENT_SLOWGRAVITY | FTENT_COLLIDEWORLD | FTENT_SMOKETRAIL);
+					pTemp->entity.angles[0] = 0;
+					pTemp->entity.angles[2] = 0;
+				}
+			}
+		}
+
+		if ((pTemp->hitSound) != 0)
+		{
+			Callback_TempEntPlaySound(pTemp, damp);
+		}
+
+		if ((pTemp->flags & FTENT_COLLIDEKILL) != 0)
+		{
+			// die on impact
+			pTemp->flags &= ~FTENT_FADEOUT;
+			pTemp->die = client_time;
+		}
+		else
+		{
+			// Reflect velocity
+			if (damp != 0)
+			{
+				proj = DotProduct(pTemp->entity.baseline.origin, traceNormal);
+				VectorMA(pTemp->entity.baseline.origin, -proj * 2, traceNormal, pTemp->entity.baseline.origin);
+				// Reflect rotation (fake)
+
+				pTemp->entity.angles[1] = -pTemp->entity.angles[1];
+			}
+
+			if (damp != 1)
+			{
+
+				VectorScale(pTemp->entity.baseline.origin, damp, pTemp->entity.baseline.origin);
+				VectorScale(pTemp->entity.angles, 0.9, pTemp->entity.angles);
+			}
+		}
+	}
+}
+
 /*
 =================
 CL_UpdateTEnts
@@ -280,10 +558,14 @@ void DLLEXPORT HUD_TempEntUpdate(
 	int (*Callback_AddVisibleEntity)(cl_entity_t* pEntity),
 	void (*Callback_TempEntPlaySound)(TEMPENTITY* pTemp, float damp))
 {
+	PROFILE_SCOPE(PROF_TEMPENTS);
+
 	static int gTempEntFrame = 0;
-	int i;
+	int i, j;
 	TEMPENTITY *pTemp, *pnext, *pprev;
+	int* piBucket;
 	float freq, gravity, gravitySlow, life, fastFreq;
+	bool bCollideAll, bFindPool;
 
 	Vector vAngles;
 
@@ -296,18 +578,6 @@ void DLLEXPORT HUD_TempEntUpdate(
 	if (!*ppTempEntActive)
 		return;
 
-	// in order to have tents collide with players, we have to run the player prediction code so
-	// that the client has the player list. We run this code once when we detect any COLLIDEALL
-	// tent, then set this bool to true so the code doesn't get run again if there's more than
-	// one COLLIDEALL ent for this update. (often are).
-	gEngfuncs.pEventAPI->EV_SetUpPlayerPrediction(0, 1);
-
-	// Store off the old count
-	gEngfuncs.pEventAPI->EV_PushPMStates();
-
-	// Now add in all of the players.
-	gEngfuncs.pEventAPI->EV_SetSolidPlayers(-1);
-
 	// !!!BUGBUG	-- This needs to be time based
 	gTempEntFrame = (gTempEntFrame + 1) & 31;
 
@@ -324,7 +594,7 @@ void DLLEXPORT HUD_TempEntUpdate(
 			}
 			pTemp = pTemp->next;
 		}
-		goto finish;
+		return;
 	}
 
 	pprev = NULL;
@@ -333,6 +603,12 @@ void DLLEXPORT HUD_TempEntUpdate(
 	gravity = -frametime * cl_gravity;
 	gravitySlow = gravity * 0.5;
 
+	// Free the dead ones, and sort the rest by how they move and animate
+	memset(g_rgiTempEntBucketCount, 0, sizeof(g_rgiTempEntBucketCount));
+	g_iTempEntCount = 0;
+	bCollideAll = false;
+	bFindPool = false;
+
 	while (pTemp)
 	{
 		bool active;
@@ -356,6 +632,10 @@ void DLLEXPORT HUD_TempEntUpdate(
 		}
 		if (!active) // Kill it
 		{
+			// so whatever's next in this slot doesn't think its path is clear
+			if (TENT_IN_POOL(pTemp))
+				TENT_CLEAR_UNTIL(pTemp) = 0;
+
 			pTemp->next = *ppTempEntFree;
 			*ppTempEntFree = pTemp;
 			if (!pprev) // Deleting at head of list
@@ -367,270 +647,250 @@ void DLLEXPORT HUD_TempEntUpdate(
 		{
 			pprev = pTemp;
 
+			if (g_iTempEntCount == g_iTempEntBucketMax)
+				TempEntGrowBuckets();
+
+			const int flags = pTemp->flags;
+			const int index = g_iTempEntCount++;
+
+			g_rgpTempEnts[index] = pTemp;
+
+			if (!TENT_IN_POOL(pTemp))
+				bFindPool = true;
+
 			VectorCopy(pTemp->entity.origin, pTemp->entity.prevstate.origin);
 
-			if ((pTemp->flags & FTENT_SPARKSHOWER) != 0)
-			{
-				// Adjust speed if it's time
-				// Scale is next think time
-				if (client_time > pTemp->entity.baseline.scale)
-				{
-					// Show Sparks
-					gEngfuncs.pEfxAPI->R_SparkEffect(pTemp->entity.origin, 8, -200, 200);
-
-					// Reduce life
-					pTemp->entity.baseline.framerate -= 0.1;
-
-					if (pTemp->entity.baseline.framerate <= 0.0)
-					{
-						pTemp->die = client_time;
-					}
-					else
-					{
-						// So it will die no matter what
-						pTemp->die = client_time + 0.5;
-
-						// Next think
-						pTemp->entity.baseline.scale = client_time + 0.1;
-					}
-				}
-			}
-			else if ((pTemp->flags & FTENT_PLYRATTACHMENT) != 0)
-			{
-				cl_entity_t* pClient;
+			if ((flags & FTENT_SPARKSHOWER) != 0)
+				TempEntBucketAdd(TENT_BUCKET_SPARKSHOWER, index);
+			else if ((flags & FTENT_PLYRATTACHMENT) != 0)
+				TempEntBucketAdd(TENT_BUCKET_ATTACHED, index);
+			else if ((flags & FTENT_SINEWAVE) != 0)
+				TempEntBucketAdd(TENT_BUCKET_SINEWAVE, index);
+			else if ((flags & FTENT_SPIRAL) != 0)
+				TempEntBucketAdd(TENT_BUCKET_SPIRAL, index);
+			else
+				TempEntBucketAdd(TENT_BUCKET_LINEAR, index);
 
-				pClient = gEngfuncs.GetEntityByIndex(pTemp->clientIndex);
+			if ((flags & FTENT_SPRANIMATE) != 0)
+				TempEntBucketAdd(TENT_BUCKET_ANIMATE, index);
+			else if ((flags & FTENT_SPRCYCLE) != 0)
+				TempEntBucketAdd(TENT_BUCKET_CYCLE, index);
+		}
+		pTemp = pnext;
+	}
 
-				VectorAdd(pClient->origin, pTemp->tentOffset, pTemp->entity.origin);
-			}
-			else if ((pTemp->flags & FTENT_SINEWAVE) != 0)
-			{
-				pTemp->x += pTemp->entity.baseline.origin[0] * frametime;
-				pTemp->y += pTemp->entity.baseline.origin[1] * frametime;
+	if (bFindPool)
+		TempEntFindPool(*ppTempEntFree, *ppTempEntActive);
 
-				pTemp->entity.origin[0] = pTemp->x + sin(pTemp->entity.baseline.origin[2] + client_time * pTemp->entity.prevstate.frame) * (10 * pTemp->entity.curstate.framerate);
-				pTemp->entity.origin[1] = pTemp->y + sin(pTemp->entity.baseline.origin[2] + fastFreq + 0.7) * (8 * pTemp->entity.curstate.framerate);
-				pTemp->entity.origin[2] += pTemp->entity.baseline.origin[2] * frametime;
-			}
-			else if ((pTemp->flags & FTENT_SPIRAL) != 0)
-			{
-				float s, c;
-				s = sin(pTemp->entity.baseline.origin[2] + fastFreq);
-				c = cos(pTemp->entity.baseline.origin[2] + fastFreq);
+	// Move
+	piBucket = g_rgiTempEntBuckets[TENT_BUCKET_SPARKSHOWER];
+	for (j = 0; j < g_rgiTempEntBucketCount[TENT_BUCKET_SPARKSHOWER]; j++)
+	{
+		pTemp = g_rgpTempEnts[piBucket[j]];
 
-				pTemp->entity.origin[0] += pTemp->entity.baseline.origin[0] * frametime + 8 * sin(client_time * 20 + (int)pTemp);
-				pTemp->entity.origin[1] += pTemp->entity.baseline.origin[1] * frametime + 4 * sin(client_time * 30 + (int)pTemp);
-				pTemp->entity.origin[2] += pTemp->entity.baseline.origin[2] * frametime;
-			}
+		// Adjust speed if it's time
+		// Scale is next think time
+		if (client_time > pTemp->entity.baseline.scale)
+		{
+			// Show Sparks
+			gEngfuncs.pEfxAPI->R_SparkEffect(pTemp->entity.origin, 8, -200, 200);
 
-			else
-			{
-				for (i = 0; i < 3; i++)
-					pTemp->entity.origin[i] += pTemp->entity.baseline.origin[i] * frametime;
-			}
+			// Reduce life
+			pTemp->entity.baseline.framerate -= 0.1;
 
-			if ((pTemp->flags & FTENT_SPRANIMATE) != 0)
+			if (pTemp->entity.baseline.framerate <= 0.0)
 			{
-				pTemp->entity.curstate.frame += frametime * pTemp->entity.curstate.framerate;
-				if (pTemp->entity.curstate.frame >= pTemp->frameMax)
-				{
-					pTemp->entity.curstate.frame = pTemp->entity.curstate.frame - (int)(pTemp->entity.curstate.frame);
-
-					if ((pTemp->flags & FTENT_SPRANIMATELOOP) == 0)
-					{
-						// this animating sprite isn't set to loop, so destroy it.
-						pTemp->die = client_time;
-						pTemp = pnext;
-						continue;
-					}
-				}
+				pTemp->die = client_time;
 			}
-			else if ((pTemp->flags & FTENT_SPRCYCLE) != 0)
+			else
 			{
-				pTemp->entity.curstate.frame += frametime * 10;
-				if (pTemp->entity.curstate.frame >= pTemp->frameMax)
-				{
-					pTemp->entity.curstate.frame = pTemp->entity.curstate.frame - (int)(pTemp->entity.curstate.frame);
-				}
+				// So it will die no matter what
+				pTemp->die = client_time + 0.5;
+
+				// Next think
+				pTemp->entity.baseline.scale = client_time + 0.1;
 			}
+		}
+	}
 
-			if ((pTemp->flags & FTENT_ROTATE) != 0)
-			{
-				pTemp->entity.angles[0] += pTemp->entity.baseline.angles[0] * frametime;
-				pTemp->entity.angles[1] += pTemp->entity.baseline.angles[1] * frametime;
-				pTemp->entity.angles[2] += pTemp->entity.baseline.angles[2] * frametime;
+	piBucket = g_rgiTempEntBuckets[TENT_BUCKET_ATTACHED];
+	for (j = 0; j < g_rgiTempEntBucketCount[TENT_BUCKET_ATTACHED]; j++)
+	{
+		pTemp = g_rgpTempEnts[piBucket[j]];
 
-				VectorCopy(pTemp->entity.angles, pTemp->entity.latched.prevangles);
-			}
+		cl_entity_t* pClient = gEngfuncs.GetEntityByIndex(pTemp->clientIndex);
 
-			if ((pTemp->flags & (FTENT_COLLIDEALL | FTENT_COLLIDEWORLD)) != 0)
-			{
-				Vector traceNormal;
-				float traceFraction = 1;
+		VectorAdd(pClient->origin, pTemp->tentOffset, pTemp->entity.origin);
+	}
 
-				if ((pTemp->flags & FTENT_COLLIDEALL) != 0)
-				{
-					pmtrace_t pmtrace;
-					physent_t* pe;
+	piBucket = g_rgiTempEntBuckets[TENT_BUCKET_SINEWAVE];
+	for (j = 0; j < g_rgiTempEntBucketCount[TENT_BUCKET_SINEWAVE]; j++)
+	{
+		pTemp = g_rgpTempEnts[piBucket[j]];
 
-					gEngfuncs.pEventAPI->EV_SetTraceHull(2);
+		pTemp->x += pTemp->entity.baseline.origin[0] * frametime;
+		pTemp->y += pTemp->entity.baseline.origin[1] * frametime;
 
-					gEngfuncs.pEventAPI->EV_PlayerTrace(pTemp->entity.prevstate.origin, pTemp->entity.origin, PM_STUDIO_BOX, -1, &pmtrace);
+		pTemp->entity.origin[0] = pTemp->x + sin(pTemp->entity.baseline.origin[2] + client_time * pTemp->entity.prevstate.frame) * (10 * pTemp->entity.curstate.framerate);
+		pTemp->entity.origin[1] = pTemp->y + sin(pTemp->entity.baseline.origin[2] + fastFreq + 0.7) * (8 * pTemp->entity.curstate.framerate);
+		pTemp->entity.origin[2] += pTemp->entity.baseline.origin[2] * frametime;
+	}
 
+	piBucket = g_rgiTempEntBuckets[TENT_BUCKET_SPIRAL];
+	for (j = 0; j < g_rgiTempEntBucketCount[TENT_BUCKET_SPIRAL]; j++)
+	{
+		pTemp = g_rgpTempEnts[piBucket[j]];
 
-					if (pmtrace.fraction != 1)
-					{
-						pe = gEngfuncs.pEventAPI->EV_GetPhysent(pmtrace.ent);
+		pTemp->entity.origin[0] += pTemp->entity.baseline.origin[0] * frametime + 8 * sin(client_time * 20 + (int)pTemp);
+		pTemp->entity.origin[1] += pTemp->entity.baseline.origin[1] * frametime + 4 * sin(client_time * 30 + (int)pTemp);
+		pTemp->entity.origin[2] += pTemp->entity.baseline.origin[2] * frametime;
+	}
 
-						if (0 == pmtrace.ent || (pe->info != pTemp->clientIndex))
-						{
-							traceFraction = pmtrace.fraction;
-							VectorCopy(pmtrace.plane.normal, traceNormal);
+	piBucket = g_rgiTempEntBuckets[TENT_BUCKET_LINEAR];
+	for (j = 0; j < g_rgiTempEntBucketCount[TENT_BUCKET_LINEAR]; j++)
+	{
+		pTemp = g_rgpTempEnts[piBucket[j]];
 
-							if (pTemp->hitcallback)
-							{
-								(*pTemp->hitcallback)(pTemp, &pmtrace);
-							}
-						}
-					}
-				}
-				else if ((pTemp->flags & FTENT_COLLIDEWORLD) != 0)
-				{
-					pmtrace_t pmtrace;
-
-					gEngfuncs.pEventAPI->EV_SetTraceHull(2);
-
-					gEngfuncs.pEventAPI->EV_PlayerTrace(pTemp->entity.prevstate.origin, pTemp->entity.origin, PM_STUDIO_BOX | PM_WORLD_ONLY, -1, &pmtrace);
-
-					if (pmtrace.fraction != 1)
-					{
-						traceFraction = pmtrace.fraction;
-						VectorCopy(pmtrace.plane.normal, traceNormal);
-
-						if ((pTemp->flags & FTENT_SPARKSHOWER) != 0)
-						{
-							// Chop spark speeds a bit more
-							//
-							VectorScale(pTemp->entity.baseline.origin, 0.6, pTemp->entity.baseline.origin);
-
-							if (Length(pTemp->entity.baseline.origin) < 10)
-							{
-								pTemp->entity.baseline.framerate = 0.0;
-							}
-						}
-
-						if (pTemp->hitcallback)
-						{
-							(*pTemp->hitcallback)(pTemp, &pmtrace);
-						}
-					}
-				}
+		for (i = 0; i < 3; i++)
+			pTemp->entity.origin[i] += pTemp->entity.baseline.origin[i] * frametime;
+	}
 
-				if (traceFraction != 1) // Decent collision now, and damping works
-				{
-					float proj, damp;
-
-					// Place at contact point
-					VectorMA(pTemp->entity.prevstate.origin, traceFraction * frametime, pTemp->entity.baseline.origin, pTemp->entity.origin);
-					// Damp velocity
-					damp = pTemp->bounceFactor;
-					if ((pTemp->flags & (FTENT_GRAVITY | FTENT_SLOWGRAVITY)) != 0)
-					{
-						damp *= 0.5;
-						if (traceNormal[2] > 0.9) // Hit floor?
-						{
-							if (pTemp->entity.baseline.origin[2] <= 0 && pTemp->entity.baseline.origin[2] >= gravity * 3)
-							{
-								damp = 0; // Stop
-								pTemp->flags &= ~(FTENT_ROTATE | FTENT_GRAVITY | FTENT_SLOWGRAVITY | FTENT_COLLIDEWORLD | FTENT_SMOKETRAIL);
-								pTemp->entity.angles[0] = 0;
-								pTemp->entity.angles[2] = 0;
-							}
-						}
-					}
-
-					if ((pTemp->hitSound) != 0)
-					{
-						Callback_TempEntPlaySound(pTemp, damp);
-					}
-
-					if ((pTemp->flags & FTENT_COLLIDEKILL) != 0)
-					{
-						// die on impact
-						pTemp->flags &= ~FTENT_FADEOUT;
-						pTemp->die = client_time;
-					}
-					else
-					{
-						// Reflect velocity
-						if (damp != 0)
-						{
-							proj = DotProduct(pTemp->entity.baseline.origin, traceNormal);
-							VectorMA(pTemp->entity.baseline.origin, -proj * 2, traceNormal, pTemp->entity.baseline.origin);
-							// Reflect rotation (fake)
-
-							pTemp->entity.angles[1] = -pTemp->entity.angles[1];
-						}
-
-						if (damp != 1)
-						{
-
-							VectorScale(pTemp->entity.baseline.origin, damp, pTemp->entity.baseline.origin);
-							VectorScale(pTemp->entity.angles, 0.9, pTemp->entity.angles);
-						}
-					}
-				}
-			}
+	// Animate
+	piBucket = g_rgiTempEntBuckets[TENT_BUCKET_ANIMATE];
+	for (j = 0; j < g_rgiTempEntBucketCount[TENT_BUCKET_ANIMATE]; j++)
+	{
+		pTemp = g_rgpTempEnts[piBucket[j]];
 
+		pTemp->entity.curstate.frame += frametime * pTemp->entity.curstate.framerate;
+		if (pTemp->entity.curstate.frame >= pTemp->frameMax)
+		{
+			pTemp->entity.curstate.frame = pTemp->entity.curstate.frame - (int)(pTemp->entity.curstate.frame);
 
-			if ((pTemp->flags & FTENT_FLICKER) != 0 && gTempEntFrame == pTemp->entity.curstate.effects)
+			if ((pTemp->flags & FTENT_SPRANIMATELOOP) == 0)
 			{
-				dlight_t* dl = gEngfuncs.pEfxAPI->CL_AllocDlight(0);
-				VectorCopy(pTemp->entity.origin, dl->origin);
-				dl->radius = 60;
-				dl->color.r = 255;
-				dl->color.g = 120;
-				dl->color.b = 0;
-				dl->die = client_time + 0.01;
+				// this animating sprite isn't set to loop, so destroy it.
+				// it's done for this update too, so the passes below skip it.
+				pTemp->die = client_time;
+				g_rgpTempEnts[piBucket[j]] = NULL;
 			}
+		}
+	}
 
-			if ((pTemp->flags & FTENT_SMOKETRAIL) != 0)
-			{
-				gEngfuncs.pEfxAPI->R_RocketTrail(pTemp->entity.prevstate.origin, pTemp->entity.origin, 1);
-			}
+	piBucket = g_rgiTempEntBuckets[TENT_BUCKET_CYCLE];
+	for (j = 0; j < g_rgiTempEntBucketCount[TENT_BUCKET_CYCLE]; j++)
+	{
+		pTemp = g_rgpTempEnts[piBucket[j]];
+
+		pTemp->entity.curstate.frame += frametime * 10;
+		if (pTemp->entity.curstate.frame >= pTemp->frameMax)
+		{
+			pTemp->entity.curstate.frame = pTemp->entity.curstate.frame - (int)(pTemp->entity.curstate.frame);
+		}
+	}
+
+	// Rotate what's left, and sort out the ones that collide
+	for (j = 0; j < g_iTempEntCount; j++)
+	{
+		pTemp = g_rgpTempEnts[j];
+		if (!pTemp)
+			continue;
+
+		if ((pTemp->flags & FTENT_ROTATE) != 0)
+		{
+			pTemp->entity.angles[0] += pTemp->entity.baseline.angles[0] * frametime;
+			pTemp->entity.angles[1] += pTemp->entity.baseline.angles[1] * frametime;
+			pTemp->entity.angles[2] += pTemp->entity.baseline.angles[2] * frametime;
+
+			VectorCopy(pTemp->entity.angles, pTemp->entity.latched.prevangles);
+		}
+
+		if ((pTemp->flags & (FTENT_COLLIDEALL | FTENT_COLLIDEWORLD)) != 0)
+		{
+			TempEntBucketAdd(TENT_BUCKET_COLLIDE, j);
+			if ((pTemp->flags & FTENT_COLLIDEALL) != 0)
+				bCollideAll = true;
+		}
+	}
+
+	// Collide
+	if (0 != g_rgiTempEntBucketCount[TENT_BUCKET_COLLIDE])
+	{
+		// in order to have tents collide with players, we have to run the player prediction code so
+		// that the client has the player list. That's only worth doing if there's a COLLIDEALL tent
+		// this update; the world-only traces don't need it.
+		if (bCollideAll)
+		{
+			gEngfuncs.pEventAPI->EV_SetUpPlayerPrediction(0, 1);
+
+			// Store off the old count
+			gEngfuncs.pEventAPI->EV_PushPMStates();
+
+			// Now add in all of the players.
+			gEngfuncs.pEventAPI->EV_SetSolidPlayers(-1);
+		}
+
+		const bool bAmortize = cl_tempent_amortize && 0 != cl_tempent_amortize->value;
+
+		piBucket = g_rgiTempEntBuckets[TENT_BUCKET_COLLIDE];
+		for (j = 0; j < g_rgiTempEntBucketCount[TENT_BUCKET_COLLIDE]; j++)
+			TempEntCollide(g_rgpTempEnts[piBucket[j]], frametime, client_time, gravity, bAmortize, Callback_TempEntPlaySound);
+
+		if (bCollideAll)
+		{
+			// Restore state info
+			gEngfuncs.pEventAPI->EV_PopPMStates();
+		}
+	}
+
+	// Everything else
+	for (j = 0; j < g_iTempEntCount; j++)
+	{
+		pTemp = g_rgpTempEnts[j];
+		if (!pTemp)
+			continue;
+
+		if ((pTemp->flags & FTENT_FLICKER) != 0 && gTempEntFrame == pTemp->entity.curstate.effects)
+		{
+			dlight_t* dl = gEngfuncs.pEfxAPI->CL_AllocDlight(0);
+			VectorCopy(pTemp->entity.origin, dl->origin);
+			dl->radius = 60;
+			dl->color.r = 255;
+			dl->color.g = 120;
+			dl->color.b = 0;
+			dl->die = client_time + 0.01;
+		}
 
-			if ((pTemp->flags & FTENT_GRAVITY) != 0)
-				pTemp->entity.baseline.origin[2] += gravity;
-			else if ((pTemp->flags & FTENT_SLOWGRAVITY) != 0)
-				pTemp->entity.baseline.origin[2] += gravitySlow;
+		if ((pTemp->flags & FTENT_SMOKETRAIL) != 0)
+		{
+			gEngfuncs.pEfxAPI->R_RocketTrail(pTemp->entity.prevstate.origin, pTemp->entity.origin, 1);
+		}
 
-			if ((pTemp->flags & FTENT_CLIENTCUSTOM) != 0)
+		if ((pTemp->flags & FTENT_GRAVITY) != 0)
+			pTemp->entity.baseline.origin[2] += gravity;
+		else if ((pTemp->flags & FTENT_SLOWGRAVITY) != 0)
+			pTemp->entity.baseline.origin[2] += gravitySlow;
+
+		if ((pTemp->flags & FTENT_CLIENTCUSTOM) != 0)
+		{
+			if (pTemp->callback)
 			{
-				if (pTemp->callback)
-				{
-					(*pTemp->callback)(pTemp, frametime, client_time);
-				}
+				(*pTemp->callback)(pTemp, frametime, client_time);
 			}
+		}
 
-			// Cull to PVS (not frustum cull, just PVS)
-			if ((pTemp->flags & FTENT_NOMODEL) == 0)
+		// Cull to PVS (not frustum cull, just PVS)
+		if ((pTemp->flags & FTENT_NOMODEL) == 0)
+		{
+			if (0 == Callback_AddVisibleEntity(&pTemp->entity))
 			{
-				if (0 == Callback_AddVisibleEntity(&pTemp->entity))
+				if ((pTemp->flags & FTENT_PERSIST) == 0)
 				{
-					if ((pTemp->flags & FTENT_PERSIST) == 0)
-					{
-						pTemp->die = client_time;		// If we can't draw it this frame, just dump it.
-						pTemp->flags &= ~FTENT_FADEOUT; // Don't fade out, just die
-					}
+					pTemp->die = client_time;		// If we can't draw it this frame, just dump it.
+					pTemp->flags &= ~FTENT_FADEOUT; // Don't fade out, just die
 				}
 			}
 		}
-		pTemp = pnext;
 	}
-
-finish:
-	// Restore state info
-	gEngfuncs.pEventAPI->EV_PopPMStates();
 }
 
 /*
@@ -47,6 +47,7 @@ bool CBaseEntity::ShouldToggle(USE_TYPE useType, bool currentState) { return fal
 int CBaseEntity::DamageDecal(int bitsDamageType) { return -1; }
 CBaseEntity* CBaseEntity::Create(const char* szName, const Vector& vecOrigin, const Vector& vecAngles, edict_t* pentOwner) { return NULL; }
 void CBaseEntity::SUB_Remove() {}
+void CBaseEntity::UpdateOnRemove() {}
 void CBaseEntity::Activate() {}										  //LRC
 void CBaseEntity::InitMoveWith() {}									  //LRC
 void CBaseEntity::SetNextThink(float delay, bool correctSpeed) {}	  //LRC
@@ -32,6 +32,8 @@
 #include "demo.h"
 #include "demo_api.h"
 #include "vgui_ScorePanel.h"
+#include "profiler.h"
+#include "map_entities.h"
 
 hud_player_info_t g_PlayerInfoList[MAX_PLAYERS_HUD + 1];	// player info from the engine
 extra_player_info_t g_PlayerExtraInfo[MAX_PLAYERS_HUD + 1]; // additional player info sent directly to the client dll
@@ -88,6 +90,7 @@ cvar_t* cl_lw = NULL;
 cvar_t* cl_rollangle = nullptr;
 cvar_t* cl_rollspeed = nullptr;
 cvar_t* cl_bobtilt = nullptr;
+extern cvar_t* cl_tempent_amortize;
 
 void ShutdownInput();
 
@@ -385,6 +388,7 @@ void CHud::Init()
 	cl_rollangle = CVAR_CREATE("cl_rollangle", "2.0", FCVAR_ARCHIVE);
 	cl_rollspeed = CVAR_CREATE("cl_rollspeed", "200", FCVAR_ARCHIVE);
 	cl_bobtilt = CVAR_CREATE("cl_bobtilt", "0", FCVAR_ARCHIVE);
+	cl_tempent_amortize = CVAR_CREATE("cl_tempent_amortize", "1", FCVAR_ARCHIVE); // trace slow tempents against the world every few frames instead of every frame
 
 	m_pSpriteList = NULL;
 	m_pShinySurface = NULL; //LRC
@@ -421,9 +425,12 @@ void CHud::Init()
 	m_StatusIcons.Init();
 	GetClientVoiceMgr()->Init(&g_VoiceStatusHelper, (vgui::Panel**)&gViewPort);
 	m_Particle.Init(); // (LRC) -- 30/08/02 November235: Particles to Order
+	m_Weather.Init();
 
 	m_Menu.Init();
 
+	g_FrameProfiler.Init();
+
 	MsgFunc_ResetHUD(0, 0, NULL);
 }
 
@@ -437,6 +444,7 @@ CHud::~CHud()
 	delete[] m_rghSprites;
 	delete[] m_rgrcRects;
 	delete[] m_rgszSpriteNames;
+	delete[] m_rgiSpriteHash;
 
 	if (m_pHudList)
 	{
@@ -451,15 +459,29 @@ CHud::~CHud()
 	}
 }
 
+static unsigned int HashSpriteName(const char* psz)
+{
+	// FNV-1a, over the same characters GetSpriteIndex compares
+	unsigned int hash = 2166136261u;
+	for (int i = 0; i < MAX_SPRITE_NAME_LENGTH && '\0' != psz[i]; i++)
+		hash = (hash ^ (unsigned char)psz[i]) * 16777619u;
+	return hash;
+}
+
 // GetSpriteIndex()
 // searches through the sprite list loaded from hud.txt for a name matching SpriteName
 // returns an index into the gHUD.m_rghSprites[] array
-// returns 0 if sprite not found
+// returns -1 if sprite not found
 int CHud::GetSpriteIndex(const char* SpriteName)
 {
-	// look through the loaded sprite name list for SpriteName
-	for (int i = 0; i < m_iSpriteCount; i++)
+	if (!m_rgiSpriteHash)
+		return -1;
+
+	// the table is never more than half full, so this always finds an empty slot
+	const unsigned int mask = m_iSpriteHashSize - 1;
+	for (unsigned int h = HashSpriteName(SpriteName) & mask; m_rgiSpriteHash[h] != -1; h = (h + 1) & mask)
 	{
+		const int i = m_rgiSpriteHash[h];
 		if (strncmp(SpriteName, m_rgszSpriteNames + (i * MAX_SPRITE_NAME_LENGTH), MAX_SPRITE_NAME_LENGTH) == 0)
 			return i;
 	}
@@ -467,6 +489,66 @@ int CHud::GetSpriteIndex(const char* SpriteName)
 	return -1; // invalid sprite
 }
 
+// BuildSpriteArrays()
+// fills in the names, rects and name hash for the hud.txt sprites at m_iRes.
+// the sprites themselves are loaded by VidInit, since they go away on every level change.
+void CHud::BuildSpriteArrays()
+{
+	delete[] m_rghSprites;
+	delete[] m_rgrcRects;
+	delete[] m_rgszSpriteNames;
+	delete[] m_rgiSpriteHash;
+
+	// count the number of sprites of the appropriate res
+	m_iSpriteCount = 0;
+	client_sprite_t* p = m_pSpriteList;
+	int j;
+	for (j = 0; j < m_iSpriteCountAllRes; j++)
+	{
+		if (p->iRes == m_iRes)
+			m_iSpriteCount++;
+		p++;
+	}
+
+	m_iSpriteHashSize = 16;
+	while (m_iSpriteHashSize < m_iSpriteCount * 2)
+		m_iSpriteHashSize <<= 1;
+
+	// allocated memory for sprite handle arrays
+	m_rghSprites = new HSPRITE[m_iSpriteCount];
+	m_rgrcRects = new Rect[m_iSpriteCount];
+	m_rgszSpriteNames = new char[m_iSpriteCount * MAX_SPRITE_NAME_LENGTH];
+	m_rgiSpriteHash = new int[m_iSpriteHashSize];
+	memset(m_rgiSpriteHash, -1, m_iSpriteHashSize * sizeof(int));
+
+	const unsigned int mask = m_iSpriteHashSize - 1;
+	p = m_pSpriteList;
+	int index = 0;
+	for (j = 0; j < m_iSpriteCountAllRes; j++)
+	{
+		if (p->iRes == m_iRes)
+		{
+			char* pszName = &m_rgszSpriteNames[index * MAX_SPRITE_NAME_LENGTH];
+			m_rghSprites[index] = 0;
+			m_rgrcRects[index] = p->rc;
+			strncpy(pszName, p->szName, MAX_SPRITE_NAME_LENGTH);
+
+			// if a name is listed twice, the first one wins, as it always has
+			unsigned int h = HashSpriteName(pszName) & mask;
+			while (m_rgiSpriteHash[h] != -1 && strncmp(pszName, m_rgszSpriteNames + (m_rgiSpriteHash[h] * MAX_SPRITE_NAME_LENGTH), MAX_SPRITE_NAME_LENGTH) != 0)
+				h = (h + 1) & mask;
+			if (m_rgiSpriteHash[h] == -1)
+				m_rgiSpriteHash[h] = index;
+
+			index++;
+		}
+
+		p++;
+	}
+
+	m_iSpriteRes = m_iRes;
+}
+
 void CHud::VidInit()
 {
 #ifdef ENGINE_DEBUG
@@ -475,6 +557,9 @@ void CHud::VidInit()
 	m_scrinfo.iSize = sizeof(m_scrinfo);
 	GetScreenInfo(&m_scrinfo);
 
+	// new map, so the entity lump needs parsing again
+	g_MapEntities.Invalidate();
+
 	// ----------
 	// Load Sprites
 	// ---------
@@ -493,48 +578,16 @@ void CHud::VidInit()
 	{
 		// we need to load the hud.txt, and all sprites within
 		m_pSpriteList = SPR_GetList("sprites/hud.txt", &m_iSpriteCountAllRes);
-
-		if (m_pSpriteList)
-		{
-			// count the number of sprites of the appropriate res
-			m_iSpriteCount = 0;
-			client_sprite_t* p = m_pSpriteList;
-			int j;
-			for (j = 0; j < m_iSpriteCountAllRes; j++)
-			{
-				if (p->iRes == m_iRes)
-					m_iSpriteCount++;
-				p++;
-			}
-
-			// allocated memory for sprite handle arrays
-			m_rghSprites = new HSPRITE[m_iSpriteCount];
-			m_rgrcRects = new Rect[m_iSpriteCount];
-			m_rgszSpriteNames = new char[m_iSpriteCount * MAX_SPRITE_NAME_LENGTH];
-
-			p = m_pSpriteList;
-			int index = 0;
-			for (j = 0; j < m_iSpriteCountAllRes; j++)
-			{
-				if (p->iRes == m_iRes)
-				{
-					char sz[256];
-					sprintf(sz, "sprites/%s.spr", p->szSprite);
-					m_rghSprites[index] = SPR_Load(sz);
-					m_rgrcRects[index] = p->rc;
-					strncpy(&m_rgszSpriteNames[index * MAX_SPRITE_NAME_LENGTH], p->szName, MAX_SPRITE_NAME_LENGTH);
-
-					index++;
-				}
-
-				p++;
-			}
-		}
+		m_iSpriteRes = 0;
 	}
-	else
+
+	if (m_pSpriteList)
 	{
-		// we have already have loaded the sprite reference from hud.txt, but
-		// we need to make sure all the sprites have been loaded (we've gone through a transition, or loaded a save game)
+		// the names and rects only change with the resolution
+		if (m_iSpriteRes != m_iRes)
+			BuildSpriteArrays();
+
+		// but we need to make sure all the sprites have been loaded (we've gone through a transition, or loaded a save game)
 		client_sprite_t* p = m_pSpriteList;
 		int index = 0;
 		for (int j = 0; j < m_iSpriteCountAllRes; j++)
@@ -573,6 +626,7 @@ void CHud::VidInit()
 	m_StatusIcons.VidInit();
 	GetClientVoiceMgr()->VidInit();
 	m_Particle.VidInit(); // (LRC) -- 30/08/02 November235: Particles to Order
+	m_Weather.VidInit();
 }
 
 bool CHud::MsgFunc_Logo(const char* pszName, int iSize, void* pbuf)
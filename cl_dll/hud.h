@@ -354,6 +354,18 @@ public:
 	int MsgFunc_Particle(const char* pszName, int iSize, void* pbuf);
 };
 
+//
+//-----------------------------------------------------
+//
+// env_rain/env_snow settings; the drops themselves are simulated in weather.cpp
+class CHudWeather : public CHudBase
+{
+public:
+	bool Init() override;
+	bool VidInit() override;
+	int MsgFunc_Weather(const char* pszName, int iSize, void* pbuf);
+};
+
 //
 //-----------------------------------------------------
 //
@@ -389,19 +401,30 @@ struct message_parms_t
 {
 	client_textmessage_t* pMessage;
 	float time;
-	int x, y;
-	int totalWidth, totalHeight;
-	int width;
-	int lines;
-	int lineLength;
 	int length;
 	int r, g, b;
-	int text;
 	int fadeBlend;
 	float charTime;
 	float fadeTime;
 };
 
+struct message_glyph_t
+{
+	short x, y;
+	unsigned char text;
+	bool visible; // fits on the screen
+};
+
+// Where every character of a message goes. Worked out when the message is added,
+// so drawing it only has to colour the characters in.
+struct message_layout_t
+{
+	message_glyph_t* pGlyphs; // every character but the line breaks
+	int numGlyphs;
+	int maxGlyphs;
+	int length; // including the line breaks
+};
+
 //
 //-----------------------------------------------------
 //
@@ -423,6 +446,7 @@ public:
 class CHudMessage : public CHudBase
 {
 public:
+	~CHudMessage() override;
 	bool Init() override;
 	bool VidInit() override;
 	bool Draw(float flTime) override;
@@ -436,7 +460,9 @@ public:
 
 	void MessageAdd(const char* pName, float time);
 	void MessageAdd(client_textmessage_t* newMessage);
-	void MessageDrawScan(client_textmessage_t* pMessage, float time);
+	void MessageLayout(int slot);
+	void MessageRelayout(client_textmessage_t* pMessage);
+	void MessageDrawScan(int slot, float time);
 	void MessageScanStart();
 	void MessageScanNextChar();
 	void Reset() override;
@@ -444,6 +470,7 @@ public:
 private:
 	client_textmessage_t* m_pMessages[maxHUDMessages];
 	float m_startTime[maxHUDMessages];
+	message_layout_t m_layouts[maxHUDMessages];
 	message_parms_t m_parms;
 	float m_gameTitleTime;
 	client_textmessage_t* m_pGameTitle;
@@ -586,11 +613,16 @@ public:
 	int m_iHUDColor; //LRC
 
 private:
-	// the memory for these arrays are allocated in the first call to CHud::VidInit(), when the hud.txt and associated sprites are loaded.
-	// freed in ~CHud()
+	// the memory for these arrays are allocated in the first call to CHud::VidInit(), when the hud.txt and associated sprites are loaded,
+	// and reallocated if the resolution changes. freed in ~CHud()
 	HSPRITE* m_rghSprites; /*[HUD_SPRITE_COUNT]*/ // the sprites loaded from hud.txt
 	Rect* m_rgrcRects;							  /*[HUD_SPRITE_COUNT]*/
 	char* m_rgszSpriteNames;					  /*[HUD_SPRITE_COUNT][MAX_SPRITE_NAME_LENGTH]*/
+	int* m_rgiSpriteHash;						  /*[m_iSpriteHashSize]*/ // indices into the arrays above, hashed on name; -1 is an empty slot
+	int m_iSpriteHashSize;						  // always a power of two
+	int m_iSpriteRes;							  // the resolution the arrays above were built for
+
+	void BuildSpriteArrays();
 
 	struct cvar_s* default_fov;
 
@@ -624,6 +656,7 @@ public:
 	CHudTextMessage m_TextMessage;
 	CHudStatusIcons m_StatusIcons;
 	CHudParticle m_Particle; // (LRC) -- 30/08/02 November235: Particles to Order
+	CHudWeather m_Weather;
 
 	void Init();
 	void VidInit();
@@ -25,6 +25,7 @@
 #include "event_api.h"
 #include "studio_util.h"
 #include "screenfade.h"
+#include "map_entities.h"
 
 
 #pragma warning(disable : 4244)
@@ -200,126 +201,52 @@ void UTIL_StringToVector(float* pVector, const char* pString)
 
 bool UTIL_FindEntityInMap(const char* name, float* origin, float* angle)
 {
-	int n;
-	bool found = false;
-	char keyname[256];
-	char token[1024];
-
-	cl_entity_t* pEnt = gEngfuncs.GetEntityByIndex(0); // get world model
-
-	if (!pEnt)
-		return false;
+	const map_entity_t* pEntity = g_MapEntities.FindByClassname(name);
 
-	if (!pEnt->model)
+	if (!pEntity)
 		return false;
 
-	char* data = pEnt->model->entities;
-
-	while (data)
+	// in lump order, so a later key still beats an earlier one
+	for (int i = 0; i < g_MapEntities.NumKeyValues(pEntity); i++)
 	{
-		data = gEngfuncs.COM_ParseFile(data, token);
-
-		if ((token[0] == '}') || (token[0] == 0))
-			break;
+		const char* keyname = g_MapEntities.GetKey(pEntity, i);
+		const char* token = g_MapEntities.GetValue(pEntity, i);
 
-		if (!data)
+		if (0 == strcmp(keyname, "angle"))
 		{
-			gEngfuncs.Con_DPrintf("UTIL_FindEntityInMap: EOF without closing brace\n");
-			return false;
-		}
-
-		if (token[0] != '{')
-		{
-			gEngfuncs.Con_DPrintf("UTIL_FindEntityInMap: expected {\n");
-			return false;
-		}
-
-		// we parse the first { now parse entities properties
+			float y = atof(token);
 
-		while (true)
-		{
-			// parse key
-			data = gEngfuncs.COM_ParseFile(data, token);
-			if (token[0] == '}')
-				break; // finish parsing this entity
-
-			if (!data)
+			if (y >= 0)
 			{
-				gEngfuncs.Con_DPrintf("UTIL_FindEntityInMap: EOF without closing brace\n");
-				return false;
+				angle[0] = 0.0f;
+				angle[1] = y;
 			}
-
-			strcpy(keyname, token);
-
-			// another hack to fix keynames with trailing spaces
-			n = strlen(keyname);
-			while (0 != n && keyname[n - 1] == ' ')
+			else if ((int)y == -1)
 			{
-				keyname[n - 1] = 0;
-				n--;
-			}
-
-			// parse value
-			data = gEngfuncs.COM_ParseFile(data, token);
-			if (!data)
-			{
-				gEngfuncs.Con_DPrintf("UTIL_FindEntityInMap: EOF without closing brace\n");
-				return false;
-			}
-
-			if (token[0] == '}')
-			{
-				gEngfuncs.Con_DPrintf("UTIL_FindEntityInMap: closing brace without data");
-				return false;
+				angle[0] = -90.0f;
+				angle[1] = 0.0f;
 			}
-
-			if (0 == strcmp(keyname, "classname"))
-			{
-				if (0 == strcmp(token, name))
-				{
-					found = true; // thats our entity
-				}
-			}
-
-			if (0 == strcmp(keyname, "angle"))
+			else
 			{
-				float y = atof(token);
-
-				if (y >= 0)
-				{
-					angle[0] = 0.0f;
-					angle[1] = y;
-				}
-				else if ((int)y == -1)
-				{
-					angle[0] = -90.0f;
-					angle[1] = 0.0f;
-				}
-				else
-				{
-					angle[0] = 90.0f;
-					angle[1] = 0.0f;
-				}
-
-				angle[2] = 0.0f;
+				angle[0] = 90.0f;
+				angle[1] = 0.0f;
 			}
 
-			if (0 == strcmp(keyname, "angles"))
-			{
-				UTIL_StringToVector(angle, token);
-			}
+			angle[2] = 0.0f;
+		}
 
-			if (0 == strcmp(keyname, "origin"))
-			{
-				UTIL_StringToVector(origin, token);
-			}
+		if (0 == strcmp(keyname, "angles"))
+		{
+			UTIL_StringToVector(angle, token);
 		}
 
-		if (found)
-			return true;
+		if (0 == strcmp(keyname, "origin"))
+		{
+			UTIL_StringToVector(origin, token);
+		}
 	}
 
-	return false; // we search all entities, but didn't found the correct
+	return true;
 }
 
 //-----------------------------------------------------------------------------
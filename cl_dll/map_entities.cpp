@@ -0,0 +1,307 @@
+// The map's entity lump, parsed once per map so client code can look entities up by classname or targetname
+//
+// Big maps can have entity lumps several megabytes long, so rather than running COM_ParseFile over the
+// whole thing for every lookup it's parsed the first time something's wanted and indexed by name.
+#include "hud.h"
+#include "cl_util.h"
+#include "cl_entity.h"
+#include "com_model.h"
+#include "map_entities.h"
+
+CMapEntities g_MapEntities;
+
+static unsigned int HashEntityName(const char* psz)
+{
+	// FNV-1a
+	unsigned int hash = 2166136261u;
+	for (; '\0' != *psz; psz++)
+		hash = (hash ^ (unsigned char)*psz) * 16777619u;
+	return hash;
+}
+
+// makes room for one more in a new[]'d array
+template <class T>
+static void GrowArray(T*& pArray, int iCount, int& iMax)
+{
+	if (iCount < iMax)
+		return;
+
+	iMax = V_max(iMax * 2, 64);
+	T* pNew = new T[iMax];
+	if (pArray)
+	{
+		memcpy(pNew, pArray, sizeof(T) * iCount);
+		delete[] pArray;
+	}
+	pArray = pNew;
+}
+
+CMapEntities::CMapEntities()
+{
+	m_pLump = NULL;
+	m_pEntities = NULL;
+	m_iNumEntities = m_iMaxEntities = 0;
+	m_pKeyValues = NULL;
+	m_iNumKeyValues = m_iMaxKeyValues = 0;
+	m_pStrings = NULL;
+	m_iStringsSize = m_iMaxStrings = 0;
+	m_pClassHash = m_pTargetHash = NULL;
+	m_iHashSize = 0;
+}
+
+CMapEntities::~CMapEntities()
+{
+	delete[] m_pEntities;
+	delete[] m_pKeyValues;
+	delete[] m_pStrings;
+	delete[] m_pClassHash;
+	delete[] m_pTargetHash;
+}
+
+// parses the world's entity lump if it isn't the one that's already been parsed
+bool CMapEntities::Update()
+{
+	cl_entity_t* pWorld = gEngfuncs.GetEntityByIndex(0);
+
+	if (!pWorld || !pWorld->model || !pWorld->model->entities)
+		return false;
+
+	if (pWorld->model->entities != m_pLump)
+		Parse(pWorld->model->entities);
+
+	return true;
+}
+
+int CMapEntities::AddString(const char* pszString)
+{
+	const int iLength = strlen(pszString) + 1;
+
+	if (m_iStringsSize + iLength > m_iMaxStrings)
+	{
+		int iMax = V_max(m_iMaxStrings * 2, m_iStringsSize + iLength);
+		char* pNew = new char[iMax];
+		if (m_pStrings)
+		{
+			memcpy(pNew, m_pStrings, m_iStringsSize);
+			delete[] m_pStrings;
+		}
+		m_pStrings = pNew;
+		m_iMaxStrings = iMax;
+	}
+
+	const int iOffset = m_iStringsSize;
+	memcpy(m_pStrings + iOffset, pszString, iLength);
+	m_iStringsSize += iLength;
+
+	return iOffset;
+}
+
+void CMapEntities::Parse(const char* pLump)
+{
+	int n;
+	char keyname[256];
+	char token[1024];
+
+	m_pLump = pLump;
+	m_iNumEntities = 0;
+	m_iNumKeyValues = 0;
+	m_iStringsSize = 0;
+
+	// the strings all come out of the lump, so they'll nearly always fit in this
+	const int iLumpSize = strlen(pLump) + 1;
+	if (m_iMaxStrings < iLumpSize)
+	{
+		delete[] m_pStrings;
+		m_pStrings = new char[iLumpSize];
+		m_iMaxStrings = iLumpSize;
+	}
+
+	const char* data = pLump;
+
+	while (data)
+	{
+		data = gEngfuncs.COM_ParseFile(data, token);
+
+		if ((token[0] == '}') || (token[0] == 0))
+			break;
+
+		if (!data)
+		{
+			gEngfuncs.Con_DPrintf("CMapEntities::Parse: EOF without closing brace\n");
+			break;
+		}
+
+		if (token[0] != '{')
+		{
+			gEngfuncs.Con_DPrintf("CMapEntities::Parse: expected {\n");
+			break;
+		}
+
+		map_entity_t entity;
+		entity.firstKeyValue = m_iNumKeyValues;
+		entity.numKeyValues = 0;
+		entity.classname = -1;
+		entity.targetname = -1;
+
+		// we parse the first { now parse entities properties
+		bool bComplete = false;
+		while (true)
+		{
+			// parse key
+			data = gEngfuncs.COM_ParseFile(data, token);
+			if (token[0] == '}')
+			{
+				bComplete = true; // finish parsing this entity
+				break;
+			}
+
+			if (!data)
+			{
+				gEngfuncs.Con_DPrintf("CMapEntities::Parse: EOF without closing brace\n");
+				break;
+			}
+
+			strncpy(keyname, token, sizeof(keyname) - 1);
+			keyname[sizeof(keyname) - 1] = '\0';
+
+			// another hack to fix keynames with trailing spaces
+			n = strlen(keyname);
+			while (0 != n && keyname[n - 1] == ' ')
+			{
+				keyname[n - 1] = 0;
+				n--;
+			}
+
+			// parse value
+			data = gEngfuncs.COM_ParseFile(data, token);
+			if (!data)
+			{
+				gEngfuncs.Con_DPrintf("CMapEntities::Parse: EOF without closing brace\n");
+				break;
+			}
+
+			if (token[0] == '}')
+			{
+				gEngfuncs.Con_DPrintf("CMapEntities::Parse: closing brace without data\n");
+				break;
+			}
+
+			GrowArray(m_pKeyValues, m_iNumKeyValues, m_iMaxKeyValues);
+			map_keyvalue_t* pKeyValue = &m_pKeyValues[m_iNumKeyValues];
+			pKeyValue->key = AddString(keyname);
+			pKeyValue->value = AddString(token);
+
+			if (0 == strcmp(keyname, "classname"))
+				entity.classname = pKeyValue->value;
+			else if (0 == strcmp(keyname, "targetname"))
+				entity.targetname = pKeyValue->value;
+
+			m_iNumKeyValues++;
+			entity.numKeyValues++;
+		}
+
+		// a broken entity is left out, and so is everything after it
+		if (!bComplete)
+			break;
+
+		GrowArray(m_pEntities, m_iNumEntities, m_iMaxEntities);
+		m_pEntities[m_iNumEntities++] = entity;
+	}
+
+	int iHashSize = 16;
+	while (iHashSize < m_iNumEntities * 2)
+		iHashSize *= 2;
+
+	if (iHashSize > m_iHashSize)
+	{
+		delete[] m_pClassHash;
+		delete[] m_pTargetHash;
+		m_pClassHash = new int[iHashSize];
+		m_pTargetHash = new int[iHashSize];
+		m_iHashSize = iHashSize;
+	}
+
+	BuildHash(m_pClassHash, false);
+	BuildHash(m_pTargetHash, true);
+}
+
+void CMapEntities::BuildHash(int* pHash, bool bTarget)
+{
+	const unsigned int mask = m_iHashSize - 1;
+	memset(pHash, 0, sizeof(int) * m_iHashSize);
+
+	// backwards, so each name's chain ends up in lump order
+	for (int i = m_iNumEntities - 1; i >= 0; i--)
+	{
+		map_entity_t* pEntity = &m_pEntities[i];
+		const int iName = bTarget ? pEntity->targetname : pEntity->classname;
+		int& iNext = bTarget ? pEntity->nextTarget : pEntity->nextClass;
+
+		iNext = -1;
+		if (iName == -1)
+			continue;
+
+		unsigned int h;
+		for (h = HashEntityName(m_pStrings + iName) & mask; 0 != pHash[h]; h = (h + 1) & mask)
+		{
+			const map_entity_t* pHead = &m_pEntities[pHash[h] - 1];
+			if (0 == strcmp(m_pStrings + (bTarget ? pHead->targetname : pHead->classname), m_pStrings + iName))
+			{
+				iNext = pHash[h] - 1;
+				break;
+			}
+		}
+
+		pHash[h] = i + 1;
+	}
+}
+
+const map_entity_t* CMapEntities::FindHash(bool bTarget, const char* pszName)
+{
+	if (!Update())
+		return NULL;
+
+	const int* pHash = bTarget ? m_pTargetHash : m_pClassHash;
+	const unsigned int mask = m_iHashSize - 1;
+	for (unsigned int h = HashEntityName(pszName) & mask; 0 != pHash[h]; h = (h + 1) & mask)
+	{
+		const map_entity_t* pEntity = &m_pEntities[pHash[h] - 1];
+		if (0 == strcmp(m_pStrings + (bTarget ? pEntity->targetname : pEntity->classname), pszName))
+			return pEntity;
+	}
+
+	return NULL;
+}
+
+const map_entity_t* CMapEntities::FindByClassname(const char* pszClassname)
+{
+	return FindHash(false, pszClassname);
+}
+
+const map_entity_t* CMapEntities::FindByTargetname(const char* pszTargetname)
+{
+	return FindHash(true, pszTargetname);
+}
+
+const map_entity_t* CMapEntities::NextByClassname(const map_entity_t* pEntity)
+{
+	return pEntity->nextClass != -1 ? &m_pEntities[pEntity->nextClass] : NULL;
+}
+
+const map_entity_t* CMapEntities::NextByTargetname(const map_entity_t* pEntity)
+{
+	return pEntity->nextTarget != -1 ? &m_pEntities[pEntity->nextTarget] : NULL;
+}
+
+const char* CMapEntities::ValueForKey(const map_entity_t* pEntity, const char* pszKey)
+{
+	const char* pszValue = NULL;
+
+	for (int i = 0; i < pEntity->numKeyValues; i++)
+	{
+		if (0 == strcmp(GetKey(pEntity, i), pszKey))
+			pszValue = GetValue(pEntity, i);
+	}
+
+	return pszValue;
+}
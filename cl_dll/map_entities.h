@@ -0,0 +1,72 @@
+// The map's entity lump, parsed once per map so client code can look entities up by classname or targetname
+#pragma once
+
+struct map_keyvalue_t
+{
+	int key; // offsets into the string pool
+	int value;
+};
+
+struct map_entity_t
+{
+	int firstKeyValue; // into the key/value list, in the order they're in the lump
+	int numKeyValues;
+	int classname; // offsets into the string pool, or -1
+	int targetname;
+	int nextClass; // the next entity with the same classname/targetname, or -1
+	int nextTarget;
+};
+
+class CMapEntities
+{
+public:
+	CMapEntities();
+	~CMapEntities();
+
+	// called on every map change; the lump's parsed again the next time something's looked up
+	void Invalidate() { m_pLump = NULL; }
+
+	// the first entity with this classname/targetname, in lump order, or NULL
+	const map_entity_t* FindByClassname(const char* pszClassname);
+	const map_entity_t* FindByTargetname(const char* pszTargetname);
+
+	// the next one with the same classname/targetname as pEntity, or NULL
+	const map_entity_t* NextByClassname(const map_entity_t* pEntity);
+	const map_entity_t* NextByTargetname(const map_entity_t* pEntity);
+
+	// the entity's key/values, in lump order
+	int NumKeyValues(const map_entity_t* pEntity) { return pEntity->numKeyValues; }
+	const char* GetKey(const map_entity_t* pEntity, int i) { return m_pStrings + m_pKeyValues[pEntity->firstKeyValue + i].key; }
+	const char* GetValue(const map_entity_t* pEntity, int i) { return m_pStrings + m_pKeyValues[pEntity->firstKeyValue + i].value; }
+
+	// the last value given for a key, or NULL
+	const char* ValueForKey(const map_entity_t* pEntity, const char* pszKey);
+
+private:
+	bool Update();
+	void Parse(const char* pLump);
+	int AddString(const char* pszString);
+	void BuildHash(int* pHash, bool bTarget);
+	const map_entity_t* FindHash(bool bTarget, const char* pszName);
+
+	const char* m_pLump; // what's been parsed, so a new one can be spotted
+
+	map_entity_t* m_pEntities;
+	int m_iNumEntities;
+	int m_iMaxEntities;
+
+	map_keyvalue_t* m_pKeyValues;
+	int m_iNumKeyValues;
+	int m_iMaxKeyValues;
+
+	char* m_pStrings;
+	int m_iStringsSize;
+	int m_iMaxStrings;
+
+	// open addressed, entity index + 1 (0 is empty); each slot is the first of a chain
+	int* m_pClassHash;
+	int* m_pTargetHash;
+	int m_iHashSize;
+};
+
+extern CMapEntities g_MapEntities;
@@ -32,6 +32,12 @@ client_textmessage_t g_pCustomMessage;
 const char* g_pCustomName = "Custom";
 char g_pCustomText[1024];
 
+CHudMessage::~CHudMessage()
+{
+	for (int i = 0; i < maxHUDMessages; i++)
+		delete[] m_layouts[i].pGlyphs;
+}
+
 bool CHudMessage::Init()
 {
 	HOOK_MESSAGE(HudText);
@@ -39,6 +45,8 @@ bool CHudMessage::Init()
 
 	gHUD.AddHudElem(this);
 
+	memset(m_layouts, 0, sizeof(m_layouts));
+
 	Reset();
 
 	return true;
@@ -49,6 +57,13 @@ bool CHudMessage::VidInit()
 	m_HUD_title_half = gHUD.GetSpriteIndex("title_half");
 	m_HUD_title_life = gHUD.GetSpriteIndex("title_life");
 
+	// the character widths and the screen size may have changed
+	for (int i = 0; i < maxHUDMessages; i++)
+	{
+		if (m_pMessages[i])
+			MessageLayout(i);
+	}
+
 	return true;
 }
 
@@ -138,6 +153,7 @@ int CHudMessage::YPosition(float y, int height)
 }
 
 
+// Works out the colour of the next character into m_parms.r, g and b
 void CHudMessage::MessageScanNextChar()
 {
 	int srcRed, srcGreen, srcBlue, destRed, destGreen, destBlue;
@@ -192,12 +208,6 @@ void CHudMessage::MessageScanNextChar()
 	m_parms.r = ((srcRed * (255 - blend)) + (destRed * blend)) >> 8;
 	m_parms.g = ((srcGreen * (255 - blend)) + (destGreen * blend)) >> 8;
 	m_parms.b = ((srcBlue * (255 - blend)) + (destBlue * blend)) >> 8;
-
-	if (m_parms.pMessage->effect == 1 && m_parms.charTime != 0)
-	{
-		if (m_parms.x >= 0 && m_parms.y >= 0 && (m_parms.x + gHUD.m_scrinfo.charWidths[m_parms.text]) <= ScreenWidth)
-			TextMessageDrawChar(m_parms.x, m_parms.y, m_parms.text, m_parms.pMessage->r2, m_parms.pMessage->g2, m_parms.pMessage->b2);
-	}
 }
 
 
@@ -242,27 +252,27 @@ void CHudMessage::MessageScanStart()
 }
 
 
-void CHudMessage::MessageDrawScan(client_textmessage_t* pMessage, float time)
+// Lays out the message in a slot: where each line starts and where each character goes on it
+void CHudMessage::MessageLayout(int slot)
 {
-	int i, j, length, width;
-	const char* pText;
-	unsigned char line[80];
+	client_textmessage_t* pMessage = m_pMessages[slot];
+	message_layout_t* pLayout = &m_layouts[slot];
+	const unsigned char* pText;
+	int i, lines, length, width, totalWidth, totalHeight, x, y;
 
-	pText = pMessage->pMessage;
+	pText = (const unsigned char*)pMessage->pMessage;
 	// Count lines
-	m_parms.lines = 1;
-	m_parms.time = time;
-	m_parms.pMessage = pMessage;
+	lines = 1;
 	length = 0;
 	width = 0;
-	m_parms.totalWidth = 0;
+	totalWidth = 0;
 	while ('\0' != *pText)
 	{
 		if (*pText == '\n')
 		{
-			m_parms.lines++;
-			if (width > m_parms.totalWidth)
-				m_parms.totalWidth = width;
+			lines++;
+			if (width > totalWidth)
+				totalWidth = width;
 			width = 0;
 		}
 		else
@@ -270,46 +280,105 @@ void CHudMessage::MessageDrawScan(client_textmessage_t* pMessage, float time)
 		pText++;
 		length++;
 	}
-	m_parms.length = length;
-	m_parms.totalHeight = (m_parms.lines * gHUD.m_scrinfo.iCharHeight);
-
+	totalHeight = (lines * gHUD.m_scrinfo.iCharHeight);
 
-	m_parms.y = YPosition(pMessage->y, m_parms.totalHeight);
-	pText = pMessage->pMessage;
-
-	m_parms.charTime = 0;
+	if (pLayout->maxGlyphs < length)
+	{
+		delete[] pLayout->pGlyphs;
+		pLayout->maxGlyphs = length;
+		pLayout->pGlyphs = new message_glyph_t[pLayout->maxGlyphs];
+	}
+	pLayout->numGlyphs = 0;
+	pLayout->length = length;
 
-	MessageScanStart();
+	y = YPosition(pMessage->y, totalHeight);
+	pText = (const unsigned char*)pMessage->pMessage;
 
-	for (i = 0; i < m_parms.lines; i++)
+	for (i = 0; i < lines; i++)
 	{
-		m_parms.lineLength = 0;
-		m_parms.width = 0;
+		const unsigned char* pLine = pText;
+
+		width = 0;
 		while ('\0' != *pText && *pText != '\n')
 		{
-			unsigned char c = *pText;
-			line[m_parms.lineLength] = c;
-			m_parms.width += gHUD.m_scrinfo.charWidths[c];
-			m_parms.lineLength++;
+			width += gHUD.m_scrinfo.charWidths[*pText];
 			pText++;
 		}
+
+		x = XPosition(pMessage->x, width, totalWidth);
+
+		for (; pLine < pText; pLine++)
+		{
+			message_glyph_t* pGlyph = &pLayout->pGlyphs[pLayout->numGlyphs++];
+			int next = x + gHUD.m_scrinfo.charWidths[*pLine];
+
+			pGlyph->x = x;
+			pGlyph->y = y;
+			pGlyph->text = *pLine;
+			pGlyph->visible = x >= 0 && y >= 0 && next <= ScreenWidth;
+			x = next;
+		}
+
 		pText++; // Skip LF
-		line[m_parms.lineLength] = 0;
+		y += gHUD.m_scrinfo.iCharHeight;
+	}
+}
+
+
+// The text of a message that's already up can be changed under it (the custom message and the
+// spectator messages are reused), so lay out again every slot that shows it
+void CHudMessage::MessageRelayout(client_textmessage_t* pMessage)
+{
+	for (int i = 0; i < maxHUDMessages; i++)
+	{
+		if (m_pMessages[i] == pMessage)
+			MessageLayout(i);
+	}
+}
+
+
+void CHudMessage::MessageDrawScan(int slot, float time)
+{
+	const message_layout_t* pLayout = &m_layouts[slot];
+	const message_glyph_t* pGlyph = pLayout->pGlyphs;
+	const message_glyph_t* pEnd = pGlyph + pLayout->numGlyphs;
 
-		m_parms.x = XPosition(pMessage->x, m_parms.width, m_parms.totalWidth);
+	m_parms.time = time;
+	m_parms.pMessage = m_pMessages[slot];
+	m_parms.length = pLayout->length;
+	m_parms.charTime = 0;
+
+	MessageScanStart();
 
-		for (j = 0; j < m_parms.lineLength; j++)
+	if (m_parms.pMessage->effect != 2)
+	{
+		// all the characters fade together, so they're all the same colour
+		MessageScanNextChar();
+
+		const bool bFlicker = m_parms.pMessage->effect == 1 && m_parms.charTime != 0;
+		for (; pGlyph < pEnd; pGlyph++)
 		{
-			m_parms.text = line[j];
-			int next = m_parms.x + gHUD.m_scrinfo.charWidths[m_parms.text];
-			MessageScanNextChar();
+			if (!pGlyph->visible)
+				continue;
 
-			if (m_parms.x >= 0 && m_parms.y >= 0 && next <= ScreenWidth)
-				TextMessageDrawChar(m_parms.x, m_parms.y, m_parms.text, m_parms.r, m_parms.g, m_parms.b);
-			m_parms.x = next;
+			if (bFlicker)
+				TextMessageDrawChar(pGlyph->x, pGlyph->y, pGlyph->text, m_parms.pMessage->r2, m_parms.pMessage->g2, m_parms.pMessage->b2);
+			TextMessageDrawChar(pGlyph->x, pGlyph->y, pGlyph->text, m_parms.r, m_parms.g, m_parms.b);
 		}
+		return;
+	}
 
-		m_parms.y += gHUD.m_scrinfo.iCharHeight;
+	for (; pGlyph < pEnd; pGlyph++)
+	{
+		MessageScanNextChar();
+
+		// each character's written out after the one before it, so once one
+		// hasn't been, none of the rest have either
+		if (m_parms.charTime > m_parms.time)
+			break;
+
+		if (pGlyph->visible)
+			TextMessageDrawChar(pGlyph->x, pGlyph->y, pGlyph->text, m_parms.r, m_parms.g, m_parms.b);
 	}
 }
 
@@ -383,7 +452,7 @@ bool CHudMessage::Draw(float fTime)
 
 			// Fade in is per character in scanning messages
 			case 2:
-				endTime = m_startTime[i] + (pMessage->fadein * strlen(pMessage->pMessage)) + pMessage->fadeout + pMessage->holdtime;
+				endTime = m_startTime[i] + (pMessage->fadein * m_layouts[i].length) + pMessage->fadeout + pMessage->holdtime;
 				break;
 			}
 
@@ -395,7 +464,7 @@ bool CHudMessage::Draw(float fTime)
 				// effect 0 is fade in/fade out
 				// effect 1 is flickery credits
 				// effect 2 is write out (training room)
-				MessageDrawScan(pMessage, messageTime);
+				MessageDrawScan(i, messageTime);
 
 				drawn++;
 			}
@@ -460,6 +529,7 @@ void CHudMessage::MessageAdd(const char* pName, float time)
 					// is this message already in the list
 					if (0 == strcmp(tempMessage->pMessage, m_pMessages[j]->pMessage))
 					{
+						MessageRelayout(tempMessage);
 						return;
 					}
 
@@ -476,6 +546,7 @@ void CHudMessage::MessageAdd(const char* pName, float time)
 
 			m_pMessages[i] = tempMessage;
 			m_startTime[i] = time;
+			MessageRelayout(tempMessage);
 			return;
 		}
 	}
@@ -529,7 +600,9 @@ void CHudMessage::MessageAdd(client_textmessage_t* newMessage)
 		{
 			m_pMessages[i] = newMessage;
 			m_startTime[i] = gHUD.m_flTime;
-			return;
+			break;
 		}
 	}
+
+	MessageRelayout(newMessage);
 }
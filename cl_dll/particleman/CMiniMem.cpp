@@ -16,6 +16,8 @@
 #undef clamp
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 
 #include "hud.h"
 #include "cl_util.h"
@@ -23,15 +25,53 @@
 #include "particleman_internal.h"
 #include "CMiniMem.h"
 
+//Every particle has its index in _particles stored just in front of it, so freeing one doesn't have to search for it.
+static std::size_t GetHeaderSize(std::size_t alignment)
+{
+	return std::max(alignment, sizeof(std::size_t));
+}
+
+static std::size_t& GetSlot(void* memory)
+{
+	return *(reinterpret_cast<std::size_t*>(memory) - 1);
+}
+
+constexpr float ForceGridCellSize = 128;
+constexpr std::size_t ForceGridBuckets = 4096;
+constexpr int ForceGridMaxCells = 512; //Forces bigger than this many cells just check every particle
+
+//Below this many visible particles a plain sort is quicker than clearing the radix histograms.
+constexpr std::size_t RadixSortThreshold = 256;
+
+static int GetForceGridCell(float value)
+{
+	return static_cast<int>(std::floor(value / ForceGridCellSize));
+}
+
+static std::uint32_t GetForceGridBucket(int x, int y, int z)
+{
+	const std::uint32_t hash = (static_cast<std::uint32_t>(x) * 73856093u) ^ (static_cast<std::uint32_t>(y) * 19349663u) ^ (static_cast<std::uint32_t>(z) * 83492791u);
+	return hash % ForceGridBuckets;
+}
+
 void* CMiniMem::Allocate(std::size_t sizeInBytes, std::size_t alignment)
 {
-	auto particle = reinterpret_cast<CBaseParticle*>(_pool.allocate(sizeInBytes, alignment));
+	alignment = std::max(alignment, alignof(std::size_t));
+	const std::size_t headerSize = GetHeaderSize(alignment);
+
+	auto memory = reinterpret_cast<char*>(_pool.allocate(sizeInBytes + headerSize, alignment));
 
-	if (nullptr != particle)
+	if (nullptr == memory)
 	{
-		_particles.push_back(particle);
+		return nullptr;
 	}
 
+	auto particle = reinterpret_cast<CBaseParticle*>(memory + headerSize);
+
+	GetSlot(particle) = _particles.size();
+	_particles.push_back(particle);
+	_forceGridValid = false;
+
 	return particle;
 }
 
@@ -42,9 +82,51 @@ void CMiniMem::Deallocate(void* memory, std::size_t sizeInBytes, std::size_t ali
 		return;
 	}
 
-	_particles.erase(std::find(_particles.begin(), _particles.end(), memory));
+	const std::size_t slot = GetSlot(memory);
+
+	if (_deferRemoval)
+	{
+		_particles[slot] = nullptr;
+		++_deferredRemovals;
+	}
+	else
+	{
+		//Fill the hole with the last particle.
+		auto last = _particles.back();
+		_particles[slot] = last;
+		GetSlot(last) = slot;
+		_particles.pop_back();
+	}
+
+	_forceGridValid = false;
+
+	alignment = std::max(alignment, alignof(std::size_t));
+	const std::size_t headerSize = GetHeaderSize(alignment);
+
+	_pool.deallocate(reinterpret_cast<char*>(memory) - headerSize, sizeInBytes + headerSize, alignment);
+}
+
+//Removes the holes left by particles freed while removal was deferred.
+void CMiniMem::CompactParticles()
+{
+	if (0 == _deferredRemovals)
+	{
+		return;
+	}
+
+	std::size_t count = 0;
+
+	for (auto particle : _particles)
+	{
+		if (particle)
+		{
+			GetSlot(particle) = count;
+			_particles[count++] = particle;
+		}
+	}
 
-	_pool.deallocate(memory, sizeInBytes, alignment);
+	_particles.resize(count);
+	_deferredRemovals = 0;
 }
 
 void CMiniMem::Shutdown()
@@ -66,18 +148,27 @@ CMiniMem* CMiniMem::Instance()
 void CMiniMem::ProcessAll()
 {
 	const float time = gEngfuncs.GetClientTime();
+	const auto player = gEngfuncs.GetLocalPlayer();
 
 	//Clear list of visible particles.
 	_visibleParticles = 0;
+	_sortItems.clear();
 
-	//Divide the particle list in two: the list of visible particles and the list of invisible particles.
-	//Remove any particles that have died.
-	std::size_t invisibleCount = 0;
+	//Particles created while we're processing get their first think next frame.
+	const std::size_t count = _particles.size();
 
-	for (std::size_t i = 0; i < (_particles.size() - invisibleCount);)
+	_deferRemoval = true;
+
+	for (std::size_t i = 0; i < count; ++i)
 	{
 		auto effect = _particles[i];
 
+		//Removed by another particle's think.
+		if (!effect)
+		{
+			continue;
+		}
+
 		if (!IsGamePaused())
 		{
 			effect->Think(time);
@@ -87,120 +178,260 @@ void CMiniMem::ProcessAll()
 		{
 			effect->Die();
 			delete effect;
-
-			//Don't do this! operator delete removes the effect from the list.
-			//_particles.erase(_particles.begin() + i);
 			continue;
 		}
 
 		if (effect->CheckVisibility())
 		{
-			auto player = gEngfuncs.GetLocalPlayer();
-			effect->SetPlayerDistance((player->origin - effect->m_vOrigin).LengthSquared());
+			const float distance = (player->origin - effect->m_vOrigin).LengthSquared();
+			effect->SetPlayerDistance(distance);
 
-			++_visibleParticles;
-		}
-		else
-		{
-			if (i + invisibleCount < _particles.size())
-			{
-				//There is an effect we haven't checked yet.
-				//Put the invisible effect at the end of the list and check the other effect next.
-				std::swap(_particles[i], _particles[_particles.size() - 1 - invisibleCount]);
-				++invisibleCount;
-				continue;
-			}
-			//No more unchecked effects in the list.
+			//Squared distances are never negative, so their bit patterns sort the same way as the values.
+			std::uint32_t key;
+			std::memcpy(&key, &distance, sizeof(key));
+			_sortItems.push_back({key, effect});
 		}
-
-		++i;
 	}
 
-	std::sort(_particles.begin(), _particles.begin() + _visibleParticles, [](const auto& lhs, const auto& rhs)
-		{
-			//Particles are ordered farthest to nearest so they can be drawn in order.
-			const float lhsDistance = lhs->GetPlayerDistance();
-			const float rhsDistance = rhs->GetPlayerDistance();
+	_deferRemoval = false;
+	CompactParticles();
+
+	//Everything may have moved.
+	_forceGridValid = false;
+
+	SortVisibleParticles();
 
-			return lhsDistance > rhsDistance;
-		});
+	_visibleParticles = _sortItems.size();
 
-	for (std::size_t i = 0; i < _visibleParticles; ++i)
+	for (const auto& item : _sortItems)
 	{
-		auto effect = _particles[i];
-		effect->Draw();
+		item.particle->Draw();
 	}
 
 	g_flOldTime = time;
 }
 
-int CMiniMem::ApplyForce(Vector vOrigin, Vector vDirection, float flRadius, float flStrength)
+//Particles are ordered farthest to nearest so they can be drawn in order.
+void CMiniMem::SortVisibleParticles()
 {
-	const float radiusSquared = flRadius * flRadius;
+	const std::size_t count = _sortItems.size();
 
-	for (auto effect : _particles)
+	if (count < RadixSortThreshold)
 	{
-		if (!effect->m_bAffectedByForce)
-		{
-			continue;
-		}
+		std::sort(_sortItems.begin(), _sortItems.end(), [](const auto& lhs, const auto& rhs)
+			{
+				return lhs.key > rhs.key;
+			});
+		return;
+	}
 
-		const float size = effect->m_flSize / 5;
+	//Least significant digit first, 11 bits at a time; the keys are inverted so the farthest comes first.
+	constexpr int RadixBits = 11;
+	constexpr std::size_t RadixSize = 1 << RadixBits;
+	constexpr std::uint32_t RadixMask = RadixSize - 1;
 
-		const Vector mins = effect->m_vOrigin - Vector{size, size, size};
-		const Vector maxs = effect->m_vOrigin + Vector{size, size, size};
+	_sortScratch.resize(count);
 
-		//If the force origin lies outside the effect's bounding box, calculate the distance from the box.
-		float totalDistanceSquared = 0;
+	auto source = &_sortItems;
+	auto destination = &_sortScratch;
+
+	for (int shift = 0; shift < 32; shift += RadixBits)
+	{
+		std::size_t offsets[RadixSize]{};
 
-		for (int i = 0; i < 3; ++i)
+		for (const auto& item : *source)
 		{
-			float boundingValue;
+			++offsets[(~item.key >> shift) & RadixMask];
+		}
 
-			if (vOrigin[i] < mins[i])
-			{
-				boundingValue = mins[i];
-			}
-			else if (vOrigin[i] > maxs[i])
-			{
-				boundingValue = maxs[i];
-			}
-			else
-			{
-				continue;
-			}
+		std::size_t total = 0;
 
-			totalDistanceSquared += (vOrigin[i] - boundingValue) * (vOrigin[i] - boundingValue);
+		for (auto& offset : offsets)
+		{
+			const std::size_t bucketCount = offset;
+			offset = total;
+			total += bucketCount;
 		}
 
-		//Effect is further away from position than force radius, don't apply force.
-		if (totalDistanceSquared > radiusSquared)
+		for (const auto& item : *source)
 		{
-			continue;
+			(*destination)[offsets[(~item.key >> shift) & RadixMask]++] = item;
+		}
+
+		std::swap(source, destination);
+	}
+
+	//Three passes, so the result ended up in the scratch buffer.
+	if (source != &_sortItems)
+	{
+		_sortItems.swap(_sortScratch);
+	}
+}
+
+void CMiniMem::BuildForceGrid()
+{
+	_forceBucketStart.assign(ForceGridBuckets + 1, 0);
+	_forceGridMaxExtent = 0;
+
+	std::size_t affected = 0;
+
+	for (auto effect : _particles)
+	{
+		if (effect && effect->m_bAffectedByForce)
+		{
+			const auto& origin = effect->m_vOrigin;
+			++_forceBucketStart[GetForceGridBucket(GetForceGridCell(origin.x), GetForceGridCell(origin.y), GetForceGridCell(origin.z)) + 1];
+			_forceGridMaxExtent = std::max(_forceGridMaxExtent, effect->m_flSize / 5);
+			++affected;
 		}
+	}
 
-		const float strength = std::max(0.f, flStrength - (vOrigin - effect->m_vOrigin).Length() * (flStrength / (0.5f * radiusSquared)));
+	for (std::size_t i = 1; i <= ForceGridBuckets; ++i)
+	{
+		_forceBucketStart[i] += _forceBucketStart[i - 1];
+	}
+
+	_forceBucketParticles.resize(affected);
 
-		if (vDirection == g_vecZero)
+	//Use the end of each bucket as a write cursor, then step back to the start.
+	for (auto effect : _particles)
+	{
+		if (effect && effect->m_bAffectedByForce)
 		{
-			const float acceleration = -(strength / effect->m_flMass);
+			const auto& origin = effect->m_vOrigin;
+			const auto bucket = GetForceGridBucket(GetForceGridCell(origin.x), GetForceGridCell(origin.y), GetForceGridCell(origin.z));
+			_forceBucketParticles[_forceBucketStart[bucket]++] = effect;
+		}
+	}
+
+	for (std::size_t i = ForceGridBuckets; i > 0; --i)
+	{
+		_forceBucketStart[i] = _forceBucketStart[i - 1];
+	}
 
-			const Vector direction = (vOrigin - effect->m_vOrigin).Normalize();
-			const Vector velocity = effect->m_vVelocity.Normalize();
+	_forceBucketStart[0] = 0;
 
-			effect->m_vVelocity = acceleration * (direction + velocity);
+	_forceGridValid = true;
+}
+
+void CMiniMem::ApplyForceToParticle(CBaseParticle* effect, const Vector& vOrigin, const Vector& vDirection, float radiusSquared, float flStrength)
+{
+	const float size = effect->m_flSize / 5;
+
+	const Vector mins = effect->m_vOrigin - Vector{size, size, size};
+	const Vector maxs = effect->m_vOrigin + Vector{size, size, size};
+
+	//If the force origin lies outside the effect's bounding box, calculate the distance from the box.
+	float totalDistanceSquared = 0;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		float boundingValue;
+
+		if (vOrigin[i] < mins[i])
+		{
+			boundingValue = mins[i];
+		}
+		else if (vOrigin[i] > maxs[i])
+		{
+			boundingValue = maxs[i];
 		}
 		else
 		{
-			const float acceleration = strength / effect->m_flMass;
+			continue;
+		}
+
+		totalDistanceSquared += (vOrigin[i] - boundingValue) * (vOrigin[i] - boundingValue);
+	}
 
-			const Vector direction = vDirection.Normalize();
-			const Vector velocity = effect->m_vVelocity.Normalize();
+	//Effect is further away from position than force radius, don't apply force.
+	if (totalDistanceSquared > radiusSquared)
+	{
+		return;
+	}
 
-			effect->m_vVelocity = acceleration * (direction + velocity);
+	const float strength = std::max(0.f, flStrength - (vOrigin - effect->m_vOrigin).Length() * (flStrength / (0.5f * radiusSquared)));
+
+	if (vDirection == g_vecZero)
+	{
+		const float acceleration = -(strength / effect->m_flMass);
+
+		const Vector direction = (vOrigin - effect->m_vOrigin).Normalize();
+		const Vector velocity = effect->m_vVelocity.Normalize();
+
+		effect->m_vVelocity = acceleration * (direction + velocity);
+	}
+	else
+	{
+		const float acceleration = strength / effect->m_flMass;
+
+		const Vector direction = vDirection.Normalize();
+		const Vector velocity = effect->m_vVelocity.Normalize();
+
+		effect->m_vVelocity = acceleration * (direction + velocity);
+	}
+
+	effect->Force();
+}
+
+int CMiniMem::ApplyForce(Vector vOrigin, Vector vDirection, float flRadius, float flStrength)
+{
+	const float radiusSquared = flRadius * flRadius;
+
+	if (!_forceGridValid)
+	{
+		BuildForceGrid();
+	}
+
+	//Every cell a particle touching the force's radius could be filed under.
+	const float reach = flRadius + _forceGridMaxExtent;
+
+	int mins[3];
+	int maxs[3];
+
+	for (int i = 0; i < 3; ++i)
+	{
+		mins[i] = GetForceGridCell(vOrigin[i] - reach);
+		maxs[i] = GetForceGridCell(vOrigin[i] + reach);
+	}
+
+	const long long cells = static_cast<long long>(maxs[0] - mins[0] + 1) * (maxs[1] - mins[1] + 1) * (maxs[2] - mins[2] + 1);
+
+	if (cells > ForceGridMaxCells)
+	{
+		for (auto effect : _forceBucketParticles)
+		{
+			ApplyForceToParticle(effect, vOrigin, vDirection, radiusSquared, flStrength);
 		}
 
-		effect->Force();
+		return 1;
+	}
+
+	//Different cells can share a bucket; make sure each bucket is only visited once.
+	std::uint32_t visited[ForceGridMaxCells];
+	int visitedCount = 0;
+
+	for (int x = mins[0]; x <= maxs[0]; ++x)
+	{
+		for (int y = mins[1]; y <= maxs[1]; ++y)
+		{
+			for (int z = mins[2]; z <= maxs[2]; ++z)
+			{
+				const auto bucket = GetForceGridBucket(x, y, z);
+
+				if (std::find(visited, visited + visitedCount, bucket) != visited + visitedCount)
+				{
+					continue;
+				}
+
+				visited[visitedCount++] = bucket;
+
+				for (auto i = _forceBucketStart[bucket]; i < _forceBucketStart[bucket + 1]; ++i)
+				{
+					ApplyForceToParticle(_forceBucketParticles[i], vOrigin, vDirection, radiusSquared, flStrength);
+				}
+			}
+		}
 	}
 
 	return 1;
@@ -209,17 +440,28 @@ int CMiniMem::ApplyForce(Vector vOrigin, Vector vDirection, float flRadius, floa
 void CMiniMem::Reset()
 {
 	_visibleParticles = 0;
+	_sortItems.clear();
+
+	_deferRemoval = true;
 
 	for (auto particle : _particles)
 	{
-		particle->Die();
-		delete particle;
+		if (particle)
+		{
+			particle->Die();
+			delete particle;
+		}
 	}
 
-	//Cleared by CBaseParticle::operator delete
-	//_particles.clear();
+	_deferRemoval = false;
+	_particles.clear();
+	_deferredRemovals = 0;
+	_forceGridValid = false;
 
 	//Wipe away previously allocated memory so maps with loads of particles don't eat up memory forever.
 	_pool.release();
 	_particles.shrink_to_fit();
+	_sortItems.shrink_to_fit();
+	_sortScratch.shrink_to_fit();
+	_forceBucketParticles.shrink_to_fit();
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <memory_resource>
 #include <vector>
 
@@ -21,11 +22,36 @@ private:
 	std::vector<CBaseParticle*> _particles;
 	std::size_t _visibleParticles = 0;
 
+	//While this is set, freed particles leave a null in _particles instead of being swapped out, so loops over it stay valid.
+	bool _deferRemoval = false;
+	std::size_t _deferredRemovals = 0;
+
+	//Visible particles and their depth keys, sorted farthest to nearest every frame.
+	struct SortItem
+	{
+		std::uint32_t key;
+		CBaseParticle* particle;
+	};
+
+	std::vector<SortItem> _sortItems;
+	std::vector<SortItem> _sortScratch;
+
+	//Coarse spatial hash of the particles affected by forces, built on demand and thrown away when anything moves.
+	bool _forceGridValid = false;
+	float _forceGridMaxExtent = 0;
+	std::vector<std::uint32_t> _forceBucketStart; //ForceGridBuckets + 1 entries
+	std::vector<CBaseParticle*> _forceBucketParticles;
+
 protected:
 	// private constructor and destructor.
 	CMiniMem() = default;
 	~CMiniMem() = default;
 
+	void CompactParticles();
+	void SortVisibleParticles();
+	void BuildForceGrid();
+	void ApplyForceToParticle(CBaseParticle* effect, const Vector& vOrigin, const Vector& vDirection, float radiusSquared, float flStrength);
+
 public:
 	void* Allocate(std::size_t sizeInBytes, std::size_t alignment = alignof(std::max_align_t));
 
@@ -41,6 +67,6 @@ public:
 
 	static CMiniMem* Instance();
 
-	std::size_t GetTotalParticles() { return _particles.size(); }
+	std::size_t GetTotalParticles() { return _particles.size() - _deferredRemovals; }
 	std::size_t GetDrawnParticles() { return _visibleParticles; }
 };
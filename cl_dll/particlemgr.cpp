@@ -8,157 +8,438 @@
 #include "triangleapi.h"
 #include "particlemgr.h"
 #include "particlesys.h"
+#include "profiler.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 ParticleSystemManager* g_pParticleSystems = NULL;
 
+static cvar_t* cl_particle_budget = NULL;	  // most live particles, over all the systems
+static cvar_t* cl_particle_sprays = NULL;	  // most new particles sprayed in one frame
+static cvar_t* cl_particle_traces = NULL;	  // most collision traces for bouncing particles in one frame
+static cvar_t* cl_particle_lod_dist = NULL;	  // systems further away than this spray less
+static cvar_t* cl_particle_lod_pixels = NULL; // ...and so do systems smaller than this on screen
+static cvar_t* cl_particle_cull = NULL;		  // don't update or draw systems outside the view
+static cvar_t* cl_particle_stats = NULL;
+static cvar_t* cl_particle_threads = NULL;	  // extra threads to simulate systems on; 0 = do it all here
+static cvar_t* cl_particle_seed = NULL;		  // the same seed gives the same particles, for the same systems made in the same order
+
+#define MAX_PARTICLE_THREADS 8
+
+// Runs ParticleSystem::Simulate for a list of systems, split between the worker threads and the caller.
+// Each system is only ever touched by one thread, and the caller doesn't get control back until they're all done.
+class ParticleWorkers
+{
+public:
+	ParticleWorkers()
+	{
+		m_iNumThreads = 0;
+		m_iGeneration = 0;
+		m_iWorking = 0;
+		m_bQuit = false;
+		m_ppJobs = NULL;
+		m_iNumJobs = 0;
+		m_fFrametime = 0;
+		m_iNextJob = 0;
+	}
+
+	~ParticleWorkers()
+	{
+		SetThreads(0);
+	}
+
+	void SetThreads(int iThreads)
+	{
+		iThreads = V_max(0, V_min(MAX_PARTICLE_THREADS, iThreads));
+		if (iThreads == m_iNumThreads)
+			return;
+
+		if (m_iNumThreads)
+		{
+			{
+				std::lock_guard guard{m_Mutex};
+				m_bQuit = true;
+			}
+			m_Start.notify_all();
+			for (int i = 0; i < m_iNumThreads; i++)
+				m_Threads[i].join();
+			m_bQuit = false;
+		}
+
+		// (they're told which job lists they've already seen, in case one comes before they get going)
+		for (int i = 0; i < iThreads; i++)
+			m_Threads[i] = std::thread{&ParticleWorkers::WorkerMain, this, m_iGeneration};
+		m_iNumThreads = iThreads;
+	}
+
+	void Run(ParticleSystem** ppJobs, int iNumJobs, float frametime)
+	{
+		if (m_iNumThreads == 0 || iNumJobs < 2)
+		{
+			for (int i = 0; i < iNumJobs; i++)
+				ppJobs[i]->Simulate(frametime);
+			return;
+		}
+
+		{
+			std::lock_guard guard{m_Mutex};
+			m_ppJobs = ppJobs;
+			m_iNumJobs = iNumJobs;
+			m_fFrametime = frametime;
+			m_iNextJob = 0;
+			m_iWorking = m_iNumThreads;
+			m_iGeneration++;
+		}
+		m_Start.notify_all();
+
+		// lend a hand, rather than just waiting
+		DoJobs();
+
+		std::unique_lock lock{m_Mutex};
+		m_Done.wait(lock, [this]
+			{ return m_iWorking == 0; });
+	}
+
+private:
+	void DoJobs()
+	{
+		int i;
+		while ((i = m_iNextJob++) < m_iNumJobs)
+			m_ppJobs[i]->Simulate(m_fFrametime);
+	}
+
+	void WorkerMain(int iGeneration)
+	{
+		std::unique_lock lock{m_Mutex};
+		for (;;)
+		{
+			m_Start.wait(lock, [&]
+				{ return m_bQuit || m_iGeneration != iGeneration; });
+			if (m_bQuit)
+				return;
+			iGeneration = m_iGeneration;
+
+			lock.unlock();
+			DoJobs();
+			lock.lock();
+
+			if (--m_iWorking == 0)
+				m_Done.notify_one();
+		}
+	}
+
+	std::thread m_Threads[MAX_PARTICLE_THREADS];
+	int m_iNumThreads;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Start; // a new job list, or time to quit
+	std::condition_variable m_Done;	 // the last worker has finished with the job list
+	int m_iGeneration;				 // counts job lists
+	int m_iWorking;					 // workers still busy with this one
+	bool m_bQuit;
+
+	ParticleSystem** m_ppJobs;
+	int m_iNumJobs;
+	float m_fFrametime;
+	std::atomic<int> m_iNextJob;
+};
+
 ParticleSystemManager::ParticleSystemManager()
 {
-	m_pFirstSystem = NULL;
+	memset(m_pEntitySystems, 0, sizeof(m_pEntitySystems));
+	m_pSystems = NULL;
+	m_iNumSystems = m_iMaxSystems = 0;
+	m_pJobs = NULL;
+	m_iMaxJobs = 0;
+	m_pWorkers = new ParticleWorkers;
+	m_iSystemsMade = 0;
 	//systemio = NULL;
+	m_fBudgetScale = 1;
+	m_iLiveParticles = m_iUpdatedSystems = m_iCulledSystems = m_iSprayed = m_iRefused = 0;
+	m_iTraced = m_iTracesRefused = 0;
+
+	cl_particle_budget = CVAR_CREATE("cl_particle_budget", "4000", FCVAR_ARCHIVE);
+	cl_particle_sprays = CVAR_CREATE("cl_particle_sprays", "400", FCVAR_ARCHIVE);
+	cl_particle_traces = CVAR_CREATE("cl_particle_traces", "256", FCVAR_ARCHIVE);
+	cl_particle_lod_dist = CVAR_CREATE("cl_particle_lod_dist", "1024", FCVAR_ARCHIVE);
+	cl_particle_lod_pixels = CVAR_CREATE("cl_particle_lod_pixels", "16", FCVAR_ARCHIVE);
+	cl_particle_cull = CVAR_CREATE("cl_particle_cull", "1", FCVAR_ARCHIVE);
+	cl_particle_stats = CVAR_CREATE("cl_particle_stats", "0", 0);
+	cl_particle_threads = CVAR_CREATE("cl_particle_threads", "0", FCVAR_ARCHIVE);
+	cl_particle_seed = CVAR_CREATE("cl_particle_seed", "0", 0);
 }
 
 ParticleSystemManager::~ParticleSystemManager()
 {
+	delete m_pWorkers; // (stops the threads)
 	ClearSystems();
+	delete[] m_pSystems;
+	delete[] m_pJobs;
 }
 
 void ParticleSystemManager::AddSystem(ParticleSystem* pNewSystem)
 {
-	pNewSystem->m_pNextSystem = m_pFirstSystem;
-	m_pFirstSystem = pNewSystem;
+	if (m_iNumSystems == m_iMaxSystems)
+	{
+		int iNewMax = m_iMaxSystems ? m_iMaxSystems * 2 : 32;
+		ParticleSystem** pNew = new ParticleSystem*[iNewMax];
+		if (m_pSystems)
+		{
+			memcpy(pNew, m_pSystems, m_iNumSystems * sizeof(ParticleSystem*));
+			delete[] m_pSystems;
+		}
+		m_pSystems = pNew;
+		m_iMaxSystems = iNewMax;
+	}
+
+	// it'll be sorted into place next frame
+	m_pSystems[m_iNumSystems++] = pNewSystem;
+
+	// its random numbers depend on the seed, which entity it's for, and how many systems came before it
+	// this level; not on when it's updated, or by which thread
+	pNewSystem->m_Random.Seed((unsigned int)cl_particle_seed->value, pNewSystem->m_iEntIndex, ++m_iSystemsMade);
+
+	// if an entity has more than one system, the newest is the one FindSystem finds
+	pNewSystem->m_pNextSystem = NULL;
+	int iIndex = pNewSystem->m_iEntIndex;
+	if (iIndex >= 0 && iIndex < MAX_EDICTS)
+	{
+		pNewSystem->m_pNextSystem = m_pEntitySystems[iIndex];
+		m_pEntitySystems[iIndex] = pNewSystem;
+	}
 }
 
 ParticleSystem* ParticleSystemManager::FindSystem(cl_entity_t* pEntity)
 {
-	for (ParticleSystem* pSys = m_pFirstSystem; pSys; pSys = pSys->m_pNextSystem)
+	if (pEntity->index >= 0 && pEntity->index < MAX_EDICTS)
+		return m_pEntitySystems[pEntity->index];
+
+	for (int i = m_iNumSystems - 1; i >= 0; i--)
+	{
+		if (pEntity->index == m_pSystems[i]->m_iEntIndex)
+			return m_pSystems[i];
+	}
+	return NULL;
+}
+
+// takes a system out of the entity table; the caller deals with m_pSystems
+void ParticleSystemManager::UnlinkSystem(ParticleSystem* pSystem)
+{
+	int iIndex = pSystem->m_iEntIndex;
+	if (iIndex < 0 || iIndex >= MAX_EDICTS)
+		return;
+
+	ParticleSystem** ppLink = &m_pEntitySystems[iIndex];
+	while (*ppLink)
 	{
-		if (pEntity->index == pSys->m_iEntIndex)
-		//		if (pEntity == pSys->GetEntity())
+		if (*ppLink == pSystem)
 		{
-			return pSys;
+			*ppLink = pSystem->m_pNextSystem;
+			return;
 		}
+		ppLink = &(*ppLink)->m_pNextSystem;
 	}
-	return NULL;
 }
 
 // blended particles don't use the z-buffer, so we need to sort them before drawing.
 // for efficiency, only the systems are sorted - individual particles just get drawn in order of creation.
 // (this should actually make things look better - no ugly popping when one particle passes through another.)
+// The systems are still in last frame's order, which is usually almost right, so an insertion sort
+// only has a few short moves to make.
 void ParticleSystemManager::SortSystems()
 {
-	ParticleSystem* pSystem;
-	ParticleSystem* pLast;
-	ParticleSystem *pBeforeCompare, *pCompare;
-
-	if (!m_pFirstSystem)
-		return;
-
 	// calculate how far away each system is from the viewer
-	for (pSystem = m_pFirstSystem; pSystem; pSystem = pSystem->m_pNextSystem)
-		pSystem->CalculateDistance();
+	for (int i = 0; i < m_iNumSystems; i++)
+		m_pSystems[i]->CalculateDistance();
 
-	// do an insertion sort on the systems
-	pLast = m_pFirstSystem;
-	pSystem = pLast->m_pNextSystem;
-	while (pSystem)
+	// furthest first
+	for (int i = 1; i < m_iNumSystems; i++)
 	{
-		if (pLast->m_fViewerDist < pSystem->m_fViewerDist)
+		ParticleSystem* pSystem = m_pSystems[i];
+		int j = i;
+		while (j > 0 && m_pSystems[j - 1]->m_fViewerDist < pSystem->m_fViewerDist)
 		{
-			// pSystem is in the wrong place! First, let's unlink it from the list
-			pLast->m_pNextSystem = pSystem->m_pNextSystem;
-
-			// then find somewhere to insert it
-			if (m_pFirstSystem == pLast || m_pFirstSystem->m_fViewerDist < pSystem->m_fViewerDist)
-			{
-				// pSystem comes before the first system, insert it there
-				pSystem->m_pNextSystem = m_pFirstSystem;
-				m_pFirstSystem = pSystem;
-			}
-			else
-			{
-				// insert pSystem somewhere within the sorted part of the list
-				pBeforeCompare = m_pFirstSystem;
-				pCompare = pBeforeCompare->m_pNextSystem;
-				while (pCompare != pLast)
-				{
-					if (pCompare->m_fViewerDist < pSystem->m_fViewerDist)
-					{
-						// pSystem comes before pCompare. We've found where it belongs.
-						break;
-					}
-
-					pBeforeCompare = pCompare;
-					pCompare = pBeforeCompare->m_pNextSystem;
-				}
-
-				// we've found where pSystem belongs. Insert it between pBeforeCompare and pCompare.
-				pBeforeCompare->m_pNextSystem = pSystem;
-				pSystem->m_pNextSystem = pCompare;
-			}
-		}
-		else
-		{
-			//pSystem is in the right place, move on
-			pLast = pSystem;
+			m_pSystems[j] = m_pSystems[j - 1];
+			j--;
 		}
-		pSystem = pLast->m_pNextSystem;
+		m_pSystems[j] = pSystem;
+	}
+}
+
+// how much detail a system deserves, judging by how far away it is and how big it looks
+float ParticleSystemManager::CalculateLOD(ParticleSystem* pSystem, float fPixelScale)
+{
+	float fDist = sqrt(pSystem->m_fViewerDist);
+	float fLOD = 1;
+
+	float fLODDist = cl_particle_lod_dist->value;
+	if (fLODDist > 0 && fDist > fLODDist)
+		fLOD = fLODDist / fDist;
+
+	// (not below a quarter, or small systems would never spray enough to grow)
+	float fLODPixels = cl_particle_lod_pixels->value;
+	if (fLODPixels > 0 && fPixelScale > 0 && fDist > 1)
+	{
+		float fPixels = pSystem->m_fRadius * fPixelScale / fDist;
+		if (fPixels < fLODPixels)
+			fLOD = V_min(fLOD, V_max(0.25f, fPixels / fLODPixels));
 	}
+
+	return V_max(0.05f, fLOD * m_fBudgetScale);
 }
 
-void ParticleSystemManager::UpdateSystems(float frametime) //LRC - now with added time!
+void ParticleSystemManager::UpdateSystems(float frametime, int iFOV, int iScreenWidth) //LRC - now with added time!
 {
+	PROFILE_SCOPE(PROF_PARTICLES);
+
 	//	gEngfuncs.pTriAPI->RenderMode(kRenderTransAdd);
 	//	gEngfuncs.pTriAPI->RenderMode(kRenderTransAlpha);
-	ParticleSystem* pSystem;
-	ParticleSystem* pLast = NULL;
-	ParticleSystem* pLastSorted = NULL;
 	cl_entity_t* localPlayer = gEngfuncs.GetLocalPlayer();
+	if (!localPlayer)
+		return; // between levels, nothing's current
 	//	vec3_t normal, forward, right, up;
 
 	//	gEngfuncs.GetViewAngles((float*)normal);
 	//	AngleVectors(normal,forward,right,up);
 
-	//SortSystems();
+	SortSystems();
+
+	bool bCull = cl_particle_cull->value != 0;
+	if (bCull)
+		m_Frustum.CalculateFrustum();
+
+	// if we were over budget last frame, everything sprays less until we aren't
+	int iBudget = V_max(1, (int)cl_particle_budget->value);
+	if (m_iLiveParticles > iBudget)
+		m_fBudgetScale = V_max(0.05f, m_fBudgetScale - frametime);
+	else
+		m_fBudgetScale = V_min(1.0f, m_fBudgetScale + frametime * 0.5f);
+
+	// and once the budget's used up, nothing sprays at all
+	int iSprayBudget = V_max(0, V_min((int)cl_particle_sprays->value, iBudget - m_iLiveParticles));
 
-	pSystem = m_pFirstSystem;
-	while (pSystem)
+	ParticleSystem::c_iTraceBudget = V_max(0, (int)cl_particle_traces->value);
+	ParticleSystem::c_iTracesRefused = 0;
+	int iTraceBudget = ParticleSystem::c_iTraceBudget;
+
+	// on-screen pixels per unit of size, at a distance of one unit
+	float fPixelScale = 0;
+	if (iFOV > 0 && iFOV < 180)
+		fPixelScale = iScreenWidth * 0.5f / tan(iFOV * (M_PI / 360));
+
+	m_iLiveParticles = m_iUpdatedSystems = m_iCulledSystems = m_iSprayed = m_iRefused = 0;
+
+	if (m_iMaxJobs < m_iNumSystems)
 	{
-		if (pSystem->UpdateSystem(frametime, /*right, up,*/ localPlayer->curstate.messagenum))
+		delete[] m_pJobs;
+		m_iMaxJobs = m_iMaxSystems;
+		m_pJobs = new ParticleSystem*[m_iMaxJobs];
+	}
+	int iNumJobs = 0;
+	int iSprayDemand = 0;
+
+	// first, everything the systems need from the engine
+	int iKept = 0;
+	for (int i = 0; i < m_iNumSystems; i++)
+	{
+		ParticleSystem* pSystem = m_pSystems[i];
+
+		// out of sight: leave it exactly as it is until it comes back
+		pSystem->m_bCulled = bCull && pSystem->m_iNumParticles && !m_Frustum.SphereInsideFrustum(pSystem->m_vecCentre.x, pSystem->m_vecCentre.y, pSystem->m_vecCentre.z, pSystem->m_fRadius);
+		if (pSystem->m_bCulled)
 		{
-			pSystem->DrawSystem();
-			pLast = pSystem;
-			pSystem = pSystem->m_pNextSystem;
+			m_pSystems[iKept++] = pSystem;
+			continue;
 		}
-		else // delete this system
+
+		pSystem->m_fLOD = CalculateLOD(pSystem, fPixelScale);
+
+		if (pSystem->PrepareUpdate(frametime, localPlayer->curstate.messagenum))
 		{
-			if (pLast)
-			{
-				pLast->m_pNextSystem = pSystem->m_pNextSystem;
-				delete pSystem;
-				pSystem = pLast->m_pNextSystem;
-			}
-			else // deleting the first system
+			if (pSystem->m_bSimulate)
 			{
-				m_pFirstSystem = pSystem->m_pNextSystem;
-				delete pSystem;
-				pSystem = m_pFirstSystem;
+				m_pJobs[iNumJobs++] = pSystem;
+				iSprayDemand += pSystem->m_iSprayDemand + 1;
 			}
+			m_pSystems[iKept++] = pSystem;
+		}
+		else // delete this system
+		{
+			UnlinkSystem(pSystem);
+			delete pSystem;
+		}
+	}
+	m_iNumSystems = iKept;
+
+	// the sprays are shared out by how many each system wanted last frame, so that the result doesn't
+	// depend on which order the systems get simulated in
+	for (int i = 0; i < iNumJobs; i++)
+		m_pJobs[i]->m_iSprayAllowance = iSprayBudget * (m_pJobs[i]->m_iSprayDemand + 1) / iSprayDemand;
+
+	// then the simulation, which doesn't
+	m_pWorkers->SetThreads((int)cl_particle_threads->value);
+	{
+		PROFILE_SCOPE(PROF_PARTICLE_SIMULATE);
+		m_pWorkers->Run(m_pJobs, iNumJobs, frametime);
+	}
+
+	// every system faces the same way
+	Vector normal, forward, right, up;
+	gEngfuncs.GetViewAngles((float*)normal);
+	AngleVectors(normal, forward, right, up);
+	ParticleSystem::BeginFrame();
+
+	// and finally the traces they asked for, and the drawing
+	for (int i = 0; i < m_iNumSystems; i++)
+	{
+		ParticleSystem* pSystem = m_pSystems[i];
+		m_iLiveParticles += pSystem->m_iNumParticles;
+		if (pSystem->m_bCulled)
+		{
+			m_iCulledSystems++;
+			continue;
+		}
+
+		if (pSystem->m_bSimulate)
+		{
+			pSystem->FinishUpdate(frametime);
+			m_iSprayed += pSystem->m_iSprayed;
+			m_iRefused += pSystem->m_iSpraysRefused;
+		}
+		{
+			PROFILE_SCOPE(PROF_PARTICLE_DRAW);
+			pSystem->DrawSystem(right, up);
 		}
+		m_iUpdatedSystems++;
 	}
+
 	gEngfuncs.pTriAPI->RenderMode(kRenderNormal);
+
+	m_iTraced = iTraceBudget - ParticleSystem::c_iTraceBudget;
+	m_iTracesRefused = ParticleSystem::c_iTracesRefused;
+
+	if (cl_particle_stats->value != 0)
+	{
+		gEngfuncs.Con_NPrintf(17, "Particle systems: %d drawn, %d culled, %d simulated", m_iUpdatedSystems, m_iCulledSystems, iNumJobs);
+		gEngfuncs.Con_NPrintf(18, "Particles: %d live, budget %d (scale %.2f)", m_iLiveParticles, iBudget, m_fBudgetScale);
+		gEngfuncs.Con_NPrintf(19, "Particles sprayed: %d, refused %d", m_iSprayed, m_iRefused);
+		gEngfuncs.Con_NPrintf(20, "Particle traces: %d, refused %d", m_iTraced, m_iTracesRefused);
+		gEngfuncs.Con_NPrintf(21, "Particle draw calls: %d, for %d quads", ParticleSystem::c_iDrawCalls, ParticleSystem::c_iQuadsDrawn);
+	}
 }
 
 void ParticleSystemManager::ClearSystems()
 {
-	ParticleSystem* pSystem = m_pFirstSystem;
-	ParticleSystem* pTemp;
+	for (int i = 0; i < m_iNumSystems; i++)
+		delete m_pSystems[i];
 
-	while (pSystem)
-	{
-		pTemp = pSystem->m_pNextSystem;
-		delete pSystem;
-		pSystem = pTemp;
-	}
+	m_iNumSystems = 0;
+	memset(m_pEntitySystems, 0, sizeof(m_pEntitySystems));
+	m_iSystemsMade = 0;
 
-	m_pFirstSystem = NULL;
+	// sprites are reloaded for the new level, so the scripts have to be parsed again
+	ParticleTemplate::ClearAll();
 }
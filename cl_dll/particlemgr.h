@@ -2,6 +2,10 @@
 #pragma once
 
 #include "particlesys.h"
+#include "CFrustum.h"
+#include "com_model.h" // for MAX_EDICTS
+
+class ParticleWorkers;
 
 class ParticleSystemManager
 {
@@ -10,11 +14,37 @@ public:
 	~ParticleSystemManager();
 	void AddSystem(ParticleSystem*);
 	ParticleSystem* FindSystem(cl_entity_t* pEntity);
-	void UpdateSystems(float frametime);
+	void UpdateSystems(float frametime, int iFOV, int iScreenWidth); // the view decides how much detail the systems get
 	void ClearSystems();
 	void SortSystems();
-	
-	ParticleSystem* m_pFirstSystem;
+
+private:
+	void UnlinkSystem(ParticleSystem* pSystem);
+
+	ParticleSystem* m_pEntitySystems[MAX_EDICTS]; // the newest system for each entity, linked through m_pNextSystem
+	ParticleSystem** m_pSystems;				   // all of them, furthest from the viewer first
+	int m_iNumSystems;
+	int m_iMaxSystems;
+	unsigned int m_iSystemsMade; // since the last ClearSystems, for seeding
+
+	float CalculateLOD(ParticleSystem* pSystem, float fPixelScale);
+
+	// the systems being simulated this frame
+	ParticleSystem** m_pJobs;
+	int m_iMaxJobs;
+	ParticleWorkers* m_pWorkers;
+
+	CFrustum m_Frustum;
+	float m_fBudgetScale; // drops while the total is over cl_particle_budget, recovers when it's back under
+
+	// last frame's totals, for cl_particle_stats
+	int m_iLiveParticles;
+	int m_iUpdatedSystems;
+	int m_iCulledSystems;
+	int m_iSprayed;
+	int m_iRefused;
+	int m_iTraced;
+	int m_iTracesRefused;
 };
 
 extern ParticleSystemManager* g_pParticleSystems;
@@ -11,10 +11,20 @@
 #include "studio_util.h" // for M_PI and matrix functions
 #include "pmtrace.h"	 // for contents and traceline
 #include "pm_defs.h"
+#include <sys/stat.h>
+
+// SSE2 is only used where the compiler is already allowed to use it (x64, and /arch:SSE2 on Windows);
+// the Linux build sticks to x87, and gets the plain loop. (The tests define PARTICLES_NO_SSE2 to check that.)
+#if !defined(PARTICLES_NO_SSE2) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define PARTICLES_SSE2
+#endif
 
 
 float ParticleSystem::c_fCosTable[360 + 90];
 bool ParticleSystem::c_bCosTableInit = false;
+int ParticleSystem::c_iTraceBudget = 0; // set by the manager each frame
+int ParticleSystem::c_iTracesRefused = 0;
 
 ParticleType::ParticleType(ParticleType* pNext)
 {
@@ -28,94 +38,98 @@ ParticleType::ParticleType(ParticleType* pNext)
 	m_iRenderMode = kRenderTransAdd;
 	m_iDrawCond = 0;
 	m_bEndFrame = false;
+	m_bBouncing = false;
 
 	m_bIsDefined = false;
 	//	m_iCollision = 0;
 }
 
-particle* ParticleType::CreateParticle(ParticleSystem* pSys) //particle *pPart)
+int ParticleType::CreateParticle(ParticleSystem* pSys)
 {
 	if (!pSys)
-		return NULL;
+		return -1;
 
-	particle* pPart = pSys->ActivateParticle();
-	if (!pPart)
-		return NULL;
+	int iPart = pSys->ActivateParticle();
+	if (iPart == -1)
+		return -1;
 
-	pPart->age = 0.0;
-	pPart->age_death = m_Life.GetInstance();
+	pSys->m_Particles.age[iPart] = 0.0;
+	// distant systems get shorter-lived particles, but never less than half as long
+	pSys->m_Particles.age_death[iPart] = m_Life.GetInstance(pSys->m_Random) * (0.5f + 0.5f * pSys->m_fLOD);
 
-	InitParticle(pPart, pSys);
+	InitParticle(iPart, pSys);
 
-	return pPart;
+	return iPart;
 }
 
-void ParticleType::InitParticle(particle* pPart, ParticleSystem* pSys)
+void ParticleType::InitParticle(int iPart, ParticleSystem* pSys)
 {
-	float fLifeRecip = 1 / pPart->age_death;
+	particle_arrays& p = pSys->m_Particles;
+	float fLifeRecip = p.age_death[iPart] > 0 ? 1 / p.age_death[iPart] : 0; // with no lifetime, nothing fades out over it
+
+	// every range below gets one of these, used or not, so a particle always takes the same
+	// number from the stream
+	float r[PARTICLE_INIT_SAMPLES];
+	pSys->m_Random.RandomSamples(r, PARTICLE_INIT_SAMPLES);
 
-	pPart->pType = this;
+	p.type[iPart] = this;
 
-	pPart->velocity[0] = pPart->velocity[1] = pPart->velocity[2] = 0;
-	pPart->accel[0] = pPart->accel[1] = 0;
-	pPart->accel[2] = m_Gravity.GetInstance();
-	pPart->m_iEntIndex = 0;
+	p.velocity[0][iPart] = p.velocity[1][iPart] = p.velocity[2][iPart] = 0;
+	p.gravity[iPart] = m_Gravity.GetInstance(r[0]);
 
-	particle* pOverlay = NULL;
 	if (m_pOverlayType)
 	{
 		// create an overlay for this particle
-		pOverlay = pSys->ActivateParticle(); //m_pOverlayType->InitParticle(pSys);
-		if (pOverlay)
+		int iOverlay = pSys->ActivateParticle();
+		if (iOverlay != -1)
 		{
-			pOverlay->age = pPart->age;
-			pOverlay->age_death = pPart->age_death;
-			m_pOverlayType->InitParticle(pOverlay, pSys);
+			p.age[iOverlay] = p.age[iPart];
+			p.age_death[iOverlay] = p.age_death[iPart];
+			m_pOverlayType->InitParticle(iOverlay, pSys);
+			p.overlay[iPart] = iOverlay;
+			p.parent[iOverlay] = iPart;
 		}
 	}
-	pPart->m_pOverlay = pOverlay;
 
 	if (m_pSprayType)
 	{
-		pPart->age_spray = 1 / m_SprayRate.GetInstance();
+		p.age_spray[iPart] = 1 / (m_SprayRate.GetInstance(r[1]) * pSys->m_fLOD);
 	}
 	else
 	{
-		pPart->age_spray = 0.0f;
+		p.age_spray[iPart] = 0.0f;
 	}
 
-	pPart->m_fSize = m_StartSize.GetInstance();
+	p.size[iPart] = m_StartSize.GetInstance(r[2]);
 	if (m_EndSize.IsDefined())
-		pPart->m_fSizeStep = m_EndSize.GetOffset(pPart->m_fSize) * fLifeRecip;
+		p.sizeStep[iPart] = (m_EndSize.GetInstance(r[3]) - p.size[iPart]) * fLifeRecip;
 	else
-		pPart->m_fSizeStep = m_SizeDelta.GetInstance();
-	//pPart->m_fSizeStep = m_EndSize.GetOffset(pPart->m_fSize) * fLifeRecip;
+		p.sizeStep[iPart] = m_SizeDelta.GetInstance(r[3]);
 
-	pPart->frame = m_StartFrame.GetInstance();
+	p.frame[iPart] = m_StartFrame.GetInstance(r[4]);
 	if (m_EndFrame.IsDefined())
-		pPart->m_fFrameStep = m_EndFrame.GetOffset(pPart->frame) * fLifeRecip;
+		p.frameStep[iPart] = (m_EndFrame.GetInstance(r[5]) - p.frame[iPart]) * fLifeRecip;
 	else
-		pPart->m_fFrameStep = m_FrameRate.GetInstance();
-
-	pPart->m_fAlpha = m_StartAlpha.GetInstance();
-	pPart->m_fAlphaStep = m_EndAlpha.GetOffset(pPart->m_fAlpha) * fLifeRecip;
-	pPart->m_fRed = m_StartRed.GetInstance();
-	pPart->m_fRedStep = m_EndRed.GetOffset(pPart->m_fRed) * fLifeRecip;
-	pPart->m_fGreen = m_StartGreen.GetInstance();
-	pPart->m_fGreenStep = m_EndGreen.GetOffset(pPart->m_fGreen) * fLifeRecip;
-	pPart->m_fBlue = m_StartBlue.GetInstance();
-	pPart->m_fBlueStep = m_EndBlue.GetOffset(pPart->m_fBlue) * fLifeRecip;
-
-	pPart->m_fAngle = m_StartAngle.GetInstance();
-	pPart->m_fAngleStep = m_AngleDelta.GetInstance();
-
-	pPart->m_fDrag = m_Drag.GetInstance();
-
-	float fWindStrength = m_WindStrength.GetInstance();
-	float fWindYaw = m_WindYaw.GetInstance();
-	pPart->m_vecWind.x = fWindStrength * ParticleSystem::CosLookup(fWindYaw);
-	pPart->m_vecWind.y = fWindStrength * ParticleSystem::SinLookup(fWindYaw);
-	pPart->m_vecWind.z = 0;
+		p.frameStep[iPart] = m_FrameRate.GetInstance(r[5]);
+
+	p.alpha[iPart] = m_StartAlpha.GetInstance(r[6]);
+	p.alphaStep[iPart] = (m_EndAlpha.GetInstance(r[7]) - p.alpha[iPart]) * fLifeRecip;
+	p.red[iPart] = m_StartRed.GetInstance(r[8]);
+	p.redStep[iPart] = (m_EndRed.GetInstance(r[9]) - p.red[iPart]) * fLifeRecip;
+	p.green[iPart] = m_StartGreen.GetInstance(r[10]);
+	p.greenStep[iPart] = (m_EndGreen.GetInstance(r[11]) - p.green[iPart]) * fLifeRecip;
+	p.blue[iPart] = m_StartBlue.GetInstance(r[12]);
+	p.blueStep[iPart] = (m_EndBlue.GetInstance(r[13]) - p.blue[iPart]) * fLifeRecip;
+
+	p.angle[iPart] = m_StartAngle.GetInstance(r[14]);
+	p.angleStep[iPart] = m_AngleDelta.GetInstance(r[15]);
+
+	p.drag[iPart] = m_Drag.GetInstance(r[16]);
+
+	float fWindStrength = m_WindStrength.GetInstance(r[17]);
+	float fWindYaw = m_WindYaw.GetInstance(r[18]);
+	p.wind[0][iPart] = fWindStrength * ParticleSystem::CosLookup(fWindYaw);
+	p.wind[1][iPart] = fWindStrength * ParticleSystem::SinLookup(fWindYaw);
 }
 
 //============================================
@@ -158,87 +172,129 @@ RandomRange::RandomRange(char* szToken)
 
 //============================================
 
-ParticleSystem::ParticleSystem(int iEntIndex, char* szFilename)
+//============================================
+
+// every script that's been loaded this level
+static ParticleTemplate* g_pFirstTemplate = NULL;
+
+// the modification time of a particle script, if it's a loose file; or 0 if it's in a pak, or missing.
+static long GetParticleFileTime(const char* szFilename)
 {
-	int iParticles = 100; // default
+	char szPath[512];
+	struct stat buf;
+
+	if (!gEngfuncs.COM_ExpandFilename(szFilename, szPath, sizeof(szPath)))
+		return 0;
+	if (stat(szPath, &buf) != 0)
+		return 0;
+	return (long)buf.st_mtime;
+}
 
-	m_iEntIndex = iEntIndex;
-	m_pNextSystem = NULL;
-	m_pFirstType = NULL;
-	if (!c_bCosTableInit)
+ParticleTemplate* ParticleTemplate::Get(const char* szFilename)
+{
+	long iModTime = GetParticleFileTime(szFilename);
+
+	ParticleTemplate* pLast = NULL;
+	for (ParticleTemplate* pTemplate = g_pFirstTemplate; pTemplate; pTemplate = pTemplate->m_pNext)
 	{
-		for (int i = 0; i < 360 + 90; i++)
+		if (!stricmp(pTemplate->m_szFilename, szFilename))
 		{
-			c_fCosTable[i] = cos(i * M_PI / 180.0);
+			if (pTemplate->m_iModTime == iModTime)
+				return pTemplate;
+
+			// the file's been edited; forget the old version. (any systems still using it keep it alive until they're done.)
+			if (pLast)
+				pLast->m_pNext = pTemplate->m_pNext;
+			else
+				g_pFirstTemplate = pTemplate->m_pNext;
+			pTemplate->m_pNext = NULL;
+			pTemplate->m_bCached = false;
+			if (pTemplate->m_iRefCount == 0)
+				delete pTemplate;
+			break;
 		}
-		c_bCosTableInit = true;
+		pLast = pTemplate;
 	}
 
-	char* szFile = (char*)gEngfuncs.COM_LoadFile(szFilename, 5, NULL);
-	char szToken[1024];
+	ParticleTemplate* pTemplate = new ParticleTemplate(szFilename);
+	pTemplate->m_iModTime = iModTime;
+	pTemplate->m_bCached = true;
+	pTemplate->m_pNext = g_pFirstTemplate;
+	g_pFirstTemplate = pTemplate;
+	return pTemplate;
+}
 
-	if (!szFile)
-	{
-		gEngfuncs.Con_Printf("Couldn't open particle file %s. Using default particle settings.\n", szFilename);
-		return;
-	}
-	else
+void ParticleTemplate::ClearAll()
+{
+	ParticleTemplate* pTemplate = g_pFirstTemplate;
+	while (pTemplate)
 	{
-		szFile = gEngfuncs.COM_ParseFile(szFile, szToken);
-
-		while (szFile)
-		{
-			if (!stricmp(szToken, "particles"))
-			{
-				szFile = gEngfuncs.COM_ParseFile(szFile, szToken);
-				iParticles = atof(szToken);
-			}
-			else if (!stricmp(szToken, "maintype"))
-			{
-				szFile = gEngfuncs.COM_ParseFile(szFile, szToken);
-				m_pMainType = AddPlaceholderType(szToken);
-				//strncpy(m_szMainType, szToken, sizeof(m_szMainType) );
-			}
-			else if (!stricmp(szToken, "{"))
-			{
-				// parse new type
-				this->ParseType(szFile); // parses the type, moves the file pointer
-			}
-
-			szFile = gEngfuncs.COM_ParseFile(szFile, szToken);
-		}
+		ParticleTemplate* pNext = pTemplate->m_pNext;
+		pTemplate->m_pNext = NULL;
+		pTemplate->m_bCached = false;
+		if (pTemplate->m_iRefCount == 0)
+			delete pTemplate;
+		pTemplate = pNext;
 	}
+	g_pFirstTemplate = NULL;
+}
 
-	gEngfuncs.COM_FreeFile(szFile);
-
-	AllocateParticles(iParticles);
+void ParticleTemplate::Release()
+{
+	m_iRefCount--;
+	if (m_iRefCount == 0 && !m_bCached)
+		delete this;
 }
 
-void ParticleSystem::AllocateParticles(int iParticles)
+ParticleTemplate::ParticleTemplate(const char* szFilename)
 {
-	m_pAllParticles = new particle[iParticles];
-	m_pFreeParticle = m_pAllParticles;
-	m_pActiveParticle = NULL;
-	m_pMainParticle = NULL;
+	m_iParticles = 100; // default
+	m_pFirstType = NULL;
+	m_pMainType = NULL;
+	m_pNext = NULL;
+	m_iRefCount = 0;
+	m_iModTime = 0;
+	m_bCached = false;
+	strncpy(m_szFilename, szFilename, sizeof(m_szFilename) - 1);
+	m_szFilename[sizeof(m_szFilename) - 1] = 0;
+
+	char* pBuffer = (char*)gEngfuncs.COM_LoadFile(szFilename, 5, NULL);
+	char szToken[1024];
+
+	if (!pBuffer)
+	{
+		gEngfuncs.Con_Printf("Couldn't open particle file %s. Using default particle settings.\n", szFilename);
+		return;
+	}
 
-	// initialise the linked list
-	particle* pLast = m_pAllParticles;
-	particle* pParticle = pLast + 1;
+	char* szFile = gEngfuncs.COM_ParseFile(pBuffer, szToken);
 
-	for (int i = 1; i < iParticles; i++)
+	while (szFile)
 	{
-		pLast->nextpart = pParticle;
+		if (!stricmp(szToken, "particles"))
+		{
+			szFile = gEngfuncs.COM_ParseFile(szFile, szToken);
+			m_iParticles = atof(szToken);
+		}
+		else if (!stricmp(szToken, "maintype"))
+		{
+			szFile = gEngfuncs.COM_ParseFile(szFile, szToken);
+			m_pMainType = AddPlaceholderType(szToken);
+		}
+		else if (!stricmp(szToken, "{"))
+		{
+			// parse new type
+			this->ParseType(szFile); // parses the type, moves the file pointer
+		}
 
-		pLast = pParticle;
-		pParticle++;
+		szFile = gEngfuncs.COM_ParseFile(szFile, szToken);
 	}
-	pLast->nextpart = NULL;
+
+	gEngfuncs.COM_FreeFile(pBuffer);
 }
 
-ParticleSystem::~ParticleSystem()
+ParticleTemplate::~ParticleTemplate()
 {
-	delete[] m_pAllParticles;
-
 	ParticleType* pType = m_pFirstType;
 	ParticleType* pNext;
 	while (pType)
@@ -249,10 +305,100 @@ ParticleSystem::~ParticleSystem()
 	}
 }
 
+//============================================
+
+ParticleSystem::ParticleSystem(int iEntIndex, char* szFilename)
+{
+	m_iEntIndex = iEntIndex;
+	m_pNextSystem = NULL;
+	m_pFloatBlock = NULL;
+	m_iNumParticles = m_iMaxParticles = 0;
+	m_iMainParticle = -1;
+	m_fViewerDist = 0;
+	m_vecCentre = Vector(0, 0, 0);
+	m_fRadius = 0;
+	m_fLOD = 1;
+	m_iNumPlanes = 0;
+	m_vecPlanesOrigin = Vector(0, 0, 0);
+	m_vecSourceOrigin = Vector(0, 0, 0);
+	m_bSourceOn = false;
+	m_bSimulate = false;
+	m_bCulled = false;
+	m_iSprayAllowance = m_iSprayDemand = m_iSprayed = m_iSpraysRefused = 0;
+	m_iNumTraceRequests = 0;
+
+	// the manager reseeds it when the system is added
+	m_Random.Seed(0, iEntIndex);
+
+	if (!c_bCosTableInit)
+	{
+		for (int i = 0; i < 360 + 90; i++)
+		{
+			c_fCosTable[i] = cos(i * M_PI / 180.0);
+		}
+		c_bCosTableInit = true;
+	}
+
+	// the script itself is only parsed the first time it's used
+	m_pTemplate = ParticleTemplate::Get(szFilename);
+	m_pTemplate->AddRef();
+	m_pMainType = m_pTemplate->m_pMainType;
+
+	AllocateParticles(m_pTemplate->m_iParticles);
+}
+
+void ParticleSystem::AllocateParticles(int iParticles)
+{
+	if (iParticles < 1)
+		iParticles = 1;
+
+	// round up to a multiple of 4, so that the update loop can always work on 4 at a time
+	int iStride = (iParticles + 3) & ~3;
+
+	m_iStride = iStride;
+	m_iMaxParticles = iParticles;
+	m_iNumParticles = 0;
+	m_iMainParticle = -1;
+
+	m_pFloatBlock = new float[iStride * PARTICLE_FLOAT_FIELDS];
+	memset(m_pFloatBlock, 0, iStride * PARTICLE_FLOAT_FIELDS * sizeof(float));
+
+	float** pFields[PARTICLE_FLOAT_FIELDS] = {
+		&m_Particles.origin[0], &m_Particles.origin[1], &m_Particles.origin[2],
+		&m_Particles.velocity[0], &m_Particles.velocity[1], &m_Particles.velocity[2],
+		&m_Particles.gravity, &m_Particles.wind[0], &m_Particles.wind[1], &m_Particles.drag,
+		&m_Particles.age, &m_Particles.age_death, &m_Particles.age_spray, &m_Particles.age_trace,
+		&m_Particles.size, &m_Particles.sizeStep, &m_Particles.alpha, &m_Particles.alphaStep,
+		&m_Particles.red, &m_Particles.redStep, &m_Particles.green, &m_Particles.greenStep,
+		&m_Particles.blue, &m_Particles.blueStep, &m_Particles.frame, &m_Particles.frameStep,
+		&m_Particles.angle, &m_Particles.angleStep};
+
+	for (int i = 0; i < PARTICLE_FLOAT_FIELDS; i++)
+		*pFields[i] = m_pFloatBlock + i * iStride;
+
+	m_Particles.type = new ParticleType*[iStride];
+	m_Particles.overlay = new int[iStride];
+	m_Particles.parent = new int[iStride];
+	m_Particles.plane = new int[iStride];
+	m_pTraceRequests = new int[iStride];
+}
+
+ParticleSystem::~ParticleSystem()
+{
+	delete[] m_pFloatBlock;
+	delete[] m_Particles.type;
+	delete[] m_Particles.overlay;
+	delete[] m_Particles.parent;
+	delete[] m_Particles.plane;
+	delete[] m_pTraceRequests;
+
+	m_pTemplate->Release();
+}
+
 
 
 // returns the ParticleType with the given name, if there is one
-ParticleType* ParticleSystem::GetType(const char* szName)
+ParticleType* ParticleTemplate::GetType(const char* szName)
 {
 	for (ParticleType* pType = m_pFirstType; pType; pType = pType->m_pNext)
 	{
@@ -262,7 +408,7 @@ ParticleType* ParticleSystem::GetType(const char* szName)
 	return NULL;
 }
 
-ParticleType* ParticleSystem::AddPlaceholderType(const char* szName)
+ParticleType* ParticleTemplate::AddPlaceholderType(const char* szName)
 {
 	m_pFirstType = new ParticleType(m_pFirstType);
 	strncpy(m_pFirstType->m_szName, szName, sizeof(m_pFirstType->m_szName));
@@ -271,7 +417,7 @@ ParticleType* ParticleSystem::AddPlaceholderType(const char* szName)
 
 // creates a new particletype from the given file
 // NB: this changes the value of szFile.
-ParticleType* ParticleSystem::ParseType(char*& szFile)
+ParticleType* ParticleTemplate::ParseType(char*& szFile)
 {
 	ParticleType* pType = new ParticleType();
 
@@ -297,7 +443,10 @@ ParticleType* ParticleSystem::ParseType(char*& szFile)
 					gEngfuncs.Con_Printf("Warning: Particle type %s is defined more than once!\n", szToken);
 
 				// copy all our data into the existing type, throw away the type we were making
+				// (but keep its place in the list)
+				ParticleType* pNext = pTemp->m_pNext;
 				*pTemp = *pType;
+				pTemp->m_pNext = pNext;
 				delete pType;
 				pType = pTemp;
 				pType->m_bIsDefined = true; // record the fact that it's defined, so we won't need to add it to the list
@@ -530,136 +679,587 @@ ParticleType* ParticleSystem::ParseType(char*& szFile)
 	return pType;
 }
 
-particle* ParticleSystem::ActivateParticle()
+int ParticleSystem::ActivateParticle()
 {
-	particle* pActivated = m_pFreeParticle;
-	if (pActivated)
-	{
-		m_pFreeParticle = pActivated->nextpart;
-		pActivated->nextpart = m_pActiveParticle;
-		m_pActiveParticle = pActivated;
-	}
-	return pActivated;
+	if (m_iNumParticles >= m_iMaxParticles)
+		return -1;
+
+	int iPart = m_iNumParticles++;
+	m_Particles.origin[0][iPart] = m_Particles.origin[1][iPart] = m_Particles.origin[2][iPart] = 0;
+	m_Particles.overlay[iPart] = -1;
+	m_Particles.parent[iPart] = PARTICLE_NO_PARENT;
+	m_Particles.age_trace[iPart] = 0;
+	m_Particles.plane[iPart] = -1;
+	return iPart;
+}
+
+void ParticleSystem::SetOrigin(int iPart, const Vector& vec)
+{
+	m_Particles.origin[0][iPart] = vec.x;
+	m_Particles.origin[1][iPart] = vec.y;
+	m_Particles.origin[2][iPart] = vec.z;
+}
+
+void ParticleSystem::SetVelocity(int iPart, const Vector& vec)
+{
+	m_Particles.velocity[0][iPart] = vec.x;
+	m_Particles.velocity[1][iPart] = vec.y;
+	m_Particles.velocity[2][iPart] = vec.z;
+}
+
+// copies a particle into another slot, and fixes up anything that refers to it
+void ParticleSystem::MoveParticle(int iFrom, int iTo)
+{
+	if (iFrom == iTo)
+		return;
+
+	for (float* pField = m_pFloatBlock; pField < m_pFloatBlock + m_iStride * PARTICLE_FLOAT_FIELDS; pField += m_iStride)
+		pField[iTo] = pField[iFrom];
+	m_Particles.type[iTo] = m_Particles.type[iFrom];
+	m_Particles.overlay[iTo] = m_Particles.overlay[iFrom];
+	m_Particles.parent[iTo] = m_Particles.parent[iFrom];
+	m_Particles.plane[iTo] = m_Particles.plane[iFrom];
+
+	if (m_Particles.overlay[iTo] >= 0)
+		m_Particles.parent[m_Particles.overlay[iTo]] = iTo;
+	if (m_Particles.parent[iTo] >= 0)
+		m_Particles.overlay[m_Particles.parent[iTo]] = iTo;
+	if (m_iMainParticle == iFrom)
+		m_iMainParticle = iTo;
+}
+
+// removes a particle during an update. Particles [0, iEnd) are the ones being updated this frame; [iEnd, m_iNumParticles)
+// have just been created, and shouldn't be updated until next frame.
+// The slot is filled with an unprocessed particle (if any), so the caller should look at iPart again.
+void ParticleSystem::KillParticle(int iPart, int& iEnd)
+{
+	if (m_Particles.overlay[iPart] >= 0)
+		m_Particles.parent[m_Particles.overlay[iPart]] = PARTICLE_ORPHAN;
+	if (m_Particles.parent[iPart] >= 0)
+		m_Particles.overlay[m_Particles.parent[iPart]] = -1;
+	if (m_iMainParticle == iPart)
+		m_iMainParticle = -1;
+
+	iEnd--;
+	MoveParticle(iEnd, iPart);
+	m_iNumParticles--;
+	MoveParticle(m_iNumParticles, iEnd);
 }
 
 extern Vector v_origin;
 
 void ParticleSystem::CalculateDistance()
 {
-	if (!m_pActiveParticle)
+	if (!m_iNumParticles)
 		return;
 
-	Vector offset = v_origin - m_pActiveParticle->origin; // just pick one
+	// a box around every particle, plus the entity in case it's moved away from them
+	Vector vecMins = GetOrigin(0);
+	Vector vecMaxs = vecMins;
+	float fMaxSize = 0;
+	for (int i = 0; i < m_iNumParticles; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			float f = m_Particles.origin[j][i];
+			if (f < vecMins[j])
+				vecMins[j] = f;
+			else if (f > vecMaxs[j])
+				vecMaxs[j] = f;
+		}
+		if (m_Particles.size[i] > fMaxSize)
+			fMaxSize = m_Particles.size[i];
+	}
+
+	cl_entity_t* source = GetEntity();
+	if (source)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			vecMins[j] = V_min(vecMins[j], source->curstate.origin[j]);
+			vecMaxs[j] = V_max(vecMaxs[j], source->curstate.origin[j]);
+		}
+	}
+
+	m_vecCentre = (vecMins + vecMaxs) * 0.5;
+	m_fRadius = (vecMaxs - m_vecCentre).Length() + fMaxSize * 1.5f; // sprites can be rotated
+
+	Vector offset = v_origin - m_vecCentre;
 	m_fViewerDist = offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2];
 }
 
 
-bool ParticleSystem::UpdateSystem(float frametime, int messagenum)
+// main thread: everything the update needs from the engine
+bool ParticleSystem::PrepareUpdate(float frametime, int messagenum)
 {
+	m_bSimulate = false;
+	m_iNumTraceRequests = 0;
+	m_iSprayed = m_iSpraysRefused = 0;
+
 	// the entity emitting this system
-	cl_entity_t* source = gEngfuncs.GetEntityByIndex(m_iEntIndex);
+	cl_entity_t* source = GetEntity();
 
 	// Don't update if the system is outside the player's PVS.
 	if (!source || source->curstate.messagenum < messagenum)
 		return true;
 
-	if (m_pMainParticle == NULL)
+	m_vecSourceOrigin = source->curstate.origin;
+	m_bSourceOn = source->curstate.body != 0;
+
+	if (m_iMainParticle == -1)
 	{
-		//	gEngfuncs.Con_Printf("body %d\n", source->curstate.body);
-		if (source->curstate.body != 0)
+		if (m_bSourceOn)
 		{
-			ParticleType* pType = m_pMainType; //GetMainType();
+			ParticleType* pType = m_pMainType;
 			if (pType)
 			{
-				m_pMainParticle = pType->CreateParticle(this); //m_pMainParticle);
-															   //				m_pMainParticle = ActivateParticle();
-				if (m_pMainParticle)
+				m_iMainParticle = pType->CreateParticle(this);
+				if (m_iMainParticle != -1)
 				{
-					m_pMainParticle->m_iEntIndex = m_iEntIndex;
-					//m_pMainParticle->origin = source->curstate.origin;
-					m_pMainParticle->age_death = -1; // never die
-													 //pPart->origin[0] = x; pPart->origin[1] = y; pPart->origin[2] = z;
+					SetOrigin(m_iMainParticle, m_vecSourceOrigin);
+
+					// never die; nor do its overlays, until it does
+					for (int i = m_iMainParticle; i != -1; i = m_Particles.overlay[i])
+						m_Particles.age_death[i] = -1;
 				}
 			}
 		}
 	}
-	else if (source && source->curstate.body == 0)
+	else if (!m_bSourceOn)
+	{
+		m_Particles.age_death[m_iMainParticle] = 0; // die now
+		m_iMainParticle = -1;
+	}
+
+	if (frametime == 0)
+		return true;
+
+	// the surfaces near the old position aren't much use now
+	if (m_iNumPlanes && (m_vecSourceOrigin - m_vecPlanesOrigin).Length() > 1)
+		ClearCollisionPlanes();
+	m_vecPlanesOrigin = m_vecSourceOrigin;
+
+	m_bSimulate = true;
+	return true;
+}
+
+// Moves, kills and sprays the particles. This doesn't touch the engine or anything outside the system,
+// so the manager can run it on a worker thread; traces are queued up for FinishUpdate.
+void ParticleSystem::Simulate(float frametime)
+{
+	// particles sprayed during this update don't move until next frame
+	int iEnd = m_iNumParticles;
+
+	// the main particle's velocity is worked out from where it was last frame
+	Vector vecMainOld;
+	if (m_iMainParticle != -1)
+		vecMainOld = GetOrigin(m_iMainParticle);
+
+	IntegrateParticles(iEnd, frametime);
+
+	int i = 0;
+	while (i < iEnd)
 	{
-		m_pMainParticle->age_death = 0; // die now
-		m_pMainParticle = NULL;
+		if (UpdateParticle(i, frametime, vecMainOld))
+			i++;
+		else
+			KillParticle(i, iEnd);
 	}
 
-	particle* pParticle = m_pActiveParticle;
-	particle* pLast = NULL;
+	m_iSprayDemand = m_iSprayed + m_iSpraysRefused;
+}
+
+// main thread, after Simulate: does the traces it asked for
+void ParticleSystem::FinishUpdate(float frametime)
+{
+	// (the particles that asked have all been updated already, so nothing's moved them since)
+	for (int i = 0; i < m_iNumTraceRequests; i++)
+		TraceParticle(m_pTraceRequests[i], frametime);
+	m_iNumTraceRequests = 0;
+}
 
-	//	gEngfuncs.GetViewAngles((float*)normal);
-	//	AngleVectors(normal,forward,right,up);
+//============================================
+// Drawing. Each system's quads are grouped by sprite, frame and render mode, and each group is sent in one
+// Begin/End - within a system the draw order doesn't matter much anyway, as long as overlays stay on top.
 
-	while (pParticle)
+struct particle_group
+{
+	HSPRITE hSprite;
+	int iFrame;
+	int iRenderMode;
+	struct model_s* pModel;
+	int iFirst; // into s_pSortedQuads
+	int iCount;
+};
+
+struct particle_quad
+{
+	int iGroup;
+	int iPart;
+	int iCorners; // into s_pCorners, 4 of them
+};
+
+static particle_group* s_pGroups = NULL;
+static int s_iMaxGroups = 0;
+static particle_quad* s_pQuads = NULL;
+static particle_quad* s_pSortedQuads = NULL;
+static Vector* s_pCorners = NULL;
+static int s_iMaxQuads = 0;
+
+int ParticleSystem::c_iDrawCalls = 0;
+int ParticleSystem::c_iQuadsDrawn = 0;
+
+// PM_PointContents answers for draw conditions, remembered for the rest of the frame.
+// Outside brush entities that have contents of their own (func_water and the like) the answer
+// only depends on the world, which is the same all through a BSP leaf; so it's kept per leaf.
+// Inside one of those entities we still have to ask every time.
+#define CONTENTS_CACHE_SIZE 256
+#define MAX_CONTENTS_ENTS 32
+
+struct contents_cache_entry
+{
+	mleaf_t* pLeaf;
+	int iContents;
+};
+
+static contents_cache_entry s_ContentsCache[CONTENTS_CACHE_SIZE];
+static Vector s_vecContentsMins[MAX_CONTENTS_ENTS];
+static Vector s_vecContentsMaxs[MAX_CONTENTS_ENTS];
+static int s_iNumContentsEnts = -1; // -1 = not gathered yet this frame
+static bool s_bContentsCache;		// false if there were too many entities to keep track of
+
+static void GatherContentsEntities()
+{
+	s_iNumContentsEnts = 0;
+
+	// between levels there's no local player, so no way to tell which entities are current
+	cl_entity_t* pLocalPlayer = gEngfuncs.GetLocalPlayer();
+	if (!pLocalPlayer)
 	{
-		//		if( TestParticle(part) )
-		//		{
-		if (UpdateParticle(pParticle, frametime))
+		s_bContentsCache = false;
+		return;
+	}
+	s_bContentsCache = true;
+
+	int iMessageNum = pLocalPlayer->curstate.messagenum;
+	for (int i = 1;; i++)
+	{
+		cl_entity_t* pEnt = gEngfuncs.GetEntityByIndex(i);
+		if (!pEnt)
+			break;
+		if (!pEnt->model || pEnt->model->type != mod_brush || pEnt->curstate.skin >= 0 || pEnt->curstate.messagenum < iMessageNum)
+			continue;
+
+		if (s_iNumContentsEnts == MAX_CONTENTS_ENTS)
 		{
-			// draw it, move onto the next one
-			//DrawParticle( pParticle, right, up );
+			s_bContentsCache = false;
+			return;
+		}
 
-			pLast = pParticle;
-			pParticle = pParticle->nextpart;
+		Vector vecOrigin = pEnt->curstate.origin;
+		if (pEnt->curstate.angles == g_vecZero)
+		{
+			s_vecContentsMins[s_iNumContentsEnts] = vecOrigin + pEnt->model->mins;
+			s_vecContentsMaxs[s_iNumContentsEnts] = vecOrigin + pEnt->model->maxs;
 		}
-		else // deactivate it
+		else
 		{
-			if (pLast)
-			{
-				pLast->nextpart = pParticle->nextpart;
-				pParticle->nextpart = m_pFreeParticle;
-				m_pFreeParticle = pParticle;
-				pParticle = pLast->nextpart;
-			}
-			else // deactivate the first particle in the list
+			Vector vecRadius(pEnt->model->radius, pEnt->model->radius, pEnt->model->radius);
+			s_vecContentsMins[s_iNumContentsEnts] = vecOrigin - vecRadius;
+			s_vecContentsMaxs[s_iNumContentsEnts] = vecOrigin + vecRadius;
+		}
+		s_iNumContentsEnts++;
+	}
+}
+
+static mleaf_t* PointInLeaf(struct model_s* pWorld, const Vector& vecPoint)
+{
+	mnode_t* pNode = pWorld->nodes;
+	while (pNode->contents >= 0)
+	{
+		mplane_t* pPlane = pNode->plane;
+		pNode = pNode->children[(DotProduct(vecPoint, pPlane->normal) - pPlane->dist) > 0 ? 0 : 1];
+	}
+	return (mleaf_t*)pNode;
+}
+
+static int CachedPointContents(Vector vecPoint)
+{
+	if (s_iNumContentsEnts == -1)
+		GatherContentsEntities();
+
+	cl_entity_t* pWorldEnt = gEngfuncs.GetEntityByIndex(0);
+	struct model_s* pWorld = pWorldEnt ? pWorldEnt->model : NULL;
+	if (!s_bContentsCache || !pWorld || !pWorld->nodes)
+		return gEngfuncs.PM_PointContents(vecPoint, NULL);
+
+	for (int i = 0; i < s_iNumContentsEnts; i++)
+	{
+		if (vecPoint.x >= s_vecContentsMins[i].x && vecPoint.x <= s_vecContentsMaxs[i].x &&
+			vecPoint.y >= s_vecContentsMins[i].y && vecPoint.y <= s_vecContentsMaxs[i].y &&
+			vecPoint.z >= s_vecContentsMins[i].z && vecPoint.z <= s_vecContentsMaxs[i].z)
+			return gEngfuncs.PM_PointContents(vecPoint, NULL);
+	}
+
+	mleaf_t* pLeaf = PointInLeaf(pWorld, vecPoint);
+	contents_cache_entry& entry = s_ContentsCache[(pLeaf - pWorld->leafs) & (CONTENTS_CACHE_SIZE - 1)];
+	if (entry.pLeaf != pLeaf)
+	{
+		entry.pLeaf = pLeaf;
+		entry.iContents = gEngfuncs.PM_PointContents(vecPoint, NULL);
+	}
+	return entry.iContents;
+}
+
+void ParticleSystem::BeginFrame()
+{
+	c_iDrawCalls = c_iQuadsDrawn = 0;
+	s_iNumContentsEnts = -1;
+	memset(s_ContentsCache, 0, sizeof(s_ContentsCache));
+}
+
+static int FindParticleGroup(int& iNumGroups, HSPRITE hSprite, int iFrame, int iRenderMode, struct model_s* pModel)
+{
+	for (int i = 0; i < iNumGroups; i++)
+	{
+		if (s_pGroups[i].hSprite == hSprite && s_pGroups[i].iFrame == iFrame && s_pGroups[i].iRenderMode == iRenderMode)
+			return i;
+	}
+
+	if (iNumGroups == s_iMaxGroups)
+	{
+		int iNewMax = s_iMaxGroups ? s_iMaxGroups * 2 : 16;
+		particle_group* pNew = new particle_group[iNewMax];
+		if (s_pGroups)
+		{
+			memcpy(pNew, s_pGroups, s_iMaxGroups * sizeof(particle_group));
+			delete[] s_pGroups;
+		}
+		s_pGroups = pNew;
+		s_iMaxGroups = iNewMax;
+	}
+
+	particle_group& group = s_pGroups[iNumGroups];
+	group.hSprite = hSprite;
+	group.iFrame = iFrame;
+	group.iRenderMode = iRenderMode;
+	group.pModel = pModel;
+	group.iCount = 0;
+	return iNumGroups++;
+}
+
+void ParticleSystem::DrawSystem(const Vector& right, const Vector& up)
+{
+	particle_arrays& p = m_Particles;
+
+	if (m_iMaxParticles > s_iMaxQuads)
+	{
+		delete[] s_pQuads;
+		delete[] s_pSortedQuads;
+		delete[] s_pCorners;
+		s_iMaxQuads = m_iMaxParticles;
+		s_pQuads = new particle_quad[s_iMaxQuads];
+		s_pSortedQuads = new particle_quad[s_iMaxQuads];
+		s_pCorners = new Vector[s_iMaxQuads * 4];
+	}
+
+	int iNumGroups = 0;
+	int iNumQuads = 0;
+	int iNumCorners = 0;
+
+	// newest first, as they were when this was a linked list. Overlays are drawn along with their parents.
+	for (int iPart = m_iNumParticles - 1; iPart >= 0; iPart--)
+	{
+		if (p.parent[iPart] != PARTICLE_NO_PARENT)
+			continue;
+
+		float fSize = p.size[iPart];
+		// nothing to draw?
+		if (fSize == 0)
+			continue;
+
+		Vector origin = GetOrigin(iPart);
+		float fCosSize = CosLookup(p.angle[iPart]) * fSize;
+		float fSinSize = SinLookup(p.angle[iPart]) * fSize;
+
+		// calculate the four corners of the sprite
+		Vector* pCorners = &s_pCorners[iNumCorners];
+		pCorners[0] = origin + up * fSinSize - right * fCosSize;
+		pCorners[1] = origin + up * fCosSize + right * fSinSize;
+		pCorners[2] = origin - up * fSinSize + right * fCosSize;
+		pCorners[3] = origin - up * fCosSize - right * fSinSize;
+
+		bool bUsed = false;
+		int iContents = 0;
+
+		for (int iDraw = iPart; iDraw != -1; iDraw = p.overlay[iDraw])
+		{
+			ParticleType* pType = p.type[iDraw];
+			if (pType->m_hSprite == 0)
+				continue;
+
+			if (pType->m_iDrawCond != 0)
 			{
-				m_pActiveParticle = pParticle->nextpart;
-				pParticle->nextpart = m_pFreeParticle;
-				m_pFreeParticle = pParticle;
-				pParticle = m_pActiveParticle;
+				if (iContents == 0)
+					iContents = CachedPointContents(origin);
+
+				if (iContents != pType->m_iDrawCond)
+					continue;
 			}
+
+			struct model_s* pModel = (struct model_s*)gEngfuncs.GetSpritePointer(pType->m_hSprite);
+
+			// if we've reached the end of the sprite's frames, loop back
+			while (p.frame[iDraw] > pModel->numframes)
+				p.frame[iDraw] -= pModel->numframes;
+
+			while (p.frame[iDraw] < 0)
+				p.frame[iDraw] += pModel->numframes;
+
+			particle_quad& quad = s_pQuads[iNumQuads++];
+			quad.iGroup = FindParticleGroup(iNumGroups, pType->m_hSprite, int(p.frame[iDraw]), pType->m_iRenderMode, pModel);
+			quad.iPart = iDraw;
+			quad.iCorners = iNumCorners;
+			s_pGroups[quad.iGroup].iCount++;
+			bUsed = true;
 		}
+
+		if (bUsed)
+			iNumCorners += 4;
 	}
 
+	if (!iNumQuads)
+		return;
 
-	return true;
+	// sort the quads into their groups, keeping them in order within each one
+	int iFirst = 0;
+	for (int i = 0; i < iNumGroups; i++)
+	{
+		s_pGroups[i].iFirst = iFirst;
+		iFirst += s_pGroups[i].iCount;
+		s_pGroups[i].iCount = 0;
+	}
+	for (int i = 0; i < iNumQuads; i++)
+	{
+		particle_group& group = s_pGroups[s_pQuads[i].iGroup];
+		s_pSortedQuads[group.iFirst + group.iCount++] = s_pQuads[i];
+	}
+
+	// groups are drawn in the order they were first seen, so an overlay's group comes after its parent's
+	for (int i = 0; i < iNumGroups; i++)
+	{
+		particle_group& group = s_pGroups[i];
+		if (gEngfuncs.pTriAPI->SpriteTexture(group.pModel, group.iFrame) == NULL)
+			continue;
+
+		gEngfuncs.pTriAPI->RenderMode(group.iRenderMode);
+		gEngfuncs.pTriAPI->Begin(TRI_QUADS);
+		for (int j = group.iFirst; j < group.iFirst + group.iCount; j++)
+		{
+			int iDraw = s_pSortedQuads[j].iPart;
+			Vector* pCorners = &s_pCorners[s_pSortedQuads[j].iCorners];
+
+			gEngfuncs.pTriAPI->Color4f(p.red[iDraw], p.green[iDraw], p.blue[iDraw], p.alpha[iDraw]);
+			gEngfuncs.pTriAPI->TexCoord2f(0, 0);
+			gEngfuncs.pTriAPI->Vertex3fv(pCorners[0]);
+
+			gEngfuncs.pTriAPI->TexCoord2f(1, 0);
+			gEngfuncs.pTriAPI->Vertex3fv(pCorners[1]);
+
+			gEngfuncs.pTriAPI->TexCoord2f(1, 1);
+			gEngfuncs.pTriAPI->Vertex3fv(pCorners[2]);
+
+			gEngfuncs.pTriAPI->TexCoord2f(0, 1);
+			gEngfuncs.pTriAPI->Vertex3fv(pCorners[3]);
+		}
+		gEngfuncs.pTriAPI->End();
+
+		c_iDrawCalls++;
+		c_iQuadsDrawn += group.iCount;
+	}
 }
 
-void ParticleSystem::DrawSystem()
+void ParticleSystem::IntegrateParticles(int iEnd, float frametime)
 {
-	Vector normal, forward, right, up;
+	particle_arrays& p = m_Particles;
+	int i = 0;
 
-	gEngfuncs.GetViewAngles((float*)normal);
-	AngleVectors(normal, forward, right, up);
+#ifdef PARTICLES_SSE2
+	// the same sums as the loop below, four particles at a time
+	const __m128 ft = _mm_set1_ps(frametime);
+	for (; i + 4 <= iEnd; i += 4)
+	{
+		__m128 vx = _mm_loadu_ps(p.velocity[0] + i);
+		__m128 vy = _mm_loadu_ps(p.velocity[1] + i);
+		__m128 vz = _mm_loadu_ps(p.velocity[2] + i);
+
+		// drag pulls the velocity towards the wind. (with no drag, this adds nothing.)
+		__m128 k = _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(p.drag + i)), ft);
+		vx = _mm_add_ps(vx, _mm_mul_ps(k, _mm_sub_ps(vx, _mm_loadu_ps(p.wind[0] + i))));
+		vy = _mm_add_ps(vy, _mm_mul_ps(k, _mm_sub_ps(vy, _mm_loadu_ps(p.wind[1] + i))));
+		vz = _mm_add_ps(vz, _mm_mul_ps(k, vz));
+
+		vz = _mm_add_ps(vz, _mm_mul_ps(ft, _mm_loadu_ps(p.gravity + i)));
+
+		_mm_storeu_ps(p.velocity[0] + i, vx);
+		_mm_storeu_ps(p.velocity[1] + i, vy);
+		_mm_storeu_ps(p.velocity[2] + i, vz);
+		_mm_storeu_ps(p.origin[0] + i, _mm_add_ps(_mm_loadu_ps(p.origin[0] + i), _mm_mul_ps(ft, vx)));
+		_mm_storeu_ps(p.origin[1] + i, _mm_add_ps(_mm_loadu_ps(p.origin[1] + i), _mm_mul_ps(ft, vy)));
+		_mm_storeu_ps(p.origin[2] + i, _mm_add_ps(_mm_loadu_ps(p.origin[2] + i), _mm_mul_ps(ft, vz)));
+
+		_mm_storeu_ps(p.age + i, _mm_add_ps(_mm_loadu_ps(p.age + i), ft));
+
+#define STEP_FIELD(field, step) _mm_storeu_ps(p.field + i, _mm_add_ps(_mm_loadu_ps(p.field + i), _mm_mul_ps(_mm_loadu_ps(p.step + i), ft)))
+		STEP_FIELD(size, sizeStep);
+		STEP_FIELD(alpha, alphaStep);
+		STEP_FIELD(red, redStep);
+		STEP_FIELD(green, greenStep);
+		STEP_FIELD(blue, blueStep);
+		STEP_FIELD(frame, frameStep);
+		STEP_FIELD(angle, angleStep);
+#undef STEP_FIELD
+	}
+#endif
 
-	particle* pParticle = m_pActiveParticle;
-	for (pParticle = m_pActiveParticle; pParticle; pParticle = pParticle->nextpart)
+	for (; i < iEnd; i++)
 	{
-		DrawParticle(pParticle, right, up);
+		float k = -p.drag[i] * frametime;
+		p.velocity[0][i] += k * (p.velocity[0][i] - p.wind[0][i]);
+		p.velocity[1][i] += k * (p.velocity[1][i] - p.wind[1][i]);
+		p.velocity[2][i] += k * p.velocity[2][i];
+
+		p.velocity[2][i] += frametime * p.gravity[i];
+
+		p.origin[0][i] += frametime * p.velocity[0][i];
+		p.origin[1][i] += frametime * p.velocity[1][i];
+		p.origin[2][i] += frametime * p.velocity[2][i];
+
+		p.age[i] += frametime;
+
+		p.size[i] += p.sizeStep[i] * frametime;
+		p.alpha[i] += p.alphaStep[i] * frametime;
+		p.red[i] += p.redStep[i] * frametime;
+		p.green[i] += p.greenStep[i] * frametime;
+		p.blue[i] += p.blueStep[i] * frametime;
+		p.frame[i] += p.frameStep[i] * frametime;
+		p.angle[i] += p.angleStep[i] * frametime;
 	}
 }
 
-bool ParticleSystem::UpdateParticle(particle* part, float frametime)
+// everything IntegrateParticles can't do in bulk: dying, following the source entity or parent, bouncing and spraying.
+bool ParticleSystem::UpdateParticle(int iPart, float frametime, const Vector& vecMainOldOrigin)
 {
-	//	gEngfuncs.Con_Printf("UpdParticle %f: age %f, life %f\n", frametime, part->age, part->age_death);
-	if (frametime == 0)
-		return true;
-
-	part->age += frametime;
+	particle_arrays& p = m_Particles;
+	ParticleType* pType = p.type[iPart];
 
 	// is this particle bound to an entity?
-	if (part->m_iEntIndex != 0)
+	if (iPart == m_iMainParticle)
 	{
-		cl_entity_t* source = gEngfuncs.GetEntityByIndex(m_iEntIndex);
-		if (source && source->curstate.body != 0)
+		if (m_bSourceOn)
 		{
-			part->velocity = (source->curstate.origin - part->origin) / frametime;
-			part->origin = source->curstate.origin;
+			SetVelocity(iPart, (m_vecSourceOrigin - vecMainOldOrigin) / frametime);
+			SetOrigin(iPart, m_vecSourceOrigin);
 		}
 		else
 		{
@@ -670,150 +1270,244 @@ bool ParticleSystem::UpdateParticle(particle* part, float frametime)
 	else
 	{
 		// not tied to an entity, check whether it's time to die
-		if (part->age_death >= 0 && part->age > part->age_death)
+		if (p.age_death[iPart] >= 0 && p.age[iPart] > p.age_death[iPart])
 			return false;
 
-		// apply acceleration and velocity
-		Vector vecOldPos = part->origin;
-		if (part->m_fDrag != 0)
-			VectorMA(part->velocity, -part->m_fDrag * frametime, part->velocity - part->m_vecWind, part->velocity);
-		VectorMA(part->velocity, frametime, part->accel, part->velocity);
-		VectorMA(part->origin, frametime, part->velocity, part->origin);
-
-		if (part->pType->m_bBouncing)
+		int iParent = p.parent[iPart];
+		if (iParent == PARTICLE_ORPHAN)
 		{
-			Vector vecTarget;
-			VectorMA(part->origin, frametime, part->velocity, vecTarget);
-			pmtrace_t* tr = gEngfuncs.PM_TraceLine(part->origin, vecTarget, PM_TRACELINE_PHYSENTSONLY, 2 /*point hull*/, -1);
-			if (tr->fraction < 1)
-			{
-				part->origin = tr->endpos;
-				float bounceforce = DotProduct(tr->plane.normal, part->velocity);
-				float newspeed = (1 - part->pType->m_BounceFriction.GetInstance());
-				part->velocity = part->velocity * newspeed;
-				VectorMA(part->velocity, -bounceforce * (newspeed + part->pType->m_Bounce.GetInstance()), tr->plane.normal, part->velocity);
-			}
+			return false;
+		}
+		else if (iParent != PARTICLE_NO_PARENT)
+		{
+			// overlays stay with the particle they're drawn on
+			SetOrigin(iPart, GetOrigin(iParent));
+			SetVelocity(iPart, GetVelocity(iParent));
+		}
+		else if (pType->m_bBouncing)
+		{
+			CollideParticle(iPart, frametime);
 		}
 	}
 
-
 	// spray children
-	if (part->age_spray != 0 && part->age > part->age_spray)
+	if (p.age_spray[iPart] != 0 && p.age[iPart] > p.age_spray[iPart])
 	{
-		part->age_spray = part->age + 1 / part->pType->m_SprayRate.GetInstance();
+		float r[4];
+		m_Random.RandomSamples(r, 4);
+		p.age_spray[iPart] = p.age[iPart] + 1 / (pType->m_SprayRate.GetInstance(r[0]) * m_fLOD);
 
-		//particle *pChild = ActivateParticle();
-		if (part->pType->m_pSprayType)
+		if (pType->m_pSprayType)
 		{
-			particle* pChild = part->pType->m_pSprayType->CreateParticle(this); //pChild);
-			if (pChild)
+			int iChild = -1;
+			if (m_iSprayed < m_iSprayAllowance)
+			{
+				m_iSprayed++;
+				iChild = pType->m_pSprayType->CreateParticle(this);
+			}
+			else
+			{
+				m_iSpraysRefused++;
+			}
+
+			if (iChild != -1)
 			{
-				pChild->origin = part->origin;
-				float fSprayForce = part->pType->m_SprayForce.GetInstance();
-				pChild->velocity = part->velocity;
+				SetOrigin(iChild, GetOrigin(iPart));
+				Vector vecVelocity = GetVelocity(iPart);
+				float fSprayForce = pType->m_SprayForce.GetInstance(r[1]);
 				if (fSprayForce != 0)
 				{
-					float fSprayPitch = part->pType->m_SprayPitch.GetInstance();
-					float fSprayYaw = part->pType->m_SprayYaw.GetInstance();
+					float fSprayPitch = pType->m_SprayPitch.GetInstance(r[2]);
+					float fSprayYaw = pType->m_SprayYaw.GetInstance(r[3]);
 					float fForceCosPitch = fSprayForce * CosLookup(fSprayPitch);
-					Vector vecSprayVel;
-					pChild->velocity.x += CosLookup(fSprayYaw) * fForceCosPitch;
-					pChild->velocity.y += SinLookup(fSprayYaw) * fForceCosPitch;
-					pChild->velocity.z -= SinLookup(fSprayPitch) * fSprayForce;
+					vecVelocity.x += CosLookup(fSprayYaw) * fForceCosPitch;
+					vecVelocity.y += SinLookup(fSprayYaw) * fForceCosPitch;
+					vecVelocity.z -= SinLookup(fSprayPitch) * fSprayForce;
 				}
+				SetVelocity(iChild, vecVelocity);
 			}
 		}
 	}
 
-	part->m_fSize += part->m_fSizeStep * frametime;
-	part->m_fAlpha += part->m_fAlphaStep * frametime;
-	part->m_fRed += part->m_fRedStep * frametime;
-	part->m_fGreen += part->m_fGreenStep * frametime;
-	part->m_fBlue += part->m_fBlueStep * frametime;
-	part->frame += part->m_fFrameStep * frametime;
-	if (part->m_fAngleStep != 0)
+	if (p.angleStep[iPart] != 0)
 	{
-		part->m_fAngle += part->m_fAngleStep * frametime;
-		while (part->m_fAngle < 0)
-			part->m_fAngle += 360;
-		while (part->m_fAngle > 360)
-			part->m_fAngle -= 360;
-
-		//		gEngfuncs.Con_Printf("Rotating to %f, width %f\n", part->m_fAngle, part->m_fWidth);
+		while (p.angle[iPart] < 0)
+			p.angle[iPart] += 360;
+		while (p.angle[iPart] > 360)
+			p.angle[iPart] -= 360;
 	}
 	return true;
 }
 
-void ParticleSystem::DrawParticle(particle* part, Vector& right, Vector& up)
+// Bouncing particles don't trace every frame. Each trace covers the next few frames of the particle's path;
+// if that's clear, it won't trace again until it gets to the end of it, and if it hits something the surface
+// is remembered, so the particle only has to check which side of that plane it's on until it gets there.
+// These run after IntegrateParticles, so what's checked is the move the particle's just made, and when that
+// goes through the plane it's traced to find where it really stopped (in a corner, there may be something
+// nearer than the plane).
+
+// where the particle was at the start of the frame (IntegrateParticles moves it by its new velocity)
+Vector ParticleSystem::FrameStart(int iPart, float frametime)
+{
+	return GetOrigin(iPart) - GetVelocity(iPart) * frametime;
+}
+
+void ParticleSystem::CollideParticle(int iPart, float frametime)
 {
-	//	gEngfuncs.Con_Printf("DrawParticle: size %f, pos %f %f %f\n", part->size, part->origin[0], part->origin[1], part->origin[2]);
-	float fSize = part->m_fSize;
-	Vector point1, point2, point3, point4;
-	Vector origin = part->origin;
+	particle_arrays& p = m_Particles;
 
-	// nothing to draw?
-	if (fSize == 0)
+	if (!CrossesCollisionPlane(iPart, FrameStart(iPart, frametime), GetOrigin(iPart)) && p.age[iPart] < p.age_trace[iPart])
 		return;
 
-	float fCosSize = CosLookup(part->m_fAngle) * fSize;
-	float fSinSize = SinLookup(part->m_fAngle) * fSize;
+	// time to look, but that's not safe here
+	m_pTraceRequests[m_iNumTraceRequests++] = iPart;
+}
 
-	// calculate the four corners of the sprite
-	VectorMA(origin, fSinSize, up, point1);
-	VectorMA(point1, -fCosSize, right, point1);
+// main thread: traces along a bouncing particle's path, from the start of this frame's move to a few frames ahead
+void ParticleSystem::TraceParticle(int iPart, float frametime)
+{
+	particle_arrays& p = m_Particles;
+	Vector vecOrigin = GetOrigin(iPart);
+	Vector vecVelocity = GetVelocity(iPart);
+	Vector vecStart = FrameStart(iPart, frametime);
+	pmtrace_t* tr;
+
+	// haven't got time to look, hope the surface it knows is the one it hit
+	if (c_iTraceBudget <= 0)
+	{
+		c_iTracesRefused++;
+		HitCollisionPlane(iPart, vecStart, vecOrigin);
+		return;
+	}
+	c_iTraceBudget--;
 
-	VectorMA(origin, fCosSize, up, point2);
-	VectorMA(point2, fSinSize, right, point2);
+	if (CrossesCollisionPlane(iPart, vecStart, vecOrigin))
+	{
+		tr = gEngfuncs.PM_TraceLine(vecStart, vecOrigin, PM_TRACELINE_PHYSENTSONLY, 2 /*point hull*/, -1);
+		if (0 != tr->allsolid)
+		{
+			HitCollisionPlane(iPart, vecStart, vecOrigin);
+			return;
+		}
 
-	VectorMA(origin, -fSinSize, up, point3);
-	VectorMA(point3, fCosSize, right, point3);
+		if (tr->fraction < 1)
+		{
+			p.plane[iPart] = AddCollisionPlane(tr->plane.normal, DotProduct(tr->plane.normal, tr->endpos));
+			BounceParticle(iPart, tr->endpos + tr->plane.normal * PARTICLE_PLANE_OFFSET, tr->plane.normal);
+			return;
+		}
 
-	VectorMA(origin, -fCosSize, up, point4);
-	VectorMA(point4, -fSinSize, right, point4);
+		// the surface doesn't reach this far, so look further
+	}
 
-	struct model_s* pModel;
-	int iContents = 0;
+	float fAhead = V_min(frametime * PARTICLE_TRACE_AHEAD, PARTICLE_TRACE_MAXTIME);
+	fAhead = V_max(fAhead, frametime);
+	Vector vecAhead;
+	VectorMA(vecOrigin, fAhead, vecVelocity, vecAhead);
+	vecAhead.z += 0.5f * p.gravity[iPart] * fAhead * (fAhead + frametime); // where frame-by-frame steps will take it, a little lower than the true curve
 
-	for (particle* pDraw = part; pDraw; pDraw = pDraw->m_pOverlay)
+	tr = gEngfuncs.PM_TraceLine(vecStart, vecAhead, PM_TRACELINE_PHYSENTSONLY, 2 /*point hull*/, -1);
+	if (0 != tr->allsolid)
 	{
-		if (pDraw->pType->m_hSprite == 0)
-			continue;
+		// it's already inside something, so the trace can't tell us anything; keep the surface it knows (if
+		// it's only a little way through that, it'll still bounce out) and look again next frame
+		p.age_trace[iPart] = p.age[iPart] + frametime;
+		HitCollisionPlane(iPart, vecStart, vecOrigin);
+		return;
+	}
 
-		if (pDraw->pType->m_iDrawCond != 0)
-		{
-			if (iContents == 0)
-				iContents = gEngfuncs.PM_PointContents(origin, NULL);
+	if (tr->fraction >= 1)
+	{
+		// nothing there; look again when it gets to the end
+		p.plane[iPart] = -1;
+		p.age_trace[iPart] = p.age[iPart] + fAhead - frametime;
+		return;
+	}
 
-			if (iContents != pDraw->pType->m_iDrawCond)
-				continue;
-		}
+	// it's going to hit something. Remember the surface; if drag or wind take the particle somewhere else, it'll
+	// trace again soon after it should have got there. (The trace started a frame back.)
+	p.plane[iPart] = AddCollisionPlane(tr->plane.normal, DotProduct(tr->plane.normal, tr->endpos));
+	p.age_trace[iPart] = p.plane[iPart] == -1 ? 0 : p.age[iPart] + tr->fraction * (fAhead + frametime);
+
+	// if it's already gone through, it bounces from where the trace stopped
+	if (DotProduct(tr->plane.normal, vecOrigin - tr->endpos) < 0)
+		BounceParticle(iPart, tr->endpos + tr->plane.normal * PARTICLE_PLANE_OFFSET, tr->plane.normal);
+}
 
-		pModel = (struct model_s*)gEngfuncs.GetSpritePointer(pDraw->pType->m_hSprite);
+// whether the particle's gone through the plane it was heading for
+bool ParticleSystem::CrossesCollisionPlane(int iPart, const Vector& vecStart, const Vector& vecEnd)
+{
+	int iPlane = m_Particles.plane[iPart];
+	if (iPlane == -1)
+		return false;
+
+	const collision_plane& plane = m_Planes[iPlane];
+	float fStart = DotProduct(plane.normal, vecStart) - plane.dist;
+	float fEnd = DotProduct(plane.normal, vecEnd) - plane.dist;
+	return fStart >= -PARTICLE_PLANE_EPSILON && fEnd < 0 && fEnd < fStart;
+}
 
-		// if we've reached the end of the sprite's frames, loop back
-		while (pDraw->frame > pModel->numframes)
-			pDraw->frame -= pModel->numframes;
+// bounces the particle off the plane it was heading for, if it's gone through; for when it can't trace
+bool ParticleSystem::HitCollisionPlane(int iPart, const Vector& vecStart, const Vector& vecEnd)
+{
+	if (!CrossesCollisionPlane(iPart, vecStart, vecEnd))
+		return false;
 
-		while (pDraw->frame < 0)
-			pDraw->frame += pModel->numframes;
+	const collision_plane& plane = m_Planes[m_Particles.plane[iPart]];
+	float fStart = DotProduct(plane.normal, vecStart) - plane.dist;
+	float fEnd = DotProduct(plane.normal, vecEnd) - plane.dist;
 
-		if (gEngfuncs.pTriAPI->SpriteTexture(pModel, int(pDraw->frame)) == NULL)
-			continue;
+	// if it started a little way through, it's put back on the surface
+	Vector vecHit;
+	if (fStart <= 0)
+		vecHit = vecStart - plane.normal * fStart;
+	else
+		vecHit = vecStart + (vecEnd - vecStart) * (fStart / (fStart - fEnd));
 
-		gEngfuncs.pTriAPI->RenderMode(pDraw->pType->m_iRenderMode);
-		gEngfuncs.pTriAPI->Color4f(pDraw->m_fRed, pDraw->m_fGreen, pDraw->m_fBlue, pDraw->m_fAlpha);
-		gEngfuncs.pTriAPI->Begin(TRI_QUADS);
-		gEngfuncs.pTriAPI->TexCoord2f(0, 0);
-		gEngfuncs.pTriAPI->Vertex3fv(point1);
+	BounceParticle(iPart, vecHit + plane.normal * PARTICLE_PLANE_OFFSET, plane.normal);
+	return true;
+}
 
-		gEngfuncs.pTriAPI->TexCoord2f(1, 0);
-		gEngfuncs.pTriAPI->Vertex3fv(point2);
+void ParticleSystem::BounceParticle(int iPart, const Vector& vecPos, const Vector& vecNormal)
+{
+	ParticleType* pType = m_Particles.type[iPart];
+	Vector vecVelocity = GetVelocity(iPart);
+
+	SetOrigin(iPart, vecPos);
+	float bounceforce = DotProduct(vecNormal, vecVelocity);
+	float newspeed = (1 - pType->m_BounceFriction.GetInstance(m_Random));
+	vecVelocity = vecVelocity * newspeed;
+	VectorMA(vecVelocity, -bounceforce * (newspeed + pType->m_Bounce.GetInstance(m_Random)), vecNormal, vecVelocity);
+	SetVelocity(iPart, vecVelocity);
+
+	// it's going somewhere new, so it'll need to look again next frame; until then, the surface it's just
+	// bounced off is the one it's most likely to hit
+	m_Particles.age_trace[iPart] = m_Particles.age[iPart];
+}
 
-		gEngfuncs.pTriAPI->TexCoord2f(1, 1);
-		gEngfuncs.pTriAPI->Vertex3fv(point3);
+// returns the index of the plane, or -1 if there's no room for it
+int ParticleSystem::AddCollisionPlane(const Vector& vecNormal, float fDist)
+{
+	for (int i = 0; i < m_iNumPlanes; i++)
+	{
+		if (fabs(m_Planes[i].dist - fDist) < 0.5f && DotProduct(m_Planes[i].normal, vecNormal) > 0.999f)
+			return i;
+	}
 
-		gEngfuncs.pTriAPI->TexCoord2f(0, 1);
-		gEngfuncs.pTriAPI->Vertex3fv(point4);
-		gEngfuncs.pTriAPI->End();
+	if (m_iNumPlanes == MAX_COLLISION_PLANES)
+		return -1;
+
+	m_Planes[m_iNumPlanes].normal = vecNormal;
+	m_Planes[m_iNumPlanes].dist = fDist;
+	return m_iNumPlanes++;
+}
+
+void ParticleSystem::ClearCollisionPlanes()
+{
+	m_iNumPlanes = 0;
+	for (int i = 0; i < m_iNumParticles; i++)
+	{
+		m_Particles.plane[i] = -1;
+		m_Particles.age_trace[i] = 0;
 	}
 }
@@ -8,47 +8,124 @@ class ParticleSystem;
 #define COLLISION_DIE 1
 #define COLLISION_BOUNCE 2
 
-struct particle
+// a particle's parent, if it's an overlay
+#define PARTICLE_NO_PARENT -1 // not an overlay; it gets drawn in its own right
+#define PARTICLE_ORPHAN -2	  // its parent has died, so it'll die too
+
+// The particles in a system are stored field by field (one array per field),
+// so that the update loop can work on several of them at once. Live particles
+// are always packed into the start of the arrays; a dying particle's slot is
+// filled by moving another one down.
+struct particle_arrays
 {
-	particle* nextpart;
+	float* origin[3];
+	float* velocity[3];
+	float* gravity; // accel is always straight down
+	float* wind[2]; // wind is always horizontal
+	float* drag;
+
+	float* age;
+	float* age_death;
+	float* age_spray;
+	float* age_trace; // bouncing particles: the path's been traced up to this age, no need to look again until then
+
+	float* size;
+	float* sizeStep;
+	float* alpha;
+	float* alphaStep;
+	float* red;
+	float* redStep;
+	float* green;
+	float* greenStep;
+	float* blue;
+	float* blueStep;
+	float* frame;
+	float* frameStep;
+	float* angle;
+	float* angleStep;
+
+	ParticleType** type;
+	int* overlay; // index of the particle drawn on top of this one, or -1
+	int* parent;  // index of the particle this is drawn on top of, or PARTICLE_NO_PARENT/PARTICLE_ORPHAN
+	int* plane;	  // bouncing particles: the cached plane it's going to hit, or -1
+};
 
-	particle* m_pOverlay; // for making multi-layered particles
+#define PARTICLE_FLOAT_FIELDS 28 // the number of float arrays above
 
-	ParticleType* pType;
+#define MAX_COLLISION_PLANES 16 // per system
+#define PARTICLE_TRACE_AHEAD 8	// bouncing particles trace this many frames' movement at once
+#define PARTICLE_TRACE_MAXTIME 0.25
+#define PARTICLE_PLANE_EPSILON 1 // how far behind its plane a particle can start a frame and still bounce off it
+#define PARTICLE_PLANE_OFFSET 0.1f // how far in front of the surface a bounced particle's left, so a trace from there doesn't start inside it
 
-	Vector origin;
-	Vector velocity;
-	Vector accel;
-	Vector m_vecWind;
+// a surface some of a system's particles are heading for
+struct collision_plane
+{
+	Vector normal;
+	float dist;
+};
 
-	int m_iEntIndex; // if non-zero, this particle is tied to the given entity
+// each system has its own random numbers, so that its particles come out the same whichever thread
+// updates it, and the same every time for the same seed.
+// (xoshiro128+, which is plenty for particles and much cheaper than going through the engine)
+class ParticleRandom
+{
+public:
+	// any seed will do, including 0; the parts are mixed together
+	void Seed(unsigned int iSeed, unsigned int iStream = 0, unsigned int iSerial = 0)
+	{
+		unsigned int x = iSeed ^ Mix(iStream + 0x68E31DA4u) ^ Mix(iSerial + 0xB5297A4Du);
+		for (int i = 0; i < 4; i++)
+			m_iState[i] = Mix(x += 0x9E3779B9u);
 
-	float m_fRed;
-	float m_fGreen;
-	float m_fBlue;
-	float m_fRedStep;
-	float m_fGreenStep;
-	float m_fBlueStep;
+		// all zero would get stuck there
+		if (!(m_iState[0] | m_iState[1] | m_iState[2] | m_iState[3]))
+			m_iState[0] = 1;
+	}
 
-	float m_fAlpha;
-	float m_fAlphaStep;
+	// between 0 and 1 (never 1)
+	float RandomSample()
+	{
+		return (Next() >> 8) * (1.0f / 16777216.0f);
+	}
 
-	float frame;
-	float m_fFrameStep;
+	float RandomFloat(float fMin, float fMax)
+	{
+		return fMin + (fMax - fMin) * RandomSample();
+	}
 
-	float m_fAngle;
-	float m_fAngleStep;
+	// a whole spawn's worth of samples at once
+	void RandomSamples(float* pOut, int iCount)
+	{
+		for (int i = 0; i < iCount; i++)
+			pOut[i] = (Next() >> 8) * (1.0f / 16777216.0f);
+	}
 
-	float m_fSize;
-	float m_fSizeStep;
+private:
+	unsigned int Next()
+	{
+		unsigned int iResult = m_iState[0] + m_iState[3];
+		unsigned int t = m_iState[1] << 9;
 
-	float m_fDrag;
+		m_iState[2] ^= m_iState[0];
+		m_iState[3] ^= m_iState[1];
+		m_iState[1] ^= m_iState[2];
+		m_iState[0] ^= m_iState[3];
+		m_iState[2] ^= t;
+		m_iState[3] = (m_iState[3] << 11) | (m_iState[3] >> 21);
 
-	float age;
-	float age_death;
-	float age_spray;
-};
+		return iResult;
+	}
 
+	static unsigned int Mix(unsigned int x)
+	{
+		x = (x ^ (x >> 16)) * 0x85EBCA6Bu;
+		x = (x ^ (x >> 13)) * 0xC2B2AE35u;
+		return x ^ (x >> 16);
+	}
+
+	unsigned int m_iState[4];
+};
 
 class RandomRange
 {
@@ -75,14 +152,20 @@ public:
 	float m_fMin;
 	bool m_bDefined;
 
-	float GetInstance()
+	float GetInstance(ParticleRandom& rng)
+	{
+		return rng.RandomFloat(m_fMin, m_fMax);
+	}
+
+	// for a sample that's already been drawn, between 0 and 1
+	float GetInstance(float fSample)
 	{
-		return gEngfuncs.pfnRandomFloat(m_fMin, m_fMax);
+		return m_fMin + (m_fMax - m_fMin) * fSample;
 	}
 
-	float GetOffset(float fBasis)
+	float GetOffset(ParticleRandom& rng, float fBasis)
 	{
-		return GetInstance() - fBasis;
+		return GetInstance(rng) - fBasis;
 	}
 
 	bool IsDefined()
@@ -150,56 +233,149 @@ public:
 	char m_szName[MAX_TYPENAME];
 
 	// here is a particle system. Add a (set of) particles according to this type, and initialise their values.
-	particle* CreateParticle(ParticleSystem* pSys);
+	// returns the new particle's index, or -1 if the system is full.
+	int CreateParticle(ParticleSystem* pSys);
 
 	// initialise this particle. Does not define velocity or age.
-	void InitParticle(particle* pPart, ParticleSystem* pSys);
+	void InitParticle(int iPart, ParticleSystem* pSys);
+#define PARTICLE_INIT_SAMPLES 19 // random numbers InitParticle uses
 };
 
-class ParticleSystem
+// a particle script, parsed once and shared by every system that uses it.
+// Scripts are reloaded if the file changes, and all of them are thrown away when the level ends.
+class ParticleTemplate
 {
 public:
-	ParticleSystem(int entindex, char* szFilename);
-	~ParticleSystem();
-	void AllocateParticles(int iParticles);
-	void CalculateDistance();
+	static ParticleTemplate* Get(const char* szFilename);
+	static void ClearAll();
+
+	void AddRef() { m_iRefCount++; }
+	void Release();
 
 	ParticleType* GetType(const char* szName);
+
+	int m_iParticles;
+	ParticleType* m_pMainType;
+
+private:
+	ParticleTemplate(const char* szFilename);
+	~ParticleTemplate();
+
 	ParticleType* AddPlaceholderType(const char* szName);
 	ParticleType* ParseType(char*& szFile);
 
+	char m_szFilename[256];
+	long m_iModTime;
+	int m_iRefCount; // the number of systems using it
+	bool m_bCached;	 // false once it's been dropped from the list; it's deleted when the last system lets go
+
+	ParticleType* m_pFirstType;
+	ParticleTemplate* m_pNext;
+};
+
+class ParticleSystem
+{
+public:
+	ParticleSystem(int entindex, char* szFilename);
+	~ParticleSystem();
+	void AllocateParticles(int iParticles);
+	void CalculateDistance(); // also works out the bounding sphere
+
 	cl_entity_t* GetEntity() { return gEngfuncs.GetEntityByIndex(m_iEntIndex); }
 
 	static float c_fCosTable[360 + 90];
 	static bool c_bCosTableInit;
 
 	// General functions
-	bool UpdateSystem(float frametime, int messagenum);	// If this function returns false, the manager deletes the system
-	void DrawSystem();									//vec3_t &right, vec3_t &up);
-	particle* ActivateParticle();						// adds one of the free particles to the active list, and returns it for initialisation.
-														//MUST CHECK WHETHER THIS RESULT IS NULL!
+	// an update is done in three steps: PrepareUpdate and FinishUpdate on the main thread, and Simulate on any thread
+	bool PrepareUpdate(float frametime, int messagenum); // If this function returns false, the manager deletes the system
+	void Simulate(float frametime);
+	void FinishUpdate(float frametime);
+	void DrawSystem(const Vector& right, const Vector& up);
+	int ActivateParticle(); // adds one of the free particles to the active list, and returns its index for initialisation.
+							// MUST CHECK WHETHER THIS RESULT IS -1!
 
 	static float CosLookup(int angle) { return angle < 0 ? c_fCosTable[angle + 360] : c_fCosTable[angle]; }
 	static float SinLookup(int angle) { return angle < -90 ? c_fCosTable[angle + 450] : c_fCosTable[angle + 90]; }
 
 	// returns false if the particle has died
-	bool UpdateParticle(particle* part, float frametime);
-	void DrawParticle(particle* part, Vector& right, Vector& up);
+	bool UpdateParticle(int iPart, float frametime, const Vector& vecMainOldOrigin);
+
+	Vector GetOrigin(int iPart) { return Vector(m_Particles.origin[0][iPart], m_Particles.origin[1][iPart], m_Particles.origin[2][iPart]); }
+	void SetOrigin(int iPart, const Vector& vec);
+	Vector GetVelocity(int iPart) { return Vector(m_Particles.velocity[0][iPart], m_Particles.velocity[1][iPart], m_Particles.velocity[2][iPart]); }
+	void SetVelocity(int iPart, const Vector& vec);
 
-	// Pointer to next system for linked list structure
+	// the next (older) system for the same entity
 	ParticleSystem* m_pNextSystem;
 
-	particle* m_pActiveParticle;
-	float m_fViewerDist;
+	particle_arrays m_Particles;
+	int m_iNumParticles; // the number in use
+	int m_iMaxParticles;
+
+	float m_fViewerDist; // squared
 	int m_iEntIndex;
 
-private:
-	// the block of allocated particles
-	particle* m_pAllParticles;
-	particle* m_pFreeParticle;
-	particle* m_pMainParticle; // the "source" particle.
+	// a sphere around the live particles and the source entity, for culling
+	Vector m_vecCentre;
+	float m_fRadius;
 
-	ParticleType* m_pFirstType;
+	// level of detail, set by the manager every frame. At 1 the script is followed exactly;
+	// lower values spray less often and make the sprayed particles die sooner.
+	float m_fLOD;
+
+	bool m_bSimulate; // set by PrepareUpdate if there's anything to do this frame
+	bool m_bCulled;	  // the manager's note to itself
+
+	// the most new particles this system can spray this frame (set by the manager before Simulate),
+	// and how many it tried to last time
+	int m_iSprayAllowance;
+	int m_iSprayDemand;
+	int m_iSprayed;
+	int m_iSpraysRefused;
 
+	ParticleRandom m_Random;
+
+	// traces for bouncing particles that can still be done this frame, shared by all the systems
+	static int c_iTraceBudget;
+	static int c_iTracesRefused;
+
+	// called by the manager before drawing anything; resets the draw counts and the contents cache
+	static void BeginFrame();
+	static int c_iDrawCalls; // Begin/End pairs
+	static int c_iQuadsDrawn;
+
+private:
+	// applies velocity, drag, gravity and all the per-second steps to particles [0, iEnd)
+	void IntegrateParticles(int iEnd, float frametime);
+	void MoveParticle(int iFrom, int iTo);
+	void KillParticle(int iPart, int& iEnd);
+	Vector FrameStart(int iPart, float frametime);
+	void CollideParticle(int iPart, float frametime);
+	void TraceParticle(int iPart, float frametime);
+	bool CrossesCollisionPlane(int iPart, const Vector& vecStart, const Vector& vecEnd);
+	bool HitCollisionPlane(int iPart, const Vector& vecStart, const Vector& vecEnd);
+	void BounceParticle(int iPart, const Vector& vecPos, const Vector& vecNormal);
+	int AddCollisionPlane(const Vector& vecNormal, float fDist);
+	void ClearCollisionPlanes();
+
+	float* m_pFloatBlock; // all the float arrays in m_Particles live in here
+	int m_iStride;		  // distance between them
+	int m_iMainParticle;  // the "source" particle, or -1.
+
+	ParticleTemplate* m_pTemplate;
 	ParticleType* m_pMainType;
+
+	// surfaces found by earlier traces. They're forgotten whenever the source entity moves.
+	collision_plane m_Planes[MAX_COLLISION_PLANES];
+	int m_iNumPlanes;
+	Vector m_vecPlanesOrigin; // where the source entity was when they were found
+
+	// the source entity, as of PrepareUpdate
+	Vector m_vecSourceOrigin;
+	bool m_bSourceOn;
+
+	// bouncing particles that need a trace, done in FinishUpdate
+	int* m_pTraceRequests;
+	int m_iNumTraceRequests;
 };
@@ -0,0 +1,277 @@
+// Where the client's frame time goes: a scope profiler for the main client entry points
+//
+// cl_profile 1 times the phases in profiler.h every frame, cl_profile 2 also shows them on screen,
+// and cl_profile_dump [file] writes the last PROF_HISTORY frames to a .csv in the game directory.
+#include "hud.h"
+#include "cl_util.h"
+#include "profiler.h"
+
+#include <algorithm>
+
+FrameProfiler g_FrameProfiler;
+
+static const char* s_szPhaseNames[PROF_NUM_PHASES] =
+	{
+		"frame",
+		"V_CalcRefdef",
+		"HUD_CreateEntities",
+		"HUD_TempEntUpdate",
+		"StudioDrawModel",
+		"StudioDrawPlayer",
+		"DrawTransparentTriangles",
+		"particles",
+		"particle simulate",
+		"particle draw",
+		"weather",
+		"HUD_Redraw",
+};
+
+static void CmdProfileDump()
+{
+	g_FrameProfiler.Dump(gEngfuncs.Cmd_Argc() > 1 ? gEngfuncs.Cmd_Argv(1) : "profile.csv");
+}
+
+FrameProfiler::FrameProfiler()
+{
+	m_bActive = false;
+	m_pCvarProfile = NULL;
+	m_flFrameStart = 0;
+	m_iDepth = 0;
+	m_iFrames = 0;
+	memset(m_flTotal, 0, sizeof(m_flTotal));
+	memset(m_iCalls, 0, sizeof(m_iCalls));
+	memset(m_iNesting, 0, sizeof(m_iNesting));
+	memset(m_iParent, -1, sizeof(m_iParent));
+	memset(m_iOrder, 0, sizeof(m_iOrder));
+	memset(m_iOrderDepth, 0, sizeof(m_iOrderDepth));
+}
+
+void FrameProfiler::Init()
+{
+	m_pCvarProfile = CVAR_CREATE("cl_profile", "0", 0); // 1 = time the client's frame, 2 = and show it
+	gEngfuncs.pfnAddCommand("cl_profile_dump", CmdProfileDump);
+}
+
+void FrameProfiler::Enter(int iPhase)
+{
+	if (m_iNesting[iPhase]++ != 0)
+		return;
+
+	m_iCalls[iPhase]++;
+	m_iParent[iPhase] = (m_iDepth > 0 && m_iDepth <= PROF_MAX_DEPTH) ? m_iStack[m_iDepth - 1] : -1;
+	if (m_iDepth < PROF_MAX_DEPTH)
+		m_iStack[m_iDepth] = iPhase;
+	m_iDepth++;
+
+	m_flEntered[iPhase] = m_Timer.GetCurTime();
+}
+
+void FrameProfiler::Leave(int iPhase)
+{
+	if (--m_iNesting[iPhase] != 0)
+		return;
+
+	m_flTotal[iPhase] += m_Timer.GetCurTime() - m_flEntered[iPhase];
+	m_iDepth--;
+}
+
+void FrameProfiler::Frame()
+{
+	const double flNow = m_Timer.GetCurTime();
+
+	if (m_bActive)
+	{
+		// file away the frame that just finished
+		m_flTotal[PROF_FRAME] = flNow - m_flFrameStart;
+		m_iCalls[PROF_FRAME] = 1;
+
+		const int iSlot = m_iFrames % PROF_HISTORY;
+		for (int i = 0; i < PROF_NUM_PHASES; i++)
+		{
+			m_flHistory[iSlot][i] = m_flTotal[i] * 1000;
+			m_iHistoryCalls[iSlot][i] = V_min(m_iCalls[i], 65535);
+		}
+		m_iFrames++;
+
+		if (m_pCvarProfile->value >= 2 && (m_iFrames & 15) == 1)
+			UpdateStats();
+	}
+
+	const bool bActive = m_pCvarProfile && m_pCvarProfile->value != 0;
+	if (bActive && !m_bActive)
+	{
+		// starting again; the old history's probably from somewhere else entirely
+		m_iFrames = 0;
+		memset(m_iParent, -1, sizeof(m_iParent));
+	}
+	m_bActive = bActive;
+
+	memset(m_flTotal, 0, sizeof(m_flTotal));
+	memset(m_iCalls, 0, sizeof(m_iCalls));
+	memset(m_iNesting, 0, sizeof(m_iNesting));
+	m_iDepth = 0;
+	m_flFrameStart = flNow;
+}
+
+void FrameProfiler::UpdateStats()
+{
+	const int iCount = V_min(m_iFrames, PROF_HISTORY);
+	float flSorted[PROF_HISTORY];
+
+	for (int i = 0; i < PROF_NUM_PHASES; i++)
+	{
+		float flSum = 0;
+		int iCalls = 0;
+		for (int j = 0; j < iCount; j++)
+		{
+			flSorted[j] = m_flHistory[j][i];
+			flSum += flSorted[j];
+			iCalls += m_iHistoryCalls[j][i];
+		}
+		std::sort(flSorted, flSorted + iCount);
+
+		// nearest rank
+		m_flAvg[i] = flSum / iCount;
+		m_flP50[i] = flSorted[(iCount * 50 + 99) / 100 - 1];
+		m_flP95[i] = flSorted[(iCount * 95 + 99) / 100 - 1];
+		m_flP99[i] = flSorted[(iCount * 99 + 99) / 100 - 1];
+		m_flMax[i] = flSorted[iCount - 1];
+		m_flAvgCalls[i] = (float)iCalls / iCount;
+	}
+
+	// put each phase under the one it was last seen inside. anything left over (which can only
+	// happen if two phases have each been inside the other) goes at the top level.
+	bool bPlaced[PROF_NUM_PHASES];
+	memset(bPlaced, 0, sizeof(bPlaced));
+	int iPlaced = 0;
+
+	for (int i = 0; i < PROF_NUM_PHASES; i++)
+	{
+		if (m_iParent[i] != -1)
+			continue;
+
+		int iStack[PROF_NUM_PHASES];
+		int iDepth[PROF_NUM_PHASES];
+		int iTop = 0;
+		iStack[iTop] = i;
+		iDepth[iTop++] = 0;
+		bPlaced[i] = true;
+
+		while (iTop > 0)
+		{
+			iTop--;
+			const int iPhase = iStack[iTop];
+			const int iPhaseDepth = iDepth[iTop];
+			m_iOrder[iPlaced] = iPhase;
+			m_iOrderDepth[iPlaced++] = iPhaseDepth;
+
+			// pushed backwards, so they come off in enum order
+			for (int j = PROF_NUM_PHASES - 1; j >= 0; j--)
+			{
+				if (!bPlaced[j] && m_iParent[j] == iPhase)
+				{
+					bPlaced[j] = true;
+					iStack[iTop] = j;
+					iDepth[iTop++] = iPhaseDepth + 1;
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < PROF_NUM_PHASES; i++)
+	{
+		if (!bPlaced[i])
+		{
+			m_iOrder[iPlaced] = i;
+			m_iOrderDepth[iPlaced++] = 0;
+		}
+	}
+}
+
+void FrameProfiler::Draw(const SCREENINFO& scrinfo)
+{
+	if (!m_bActive || m_pCvarProfile->value < 2 || m_iFrames == 0)
+		return;
+
+	if (m_iFrames < 16)
+		UpdateStats();
+
+	static const char* szColumns[] = {"avg ms", "p50", "p95", "p99", "max", "calls"};
+	const int iLineHeight = V_max(scrinfo.iCharHeight, 12);
+	const int iNameWidth = 200;
+	const int iColumnWidth = 56;
+	const int x = 16;
+	int y = scrinfo.iHeight / 4;
+
+	FillRGBA(x - 4, y - 2, iNameWidth + iColumnWidth * 6 + 8, iLineHeight * (PROF_NUM_PHASES + 1) + 4, 0, 0, 0, 160);
+
+	char sz[64];
+	gEngfuncs.pfnDrawSetTextColor(1, 0.7, 0);
+	sprintf(sz, "last %d frames", V_min(m_iFrames, PROF_HISTORY));
+	DrawConsoleString(x, y, sz);
+	for (int i = 0; i < 6; i++)
+	{
+		gEngfuncs.pfnDrawSetTextColor(1, 0.7, 0);
+		DrawConsoleString(x + iNameWidth + iColumnWidth * i, y, szColumns[i]);
+	}
+	y += iLineHeight;
+
+	for (int i = 0; i < PROF_NUM_PHASES; i++)
+	{
+		const int iPhase = m_iOrder[i];
+		const float flValues[6] = {m_flAvg[iPhase], m_flP50[iPhase], m_flP95[iPhase], m_flP99[iPhase], m_flMax[iPhase], m_flAvgCalls[iPhase]};
+
+		gEngfuncs.pfnDrawSetTextColor(1, 1, 1);
+		DrawConsoleString(x + m_iOrderDepth[i] * 12, y, s_szPhaseNames[iPhase]);
+		for (int j = 0; j < 6; j++)
+		{
+			sprintf(sz, j == 5 ? "%.1f" : "%.3f", flValues[j]);
+			gEngfuncs.pfnDrawSetTextColor(1, 1, 1);
+			DrawConsoleString(x + iNameWidth + iColumnWidth * j, y, sz);
+		}
+		y += iLineHeight;
+	}
+}
+
+void FrameProfiler::Dump(const char* pszFile)
+{
+	if (m_iFrames == 0)
+	{
+		gEngfuncs.Con_Printf("Nothing to dump; set cl_profile 1 first\n");
+		return;
+	}
+
+	char szPath[MAX_PATH];
+	snprintf(szPath, sizeof(szPath), "%s/%s", gEngfuncs.pfnGetGameDirectory(), pszFile);
+
+	FILE* pFile = fopen(szPath, "w");
+	if (!pFile)
+	{
+		gEngfuncs.Con_Printf("Couldn't write %s\n", szPath);
+		return;
+	}
+
+	int i;
+	fprintf(pFile, "frame");
+	for (i = 0; i < PROF_NUM_PHASES; i++)
+		fprintf(pFile, ",%s ms", s_szPhaseNames[i]);
+	for (i = 0; i < PROF_NUM_PHASES; i++)
+		fprintf(pFile, ",%s calls", s_szPhaseNames[i]);
+	fprintf(pFile, "\n");
+
+	// oldest first
+	const int iCount = V_min(m_iFrames, PROF_HISTORY);
+	for (int iFrame = m_iFrames - iCount; iFrame < m_iFrames; iFrame++)
+	{
+		const int iSlot = iFrame % PROF_HISTORY;
+		fprintf(pFile, "%d", iFrame);
+		for (i = 0; i < PROF_NUM_PHASES; i++)
+			fprintf(pFile, ",%.4f", m_flHistory[iSlot][i]);
+		for (i = 0; i < PROF_NUM_PHASES; i++)
+			fprintf(pFile, ",%d", m_iHistoryCalls[iSlot][i]);
+		fprintf(pFile, "\n");
+	}
+
+	fclose(pFile);
+	gEngfuncs.Con_Printf("Wrote %d frames to %s\n", iCount, szPath);
+}
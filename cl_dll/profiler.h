@@ -0,0 +1,100 @@
+// Where the client's frame time goes: a scope profiler for the main client entry points
+#pragma once
+
+#include "perf_counter.h"
+
+// the things that get timed. a phase's parent is whichever phase it was
+// last entered from, so the overlay shows them as a tree.
+enum
+{
+	PROF_FRAME, // from one HUD_Frame to the next
+	PROF_CALCREFDEF,
+	PROF_CREATEENTITIES,
+	PROF_TEMPENTS,
+	PROF_STUDIO_MODEL,
+	PROF_STUDIO_PLAYER,
+	PROF_TRANS_TRIANGLES,
+	PROF_PARTICLES,
+	PROF_PARTICLE_SIMULATE,
+	PROF_PARTICLE_DRAW,
+	PROF_WEATHER,
+	PROF_REDRAW,
+	PROF_NUM_PHASES
+};
+
+#define PROF_HISTORY 256  // frames kept for the averages, percentiles and dump
+#define PROF_MAX_DEPTH 16 // deepest nesting of phases that gets timed
+
+class FrameProfiler
+{
+public:
+	FrameProfiler();
+
+	void Init();
+	void Frame(); // once per frame, from HUD_Frame
+	void Draw(const SCREENINFO& scrinfo); // the overlay, from HUD_Redraw
+	void Dump(const char* pszFile);
+
+	// only call these if m_bActive
+	void Enter(int iPhase);
+	void Leave(int iPhase);
+
+	bool m_bActive; // read once per frame from cl_profile, so a scope costs one test when it's off
+
+private:
+	void UpdateStats();
+
+	CPerformanceCounter m_Timer;
+	struct cvar_s* m_pCvarProfile;
+
+	// this frame
+	double m_flFrameStart;
+	double m_flTotal[PROF_NUM_PHASES];
+	int m_iCalls[PROF_NUM_PHASES];
+	int m_iNesting[PROF_NUM_PHASES]; // a phase entered from inside itself is only timed once
+	double m_flEntered[PROF_NUM_PHASES];
+	int m_iParent[PROF_NUM_PHASES]; // -1 for none
+	int m_iStack[PROF_MAX_DEPTH];
+	int m_iDepth;
+
+	// the last PROF_HISTORY frames, in milliseconds; m_iFrames counts every frame recorded
+	float m_flHistory[PROF_HISTORY][PROF_NUM_PHASES];
+	unsigned short m_iHistoryCalls[PROF_HISTORY][PROF_NUM_PHASES];
+	int m_iFrames;
+
+	// what the overlay shows; only worked out every few frames
+	float m_flAvg[PROF_NUM_PHASES];
+	float m_flP50[PROF_NUM_PHASES];
+	float m_flP95[PROF_NUM_PHASES];
+	float m_flP99[PROF_NUM_PHASES];
+	float m_flMax[PROF_NUM_PHASES];
+	float m_flAvgCalls[PROF_NUM_PHASES];
+	int m_iOrder[PROF_NUM_PHASES]; // phases in tree order
+	int m_iOrderDepth[PROF_NUM_PHASES];
+};
+
+extern FrameProfiler g_FrameProfiler;
+
+class ProfileScope
+{
+public:
+	ProfileScope(int iPhase) : m_iPhase(iPhase), m_bTiming(g_FrameProfiler.m_bActive)
+	{
+		if (m_bTiming)
+			g_FrameProfiler.Enter(m_iPhase);
+	}
+
+	~ProfileScope()
+	{
+		if (m_bTiming)
+			g_FrameProfiler.Leave(m_iPhase);
+	}
+
+private:
+	int m_iPhase;
+	bool m_bTiming; // so turning the profiler on or off mid-scope can't unbalance it
+};
+
+#define PROFILE_SCOPE_NAME2(line) _profileScope##line
+#define PROFILE_SCOPE_NAME(line) PROFILE_SCOPE_NAME2(line)
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_SCOPE_NAME(__LINE__)(phase)
@@ -12,6 +12,13 @@
 #include "com_model.h"
 #include "studio_util.h"
 
+// SSE2 is only used where the compiler is already allowed to use it (x64, and /arch:SSE2 on Windows);
+// the Linux build sticks to x87, and gets the plain loops.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STUDIO_SSE2
+#endif
+
 // angles index are not the same as ROLL, PITCH, YAW
 
 /*
@@ -127,6 +134,253 @@ void QuaternionMatrix(vec4_t quaternion, float (*matrix)[4])
 	matrix[2][2] = 1.0 - 2.0 * quaternion[0] * quaternion[0] - 2.0 * quaternion[1] * quaternion[1];
 }
 
+/*
+====================
+QuaternionSlerpBones
+
+Slerps q1 towards q2 and lerps pos1 towards pos2, for a whole skeleton; the results go in q1 and pos1.
+====================
+*/
+void QuaternionSlerpBones(vec4_t* q1, float (*pos1)[3], vec4_t* q2, float (*pos2)[3], float t, int numbones)
+{
+	int i = 0;
+	int j;
+	float t1 = 1.0 - t;
+	vec4_t q3;
+
+#ifdef STUDIO_SSE2
+	// the trig is still done a bone at a time, but the rest is done four at once
+	const __m128 signbit = _mm_set1_ps(-0.0f);
+	const __m128 vt = _mm_set1_ps(t);
+	const __m128 vt1 = _mm_set1_ps(t1);
+
+	for (; i + 4 <= numbones; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(q1[i]);
+		__m128 py = _mm_loadu_ps(q1[i + 1]);
+		__m128 pz = _mm_loadu_ps(q1[i + 2]);
+		__m128 pw = _mm_loadu_ps(q1[i + 3]);
+		_MM_TRANSPOSE4_PS(px, py, pz, pw);
+
+		__m128 qx = _mm_loadu_ps(q2[i]);
+		__m128 qy = _mm_loadu_ps(q2[i + 1]);
+		__m128 qz = _mm_loadu_ps(q2[i + 2]);
+		__m128 qw = _mm_loadu_ps(q2[i + 3]);
+		_MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+		// decide if one of the quaternions is backwards
+		__m128 d, a, b;
+		d = _mm_sub_ps(px, qx);
+		a = _mm_mul_ps(d, d);
+		d = _mm_sub_ps(py, qy);
+		a = _mm_add_ps(a, _mm_mul_ps(d, d));
+		d = _mm_sub_ps(pz, qz);
+		a = _mm_add_ps(a, _mm_mul_ps(d, d));
+		d = _mm_sub_ps(pw, qw);
+		a = _mm_add_ps(a, _mm_mul_ps(d, d));
+		d = _mm_add_ps(px, qx);
+		b = _mm_mul_ps(d, d);
+		d = _mm_add_ps(py, qy);
+		b = _mm_add_ps(b, _mm_mul_ps(d, d));
+		d = _mm_add_ps(pz, qz);
+		b = _mm_add_ps(b, _mm_mul_ps(d, d));
+		d = _mm_add_ps(pw, qw);
+		b = _mm_add_ps(b, _mm_mul_ps(d, d));
+
+		__m128 flip = _mm_and_ps(_mm_cmpgt_ps(a, b), signbit);
+		qx = _mm_xor_ps(qx, flip);
+		qy = _mm_xor_ps(qy, flip);
+		qz = _mm_xor_ps(qz, flip);
+		qw = _mm_xor_ps(qw, flip);
+
+		__m128 cosom = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, qx), _mm_mul_ps(py, qy)), _mm_add_ps(_mm_mul_ps(pz, qz), _mm_mul_ps(pw, qw)));
+
+		float cosoms[4], sclp[4], sclq[4];
+		_mm_storeu_ps(cosoms, cosom);
+
+		bool opposite = false;
+		for (j = 0; j < 4; j++)
+		{
+			if ((1.0 + cosoms[j]) <= 0.000001)
+			{
+				opposite = true;
+				break;
+			}
+
+			if ((1.0 - cosoms[j]) > 0.000001)
+			{
+				float omega = acos(cosoms[j]);
+				float sinom = sin(omega);
+				sclp[j] = sin((1.0 - t) * omega) / sinom;
+				sclq[j] = sin(t * omega) / sinom;
+			}
+			else
+			{
+				sclp[j] = 1.0 - t;
+				sclq[j] = t;
+			}
+		}
+
+		if (opposite)
+		{
+			// rare enough not to bother with
+			for (j = i; j < i + 4; j++)
+			{
+				QuaternionSlerp(q1[j], q2[j], t, q3);
+				q1[j][0] = q3[0];
+				q1[j][1] = q3[1];
+				q1[j][2] = q3[2];
+				q1[j][3] = q3[3];
+			}
+		}
+		else
+		{
+			__m128 vsclp = _mm_loadu_ps(sclp);
+			__m128 vsclq = _mm_loadu_ps(sclq);
+			px = _mm_add_ps(_mm_mul_ps(vsclp, px), _mm_mul_ps(vsclq, qx));
+			py = _mm_add_ps(_mm_mul_ps(vsclp, py), _mm_mul_ps(vsclq, qy));
+			pz = _mm_add_ps(_mm_mul_ps(vsclp, pz), _mm_mul_ps(vsclq, qz));
+			pw = _mm_add_ps(_mm_mul_ps(vsclp, pw), _mm_mul_ps(vsclq, qw));
+			_MM_TRANSPOSE4_PS(px, py, pz, pw);
+			_mm_storeu_ps(q1[i], px);
+			_mm_storeu_ps(q1[i + 1], py);
+			_mm_storeu_ps(q1[i + 2], pz);
+			_mm_storeu_ps(q1[i + 3], pw);
+		}
+
+		// four bones' positions are twelve floats in a row
+		float* p1 = pos1[i];
+		float* p2 = pos2[i];
+		for (j = 0; j < 12; j += 4)
+			_mm_storeu_ps(p1 + j, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(p1 + j), vt1), _mm_mul_ps(_mm_loadu_ps(p2 + j), vt)));
+	}
+#endif
+
+	for (; i < numbones; i++)
+	{
+		QuaternionSlerp(q1[i], q2[i], t, q3);
+		q1[i][0] = q3[0];
+		q1[i][1] = q3[1];
+		q1[i][2] = q3[2];
+		q1[i][3] = q3[3];
+		pos1[i][0] = pos1[i][0] * t1 + pos2[i][0] * t;
+		pos1[i][1] = pos1[i][1] * t1 + pos2[i][1] * t;
+		pos1[i][2] = pos1[i][2] * t1 + pos2[i][2] * t;
+	}
+}
+
+/*
+====================
+QuaternionMatrixBones
+
+Makes each bone's matrix from its quaternion and position.
+====================
+*/
+void QuaternionMatrixBones(vec4_t* quaternions, float (*positions)[3], float (*matrices)[3][4], int numbones)
+{
+	int i = 0;
+
+#ifdef STUDIO_SSE2
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+
+	for (; i + 4 <= numbones; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(quaternions[i]);
+		__m128 y = _mm_loadu_ps(quaternions[i + 1]);
+		__m128 z = _mm_loadu_ps(quaternions[i + 2]);
+		__m128 w = _mm_loadu_ps(quaternions[i + 3]);
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+
+		__m128 x2 = _mm_mul_ps(two, x);
+		__m128 y2 = _mm_mul_ps(two, y);
+		__m128 z2 = _mm_mul_ps(two, z);
+
+		__m128 xx = _mm_mul_ps(x2, x);
+		__m128 yy = _mm_mul_ps(y2, y);
+		__m128 zz = _mm_mul_ps(z2, z);
+		__m128 xy = _mm_mul_ps(x2, y);
+		__m128 xz = _mm_mul_ps(x2, z);
+		__m128 yz = _mm_mul_ps(y2, z);
+		__m128 wx = _mm_mul_ps(x2, w);
+		__m128 wy = _mm_mul_ps(y2, w);
+		__m128 wz = _mm_mul_ps(z2, w);
+
+		// a row of each of the four matrices, then turned round into each matrix's row
+		__m128 r0 = _mm_sub_ps(_mm_sub_ps(one, yy), zz);
+		__m128 r1 = _mm_sub_ps(xy, wz);
+		__m128 r2 = _mm_add_ps(xz, wy);
+		__m128 r3 = _mm_setr_ps(positions[i][0], positions[i + 1][0], positions[i + 2][0], positions[i + 3][0]);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(matrices[i][0], r0);
+		_mm_storeu_ps(matrices[i + 1][0], r1);
+		_mm_storeu_ps(matrices[i + 2][0], r2);
+		_mm_storeu_ps(matrices[i + 3][0], r3);
+
+		r0 = _mm_add_ps(xy, wz);
+		r1 = _mm_sub_ps(_mm_sub_ps(one, xx), zz);
+		r2 = _mm_sub_ps(yz, wx);
+		r3 = _mm_setr_ps(positions[i][1], positions[i + 1][1], positions[i + 2][1], positions[i + 3][1]);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(matrices[i][1], r0);
+		_mm_storeu_ps(matrices[i + 1][1], r1);
+		_mm_storeu_ps(matrices[i + 2][1], r2);
+		_mm_storeu_ps(matrices[i + 3][1], r3);
+
+		r0 = _mm_sub_ps(xz, wy);
+		r1 = _mm_add_ps(yz, wx);
+		r2 = _mm_sub_ps(_mm_sub_ps(one, xx), yy);
+		r3 = _mm_setr_ps(positions[i][2], positions[i + 1][2], positions[i + 2][2], positions[i + 3][2]);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(matrices[i][2], r0);
+		_mm_storeu_ps(matrices[i + 1][2], r1);
+		_mm_storeu_ps(matrices[i + 2][2], r2);
+		_mm_storeu_ps(matrices[i + 3][2], r3);
+	}
+#endif
+
+	for (; i < numbones; i++)
+	{
+		QuaternionMatrix(quaternions[i], matrices[i]);
+
+		matrices[i][0][3] = positions[i][0];
+		matrices[i][1][3] = positions[i][1];
+		matrices[i][2][3] = positions[i][2];
+	}
+}
+
+/*
+====================
+ConcatTransformsSIMD
+
+Same as ConcatTransforms, a row at a time.
+====================
+*/
+void ConcatTransformsSIMD(float in1[3][4], float in2[3][4], float out[3][4])
+{
+#ifdef STUDIO_SSE2
+	const __m128 b0 = _mm_loadu_ps(in2[0]);
+	const __m128 b1 = _mm_loadu_ps(in2[1]);
+	const __m128 b2 = _mm_loadu_ps(in2[2]);
+	const __m128 b3 = _mm_setr_ps(0, 0, 0, 1); // in1's translation only goes in the last column
+
+	__m128 rows[3];
+	for (int i = 0; i < 3; i++)
+	{
+		__m128 a = _mm_loadu_ps(in1[i]);
+		rows[i] = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)), b0), _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)), b1)),
+			_mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)), b2), _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b3)));
+	}
+
+	_mm_storeu_ps(out[0], rows[0]);
+	_mm_storeu_ps(out[1], rows[1]);
+	_mm_storeu_ps(out[2], rows[2]);
+#else
+	ConcatTransforms(in1, in2, out);
+#endif
+}
+
 /*
 ====================
 MatrixCopy
@@ -28,3 +28,8 @@ void	MatrixCopy( float in[3][4], float out[3][4] );
 void	QuaternionMatrix( vec4_t quaternion, float (*matrix)[4] );
 void	QuaternionSlerp( vec4_t p, vec4_t q, float t, vec4_t qt );
 void	AngleQuaternion( float *angles, vec4_t quaternion );
+
+// Whole-skeleton versions of the above, four bones at a time where SSE2 is available
+void	QuaternionSlerpBones( vec4_t *q1, float (*pos1)[3], vec4_t *q2, float (*pos2)[3], float t, int numbones );
+void	QuaternionMatrixBones( vec4_t *quaternions, float (*positions)[3], float (*matrices)[3][4], int numbones );
+void	ConcatTransformsSIMD( float in1[3][4], float in2[3][4], float out[3][4] );
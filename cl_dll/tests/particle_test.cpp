@@ -0,0 +1,760 @@
+// Headless test and benchmark for the particle systems
+//
+// Runs particle scripts through ParticleSystemManager with a stand-in for the engine: a fixed scene of
+// planes to bounce off, an emitter that moves and switches off and on, sprites with known frame counts
+// and a TriAPI that records what's drawn. At the end of each run the particles left alive, and the last
+// frame's draw calls, are compared against a golden file; along the way it times the updates.
+//
+//	particle_test [-seconds n] [-fps n] [-threads n] [-seed n] [-golden dir] [-update] script...
+//
+// "make tests" in linux/ builds it and checks the scripts in particles/ against golden/. -update writes
+// the golden files instead of checking them. Only use it when a change to the particles is meant to
+// change what they do, and look at the difference before checking it in. (The particles are chaotic
+// enough that x87 maths gives different answers, so the tests are built for SSE.) It's built twice: once
+// with the SSE2 loops, and once as particle_test_scalar with the plain loops the x87 client runs. Both
+// check against the same golden files, but x87 precision itself isn't tested.
+#include "hud.h"
+#include "cl_util.h"
+#include "const.h"
+#include "entity_state.h"
+#include "cl_entity.h"
+#include "triangleapi.h"
+#include "com_model.h"
+#include "pmtrace.h"
+#include "pm_defs.h"
+#include "particlesys.h"
+#include "particlemgr.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#undef AngleVectors
+void AngleVectors(const Vector& angles, Vector* forward, Vector* right, Vector* up); // pm_math.cpp
+
+cl_enginefunc_t gEngfuncs;
+Vector v_origin;
+
+//============================================
+// the scene
+
+#define TEST_ENTITY_WORLD 0
+#define TEST_ENTITY_PLAYER 1
+#define TEST_ENTITY_EMITTER 2
+#define TEST_NUM_ENTITIES 3
+
+// the view, which decides the particles' level of detail
+#define TEST_FOV 90
+#define TEST_SCREEN_WIDTH 640
+
+static cl_entity_t g_Entities[TEST_NUM_ENTITIES];
+
+// solid behind each plane: a floor, and a wall in front of the emitter
+static const collision_plane g_ScenePlanes[] =
+	{
+		{Vector(0, 0, 1), 0},
+		{Vector(-1, 0, 0), -192},
+};
+
+#define TEST_NUM_PLANES (sizeof(g_ScenePlanes) / sizeof(g_ScenePlanes[0]))
+
+// water fills everything on the negative x side up to this height
+#define TEST_WATER_LEVEL 64
+
+static int g_iTraces;
+
+// where the emitter is over the run (0 to 1): out in the open, under water, off, then back where it started
+static void MoveEmitter(float fTime)
+{
+	cl_entity_t* pEmitter = &g_Entities[TEST_ENTITY_EMITTER];
+
+	if (fTime < 0.4f)
+	{
+		pEmitter->curstate.origin = Vector(0, 0, 96);
+		pEmitter->curstate.body = 1;
+	}
+	else if (fTime < 0.7f)
+	{
+		pEmitter->curstate.origin = Vector(-64, 0, 32);
+		pEmitter->curstate.body = 1;
+	}
+	else if (fTime < 0.85f)
+	{
+		pEmitter->curstate.body = 0;
+	}
+	else
+	{
+		pEmitter->curstate.origin = Vector(0, 0, 96);
+		pEmitter->curstate.body = 1;
+	}
+}
+
+//============================================
+// sprites
+
+struct test_sprite
+{
+	const char* pszName;
+	int iFrames;
+};
+
+// frame counts for the sprites the scripts use; any others have one frame
+static const test_sprite g_KnownSprites[] =
+	{
+		{"sprites/steam1.spr", 16},
+		{"sprites/richo1.spr", 4},
+		{"sprites/glow01.spr", 1},
+		{"sprites/flare1.spr", 1},
+		{"sprites/bubble.spr", 1},
+};
+
+#define TEST_MAX_SPRITES 32
+
+static model_s g_Sprites[TEST_MAX_SPRITES];
+static int g_iNumSprites;
+
+static HSPRITE Test_SPR_Load(const char* pszName)
+{
+	for (int i = 0; i < g_iNumSprites; i++)
+	{
+		if (!strcmp(g_Sprites[i].name, pszName))
+			return i + 1;
+	}
+
+	if (g_iNumSprites == TEST_MAX_SPRITES)
+		return 0;
+
+	model_s* pModel = &g_Sprites[g_iNumSprites];
+	strncpy(pModel->name, pszName, sizeof(pModel->name) - 1);
+	pModel->type = mod_sprite;
+	pModel->numframes = 1;
+	for (int i = 0; i < (int)(sizeof(g_KnownSprites) / sizeof(g_KnownSprites[0])); i++)
+	{
+		if (!strcmp(g_KnownSprites[i].pszName, pszName))
+			pModel->numframes = g_KnownSprites[i].iFrames;
+	}
+
+	return ++g_iNumSprites;
+}
+
+static const model_s* Test_GetSpritePointer(HSPRITE hSprite)
+{
+	if (hSprite < 1 || hSprite > g_iNumSprites)
+		return NULL;
+	return &g_Sprites[hSprite - 1];
+}
+
+//============================================
+// the recording TriAPI
+
+struct draw_record
+{
+	int iRenderMode;
+	int iSprite; // index into g_Sprites
+	int iFrame;
+	int iVertices;
+};
+
+static std::vector<draw_record> g_Draws; // this frame's
+static int g_iRenderMode;
+static int g_iSprite = -1;
+static int g_iFrame;
+static bool g_bDrawing;
+static int g_iDrawErrors;
+
+static void DrawError(const char* pszError)
+{
+	if (g_iDrawErrors++ == 0)
+		printf("TriAPI misuse: %s\n", pszError);
+}
+
+static void Tri_RenderMode(int iMode)
+{
+	if (g_bDrawing)
+		DrawError("RenderMode between Begin and End");
+	g_iRenderMode = iMode;
+}
+
+static void Tri_Begin(int iPrimitive)
+{
+	if (g_bDrawing)
+		DrawError("Begin without End");
+	if (iPrimitive != TRI_QUADS)
+		DrawError("particles should be drawn as quads");
+	if (g_iSprite == -1)
+		DrawError("Begin without a sprite");
+
+	g_bDrawing = true;
+	draw_record record = {g_iRenderMode, g_iSprite, g_iFrame, 0};
+	g_Draws.push_back(record);
+}
+
+static void Tri_End()
+{
+	if (!g_bDrawing)
+		DrawError("End without Begin");
+	else if (g_Draws.back().iVertices % 4 != 0)
+		DrawError("a quad without four corners");
+	g_bDrawing = false;
+}
+
+static void Tri_Vertex3fv(const float* pPoint)
+{
+	if (!g_bDrawing)
+		DrawError("Vertex outside Begin and End");
+	else
+		g_Draws.back().iVertices++;
+}
+
+static int Tri_SpriteTexture(struct model_s* pModel, int iFrame)
+{
+	if (g_bDrawing)
+		DrawError("SpriteTexture between Begin and End");
+	if (!pModel || iFrame < 0 || iFrame >= pModel->numframes)
+	{
+		DrawError("SpriteTexture with a bad frame");
+		g_iSprite = -1;
+		return 0;
+	}
+
+	g_iSprite = pModel - g_Sprites;
+	g_iFrame = iFrame;
+	return 1;
+}
+
+static void Tri_Color4f(float r, float g, float b, float a) {}
+static void Tri_TexCoord2f(float u, float v) {}
+
+static void Tri_GetMatrix(const int iName, float* pMatrix)
+{
+	for (int i = 0; i < 16; i++)
+		pMatrix[i] = (i % 5 == 0) ? 1 : 0;
+}
+
+static triangleapi_t g_TriAPI;
+
+//============================================
+// the rest of the engine
+
+static cvar_t g_Cvars[32];
+static int g_iNumCvars;
+
+static cvar_t* Test_RegisterVariable(const char* pszName, const char* pszValue, int iFlags)
+{
+	for (int i = 0; i < g_iNumCvars; i++)
+	{
+		if (!strcmp(g_Cvars[i].name, pszName))
+			return &g_Cvars[i];
+	}
+
+	if (g_iNumCvars == sizeof(g_Cvars) / sizeof(g_Cvars[0]))
+	{
+		printf("Too many cvars\n");
+		exit(1);
+	}
+
+	cvar_t* pCvar = &g_Cvars[g_iNumCvars++];
+	pCvar->name = (char*)pszName;
+	pCvar->string = (char*)pszValue;
+	pCvar->flags = iFlags;
+	pCvar->value = atof(pszValue);
+	return pCvar;
+}
+
+static void SetCvar(const char* pszName, float fValue)
+{
+	Test_RegisterVariable(pszName, "0", 0)->value = fValue;
+}
+
+static void Test_Con_Printf(const char* pszFormat, ...)
+{
+	va_list args;
+	va_start(args, pszFormat);
+	vprintf(pszFormat, args);
+	va_end(args);
+}
+
+static void Test_Con_NPrintf(int iPos, const char* pszFormat, ...) {}
+
+static cl_entity_t* Test_GetEntityByIndex(int iIndex)
+{
+	if (iIndex < 0 || iIndex >= TEST_NUM_ENTITIES)
+		return NULL;
+	return &g_Entities[iIndex];
+}
+
+static cl_entity_t* Test_GetLocalPlayer()
+{
+	return &g_Entities[TEST_ENTITY_PLAYER];
+}
+
+static void Test_GetViewAngles(float* pAngles)
+{
+	pAngles[0] = pAngles[1] = pAngles[2] = 0;
+}
+
+static void Test_AngleVectors(const float* pAngles, float* pForward, float* pRight, float* pUp)
+{
+	Vector forward, right, up;
+	AngleVectors(Vector(pAngles[0], pAngles[1], pAngles[2]), &forward, &right, &up);
+	if (pForward)
+		VectorCopy(forward, pForward);
+	if (pRight)
+		VectorCopy(right, pRight);
+	if (pUp)
+		VectorCopy(up, pUp);
+}
+
+static pmtrace_t g_Trace;
+
+static pmtrace_t* Test_PM_TraceLine(float* pStart, float* pEnd, int iFlags, int iHull, int iIgnore)
+{
+	Vector vecStart(pStart[0], pStart[1], pStart[2]);
+	Vector vecEnd(pEnd[0], pEnd[1], pEnd[2]);
+
+	g_iTraces++;
+	memset(&g_Trace, 0, sizeof(g_Trace));
+	g_Trace.fraction = 1;
+	g_Trace.ent = -1;
+
+	for (int i = 0; i < (int)TEST_NUM_PLANES; i++)
+	{
+		const collision_plane& plane = g_ScenePlanes[i];
+		float fStart = DotProduct(vecStart, plane.normal) - plane.dist;
+		float fEnd = DotProduct(vecEnd, plane.normal) - plane.dist;
+
+		if (fStart < 0)
+		{
+			g_Trace.allsolid = g_Trace.startsolid = 1;
+			g_Trace.fraction = 0;
+			g_Trace.plane.normal = plane.normal;
+			g_Trace.plane.dist = plane.dist;
+			break;
+		}
+
+		if (fEnd < 0 && fStart / (fStart - fEnd) < g_Trace.fraction)
+		{
+			g_Trace.fraction = fStart / (fStart - fEnd);
+			g_Trace.plane.normal = plane.normal;
+			g_Trace.plane.dist = plane.dist;
+			g_Trace.ent = 0;
+		}
+	}
+
+	g_Trace.endpos = vecStart + (vecEnd - vecStart) * g_Trace.fraction;
+	return &g_Trace;
+}
+
+static int Test_PM_PointContents(float* pPoint, int* pTrueContents)
+{
+	Vector vecPoint(pPoint[0], pPoint[1], pPoint[2]);
+	int iContents = CONTENTS_EMPTY;
+
+	if (vecPoint.x < 0 && vecPoint.z < TEST_WATER_LEVEL)
+		iContents = CONTENTS_WATER;
+
+	for (int i = 0; i < (int)TEST_NUM_PLANES; i++)
+	{
+		if (DotProduct(vecPoint, g_ScenePlanes[i].normal) < g_ScenePlanes[i].dist)
+			iContents = CONTENTS_SOLID;
+	}
+
+	if (pTrueContents)
+		*pTrueContents = iContents;
+	return iContents;
+}
+
+// the scripts are loose files, named on the command line
+static byte* Test_COM_LoadFile(const char* pszPath, int iUseHunk, int* pLength)
+{
+	FILE* pFile = fopen(pszPath, "rb");
+	if (!pFile)
+		return NULL;
+
+	fseek(pFile, 0, SEEK_END);
+	int iLength = ftell(pFile);
+	fseek(pFile, 0, SEEK_SET);
+
+	byte* pBuffer = new byte[iLength + 1];
+	iLength = fread(pBuffer, 1, iLength, pFile);
+	pBuffer[iLength] = 0;
+	fclose(pFile);
+
+	if (pLength)
+		*pLength = iLength;
+	return pBuffer;
+}
+
+static void Test_COM_FreeFile(void* pBuffer)
+{
+	delete[](byte*) pBuffer;
+}
+
+// tokenises the same way as the engine
+static char* Test_COM_ParseFile(const char* pData, char* pszToken)
+{
+	int c;
+	int len = 0;
+
+	pszToken[0] = 0;
+
+	if (!pData)
+		return NULL;
+
+skipwhite:
+	while ((c = (unsigned char)*pData) <= ' ')
+	{
+		if (c == 0)
+			return NULL;
+		pData++;
+	}
+
+	if (c == '/' && pData[1] == '/')
+	{
+		while ('\0' != *pData && *pData != '\n')
+			pData++;
+		goto skipwhite;
+	}
+
+	if (c == '\"')
+	{
+		pData++;
+		while (true)
+		{
+			c = *pData++;
+			if (c == '\"' || '\0' == c)
+			{
+				pszToken[len] = 0;
+				return (char*)pData;
+			}
+			pszToken[len++] = c;
+		}
+	}
+
+	if (c == '{' || c == '}' || c == ')' || c == '(' || c == '\'' || c == ',')
+	{
+		pszToken[len++] = c;
+		pszToken[len] = 0;
+		return (char*)pData + 1;
+	}
+
+	do
+	{
+		pszToken[len++] = c;
+		pData++;
+		c = (unsigned char)*pData;
+		if (c == '{' || c == '}' || c == ')' || c == '(' || c == '\'' || c == ',')
+			break;
+	} while (c > 32);
+
+	pszToken[len] = 0;
+	return (char*)pData;
+}
+
+// no loose file paths, so the scripts are never reloaded during a run
+static int Test_COM_ExpandFilename(const char* pszName, char* pszOut, int iOutSize)
+{
+	return 0;
+}
+
+static void InitEngine()
+{
+	g_TriAPI.version = TRI_API_VERSION;
+	g_TriAPI.RenderMode = Tri_RenderMode;
+	g_TriAPI.Begin = Tri_Begin;
+	g_TriAPI.End = Tri_End;
+	g_TriAPI.Color4f = Tri_Color4f;
+	g_TriAPI.TexCoord2f = Tri_TexCoord2f;
+	g_TriAPI.Vertex3fv = Tri_Vertex3fv;
+	g_TriAPI.SpriteTexture = Tri_SpriteTexture;
+	g_TriAPI.GetMatrix = Tri_GetMatrix;
+
+	gEngfuncs.pTriAPI = &g_TriAPI;
+	gEngfuncs.pfnRegisterVariable = Test_RegisterVariable;
+	gEngfuncs.Con_Printf = Test_Con_Printf;
+	gEngfuncs.Con_DPrintf = Test_Con_Printf;
+	gEngfuncs.Con_NPrintf = Test_Con_NPrintf;
+	gEngfuncs.GetEntityByIndex = Test_GetEntityByIndex;
+	gEngfuncs.GetLocalPlayer = Test_GetLocalPlayer;
+	gEngfuncs.GetViewAngles = Test_GetViewAngles;
+	gEngfuncs.pfnAngleVectors = Test_AngleVectors;
+	gEngfuncs.PM_TraceLine = Test_PM_TraceLine;
+	gEngfuncs.PM_PointContents = Test_PM_PointContents;
+	gEngfuncs.pfnSPR_Load = Test_SPR_Load;
+	gEngfuncs.GetSpritePointer = Test_GetSpritePointer;
+	gEngfuncs.COM_LoadFile = Test_COM_LoadFile;
+	gEngfuncs.COM_FreeFile = Test_COM_FreeFile;
+	gEngfuncs.COM_ParseFile = Test_COM_ParseFile;
+	gEngfuncs.COM_ExpandFilename = Test_COM_ExpandFilename;
+
+	for (int i = 0; i < TEST_NUM_ENTITIES; i++)
+		g_Entities[i].index = i;
+
+	v_origin = Vector(-384, 0, 128);
+	g_Entities[TEST_ENTITY_PLAYER].curstate.origin = v_origin;
+}
+
+//============================================
+// running a script
+
+struct test_options
+{
+	float fSeconds;
+	int iFPS;
+	int iThreads;
+	int iSeed;
+	const char* pszGoldenDir;
+	bool bUpdate;
+};
+
+static void AppendF(std::string& str, const char* pszFormat, ...)
+{
+	char szLine[512];
+	va_list args;
+	va_start(args, pszFormat);
+	vsnprintf(szLine, sizeof(szLine), pszFormat, args);
+	va_end(args);
+	str += szLine;
+}
+
+// what's left at the end of a run, in the golden file format
+static void DescribeState(std::string& str, const char* pszScript, const test_options& options, ParticleSystem* pSystem)
+{
+	AppendF(str, "// %s after %g seconds at %d fps, seed %d\n", pszScript, options.fSeconds, options.iFPS, options.iSeed);
+
+	AppendF(str, "draws %d\n", (int)g_Draws.size());
+	for (int i = 0; i < (int)g_Draws.size(); i++)
+	{
+		const draw_record& draw = g_Draws[i];
+		AppendF(str, "draw %d %s %d %d\n", draw.iRenderMode, g_Sprites[draw.iSprite].name, draw.iFrame, draw.iVertices / 4);
+	}
+
+	if (!pSystem)
+	{
+		AppendF(str, "particles 0\n");
+		return;
+	}
+
+	const particle_arrays& p = pSystem->m_Particles;
+	AppendF(str, "particles %d\n", pSystem->m_iNumParticles);
+	for (int i = 0; i < pSystem->m_iNumParticles; i++)
+	{
+		AppendF(str, "%s %d %.2f %.2f %.2f %.2f %.2f %.2f %.3f %.2f %.3f\n",
+			p.type[i]->m_szName, p.parent[i],
+			p.origin[0][i], p.origin[1][i], p.origin[2][i],
+			p.velocity[0][i], p.velocity[1][i], p.velocity[2][i],
+			p.age[i], p.size[i], p.alpha[i]);
+	}
+}
+
+static void SplitLines(const std::string& str, std::vector<std::string>& lines)
+{
+	size_t iStart = 0;
+	while (iStart < str.size())
+	{
+		size_t iEnd = str.find('\n', iStart);
+		if (iEnd == std::string::npos)
+			iEnd = str.size();
+		std::string line = str.substr(iStart, iEnd - iStart);
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		lines.push_back(line);
+		iStart = iEnd + 1;
+	}
+}
+
+// numbers can be a little out, as compilers don't all round the same way; anything else has to match
+static bool TokensMatch(const char* pszA, const char* pszB)
+{
+	char* pEndA;
+	char* pEndB;
+	double a = strtod(pszA, &pEndA);
+	double b = strtod(pszB, &pEndB);
+
+	if (pEndA == pszA || *pEndA || pEndB == pszB || *pEndB)
+		return !strcmp(pszA, pszB);
+
+	return fabs(a - b) <= 0.02 + 0.001 * fabs(b);
+}
+
+static bool LinesMatch(const std::string& a, const std::string& b)
+{
+	char szA[512], szB[512];
+	strncpy(szA, a.c_str(), sizeof(szA) - 1);
+	szA[sizeof(szA) - 1] = 0;
+	strncpy(szB, b.c_str(), sizeof(szB) - 1);
+	szB[sizeof(szB) - 1] = 0;
+
+	char* pSaveA;
+	char* pSaveB;
+	char* pszA = strtok_r(szA, " \t", &pSaveA);
+	char* pszB = strtok_r(szB, " \t", &pSaveB);
+	while (pszA && pszB)
+	{
+		if (!TokensMatch(pszA, pszB))
+			return false;
+		pszA = strtok_r(NULL, " \t", &pSaveA);
+		pszB = strtok_r(NULL, " \t", &pSaveB);
+	}
+	return !pszA && !pszB;
+}
+
+static bool CheckGolden(const char* pszPath, const std::string& state)
+{
+	int iLength;
+	byte* pGolden = Test_COM_LoadFile(pszPath, 0, &iLength);
+	if (!pGolden)
+	{
+		printf("  FAILED: no golden file %s (run with -update to make one)\n", pszPath);
+		return false;
+	}
+
+	std::vector<std::string> expected, actual;
+	SplitLines(std::string((char*)pGolden, iLength), expected);
+	SplitLines(state, actual);
+	Test_COM_FreeFile(pGolden);
+
+	for (int i = 0; i < (int)V_max(expected.size(), actual.size()); i++)
+	{
+		const std::string& a = i < (int)actual.size() ? actual[i] : std::string("(end of file)");
+		const std::string& b = i < (int)expected.size() ? expected[i] : std::string("(end of file)");
+		if (!LinesMatch(a, b))
+		{
+			printf("  FAILED: differs from %s at line %d\n    expected: %s\n    got:      %s\n", pszPath, i + 1, b.c_str(), a.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool RunScript(const char* pszPath, const test_options& options)
+{
+	const char* pszScript = strrchr(pszPath, '/');
+	pszScript = pszScript ? pszScript + 1 : pszPath;
+
+	ParticleSystemManager* pManager = new ParticleSystemManager;
+	SetCvar("cl_particle_cull", 0); // the stand-in matrices don't describe a real view
+	SetCvar("cl_particle_threads", options.iThreads);
+	SetCvar("cl_particle_seed", options.iSeed);
+
+	g_iTraces = 0;
+	g_iDrawErrors = 0;
+	MoveEmitter(0);
+	pManager->AddSystem(new ParticleSystem(TEST_ENTITY_EMITTER, (char*)pszPath));
+
+	const int iFrames = (int)(options.fSeconds * options.iFPS);
+	const float fFrametime = 1.0f / options.iFPS;
+	double fParticleFrames = 0;
+	int iDrawCalls = 0;
+	int iQuads = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int iFrame = 0; iFrame < iFrames; iFrame++)
+	{
+		MoveEmitter(iFrame / (float)iFrames);
+		for (int i = 0; i < TEST_NUM_ENTITIES; i++)
+			g_Entities[i].curstate.messagenum = iFrame + 1;
+
+		g_Draws.clear();
+		pManager->UpdateSystems(fFrametime, TEST_FOV, TEST_SCREEN_WIDTH);
+
+		ParticleSystem* pSystem = pManager->FindSystem(&g_Entities[TEST_ENTITY_EMITTER]);
+		if (pSystem)
+			fParticleFrames += pSystem->m_iNumParticles;
+		iDrawCalls += ParticleSystem::c_iDrawCalls;
+		iQuads += ParticleSystem::c_iQuadsDrawn;
+	}
+	double fElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	ParticleSystem* pSystem = pManager->FindSystem(&g_Entities[TEST_ENTITY_EMITTER]);
+	printf("%s: %d frames, %d particles at the end (%.0f on average)\n", pszScript, iFrames, pSystem ? pSystem->m_iNumParticles : 0, fParticleFrames / V_max(iFrames, 1));
+	printf("  %.2fM particle updates/sec, %.1f draw calls and %.0f quads a frame, %.1f traces a frame\n",
+		fParticleFrames / V_max(fElapsed, 1e-9) / 1e6, iDrawCalls / (float)V_max(iFrames, 1), iQuads / (float)V_max(iFrames, 1), g_iTraces / (float)V_max(iFrames, 1));
+
+	std::string state;
+	DescribeState(state, pszScript, options, pSystem);
+
+	bool bPassed = g_iDrawErrors == 0;
+	if (options.pszGoldenDir)
+	{
+		std::string golden = std::string(options.pszGoldenDir) + "/" + pszScript;
+		if (options.bUpdate)
+		{
+			FILE* pFile = fopen(golden.c_str(), "wb");
+			if (!pFile || fwrite(state.c_str(), 1, state.size(), pFile) != state.size())
+			{
+				printf("  FAILED: couldn't write %s\n", golden.c_str());
+				bPassed = false;
+			}
+			if (pFile)
+				fclose(pFile);
+		}
+		else if (!CheckGolden(golden.c_str(), state))
+			bPassed = false;
+	}
+
+	delete pManager;
+	ParticleTemplate::ClearAll();
+
+	return bPassed;
+}
+
+int main(int argc, char** argv)
+{
+	test_options options;
+	options.fSeconds = 10;
+	options.iFPS = 60;
+	options.iThreads = 0;
+	options.iSeed = 0;
+	options.pszGoldenDir = NULL;
+	options.bUpdate = false;
+
+	std::vector<const char*> scripts;
+	bool bUsage = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-seconds") && i + 1 < argc)
+			options.fSeconds = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-fps") && i + 1 < argc)
+			options.iFPS = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+			options.iThreads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-seed") && i + 1 < argc)
+			options.iSeed = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-golden") && i + 1 < argc)
+			options.pszGoldenDir = argv[++i];
+		else if (!strcmp(argv[i], "-update"))
+			options.bUpdate = true;
+		else if (argv[i][0] == '-')
+			bUsage = true;
+		else
+			scripts.push_back(argv[i]);
+	}
+
+	if (bUsage || scripts.empty() || options.iFPS < 1)
+	{
+		printf("usage: particle_test [-seconds n] [-fps n] [-threads n] [-seed n] [-golden dir] [-update] script...\n");
+		return 2;
+	}
+
+	InitEngine();
+
+	int iFailed = 0;
+	for (int i = 0; i < (int)scripts.size(); i++)
+	{
+		if (!RunScript(scripts[i], options))
+			iFailed++;
+	}
+
+	if (iFailed)
+		printf("%d of %d particle scripts FAILED\n", iFailed, (int)scripts.size());
+	else
+		printf("all %d particle scripts passed\n", (int)scripts.size());
+
+	return iFailed ? 1 : 0;
+}
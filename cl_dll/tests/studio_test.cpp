@@ -0,0 +1,299 @@
+// Checks the whole-skeleton bone maths in studio_util.cpp against the one-bone-at-a-time versions
+//
+// QuaternionSlerpBones, QuaternionMatrixBones and ConcatTransformsSIMD do four bones (or a row) at once
+// where SSE2 is available, and fall back to QuaternionSlerp, QuaternionMatrix and ConcatTransforms for
+// whatever's left over. This runs random skeletons through both, including the awkward cases (the same
+// quaternion twice, one pointing backwards, bone counts that aren't a multiple of four), fails if they
+// differ by more than rounding, and times the two the way StudioSetupBones uses them.
+//
+//	studio_test [-skeletons n] [-seed n]
+//
+// "make tests" in linux/ builds and runs it. The tests are built for SSE, so it's the SSE2 paths that
+// get checked.
+#include "hud.h"
+#include "cl_util.h"
+#include "const.h"
+#include "com_model.h"
+#include "studio.h"
+#include "studio_util.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+cl_enginefunc_t gEngfuncs;
+
+#define TEST_MAX_BONES MAXSTUDIOBONES
+
+// how far apart the two can be; the SSE2 paths round differently, but no more than that. (Slerping
+// between two nearly opposite quaternions divides by a small sine, so that's the loosest.)
+#define TEST_QUATERNION_EPSILON 1e-5f
+#define TEST_MATRIX_EPSILON 1e-6f
+#define TEST_CONCAT_EPSILON 1e-5f // relative to the size of the value
+
+static vec4_t g_Q1[TEST_MAX_BONES];
+static vec4_t g_Q2[TEST_MAX_BONES];
+static float g_Pos1[TEST_MAX_BONES][3];
+static float g_Pos2[TEST_MAX_BONES][3];
+static float g_Matrices[TEST_MAX_BONES][3][4];
+static float g_BoneTransform[TEST_MAX_BONES][3][4];
+
+static float RandomFloat(float fLow, float fHigh)
+{
+	return fLow + (fHigh - fLow) * (rand() / (float)RAND_MAX);
+}
+
+static void RandomQuaternion(vec4_t q)
+{
+	float fLength = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		q[i] = RandomFloat(-1, 1);
+		fLength += q[i] * q[i];
+	}
+
+	fLength = sqrt(fLength);
+	if (fLength < 0.001f)
+	{
+		q[0] = q[1] = q[2] = 0;
+		q[3] = 1;
+		return;
+	}
+
+	for (int i = 0; i < 4; i++)
+		q[i] /= fLength;
+}
+
+// one skeleton to blend from, one to blend to, with a few bones that make QuaternionSlerp take its other branches
+static void RandomSkeletons(int iNumBones)
+{
+	for (int i = 0; i < iNumBones; i++)
+	{
+		RandomQuaternion(g_Q1[i]);
+
+		switch (rand() % 8)
+		{
+		case 0: // the same way round; the plain lerp
+			memcpy(g_Q2[i], g_Q1[i], sizeof(vec4_t));
+			g_Q2[i][0] += 1e-4f;
+			break;
+		case 1: // backwards, so it gets flipped
+			for (int j = 0; j < 4; j++)
+				g_Q2[i][j] = -g_Q1[i][j];
+			break;
+		default:
+			RandomQuaternion(g_Q2[i]);
+			break;
+		}
+
+		for (int j = 0; j < 3; j++)
+		{
+			g_Pos1[i][j] = RandomFloat(-64, 64);
+			g_Pos2[i][j] = RandomFloat(-64, 64);
+		}
+	}
+}
+
+static float MaxDifference(const float* a, const float* b, int iCount, bool bRelative)
+{
+	float fMax = 0;
+	for (int i = 0; i < iCount; i++)
+	{
+		float fDiff = fabs(a[i] - b[i]);
+		if (bRelative)
+			fDiff /= 1 + fabs(a[i]);
+		if (fDiff > fMax)
+			fMax = fDiff;
+	}
+	return fMax;
+}
+
+//============================================
+// the checks
+
+struct test_results
+{
+	float fSlerp;
+	float fMatrix;
+	float fConcat;
+};
+
+static void CheckSkeleton(int iNumBones, float t, test_results& results)
+{
+	static vec4_t q1[TEST_MAX_BONES], q2[TEST_MAX_BONES];
+	static float pos1[TEST_MAX_BONES][3];
+	static vec4_t q3;
+	static float matrices[TEST_MAX_BONES][3][4];
+	static float out1[3][4], out2[3][4];
+
+	RandomSkeletons(iNumBones);
+
+	// a bone at a time; QuaternionSlerp can flip q2, so each side gets its own copy
+	memcpy(q1, g_Q1, sizeof(vec4_t) * iNumBones);
+	memcpy(q2, g_Q2, sizeof(vec4_t) * iNumBones);
+	memcpy(pos1, g_Pos1, sizeof(float) * 3 * iNumBones);
+	for (int i = 0; i < iNumBones; i++)
+	{
+		QuaternionSlerp(q1[i], q2[i], t, q3);
+		memcpy(q1[i], q3, sizeof(vec4_t));
+		for (int j = 0; j < 3; j++)
+			pos1[i][j] = pos1[i][j] * (1.0 - t) + g_Pos2[i][j] * t;
+	}
+
+	// the whole skeleton
+	QuaternionSlerpBones(g_Q1, g_Pos1, g_Q2, g_Pos2, t, iNumBones);
+
+	results.fSlerp = V_max(results.fSlerp, MaxDifference(q1[0], g_Q1[0], 4 * iNumBones, false));
+	results.fSlerp = V_max(results.fSlerp, MaxDifference(pos1[0], g_Pos1[0], 3 * iNumBones, true));
+
+	// both from the same blended skeleton, so only the matrix maths is being compared
+	for (int i = 0; i < iNumBones; i++)
+	{
+		QuaternionMatrix(g_Q1[i], matrices[i]);
+		matrices[i][0][3] = g_Pos1[i][0];
+		matrices[i][1][3] = g_Pos1[i][1];
+		matrices[i][2][3] = g_Pos1[i][2];
+	}
+	QuaternionMatrixBones(g_Q1, g_Pos1, g_Matrices, iNumBones);
+
+	results.fMatrix = V_max(results.fMatrix, MaxDifference(matrices[0][0], g_Matrices[0][0], 12 * iNumBones, false));
+
+	for (int i = 1; i < iNumBones; i++)
+	{
+		ConcatTransforms(g_Matrices[i - 1], g_Matrices[i], out1);
+		ConcatTransformsSIMD(g_Matrices[i - 1], g_Matrices[i], out2);
+		results.fConcat = V_max(results.fConcat, MaxDifference(out1[0], out2[0], 12, true));
+	}
+}
+
+//============================================
+// the benchmark
+
+// blends two sequences and builds the bone transforms, like StudioSetupBones does for each model
+static double TimeSetupBones(bool bBatch, int iNumBones, int iModels, int iFrames)
+{
+	static vec4_t q3;
+	double fSink = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int iFrame = 0; iFrame < iFrames; iFrame++)
+	{
+		for (int iModel = 0; iModel < iModels; iModel++)
+		{
+			const float t = 0.3f + iModel * 0.001f;
+
+			if (bBatch)
+			{
+				QuaternionSlerpBones(g_Q1, g_Pos1, g_Q2, g_Pos2, t, iNumBones);
+				QuaternionMatrixBones(g_Q1, g_Pos1, g_Matrices, iNumBones);
+			}
+			else
+			{
+				for (int i = 0; i < iNumBones; i++)
+				{
+					QuaternionSlerp(g_Q1[i], g_Q2[i], t, q3);
+					memcpy(g_Q1[i], q3, sizeof(vec4_t));
+					for (int j = 0; j < 3; j++)
+						g_Pos1[i][j] = g_Pos1[i][j] * (1.0 - t) + g_Pos2[i][j] * t;
+
+					QuaternionMatrix(g_Q1[i], g_Matrices[i]);
+					g_Matrices[i][0][3] = g_Pos1[i][0];
+					g_Matrices[i][1][3] = g_Pos1[i][1];
+					g_Matrices[i][2][3] = g_Pos1[i][2];
+				}
+			}
+
+			// each bone's parent is earlier in the list
+			memcpy(g_BoneTransform[0], g_Matrices[0], sizeof(g_BoneTransform[0]));
+			for (int i = 1; i < iNumBones; i++)
+			{
+				if (bBatch)
+					ConcatTransformsSIMD(g_BoneTransform[(i - 1) / 2], g_Matrices[i], g_BoneTransform[i]);
+				else
+					ConcatTransforms(g_BoneTransform[(i - 1) / 2], g_Matrices[i], g_BoneTransform[i]);
+			}
+
+			fSink += g_BoneTransform[iNumBones - 1][0][3];
+		}
+	}
+
+	double fElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// so the optimiser can't throw the work away
+	if (fSink == 12345.678)
+		printf(" ");
+
+	return fElapsed;
+}
+
+int main(int argc, char** argv)
+{
+	int iSkeletons = 2000;
+	int iSeed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (0 == strcmp(argv[i], "-skeletons") && i + 1 < argc)
+			iSkeletons = atoi(argv[++i]);
+		else if (0 == strcmp(argv[i], "-seed") && i + 1 < argc)
+			iSeed = atoi(argv[++i]);
+		else
+		{
+			iSkeletons = 0;
+			break;
+		}
+	}
+
+	if (iSkeletons < 1)
+	{
+		printf("usage: studio_test [-skeletons n] [-seed n]\n");
+		return 1;
+	}
+
+	srand(iSeed);
+
+	test_results results = {0, 0, 0};
+	for (int i = 0; i < iSkeletons; i++)
+	{
+		// 1 to 3 bones only ever take the scalar path
+		int iNumBones = 1 + rand() % TEST_MAX_BONES;
+		CheckSkeleton(iNumBones, RandomFloat(0, 1), results);
+	}
+
+	printf("%d skeletons: largest difference %g in QuaternionSlerpBones, %g in QuaternionMatrixBones, %g in ConcatTransformsSIMD\n",
+		iSkeletons, results.fSlerp, results.fMatrix, results.fConcat);
+
+	const int iNumBones = TEST_MAX_BONES;
+	const int iModels = 64;
+	const int iFrames = 100;
+	RandomSkeletons(iNumBones);
+	double fScalar = TimeSetupBones(false, iNumBones, iModels, iFrames);
+	double fBatch = TimeSetupBones(true, iNumBones, iModels, iFrames);
+	printf("  %d models of %d bones: %.3f ms a frame a bone at a time, %.3f ms a frame batched\n",
+		iModels, iNumBones, fScalar * 1000 / iFrames, fBatch * 1000 / iFrames);
+
+	bool bPassed = true;
+	if (results.fSlerp > TEST_QUATERNION_EPSILON)
+	{
+		printf("  FAILED: QuaternionSlerpBones differs from QuaternionSlerp by more than %g\n", TEST_QUATERNION_EPSILON);
+		bPassed = false;
+	}
+	if (results.fMatrix > TEST_MATRIX_EPSILON)
+	{
+		printf("  FAILED: QuaternionMatrixBones differs from QuaternionMatrix by more than %g\n", TEST_MATRIX_EPSILON);
+		bPassed = false;
+	}
+	if (results.fConcat > TEST_CONCAT_EPSILON)
+	{
+		printf("  FAILED: ConcatTransformsSIMD differs from ConcatTransforms by more than %g\n", TEST_CONCAT_EPSILON);
+		bPassed = false;
+	}
+
+	if (bPassed)
+		printf("bone maths passed\n");
+
+	return bPassed ? 0 : 1;
+}
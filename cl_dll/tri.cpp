@@ -17,6 +17,8 @@
 #include "cl_entity.h"
 #include "triangleapi.h"
 #include "particlemgr.h"
+#include "weather.h"
+#include "profiler.h"
 #include "Exports.h"
 
 #include "particleman.h"
@@ -162,6 +164,8 @@ extern ParticleSystemManager* g_pParticleSystems; // LRC
 
 void DLLEXPORT HUD_DrawTransparentTriangles()
 {
+	PROFILE_SCOPE(PROF_TRANS_TRIANGLES);
+
 	if (g_pParticleMan)
 		g_pParticleMan->Update();
 
@@ -177,5 +181,9 @@ void DLLEXPORT HUD_DrawTransparentTriangles()
 	fTime = gEngfuncs.GetClientTime();
 
 	// LRC: draw and update particle systems
-	g_pParticleSystems->UpdateSystems(fTime - fOldTime);
+	g_pParticleSystems->UpdateSystems(fTime - fOldTime, gHUD.m_iFOV, ScreenWidth);
+
+	// env_rain/env_snow
+	PROFILE_SCOPE(PROF_WEATHER);
+	g_Weather.UpdateAndDraw(fTime - fOldTime);
 }
@@ -231,6 +231,10 @@ ScorePanel::ScorePanel(int x, int y, int wide, int tall) : Panel(x, y, wide, tal
 	m_pCloseButton->setBoundKey((char)255);
 	m_pCloseButton->setContentAlignment(Label::a_center);
 
+	// nothing's been put in the rows yet
+	for (int row = 0; row < NUM_ROWS; row++)
+		m_iRowStyle[row] = -2;
+	m_szTitle[0] = '\0';
 
 	Initialize();
 }
@@ -246,6 +250,8 @@ void ScorePanel::Initialize()
 	m_fLastKillTime = 0;
 	m_iPlayerNum = 0;
 	m_iNumTeams = 0;
+	m_iNumPlayerOrder = 0;
+	m_iNumTeamOrder = 0;
 	memset(g_PlayerExtraInfo, 0, sizeof g_PlayerExtraInfo);
 	memset(g_TeamInfo, 0, sizeof g_TeamInfo);
 }
@@ -263,11 +269,10 @@ void ScorePanel::Update()
 	int i;
 
 	// Set the title
-	if (gViewPort->m_szServerName)
+	if (gViewPort->m_szServerName && 0 != strcmp(m_szTitle, gViewPort->m_szServerName))
 	{
-		char sz[MAX_SERVERNAME_LENGTH + 16];
-		sprintf(sz, "%s", gViewPort->m_szServerName);
-		m_TitleLabel.setText(sz);
+		strcpy(m_szTitle, gViewPort->m_szServerName);
+		m_TitleLabel.setText(m_szTitle);
 	}
 
 	m_iRows = 0;
@@ -284,6 +289,8 @@ void ScorePanel::Update()
 		m_bHasBeenSorted[i] = false;
 	}
 
+	UpdatePlayerOrder();
+
 	// If it's not teamplay, sort all the players. Otherwise, sort the teams.
 	if (!gHUD.m_Teamplay)
 		SortPlayers(0, NULL);
@@ -293,7 +300,9 @@ void ScorePanel::Update()
 	// set scrollbar range
 	m_PlayerList.SetScrollRange(m_iRows);
 
-	FillGrid();
+	// score messages keep coming while the board is hidden; the labels can wait until it's opened
+	if (isVisible())
+		FillGrid();
 
 	if (gViewPort->m_pSpectatorPanel->m_menuVisible)
 	{
@@ -368,37 +377,17 @@ void ScorePanel::SortTeams()
 		}
 	}
 
+	UpdateTeamOrder();
+
 	// Draw the teams
-	while (true)
+	for (i = 0; i < m_iNumTeamOrder; i++)
 	{
-		int highest_frags = -99999;
-		int lowest_deaths = 99999;
-		int best_team = 0;
-
-		for (i = 1; i <= m_iNumTeams; i++)
-		{
-			if (g_TeamInfo[i].players < 1)
-				continue;
-
-			if (!g_TeamInfo[i].already_drawn && g_TeamInfo[i].frags >= highest_frags)
-			{
-				if (g_TeamInfo[i].frags > highest_frags || g_TeamInfo[i].deaths < lowest_deaths)
-				{
-					best_team = i;
-					lowest_deaths = g_TeamInfo[i].deaths;
-					highest_frags = g_TeamInfo[i].frags;
-				}
-			}
-		}
-
-		// draw the best team on the scoreboard
-		if (0 == best_team)
-			break;
+		int best_team = m_iTeamOrder[i];
 
 		// Put this team in the sorted list
 		m_iSortedRows[m_iRows] = best_team;
 		m_iIsATeam[m_iRows] = TEAM_YES;
-		g_TeamInfo[best_team].already_drawn = true; // set the already_drawn to be true, so this team won't get sorted again
+		g_TeamInfo[best_team].already_drawn = true;
 		m_iRows++;
 
 		// Now sort all the players on this team
@@ -417,35 +406,12 @@ void ScorePanel::SortPlayers(int iTeam, char* team)
 	bool bCreatedTeam = false;
 
 	// draw the players, in order,  and restricted to team if set
-	while (true)
+	for (int i = 0; i < m_iNumPlayerOrder; i++)
 	{
-		// Find the top ranking player
-		int highest_frags = -99999;
-		int lowest_deaths = 99999;
-		int best_player;
-		best_player = 0;
+		int best_player = m_iPlayerOrder[i];
 
-		for (int i = 1; i < MAX_PLAYERS_HUD; i++)
-		{
-			if (m_bHasBeenSorted[i] == false && g_PlayerInfoList[i].name && g_PlayerExtraInfo[i].frags >= highest_frags)
-			{
-				cl_entity_t* ent = gEngfuncs.GetEntityByIndex(i);
-
-				if (ent && !(team && stricmp(g_PlayerExtraInfo[i].teamname, team)))
-				{
-					extra_player_info_t* pl_info = &g_PlayerExtraInfo[i];
-					if (pl_info->frags > highest_frags || pl_info->deaths < lowest_deaths)
-					{
-						best_player = i;
-						lowest_deaths = pl_info->deaths;
-						highest_frags = pl_info->frags;
-					}
-				}
-			}
-		}
-
-		if (0 == best_player)
-			break;
+		if (m_bHasBeenSorted[best_player] || (team && stricmp(g_PlayerExtraInfo[best_player].teamname, team)))
+			continue;
 
 		// If we haven't created the Team yet, do it first
 		if (!bCreatedTeam && 0 != iTeam)
@@ -468,6 +434,100 @@ void ScorePanel::SortPlayers(int iTeam, char* team)
 	}
 }
 
+// Higher score first, then fewer deaths, then lower index
+static bool PlayerRanksAbove(int a, int b)
+{
+	if (g_PlayerExtraInfo[a].frags != g_PlayerExtraInfo[b].frags)
+		return g_PlayerExtraInfo[a].frags > g_PlayerExtraInfo[b].frags;
+	if (g_PlayerExtraInfo[a].deaths != g_PlayerExtraInfo[b].deaths)
+		return g_PlayerExtraInfo[a].deaths < g_PlayerExtraInfo[b].deaths;
+	return a < b;
+}
+
+static bool TeamRanksAbove(int a, int b)
+{
+	if (g_TeamInfo[a].frags != g_TeamInfo[b].frags)
+		return g_TeamInfo[a].frags > g_TeamInfo[b].frags;
+	if (g_TeamInfo[a].deaths != g_TeamInfo[b].deaths)
+		return g_TeamInfo[a].deaths < g_TeamInfo[b].deaths;
+	return a < b;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Bring the player order up to date with who's connected and their scores.
+//			It's an insertion sort over last update's order, so it's linear when
+//			nothing's changed and only walks as far as a player has to move when
+//			something has.
+//-----------------------------------------------------------------------------
+void ScorePanel::UpdatePlayerOrder()
+{
+	bool bListed[MAX_PLAYERS_HUD];
+	memset(bListed, 0, sizeof(bListed));
+
+	// drop anyone who's left
+	int i, j;
+	for (i = j = 0; i < m_iNumPlayerOrder; i++)
+	{
+		int iPlayer = m_iPlayerOrder[i];
+		if (g_PlayerInfoList[iPlayer].name && gEngfuncs.GetEntityByIndex(iPlayer))
+		{
+			m_iPlayerOrder[j++] = iPlayer;
+			bListed[iPlayer] = true;
+		}
+	}
+	m_iNumPlayerOrder = j;
+
+	// and add anyone who's new
+	for (i = 1; i < MAX_PLAYERS_HUD; i++)
+	{
+		if (!bListed[i] && g_PlayerInfoList[i].name && gEngfuncs.GetEntityByIndex(i))
+			m_iPlayerOrder[m_iNumPlayerOrder++] = i;
+	}
+
+	for (i = 1; i < m_iNumPlayerOrder; i++)
+	{
+		int iPlayer = m_iPlayerOrder[i];
+		for (j = i; j > 0 && PlayerRanksAbove(iPlayer, m_iPlayerOrder[j - 1]); j--)
+			m_iPlayerOrder[j] = m_iPlayerOrder[j - 1];
+		m_iPlayerOrder[j] = iPlayer;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: The same for the teams, once their scores have been totalled
+//-----------------------------------------------------------------------------
+void ScorePanel::UpdateTeamOrder()
+{
+	bool bListed[MAX_TEAMS + 1];
+	memset(bListed, 0, sizeof(bListed));
+
+	int i, j;
+	for (i = j = 0; i < m_iNumTeamOrder; i++)
+	{
+		int iTeam = m_iTeamOrder[i];
+		if (iTeam <= m_iNumTeams && g_TeamInfo[iTeam].players > 0)
+		{
+			m_iTeamOrder[j++] = iTeam;
+			bListed[iTeam] = true;
+		}
+	}
+	m_iNumTeamOrder = j;
+
+	for (i = 1; i <= m_iNumTeams && m_iNumTeamOrder < MAX_TEAMS; i++)
+	{
+		if (!bListed[i] && g_TeamInfo[i].players > 0)
+			m_iTeamOrder[m_iNumTeamOrder++] = i;
+	}
+
+	for (i = 1; i < m_iNumTeamOrder; i++)
+	{
+		int iTeam = m_iTeamOrder[i];
+		for (j = i; j > 0 && TeamRanksAbove(iTeam, m_iTeamOrder[j - 1]); j--)
+			m_iTeamOrder[j] = m_iTeamOrder[j - 1];
+		m_iTeamOrder[j] = iTeam;
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Recalculate the existing teams in the match
 //-----------------------------------------------------------------------------
@@ -531,6 +591,189 @@ void ScorePanel::RebuildTeams()
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Everything about how a row looks apart from its text, packed into an
+//			int so FillGrid can tell when it needs restyling. -1 is a hidden row.
+//-----------------------------------------------------------------------------
+int ScorePanel::GetRowStyle(int row)
+{
+	if (row >= m_iRows)
+		return -1;
+
+	int color = 0;
+	int highlight = 0;
+
+	if (m_iIsATeam[row] == TEAM_YES)
+	{
+		color = g_TeamInfo[m_iSortedRows[row]].teamnumber % iNumberOfTeamColors;
+	}
+	else if (m_iIsATeam[row] == TEAM_NO)
+	{
+		color = g_PlayerExtraInfo[m_iSortedRows[row]].teamnumber % iNumberOfTeamColors;
+
+		if (0 != g_PlayerInfoList[m_iSortedRows[row]].thisplayer)
+			highlight = 1;
+		else if (m_iSortedRows[row] == m_iLastKilledBy && 0 != m_fLastKillTime && m_fLastKillTime > gHUD.m_flTime)
+			highlight = 2 + (int)(255 - ((float)15 * (float)(m_fLastKillTime - gHUD.m_flTime))); // the killer's fade
+	}
+
+	return m_iIsATeam[row] | (color << 4) | (highlight << 12);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Set up a row's labels for the kind of row it now is
+//-----------------------------------------------------------------------------
+void ScorePanel::SetRowStyle(int row, Font* sfont, Font* tfont, Font* smallfont)
+{
+	CGrid* pGridRow = &m_PlayerGrids[row];
+	pGridRow->SetRowUnderline(0, false, 0, 0, 0, 0, 0);
+
+	if (row >= m_iRows)
+	{
+		for (int col = 0; col < NUM_COLUMNS; col++)
+			m_PlayerEntries[col][row].setVisible(false);
+
+		return;
+	}
+
+	for (int col = 0; col < NUM_COLUMNS; col++)
+	{
+		CLabelHeader* pLabel = &m_PlayerEntries[col][row];
+
+		pLabel->setVisible(true);
+		pLabel->setImage(NULL);
+		pLabel->setFont(sfont);
+		pLabel->setTextOffset(0, 0);
+
+		int rowheight = 13;
+		if (ScreenHeight > 480)
+		{
+			rowheight = YRES(rowheight);
+		}
+		else
+		{
+			// more tweaking, make sure icons fit at low res
+			rowheight = 15;
+		}
+		pLabel->setSize(pLabel->getWide(), rowheight);
+		pLabel->setBgColor(0, 0, 0, 255);
+
+		if (m_iIsATeam[row] == TEAM_BLANK)
+		{
+			continue;
+		}
+		else if (m_iIsATeam[row] == TEAM_YES)
+		{
+			team_info_t* team_info = &g_TeamInfo[m_iSortedRows[row]];
+
+			// team color text for team names
+			pLabel->setFgColor(iTeamColors[team_info->teamnumber % iNumberOfTeamColors][0],
+				iTeamColors[team_info->teamnumber % iNumberOfTeamColors][1],
+				iTeamColors[team_info->teamnumber % iNumberOfTeamColors][2],
+				0);
+
+			// different height for team header rows
+			rowheight = 20;
+			if (ScreenHeight >= 480)
+			{
+				rowheight = YRES(rowheight);
+			}
+			pLabel->setSize(pLabel->getWide(), rowheight);
+			pLabel->setFont(tfont);
+			pLabel->setFont2(smallfont);
+
+			pGridRow->SetRowUnderline(0,
+				true,
+				YRES(3),
+				iTeamColors[team_info->teamnumber % iNumberOfTeamColors][0],
+				iTeamColors[team_info->teamnumber % iNumberOfTeamColors][1],
+				iTeamColors[team_info->teamnumber % iNumberOfTeamColors][2],
+				0);
+		}
+		else if (m_iIsATeam[row] == TEAM_SPECTATORS)
+		{
+			// grey text for spectators
+			pLabel->setFgColor(100, 100, 100, 0);
+
+			// different height for team header rows
+			rowheight = 20;
+			if (ScreenHeight >= 480)
+			{
+				rowheight = YRES(rowheight);
+			}
+			pLabel->setSize(pLabel->getWide(), rowheight);
+			pLabel->setFont(tfont);
+
+			pGridRow->SetRowUnderline(0, true, YRES(3), 100, 100, 100, 0);
+		}
+		else
+		{
+			// team color text for player names
+			pLabel->setFgColor(iTeamColors[g_PlayerExtraInfo[m_iSortedRows[row]].teamnumber % iNumberOfTeamColors][0],
+				iTeamColors[g_PlayerExtraInfo[m_iSortedRows[row]].teamnumber % iNumberOfTeamColors][1],
+				iTeamColors[g_PlayerExtraInfo[m_iSortedRows[row]].teamnumber % iNumberOfTeamColors][2],
+				0);
+
+			// Set background color
+			if (0 != g_PlayerInfoList[m_iSortedRows[row]].thisplayer) // if it is their name, draw it a different color
+			{
+				// Highlight this player
+				pLabel->setFgColor(Scheme::sc_white);
+				pLabel->setBgColor(iTeamColors[g_PlayerExtraInfo[m_iSortedRows[row]].teamnumber % iNumberOfTeamColors][0],
+					iTeamColors[g_PlayerExtraInfo[m_iSortedRows[row]].teamnumber % iNumberOfTeamColors][1],
+					iTeamColors[g_PlayerExtraInfo[m_iSortedRows[row]].teamnumber % iNumberOfTeamColors][2],
+					196);
+			}
+			else if (m_iSortedRows[row] == m_iLastKilledBy && 0 != m_fLastKillTime && m_fLastKillTime > gHUD.m_flTime)
+			{
+				// Killer's name
+				pLabel->setBgColor(255, 0, 0, 255 - ((float)15 * (float)(m_fLastKillTime - gHUD.m_flTime)));
+			}
+		}
+
+		// Align
+		if (col == COLUMN_NAME || col == COLUMN_CLASS)
+		{
+			pLabel->setContentAlignment(vgui::Label::a_west);
+		}
+		else if (col == COLUMN_TRACKER)
+		{
+			pLabel->setContentAlignment(vgui::Label::a_center);
+		}
+		else
+		{
+			pLabel->setContentAlignment(vgui::Label::a_east);
+		}
+	}
+
+	pGridRow->AutoSetRowHeights();
+	pGridRow->setSize(PanelWidth(pGridRow), pGridRow->CalcDrawHeight());
+	pGridRow->RepositionContents();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Give a cell new text, if it's different from what it's showing.
+//			Setting a label's text measures every character, so it's worth avoiding.
+//-----------------------------------------------------------------------------
+void ScorePanel::SetCellText(int row, int col, const char* text, const char* text2, bool force)
+{
+	CLabelHeader* pLabel = &m_PlayerEntries[col][row];
+
+	if (col == COLUMN_NAME && (force || 0 != strcmp(m_szCellText2[row], text2)))
+	{
+		strncpy(m_szCellText2[row], text2, MAX_CELL_TEXT - 1);
+		m_szCellText2[row][MAX_CELL_TEXT - 1] = '\0';
+		pLabel->setText2(text2);
+	}
+
+	if (force || 0 != strcmp(m_szCellText[row][col], text))
+	{
+		strncpy(m_szCellText[row][col], text, MAX_CELL_TEXT - 1);
+		m_szCellText[row][col][MAX_CELL_TEXT - 1] = '\0';
+		pLabel->setText(text);
+	}
+}
+
 void ScorePanel::FillGrid()
 {
 	CSchemeManager* pSchemes = gViewPort->GetSchemeManager();
@@ -553,166 +796,65 @@ void ScorePanel::FillGrid()
 		m_iHighlightRow = -1;
 	}
 
-	bool bNextRowIsGap = false;
-	int row;
-	for (row = 0; row < NUM_ROWS; row++)
+	bool bResized = false;
+	for (int row = 0; row < NUM_ROWS; row++)
 	{
-		CGrid* pGridRow = &m_PlayerGrids[row];
-		pGridRow->SetRowUnderline(0, false, 0, 0, 0, 0, 0);
-
-		if (row >= m_iRows)
+		// only restyle rows that have changed kind, team or highlight
+		int iStyle = GetRowStyle(row);
+		bool bRestyled = iStyle != m_iRowStyle[row];
+		if (bRestyled)
 		{
-			for (int col = 0; col < NUM_COLUMNS; col++)
-				m_PlayerEntries[col][row].setVisible(false);
-
-			continue;
+			SetRowStyle(row, sfont, tfont, smallfont);
+			m_iRowStyle[row] = iStyle;
+			bResized = true;
 		}
 
-		bool bRowIsGap = false;
-		if (bNextRowIsGap)
-		{
-			bNextRowIsGap = false;
-			bRowIsGap = true;
-		}
+		if (row >= m_iRows)
+			continue;
 
 		for (int col = 0; col < NUM_COLUMNS; col++)
 		{
 			CLabelHeader* pLabel = &m_PlayerEntries[col][row];
 
-			pLabel->setVisible(true);
-			pLabel->setText2("");
-			pLabel->setImage(NULL);
-			pLabel->setFont(sfont);
-			pLabel->setTextOffset(0, 0);
-
-			int rowheight = 13;
-			if (ScreenHeight > 480)
-			{
-				rowheight = YRES(rowheight);
-			}
-			else
-			{
-				// more tweaking, make sure icons fit at low res
-				rowheight = 15;
-			}
-			pLabel->setSize(pLabel->getWide(), rowheight);
-			pLabel->setBgColor(0, 0, 0, 255);
-
-			char sz[128];
+			char sz[MAX_CELL_TEXT];
+			char sz2[MAX_CELL_TEXT];
 			hud_player_info_t* pl_info = NULL;
 			team_info_t* team_info = NULL;
 
+			sz[0] = '\0';
+			sz2[0] = '\0';
+
 			if (m_iIsATeam[row] == TEAM_BLANK)
 			{
-				pLabel->setText(" ");
+				SetCellText(row, col, " ", sz2, bRestyled);
 				continue;
 			}
 			else if (m_iIsATeam[row] == TEAM_YES)
 			{
 				// Get the team's data
 				team_info = &g_TeamInfo[m_iSortedRows[row]];
-
-				// team color text for team names
-				pLabel->setFgColor(iTeamColors[team_info->teamnumber % iNumberOfTeamColors][0],
-					iTeamColors[team_info->teamnumber % iNumberOfTeamColors][1],
-					iTeamColors[team_info->teamnumber % iNumberOfTeamColors][2],
-					0);
-
-				// different height for team header rows
-				rowheight = 20;
-				if (ScreenHeight >= 480)
-				{
-					rowheight = YRES(rowheight);
-				}
-				pLabel->setSize(pLabel->getWide(), rowheight);
-				pLabel->setFont(tfont);
-
-				pGridRow->SetRowUnderline(0,
-					true,
-					YRES(3),
-					iTeamColors[team_info->teamnumber % iNumberOfTeamColors][0],
-					iTeamColors[team_info->teamnumber % iNumberOfTeamColors][1],
-					iTeamColors[team_info->teamnumber % iNumberOfTeamColors][2],
-					0);
 			}
-			else if (m_iIsATeam[row] == TEAM_SPECTATORS)
+			else if (m_iIsATeam[row] == TEAM_NO)
 			{
-				// grey text for spectators
-				pLabel->setFgColor(100, 100, 100, 0);
-
-				// different height for team header rows
-				rowheight = 20;
-				if (ScreenHeight >= 480)
-				{
-					rowheight = YRES(rowheight);
-				}
-				pLabel->setSize(pLabel->getWide(), rowheight);
-				pLabel->setFont(tfont);
-
-				pGridRow->SetRowUnderline(0, true, YRES(3), 100, 100, 100, 0);
-			}
-			else
-			{
-				// team color text for player names
-				pLabel->setFgColor(iTeamColors[g_PlayerExtraInfo[m_iSortedRows[row]].teamnumber % iNumberOfTeamColors][0],
-					iTeamColors[g_PlayerExtraInfo[m_iSortedRows[row]].teamnumber % iNumberOfTeamColors][1],
-					iTeamColors[g_PlayerExtraInfo[m_iSortedRows[row]].teamnumber % iNumberOfTeamColors][2],
-					0);
-
 				// Get the player's data
 				pl_info = &g_PlayerInfoList[m_iSortedRows[row]];
-
-				// Set background color
-				if (0 != pl_info->thisplayer) // if it is their name, draw it a different color
-				{
-					// Highlight this player
-					pLabel->setFgColor(Scheme::sc_white);
-					pLabel->setBgColor(iTeamColors[g_PlayerExtraInfo[m_iSortedRows[row]].teamnumber % iNumberOfTeamColors][0],
-						iTeamColors[g_PlayerExtraInfo[m_iSortedRows[row]].teamnumber % iNumberOfTeamColors][1],
-						iTeamColors[g_PlayerExtraInfo[m_iSortedRows[row]].teamnumber % iNumberOfTeamColors][2],
-						196);
-				}
-				else if (m_iSortedRows[row] == m_iLastKilledBy && 0 != m_fLastKillTime && m_fLastKillTime > gHUD.m_flTime)
-				{
-					// Killer's name
-					pLabel->setBgColor(255, 0, 0, 255 - ((float)15 * (float)(m_fLastKillTime - gHUD.m_flTime)));
-				}
-			}
-
-			// Align
-			if (col == COLUMN_NAME || col == COLUMN_CLASS)
-			{
-				pLabel->setContentAlignment(vgui::Label::a_west);
-			}
-			else if (col == COLUMN_TRACKER)
-			{
-				pLabel->setContentAlignment(vgui::Label::a_center);
-			}
-			else
-			{
-				pLabel->setContentAlignment(vgui::Label::a_east);
 			}
 
 			// Fill out with the correct data
-			strcpy(sz, "");
 			if (TEAM_NO != m_iIsATeam[row])
 			{
-				char sz2[128];
-
 				switch (col)
 				{
 				case COLUMN_NAME:
 					if (m_iIsATeam[row] == TEAM_SPECTATORS)
 					{
-						sprintf(sz2, "%s", CHudTextMessage::BufferedLocaliseTextString("#Spectators"));
+						sprintf(sz, "%s", CHudTextMessage::BufferedLocaliseTextString("#Spectators"));
 					}
 					else
 					{
-						sprintf(sz2, "%s", gViewPort->GetTeamName(team_info->teamnumber));
+						sprintf(sz, "%s", gViewPort->GetTeamName(team_info->teamnumber));
 					}
 
-					strcpy(sz, sz2);
-
 					// Append the number of players
 					if (m_iIsATeam[row] == TEAM_YES)
 					{
@@ -724,9 +866,6 @@ void ScorePanel::FillGrid()
 						{
 							sprintf(sz2, "(%d %s)", team_info->players, CHudTextMessage::BufferedLocaliseTextString("#Player_plural"));
 						}
-
-						pLabel->setText2(sz2);
-						pLabel->setFont2(smallfont);
 					}
 					break;
 				case COLUMN_VOICE:
@@ -773,6 +912,7 @@ void ScorePanel::FillGrid()
 					break;
 				case COLUMN_VOICE:
 					sz[0] = 0;
+					// this also tells the voice manager which label the player's in now
 					GetClientVoiceMgr()->UpdateSpeakerImage(pLabel, m_iSortedRows[row]);
 					break;
 				case COLUMN_CLASS:
@@ -835,22 +975,16 @@ void ScorePanel::FillGrid()
 				}
 			}
 
-			pLabel->setText(sz);
+			SetCellText(row, col, sz, sz2, bRestyled);
 		}
 	}
 
-	for (row = 0; row < NUM_ROWS; row++)
+	// hack, for the thing to resize
+	if (bResized)
 	{
-		CGrid* pGridRow = &m_PlayerGrids[row];
-
-		pGridRow->AutoSetRowHeights();
-		pGridRow->setSize(PanelWidth(pGridRow), pGridRow->CalcDrawHeight());
-		pGridRow->RepositionContents();
+		m_PlayerList.getSize(x, y);
+		m_PlayerList.setSize(x, y);
 	}
-
-	// hack, for the thing to resize
-	m_PlayerList.getSize(x, y);
-	m_PlayerList.setSize(x, y);
 }
 
 
@@ -873,9 +1007,10 @@ void ScorePanel::DeathMsg(int killer, int victim)
 
 void ScorePanel::Open()
 {
-	RebuildTeams();
+	// visible first, so the update fills in the rows
 	setVisible(true);
 	m_HitTestPanel.setVisible(true);
+	RebuildTeams();
 }
 
 
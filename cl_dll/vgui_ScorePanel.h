@@ -31,6 +31,7 @@
 #define COLUMN_BLANK 7
 #define NUM_COLUMNS 8
 #define NUM_ROWS (MAX_PLAYERS_HUD + (MAX_SCOREBOARD_TEAMS * 2))
+#define MAX_CELL_TEXT 128
 
 using namespace vgui;
 
@@ -273,6 +274,19 @@ public:
 	int m_iLastKilledBy;
 	int m_fLastKillTime;
 
+	// Everyone on the board last update, best first. Kept between updates so a score
+	// change only has to move one entry along, rather than sorting from scratch.
+	int m_iPlayerOrder[MAX_PLAYERS_HUD];
+	int m_iNumPlayerOrder;
+	int m_iTeamOrder[MAX_TEAMS];
+	int m_iNumTeamOrder;
+
+	// What FillGrid last put in each row, so it only touches the labels that have changed.
+	int m_iRowStyle[NUM_ROWS];
+	char m_szCellText[NUM_ROWS][NUM_COLUMNS][MAX_CELL_TEXT];
+	char m_szCellText2[NUM_ROWS][MAX_CELL_TEXT];
+	char m_szTitle[MAX_SERVERNAME_LENGTH];
+
 
 public:
 	ScorePanel(int x, int y, int wide, int tall);
@@ -283,7 +297,13 @@ public:
 	void SortPlayers(int iTeam, char* team);
 	void RebuildTeams();
 
+	void UpdatePlayerOrder();
+	void UpdateTeamOrder();
+
 	void FillGrid();
+	int GetRowStyle(int row);
+	void SetRowStyle(int row, Font* sfont, Font* tfont, Font* smallfont);
+	void SetCellText(int row, int col, const char* text, const char* text2, bool force);
 
 	void DeathMsg(int killer, int victim);
 
@@ -43,6 +43,7 @@ void VectorAngles(const float* forward, float* angles);
 #include "r_studioint.h"
 #include "com_model.h"
 #include "kbutton.h"
+#include "profiler.h"
 
 extern engine_studio_api_t IEngineStudio;
 
@@ -1657,6 +1658,8 @@ void V_CalcSpectatorRefdef(struct ref_params_s* pparams)
 
 void DLLEXPORT V_CalcRefdef(struct ref_params_s* pparams)
 {
+	PROFILE_SCOPE(PROF_CALCREFDEF);
+
 	// intermission / finale rendering
 	if (0 != pparams->intermission)
 	{
@@ -0,0 +1,502 @@
+//
+// weather.cpp
+//
+// Client-side simulation for env_rain and env_snow. The server sends one Weather message
+// describing the volume whenever an emitter changes state, and the drops are made,
+// moved and collided here rather than being sent as one beam each.
+//
+#include "hud.h"
+#include "cl_util.h"
+#include "parsemsg.h"
+#include "const.h"
+#include "entity_state.h"
+#include "cl_entity.h"
+#include "triangleapi.h"
+#include "com_model.h"
+#include "pmtrace.h"
+#include "pm_defs.h"
+#include "weather.h"
+
+WeatherManager g_Weather;
+
+static cvar_t* cl_weather = NULL;		   // 0 = don't draw client-side weather at all
+static cvar_t* cl_weather_density = NULL;  // scales the number of drops the mapper asked for
+static cvar_t* cl_weather_range = NULL;	   // drops only appear within this distance of the viewer
+static cvar_t* cl_weather_maxdrops = NULL; // budget for live drops, shared by all emitters
+
+// the mapper's drip speed is the beam scroll rate in beam mode, scale it into something sensible
+#define WEATHER_RAIN_SPEEDSCALE 20
+#define WEATHER_SNOW_SPEEDSCALE 3
+#define WEATHER_SNOW_SWAY 4
+
+extern Vector v_origin;
+
+DECLARE_MESSAGE(m_Weather, Weather)
+
+bool CHudWeather::Init()
+{
+	HOOK_MESSAGE(Weather);
+
+	cl_weather = CVAR_CREATE("cl_weather", "1", FCVAR_ARCHIVE);
+	cl_weather_density = CVAR_CREATE("cl_weather_density", "1", FCVAR_ARCHIVE);
+	cl_weather_range = CVAR_CREATE("cl_weather_range", "1024", FCVAR_ARCHIVE);
+	cl_weather_maxdrops = CVAR_CREATE("cl_weather_maxdrops", "4096", FCVAR_ARCHIVE);
+
+	return true;
+}
+
+bool CHudWeather::VidInit()
+{
+	g_Weather.ClearEmitters();
+	return true;
+}
+
+int CHudWeather::MsgFunc_Weather(const char* pszName, int iSize, void* pbuf)
+{
+	BEGIN_READ(pbuf, iSize);
+	int iEntIndex = READ_SHORT();
+	int iType = READ_BYTE();
+
+	if (iType == WEATHER_OFF)
+	{
+		g_Weather.RemoveEmitter(iEntIndex);
+		return 1;
+	}
+
+	if (iType == WEATHER_MOVE)
+	{
+		Vector vecOrigin;
+		vecOrigin.x = READ_COORD();
+		vecOrigin.y = READ_COORD();
+		vecOrigin.z = READ_COORD();
+
+		WeatherEmitter* pEmitter = g_Weather.FindEmitter(iEntIndex);
+		if (pEmitter)
+			pEmitter->MoveTo(vecOrigin);
+		return 1;
+	}
+
+	WeatherEmitter* pEmitter = g_Weather.AddEmitter(iEntIndex);
+	if (pEmitter)
+		pEmitter->ReadSettings(iType);
+
+	return 1;
+}
+
+//============================================
+
+WeatherEmitter::WeatherEmitter(int iEntIndex)
+{
+	m_iEntIndex = iEntIndex;
+	m_pNext = m_pPrev = NULL;
+	m_iType = WEATHER_OFF;
+	m_hSprite = 0;
+	m_fSpawnAccum = 0;
+	m_pColumns = NULL;
+	m_iColumnsU = m_iColumnsV = 0;
+	m_pDrops = new weather_drop[MAX_WEATHER_DROPS];
+	m_iNumDrops = 0;
+}
+
+WeatherEmitter::~WeatherEmitter()
+{
+	delete[] m_pDrops;
+	delete[] m_pColumns;
+}
+
+void WeatherEmitter::ReadSettings(int iType)
+{
+	m_iType = iType;
+
+	m_vecMins.x = READ_COORD();
+	m_vecMins.y = READ_COORD();
+	m_vecMins.z = READ_COORD();
+	m_vecMaxs.x = READ_COORD();
+	m_vecMaxs.y = READ_COORD();
+	m_vecMaxs.z = READ_COORD();
+	m_vecOrigin.x = READ_COORD();
+	m_vecOrigin.y = READ_COORD();
+	m_vecOrigin.z = READ_COORD();
+	m_vecMins = m_vecMins + m_vecOrigin;
+	m_vecMaxs = m_vecMaxs + m_vecOrigin;
+
+	Vector vecForward;
+	vecForward.x = READ_SHORT() / 4096.0f;
+	vecForward.y = READ_SHORT() / 4096.0f;
+	vecForward.z = READ_SHORT() / 4096.0f;
+
+	int iAxis = READ_BYTE();
+	m_iExtent = READ_BYTE();
+	m_fDensity = READ_SHORT();
+
+	float fScale = (m_iType == WEATHER_SNOW) ? WEATHER_SNOW_SPEEDSCALE : WEATHER_RAIN_SPEEDSCALE;
+	m_fMinSpeed = READ_SHORT() * fScale;
+	m_fMaxSpeed = READ_SHORT() * fScale;
+
+	// beam widths are in tenths of a unit
+	m_fSize = V_max(READ_BYTE() * 0.1f, 0.5f);
+	m_fColor[3] = READ_BYTE() / 255.0f;
+	m_fColor[0] = READ_BYTE() / 255.0f;
+	m_fColor[1] = READ_BYTE() / 255.0f;
+	m_fColor[2] = READ_BYTE() / 255.0f;
+	m_hSprite = SPR_Load(READ_STRING());
+
+	switch (iAxis)
+	{
+	case WEATHER_AXIS_X:
+		m_iFallAxis = 0;
+		m_iAxisU = 1;
+		m_iAxisV = 2;
+		break;
+	case WEATHER_AXIS_Y:
+		m_iFallAxis = 1;
+		m_iAxisU = 0;
+		m_iAxisV = 2;
+		break;
+	default:
+		m_iFallAxis = 2;
+		m_iAxisU = 0;
+		m_iAxisV = 1;
+		break;
+	}
+
+	// same as env_rain's beams: the column runs the full depth of the volume along the fall axis
+	Vector vecSize = m_vecMaxs - m_vecMins;
+	if (vecForward[m_iFallAxis] == 0)
+		vecForward[m_iFallAxis] = 1.0f / 4096.0f;
+	m_vecOffs = vecForward * (vecSize[m_iFallAxis] / vecForward[m_iFallAxis]);
+	m_fOffsLength = m_vecOffs.Length();
+	m_vecDir = -m_vecOffs.Normalize();
+
+	// the old drops might not fit the new volume
+	m_iNumDrops = 0;
+	m_fSpawnAccum = 0;
+	ResetColumns();
+}
+
+void WeatherEmitter::MoveTo(const Vector& vecOrigin)
+{
+	Vector vecMove = vecOrigin - m_vecOrigin;
+	if (vecMove == g_vecZero)
+		return;
+
+	m_vecOrigin = vecOrigin;
+	m_vecMins = m_vecMins + vecMove;
+	m_vecMaxs = m_vecMaxs + vecMove;
+
+	for (int i = 0; i < m_iNumDrops; i++)
+		m_pDrops[i].origin = m_pDrops[i].origin + vecMove;
+
+	// the columns are somewhere else now, so they need tracing again
+	ResetColumns();
+}
+
+void WeatherEmitter::ResetColumns()
+{
+	delete[] m_pColumns;
+	m_pColumns = NULL;
+
+	if (m_iExtent == WEATHER_EXTENT_FILL)
+		return; // nothing to trace
+
+	float fSizeU = m_vecMaxs[m_iAxisU] - m_vecMins[m_iAxisU];
+	float fSizeV = m_vecMaxs[m_iAxisV] - m_vecMins[m_iAxisV];
+
+	m_fColumnSize = WEATHER_COLUMN_SIZE;
+	do
+	{
+		m_iColumnsU = V_max(1, (int)ceil(fSizeU / m_fColumnSize));
+		m_iColumnsV = V_max(1, (int)ceil(fSizeV / m_fColumnSize));
+		if (m_iColumnsU * m_iColumnsV <= MAX_WEATHER_COLUMNS)
+			break;
+		m_fColumnSize *= 2;
+	} while (true);
+
+	int iColumns = m_iColumnsU * m_iColumnsV;
+	m_pColumns = new float[iColumns * 2];
+	for (int i = 0; i < iColumns; i++)
+	{
+		m_pColumns[i * 2] = -1;
+		m_pColumns[i * 2 + 1] = -1;
+	}
+}
+
+// finds the part of the column at fU, fV which the drops should travel, as fractions of m_vecOffs.
+// returns false if drops shouldn't appear in this column at all.
+bool WeatherEmitter::GetColumnExtent(float fU, float fV, float& fStart, float& fEnd)
+{
+	if (!m_pColumns)
+	{
+		fStart = 0;
+		fEnd = 1;
+		return true;
+	}
+
+	int iU = V_min(m_iColumnsU - 1, (int)((fU - m_vecMins[m_iAxisU]) / m_fColumnSize));
+	int iV = V_min(m_iColumnsV - 1, (int)((fV - m_vecMins[m_iAxisV]) / m_fColumnSize));
+	float* pColumn = &m_pColumns[(iV * m_iColumnsU + iU) * 2];
+
+	if (pColumn[0] < 0)
+	{
+		// first drop in this column, trace it through the middle
+		Vector vecSrc;
+		vecSrc[m_iFallAxis] = m_vecMaxs[m_iFallAxis];
+		vecSrc[m_iAxisU] = m_vecMins[m_iAxisU] + (iU + 0.5f) * m_fColumnSize;
+		vecSrc[m_iAxisV] = m_vecMins[m_iAxisV] + (iV + 0.5f) * m_fColumnSize;
+		Vector vecDest = vecSrc - m_vecOffs;
+
+		bool bReverse = (m_iExtent == WEATHER_EXTENT_OBSTRUCTED_REVERSE || m_iExtent == WEATHER_EXTENT_ARCING_REVERSE);
+		pmtrace_t* tr;
+		if (bReverse)
+			tr = gEngfuncs.PM_TraceLine(vecDest, vecSrc, PM_TRACELINE_PHYSENTSONLY, 2 /*point hull*/, -1);
+		else
+			tr = gEngfuncs.PM_TraceLine(vecSrc, vecDest, PM_TRACELINE_PHYSENTSONLY, 2 /*point hull*/, -1);
+
+		bool bArcing = (m_iExtent == WEATHER_EXTENT_ARCING || m_iExtent == WEATHER_EXTENT_ARCING_REVERSE);
+		if (bReverse)
+		{
+			pColumn[0] = 1 - tr->fraction;
+			pColumn[1] = 1;
+		}
+		else
+		{
+			pColumn[0] = 0;
+			pColumn[1] = tr->fraction;
+		}
+
+		if (bArcing && tr->fraction == 1.0)
+			pColumn[1] = -1;
+	}
+
+	fStart = pColumn[0];
+	fEnd = pColumn[1];
+	return fEnd >= 0 && fEnd > fStart;
+}
+
+void WeatherEmitter::SpawnDrop(float fU, float fV)
+{
+	float fStart, fEnd;
+	if (!GetColumnExtent(fU, fV, fStart, fEnd))
+		return;
+
+	weather_drop* pDrop = &m_pDrops[m_iNumDrops++];
+
+	pDrop->speed = gEngfuncs.pfnRandomFloat(m_fMinSpeed, m_fMaxSpeed);
+	pDrop->distance = 0;
+	pDrop->length = (fEnd - fStart) * m_fOffsLength;
+	pDrop->phase = gEngfuncs.pfnRandomFloat(0, 2 * M_PI);
+
+	pDrop->origin[m_iFallAxis] = m_vecMaxs[m_iFallAxis];
+	pDrop->origin[m_iAxisU] = fU;
+	pDrop->origin[m_iAxisV] = fV;
+	// drops with a negative speed start at the far end of the column
+	pDrop->origin = pDrop->origin - m_vecOffs * ((pDrop->speed >= 0) ? fStart : fEnd);
+}
+
+void WeatherEmitter::Update(float frametime, const Vector& vecView, float fDensityScale, float fRange, int& iBudget)
+{
+	int i;
+
+	// move the drops we've got, and throw away the ones that have finished
+	for (i = 0; i < m_iNumDrops;)
+	{
+		weather_drop* pDrop = &m_pDrops[i];
+		float fMove = pDrop->speed * frametime;
+		pDrop->distance += fabs(fMove);
+		if (pDrop->distance >= pDrop->length)
+		{
+			KillDrop(i);
+			continue;
+		}
+		pDrop->origin = pDrop->origin + m_vecDir * fMove;
+		pDrop->phase += frametime * 1.5f;
+		i++;
+	}
+	iBudget -= m_iNumDrops;
+
+	// only bother spawning drops in the part of the volume that's near the viewer
+	float fMinU = V_max(m_vecMins[m_iAxisU], vecView[m_iAxisU] - fRange);
+	float fMaxU = V_min(m_vecMaxs[m_iAxisU], vecView[m_iAxisU] + fRange);
+	float fMinV = V_max(m_vecMins[m_iAxisV], vecView[m_iAxisV] - fRange);
+	float fMaxV = V_min(m_vecMaxs[m_iAxisV], vecView[m_iAxisV] + fRange);
+	if (fMinU >= fMaxU || fMinV >= fMaxV)
+	{
+		m_fSpawnAccum = 0;
+		return;
+	}
+
+	float fArea = (m_vecMaxs[m_iAxisU] - m_vecMins[m_iAxisU]) * (m_vecMaxs[m_iAxisV] - m_vecMins[m_iAxisV]);
+	float fNearArea = (fMaxU - fMinU) * (fMaxV - fMinV);
+	m_fSpawnAccum += m_fDensity * fDensityScale * frametime * (fNearArea / fArea);
+
+	int iSpawn = (int)m_fSpawnAccum;
+	m_fSpawnAccum -= iSpawn;
+	iSpawn = V_min(iSpawn, V_min(iBudget, MAX_WEATHER_DROPS - m_iNumDrops));
+
+	float fHalfRange = fRange * 0.5f;
+	for (i = 0; i < iSpawn; i++)
+	{
+		float fU = gEngfuncs.pfnRandomFloat(fMinU, fMaxU);
+		float fV = gEngfuncs.pfnRandomFloat(fMinV, fMaxV);
+
+		// full density close up, thinning out to nothing at the edge of the range
+		float fDU = fU - vecView[m_iAxisU];
+		float fDV = fV - vecView[m_iAxisV];
+		float fDist = sqrt(fDU * fDU + fDV * fDV);
+		if (fDist > fHalfRange && gEngfuncs.pfnRandomFloat(0, fHalfRange) < fDist - fHalfRange)
+			continue;
+
+		SpawnDrop(fU, fV);
+		iBudget--;
+	}
+}
+
+void WeatherEmitter::Draw(const Vector& vecView, const Vector& right, const Vector& up)
+{
+	if (m_iNumDrops == 0 || m_hSprite == 0)
+		return;
+
+	struct model_s* pModel = (struct model_s*)gEngfuncs.GetSpritePointer(m_hSprite);
+	if (!pModel || gEngfuncs.pTriAPI->SpriteTexture(pModel, 0) == 0)
+		return;
+
+	gEngfuncs.pTriAPI->RenderMode(kRenderTransAdd);
+	gEngfuncs.pTriAPI->CullFace(TRI_NONE);
+	gEngfuncs.pTriAPI->Color4f(m_fColor[0], m_fColor[1], m_fColor[2], m_fColor[3]);
+
+	// everything goes in one batch, the drops only differ by position
+	gEngfuncs.pTriAPI->Begin(TRI_QUADS);
+	for (int i = 0; i < m_iNumDrops; i++)
+	{
+		weather_drop* pDrop = &m_pDrops[i];
+		Vector vecTop, vecBottom, vecSide;
+
+		if (m_iType == WEATHER_SNOW)
+		{
+			Vector vecOrigin = pDrop->origin;
+			vecOrigin[m_iAxisU] += sin(pDrop->phase) * WEATHER_SNOW_SWAY;
+			vecOrigin[m_iAxisV] += cos(pDrop->phase * 0.7f) * WEATHER_SNOW_SWAY;
+
+			vecTop = vecOrigin + up * m_fSize;
+			vecBottom = vecOrigin - up * m_fSize;
+			vecSide = right * m_fSize;
+		}
+		else
+		{
+			// a streak along the direction of travel, turned to face the viewer
+			float fStreak = V_min(fabs(pDrop->speed) * 0.04f, pDrop->distance);
+			vecTop = pDrop->origin;
+			vecBottom = pDrop->origin - m_vecDir * ((pDrop->speed >= 0) ? fStreak : -fStreak);
+
+			vecSide = CrossProduct(m_vecDir, pDrop->origin - vecView);
+			float fLength = vecSide.Length();
+			if (fLength == 0)
+				continue;
+			vecSide = vecSide * (m_fSize / fLength);
+		}
+
+		gEngfuncs.pTriAPI->TexCoord2f(0, 0);
+		gEngfuncs.pTriAPI->Vertex3fv(vecTop - vecSide);
+		gEngfuncs.pTriAPI->TexCoord2f(1, 0);
+		gEngfuncs.pTriAPI->Vertex3fv(vecTop + vecSide);
+		gEngfuncs.pTriAPI->TexCoord2f(1, 1);
+		gEngfuncs.pTriAPI->Vertex3fv(vecBottom + vecSide);
+		gEngfuncs.pTriAPI->TexCoord2f(0, 1);
+		gEngfuncs.pTriAPI->Vertex3fv(vecBottom - vecSide);
+	}
+	gEngfuncs.pTriAPI->End();
+}
+
+//============================================
+
+WeatherManager::WeatherManager()
+{
+	m_pFirstEmitter = NULL;
+	memset(m_pEntityEmitters, 0, sizeof(m_pEntityEmitters));
+}
+
+WeatherManager::~WeatherManager()
+{
+	ClearEmitters();
+}
+
+WeatherEmitter* WeatherManager::FindEmitter(int iEntIndex)
+{
+	if (iEntIndex < 0 || iEntIndex >= MAX_EDICTS)
+		return NULL;
+	return m_pEntityEmitters[iEntIndex];
+}
+
+WeatherEmitter* WeatherManager::AddEmitter(int iEntIndex)
+{
+	if (iEntIndex < 0 || iEntIndex >= MAX_EDICTS)
+		return NULL;
+
+	WeatherEmitter* pEmitter = m_pEntityEmitters[iEntIndex];
+	if (pEmitter)
+		return pEmitter;
+
+	pEmitter = new WeatherEmitter(iEntIndex);
+	pEmitter->m_pNext = m_pFirstEmitter;
+	if (m_pFirstEmitter)
+		m_pFirstEmitter->m_pPrev = pEmitter;
+	m_pFirstEmitter = pEmitter;
+	m_pEntityEmitters[iEntIndex] = pEmitter;
+	return pEmitter;
+}
+
+void WeatherManager::RemoveEmitter(int iEntIndex)
+{
+	WeatherEmitter* pEmitter = FindEmitter(iEntIndex);
+	if (!pEmitter)
+		return;
+
+	if (pEmitter->m_pPrev)
+		pEmitter->m_pPrev->m_pNext = pEmitter->m_pNext;
+	else
+		m_pFirstEmitter = pEmitter->m_pNext;
+	if (pEmitter->m_pNext)
+		pEmitter->m_pNext->m_pPrev = pEmitter->m_pPrev;
+
+	m_pEntityEmitters[iEntIndex] = NULL;
+	delete pEmitter;
+}
+
+void WeatherManager::ClearEmitters()
+{
+	WeatherEmitter* pEmitter = m_pFirstEmitter;
+	WeatherEmitter* pTemp;
+
+	while (pEmitter)
+	{
+		pTemp = pEmitter->m_pNext;
+		delete pEmitter;
+		pEmitter = pTemp;
+	}
+
+	m_pFirstEmitter = NULL;
+	memset(m_pEntityEmitters, 0, sizeof(m_pEntityEmitters));
+}
+
+void WeatherManager::UpdateAndDraw(float frametime)
+{
+	if (!m_pFirstEmitter || !cl_weather || cl_weather->value == 0)
+		return;
+
+	Vector normal, forward, right, up;
+	gEngfuncs.GetViewAngles((float*)normal);
+	AngleVectors(normal, forward, right, up);
+
+	float fDensityScale = V_max(0, cl_weather_density->value);
+	float fRange = V_max(64, cl_weather_range->value);
+	int iBudget = (int)cl_weather_maxdrops->value;
+
+	for (WeatherEmitter* pEmitter = m_pFirstEmitter; pEmitter; pEmitter = pEmitter->m_pNext)
+	{
+		if (frametime > 0)
+			pEmitter->Update(frametime, v_origin, fDensityScale, fRange, iBudget);
+		pEmitter->Draw(v_origin, right, up);
+	}
+
+	gEngfuncs.pTriAPI->RenderMode(kRenderNormal);
+}
@@ -0,0 +1,112 @@
+// Client-side simulation for env_rain and env_snow
+#pragma once
+
+#include "com_model.h" // for MAX_EDICTS
+
+// weather types, as sent by the server (these must match the RAIN_MODE_ values in dlls/effects.cpp)
+#define WEATHER_OFF 0
+#define WEATHER_RAIN 1
+#define WEATHER_SNOW 2
+#define WEATHER_MOVE 3 // not a type; the emitter's entity has moved
+
+// env_rain's m_axis
+#define WEATHER_AXIS_Z 0
+#define WEATHER_AXIS_X 1
+#define WEATHER_AXIS_Y 2
+
+// env_rain's m_iExtent
+#define WEATHER_EXTENT_FILL 0
+#define WEATHER_EXTENT_OBSTRUCTED 1
+#define WEATHER_EXTENT_ARCING 2
+#define WEATHER_EXTENT_OBSTRUCTED_REVERSE 3
+#define WEATHER_EXTENT_ARCING_REVERSE 4
+
+#define MAX_WEATHER_DROPS 2048	   // per emitter
+#define MAX_WEATHER_COLUMNS 16384  // per emitter; the column size grows to stay under this
+#define WEATHER_COLUMN_SIZE 32	   // smallest column width, in world units
+
+struct weather_drop
+{
+	Vector origin;
+	float speed;	// negative speeds travel back up the column
+	float distance; // how far it's travelled along its path
+	float length;	// how far it can travel before it dies
+	float phase;	// snow: where it is in its sway
+};
+
+// one env_rain/env_snow entity
+class WeatherEmitter
+{
+public:
+	WeatherEmitter(int iEntIndex);
+	~WeatherEmitter();
+
+	void ReadSettings(int iType); // reads the rest of a Weather message
+	void MoveTo(const Vector& vecOrigin); // moves the volume, and the drops in it, with the entity
+
+	// fRange is the LOD radius, iBudget the number of drops still allowed this frame (updated)
+	void Update(float frametime, const Vector& vecView, float fDensityScale, float fRange, int& iBudget);
+	void Draw(const Vector& vecView, const Vector& right, const Vector& up);
+
+	int NumDrops() { return m_iNumDrops; }
+
+	WeatherEmitter* m_pNext;
+	WeatherEmitter* m_pPrev;
+	int m_iEntIndex;
+
+private:
+	void KillDrop(int i) { m_pDrops[i] = m_pDrops[--m_iNumDrops]; }
+	void SpawnDrop(float fU, float fV);
+	bool GetColumnExtent(float fU, float fV, float& fStart, float& fEnd);
+	void ResetColumns();
+
+	int m_iType;
+	Vector m_vecOrigin; // the entity's, when the volume was last moved
+	Vector m_vecMins;	// world space
+	Vector m_vecMaxs;
+	Vector m_vecOffs; // from the top of a column to the bottom
+	float m_fOffsLength;
+	Vector m_vecDir; // normalised m_vecOffs; the way the drops move if speed is positive
+	int m_iFallAxis;
+	int m_iAxisU;
+	int m_iAxisV;
+	int m_iExtent;
+	float m_fDensity; // drops per second, over the whole volume
+	float m_fMinSpeed;
+	float m_fMaxSpeed;
+	float m_fSize;
+	float m_fColor[4];
+	HSPRITE m_hSprite;
+
+	float m_fSpawnAccum; // fractional drops left over from previous frames
+
+	// cached start/end fractions (along m_vecOffs) for each column, traced on first use.
+	// a start fraction below 0 means the column hasn't been traced yet, an end fraction
+	// below 0 means no drops should appear in it.
+	float* m_pColumns;
+	float m_fColumnSize;
+	int m_iColumnsU;
+	int m_iColumnsV;
+
+	weather_drop* m_pDrops;
+	int m_iNumDrops;
+};
+
+class WeatherManager
+{
+public:
+	WeatherManager();
+	~WeatherManager();
+
+	WeatherEmitter* FindEmitter(int iEntIndex);
+	WeatherEmitter* AddEmitter(int iEntIndex); // finds the entity's emitter, or makes one
+	void RemoveEmitter(int iEntIndex);
+	void ClearEmitters();
+
+	void UpdateAndDraw(float frametime);
+
+	WeatherEmitter* m_pFirstEmitter;
+	WeatherEmitter* m_pEntityEmitters[MAX_EDICTS]; // the emitter for each entity, or NULL
+};
+
+extern WeatherManager g_Weather;
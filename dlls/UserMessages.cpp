@@ -49,6 +49,7 @@ void LinkUserMessages()
 	gmsgHUDColor = REG_USER_MSG("HUDColor", 4);		   //LRC
 	gmsgAddShine = REG_USER_MSG("AddShine", -1);	   //LRC
 	gmsgParticle = REG_USER_MSG("Particle", -1);	   //LRC
+	gmsgWeather = REG_USER_MSG("Weather", -1);
 
 	gmsgShowGameTitle = REG_USER_MSG("GameTitle", 1);
 	gmsgDeathMsg = REG_USER_MSG("DeathMsg", -1);
@@ -27,6 +27,7 @@ inline int gmsgSetSky = 0;		// LRC
 inline int gmsgHUDColor = 0;	// LRC
 inline int gmsgAddShine = 0;	// LRC
 inline int gmsgParticle = 0;	// LRC
+inline int gmsgWeather = 0;
 inline int gmsgShowGameTitle = 0;
 inline int gmsgCurWeapon = 0;
 inline int gmsgHealth = 0;
@@ -25,6 +25,211 @@
 #pragma warning(disable : 4244)
 
 
+//=========================================================
+// Per-model lookup tables
+//
+// Monsters look up sequences by name and activity, and check for animation
+// events, every time they think. Rather than scanning every seqdesc each time,
+// build these tables the first time a model is used.
+//=========================================================
+
+struct studio_activity_t
+{
+	int activity;
+	int first;	   // index into pSeqs/pWeightSums
+	int count;	   // number of sequences with this activity
+	int heaviest;  // result of LookupActivityHeaviest
+};
+
+struct studio_cache_t
+{
+	studiohdr_t* pstudiohdr;
+	int length; // so that we notice if the engine reuses this memory for another model
+
+	// sequence names, open hashing. Each entry is a sequence index + 1, or 0 for empty.
+	int* pNameHash;
+	int iNameHashMask;
+
+	// sorted by activity; then sequences in file order, each with the total weight up to and including it
+	studio_activity_t* pActivities;
+	int iNumActivities;
+	int* pSeqs;
+	int* pWeightSums;
+
+	// for each sequence, the range of frames of its server-side events (first > last if there aren't any)
+	float* pFirstEventFrame;
+	float* pLastEventFrame;
+
+	studio_cache_t* pNext;
+};
+
+#define STUDIO_CACHE_HASH 64
+
+static studio_cache_t* g_pStudioCache[STUDIO_CACHE_HASH];
+
+static unsigned int HashSequenceName(const char* label)
+{
+	unsigned int hash = 0;
+	for (; *label; label++)
+		hash = hash * 31 + tolower(*label);
+	return hash;
+}
+
+static int CompareActivitySeqs(const void* a, const void* b)
+{
+	// sort by activity, keeping file order within an activity
+	const int* pa = (const int*)a;
+	const int* pb = (const int*)b;
+	if (pa[0] != pb[0])
+		return pa[0] - pb[0];
+	return pa[1] - pb[1];
+}
+
+static studio_cache_t* BuildStudioCache(studiohdr_t* pstudiohdr)
+{
+	studio_cache_t* pCache = new studio_cache_t;
+	mstudioseqdesc_t* pseqdesc = (mstudioseqdesc_t*)((byte*)pstudiohdr + pstudiohdr->seqindex);
+	int numseq = pstudiohdr->numseq;
+	int i;
+
+	pCache->pstudiohdr = pstudiohdr;
+	pCache->length = pstudiohdr->length;
+
+	// name lookup; the first sequence with a given name wins, just like a linear search.
+	int iHashSize = 16;
+	while (iHashSize < numseq * 2)
+		iHashSize <<= 1;
+	pCache->iNameHashMask = iHashSize - 1;
+	pCache->pNameHash = new int[iHashSize];
+	memset(pCache->pNameHash, 0, iHashSize * sizeof(int));
+	for (i = 0; i < numseq; i++)
+	{
+		int slot = HashSequenceName(pseqdesc[i].label) & pCache->iNameHashMask;
+		while (pCache->pNameHash[slot] && stricmp(pseqdesc[pCache->pNameHash[slot] - 1].label, pseqdesc[i].label) != 0)
+			slot = (slot + 1) & pCache->iNameHashMask;
+		if (!pCache->pNameHash[slot])
+			pCache->pNameHash[slot] = i + 1;
+	}
+
+	// activities
+	int* pSorted = new int[numseq * 2 + 1];
+	for (i = 0; i < numseq; i++)
+	{
+		pSorted[i * 2] = pseqdesc[i].activity;
+		pSorted[i * 2 + 1] = i;
+	}
+	qsort(pSorted, numseq, sizeof(int) * 2, CompareActivitySeqs);
+
+	pCache->pSeqs = new int[numseq + 1];
+	pCache->pWeightSums = new int[numseq + 1];
+	pCache->pActivities = new studio_activity_t[numseq + 1];
+	pCache->iNumActivities = 0;
+
+	studio_activity_t* pAct = NULL;
+	for (i = 0; i < numseq; i++)
+	{
+		int seq = pSorted[i * 2 + 1];
+		if (!pAct || pAct->activity != pSorted[i * 2])
+		{
+			pAct = &pCache->pActivities[pCache->iNumActivities++];
+			pAct->activity = pSorted[i * 2];
+			pAct->first = i;
+			pAct->count = 0;
+			pAct->heaviest = ACTIVITY_NOT_AVAILABLE;
+		}
+
+		int weight = pseqdesc[seq].actweight;
+		pCache->pSeqs[i] = seq;
+		pCache->pWeightSums[i] = (pAct->count ? pCache->pWeightSums[i - 1] : 0) + weight;
+
+		if (weight > (pAct->heaviest == ACTIVITY_NOT_AVAILABLE ? 0 : pseqdesc[pAct->heaviest].actweight))
+			pAct->heaviest = seq;
+		pAct->count++;
+	}
+	delete[] pSorted;
+
+	// events
+	pCache->pFirstEventFrame = new float[numseq + 1];
+	pCache->pLastEventFrame = new float[numseq + 1];
+	for (i = 0; i < numseq; i++)
+	{
+		mstudioevent_t* pevent = (mstudioevent_t*)((byte*)pstudiohdr + pseqdesc[i].eventindex);
+		float flFirst = 1;
+		float flLast = 0;
+		for (int j = 0; j < pseqdesc[i].numevents; j++)
+		{
+			if (pevent[j].event >= EVENT_CLIENT)
+				continue;
+			if (flFirst > flLast)
+				flFirst = flLast = pevent[j].frame;
+			else
+			{
+				flFirst = V_min(flFirst, (float)pevent[j].frame);
+				flLast = V_max(flLast, (float)pevent[j].frame);
+			}
+		}
+		pCache->pFirstEventFrame[i] = flFirst;
+		pCache->pLastEventFrame[i] = flLast;
+	}
+
+	return pCache;
+}
+
+static studio_cache_t* GetStudioCache(studiohdr_t* pstudiohdr)
+{
+	int iHash = ((size_t)pstudiohdr >> 4) & (STUDIO_CACHE_HASH - 1);
+	studio_cache_t* pCache;
+
+	for (pCache = g_pStudioCache[iHash]; pCache; pCache = pCache->pNext)
+	{
+		if (pCache->pstudiohdr == pstudiohdr && pCache->length == pstudiohdr->length)
+			return pCache;
+	}
+
+	pCache = BuildStudioCache(pstudiohdr);
+	pCache->pNext = g_pStudioCache[iHash];
+	g_pStudioCache[iHash] = pCache;
+	return pCache;
+}
+
+static studio_activity_t* FindCachedActivity(studio_cache_t* pCache, int activity)
+{
+	int lo = 0;
+	int hi = pCache->iNumActivities - 1;
+	while (lo <= hi)
+	{
+		int mid = (lo + hi) / 2;
+		studio_activity_t* pAct = &pCache->pActivities[mid];
+		if (pAct->activity == activity)
+			return pAct;
+		else if (pAct->activity < activity)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return NULL;
+}
+
+// models can be unloaded between levels, so throw the tables away when a new one starts.
+void ClearAnimationCache()
+{
+	for (int i = 0; i < STUDIO_CACHE_HASH; i++)
+	{
+		while (g_pStudioCache[i])
+		{
+			studio_cache_t* pCache = g_pStudioCache[i];
+			g_pStudioCache[i] = pCache->pNext;
+			delete[] pCache->pNameHash;
+			delete[] pCache->pActivities;
+			delete[] pCache->pSeqs;
+			delete[] pCache->pWeightSums;
+			delete[] pCache->pFirstEventFrame;
+			delete[] pCache->pLastEventFrame;
+			delete pCache;
+		}
+	}
+}
+
 
 bool ExtractBbox(void* pmodel, int sequence, float* mins, float* maxs)
 {
@@ -58,23 +263,30 @@ int LookupActivity(void* pmodel, entvars_t* pev, int activity)
 	if (!pstudiohdr)
 		return 0;
 
-	mstudioseqdesc_t* pseqdesc;
-
-	pseqdesc = (mstudioseqdesc_t*)((byte*)pstudiohdr + pstudiohdr->seqindex);
-
-	int weighttotal = 0;
-	int seq = ACTIVITY_NOT_AVAILABLE;
-	for (int i = 0; i < pstudiohdr->numseq; i++)
+	studio_cache_t* pCache = GetStudioCache(pstudiohdr);
+	studio_activity_t* pAct = FindCachedActivity(pCache, activity);
+	if (!pAct)
+		return ACTIVITY_NOT_AVAILABLE;
+
+	const int* pSums = &pCache->pWeightSums[pAct->first];
+	int weighttotal = pSums[pAct->count - 1];
+	if (0 == weighttotal)
+		return pCache->pSeqs[pAct->first + pAct->count - 1]; // no weights; the last one wins
+
+	// pick by weight: the first sequence whose running total is past the random value
+	int pick = RANDOM_LONG(0, weighttotal - 1);
+	int lo = 0;
+	int hi = pAct->count - 1;
+	while (lo < hi)
 	{
-		if (pseqdesc[i].activity == activity)
-		{
-			weighttotal += pseqdesc[i].actweight;
-			if (0 == weighttotal || RANDOM_LONG(0, weighttotal - 1) < pseqdesc[i].actweight)
-				seq = i;
-		}
+		int mid = (lo + hi) / 2;
+		if (pSums[mid] > pick)
+			hi = mid;
+		else
+			lo = mid + 1;
 	}
 
-	return seq;
+	return pCache->pSeqs[pAct->first + lo];
 }
 
 
@@ -86,25 +298,11 @@ int LookupActivityHeaviest(void* pmodel, entvars_t* pev, int activity)
 	if (!pstudiohdr)
 		return 0;
 
-	mstudioseqdesc_t* pseqdesc;
-
-	pseqdesc = (mstudioseqdesc_t*)((byte*)pstudiohdr + pstudiohdr->seqindex);
+	studio_activity_t* pAct = FindCachedActivity(GetStudioCache(pstudiohdr), activity);
+	if (!pAct)
+		return ACTIVITY_NOT_AVAILABLE;
 
-	int weight = 0;
-	int seq = ACTIVITY_NOT_AVAILABLE;
-	for (int i = 0; i < pstudiohdr->numseq; i++)
-	{
-		if (pseqdesc[i].activity == activity)
-		{
-			if (pseqdesc[i].actweight > weight)
-			{
-				weight = pseqdesc[i].actweight;
-				seq = i;
-			}
-		}
-	}
-
-	return seq;
+	return pAct->heaviest;
 }
 
 void GetEyePosition(void* pmodel, float* vecEyePosition)
@@ -134,10 +332,14 @@ int LookupSequence(void* pmodel, const char* label)
 
 	pseqdesc = (mstudioseqdesc_t*)((byte*)pstudiohdr + pstudiohdr->seqindex);
 
-	for (int i = 0; i < pstudiohdr->numseq; i++)
+	studio_cache_t* pCache = GetStudioCache(pstudiohdr);
+	int slot = HashSequenceName(label) & pCache->iNameHashMask;
+	while (pCache->pNameHash[slot])
 	{
+		int i = pCache->pNameHash[slot] - 1;
 		if (stricmp(pseqdesc[i].label, label) == 0)
 			return i;
+		slot = (slot + 1) & pCache->iNameHashMask;
 	}
 
 	return -1;
@@ -270,6 +472,18 @@ int GetAnimationEvent(void* pmodel, entvars_t* pev, MonsterEvent_t* pMonsterEven
 		flEnd = 1.0;
 	}
 
+	// quick check against the range of frames that have server-side events, so that the usual
+	// case (nothing happens this frame) doesn't have to look at each event.
+	studio_cache_t* pCache = GetStudioCache(pstudiohdr);
+	float flFirst = pCache->pFirstEventFrame[(int)pev->sequence];
+	float flLast = pCache->pLastEventFrame[(int)pev->sequence];
+	if (flFirst > flLast)
+		return 0; // only client-side events
+
+	if ((flLast < flStart || flFirst >= flEnd) &&
+		!((pseqdesc->flags & STUDIO_LOOPING) != 0 && flEnd >= pseqdesc->numframes - 1 && flFirst < flEnd - pseqdesc->numframes + 1))
+		return 0;
+
 	for (; index < pseqdesc->numevents; index++)
 	{
 		// Don't send client-side events to the server AI
@@ -43,5 +43,7 @@ int GetSequenceFrames(void* pmodel, entvars_t* pev); //LRC
 int GetAnimationEvent(void* pmodel, entvars_t* pev, MonsterEvent_t* pMonsterEvent, float flStart, float flEnd, int index);
 bool ExtractBbox(void* pmodel, int sequence, float* mins, float* maxs);
 
+void ClearAnimationCache();
+
 // From /engine/studio.h
 #define STUDIO_LOOPING 0x0001
@@ -160,6 +160,17 @@ public:
 	bool Restore(CRestore& restore) override;
 
 	STATE GetState() override { return m_iState; }
+	bool PublishesState() override { return true; } //LRC
+
+	//LRC- tells any watchers when the state actually changes
+	void ChangeState(STATE iState)
+	{
+		if (m_iState != iState)
+		{
+			m_iState = iState;
+			StateChanged();
+		}
+	}
 
 	static TYPEDESCRIPTION m_SaveData[];
 
@@ -234,7 +245,7 @@ void CEnvState::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE useT
 	case STATE_TURN_ON:
 		if (m_fTurnOffTime != 0)
 		{
-			m_iState = STATE_TURN_OFF;
+			ChangeState(STATE_TURN_OFF);
 			if (FBitSet(pev->spawnflags, SF_ENVSTATE_DEBUG))
 			{
 				ALERT(at_debug, "DEBUG: env_state \"%s\" triggered; will turn off in %f seconds.\n", STRING(pev->targetname), m_fTurnOffTime);
@@ -243,7 +254,7 @@ void CEnvState::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE useT
 		}
 		else
 		{
-			m_iState = STATE_OFF;
+			ChangeState(STATE_OFF);
 			if (FBitSet(pev->spawnflags, SF_ENVSTATE_DEBUG))
 			{
 				ALERT(at_debug, "DEBUG: env_state \"%s\" triggered, turned off", STRING(pev->targetname));
@@ -266,7 +277,7 @@ void CEnvState::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE useT
 	case STATE_TURN_OFF:
 		if (m_fTurnOnTime != 0)
 		{
-			m_iState = STATE_TURN_ON;
+			ChangeState(STATE_TURN_ON);
 			if (FBitSet(pev->spawnflags, SF_ENVSTATE_DEBUG))
 			{
 				ALERT(at_debug, "DEBUG: env_state \"%s\" triggered; will turn on in %f seconds.\n", STRING(pev->targetname), m_fTurnOnTime);
@@ -275,7 +286,7 @@ void CEnvState::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE useT
 		}
 		else
 		{
-			m_iState = STATE_ON;
+			ChangeState(STATE_ON);
 			if (FBitSet(pev->spawnflags, SF_ENVSTATE_DEBUG))
 			{
 				ALERT(at_debug, "DEBUG: env_state \"%s\" triggered, turned on", STRING(pev->targetname));
@@ -301,7 +312,7 @@ void CEnvState::Think()
 {
 	if (m_iState == STATE_TURN_ON)
 	{
-		m_iState = STATE_ON;
+		ChangeState(STATE_ON);
 		if (FBitSet(pev->spawnflags, SF_ENVSTATE_DEBUG))
 		{
 			ALERT(at_debug, "DEBUG: env_state \"%s\" turned itself on", STRING(pev->targetname));
@@ -320,7 +331,7 @@ void CEnvState::Think()
 	}
 	else if (m_iState == STATE_TURN_OFF)
 	{
-		m_iState = STATE_OFF;
+		ChangeState(STATE_OFF);
 		if (FBitSet(pev->spawnflags, SF_ENVSTATE_DEBUG))
 		{
 			ALERT(at_debug, "DEBUG: env_state \"%s\" turned itself off", STRING(pev->targetname));
@@ -783,7 +794,7 @@ void CBaseButton::Spawn()
 	if (m_flLip == 0)
 		m_flLip = 4;
 
-	m_toggle_state = TS_AT_BOTTOM;
+	ChangeToggleState(TS_AT_BOTTOM);
 	m_vecPosition1 = pev->origin;
 	// Subtract 2 from size because the engine expands bboxes by 1 in all directions making the size too big
 	m_vecPosition2 = m_vecPosition1 + (pev->movedir * (fabs(pev->movedir.x * (pev->size.x - 2)) + fabs(pev->movedir.y * (pev->size.y - 2)) + fabs(pev->movedir.z * (pev->size.z - 2)) - m_flLip));
@@ -1065,7 +1076,7 @@ void CBaseButton::ButtonActivate()
 	}
 
 	ASSERT(m_toggle_state == TS_AT_BOTTOM);
-	m_toggle_state = TS_GOING_UP;
+	ChangeToggleState(TS_GOING_UP);
 
 	//LRC - unhelpfully, SF_BUTTON_DONTMOVE is the same value as
 	// SF_ROTBUTTON_NOTSOLID, so we have to assume that a rotbutton will
@@ -1094,7 +1105,7 @@ void CBaseButton::TriggerAndWait()
 	if (!UTIL_IsMasterTriggered(m_sMaster, m_hActivator))
 		return;
 
-	m_toggle_state = TS_AT_TOP;
+	ChangeToggleState(TS_AT_TOP);
 
 	pev->frame = 1; // use alternate textures
 	//LRC
@@ -1138,7 +1149,7 @@ void CBaseButton::TriggerAndWait()
 void CBaseButton::ButtonReturn()
 {
 	ASSERT(m_toggle_state == TS_AT_TOP);
-	m_toggle_state = TS_GOING_DOWN;
+	ChangeToggleState(TS_GOING_DOWN);
 
 	pev->frame = 0; // use normal textures
 
@@ -1169,7 +1180,7 @@ void CBaseButton::ButtonReturn()
 void CBaseButton::ButtonBackHome()
 {
 	ASSERT(m_toggle_state == TS_GOING_DOWN);
-	m_toggle_state = TS_AT_BOTTOM;
+	ChangeToggleState(TS_AT_BOTTOM);
 
 	if (FBitSet(pev->spawnflags, SF_BUTTON_TOGGLE))
 	{
@@ -1282,7 +1293,7 @@ void CRotButton::Spawn()
 		pev->takedamage = DAMAGE_YES;
 	}
 
-	m_toggle_state = TS_AT_BOTTOM;
+	ChangeToggleState(TS_AT_BOTTOM);
 	m_vecAngle1 = pev->angles;
 	m_vecAngle2 = pev->angles + pev->movedir * m_flMoveDistance;
 	ASSERTSZ(m_vecAngle1 != m_vecAngle2, "rotating button start/end positions are equal");
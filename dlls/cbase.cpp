@@ -24,6 +24,7 @@
 #include "pm_shared.h"
 #include "movewith.h"
 #include "skill.h"
+#include "locus.h"
 
 void EntvarsKeyvalue(entvars_t* pev, KeyValueData* pkvd);
 
@@ -196,6 +197,15 @@ int DispatchSpawn(edict_t* pent)
 				//				ALERT( at_console, "Added global entity %s (%s)\n", STRING(pEntity->pev->classname), STRING(pEntity->pev->globalname) );
 			}
 		}
+
+		if (pEntity)
+		{
+			//LRC- let any watcher_counts know there's a new entity with this name
+			pEntity->StateChanged();
+
+			//LRC- and make any cached calc_ references to this name look again, in case this one comes first now
+			LocusTargetnameChanged(pEntity->pev->targetname);
+		}
 	}
 
 	return 0;
@@ -107,6 +107,8 @@ typedef enum
 extern char* GetStringForUseType(USE_TYPE useType);
 
 extern void FireTargets(const char* targetName, CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE useType, float value);
+extern void FireTargets(string_t iszTarget, CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE useType, float value);
+extern void ClearCompiledTargets();
 
 typedef void (CBaseEntity::*BASEPTR)();
 typedef void (CBaseEntity::*ENTITYFUNCPTR)(CBaseEntity* pOther);
@@ -287,6 +289,14 @@ public:
 	// For team-specific doors in multiplayer, etc: a master's state depends on who wants to know.
 	virtual STATE GetState(CBaseEntity* pEnt) { return GetState(); };
 
+	// LRC- an entity which returns true here promises to call StateChanged() whenever the result
+	// of GetState() changes, so that watchers can stop polling it.
+	virtual bool PublishesState() { return false; }
+	void StateChanged();
+	// called on a StateListener when an entity with a name it's watching calls StateChanged().
+	virtual void WatchedStateChanged(CBaseEntity* pChanged) {}
+	bool m_fStateListener; // LRC- whether it's in the StateListener table
+
 	static TYPEDESCRIPTION m_SaveData[];
 
 	virtual void TraceAttack(entvars_t* pevAttacker, float flDamage, Vector vecDir, TraceResult* ptr, int bitsDamageType);
@@ -369,7 +379,7 @@ public:
 		::operator delete(pMem);
 	}
 
-	void UpdateOnRemove();
+	virtual void UpdateOnRemove();
 
 	// common member functions
 	void EXPORT SUB_Remove();
@@ -679,6 +689,7 @@ public:
 
 	// LRC- overridden because toggling entities have general rules governing their states.
 	STATE GetState() override;
+	void ChangeToggleState(TOGGLE_STATE state);
 
 	float GetDelay() override { return m_flWait; }
 
@@ -788,6 +799,7 @@ public:
 
 	static TYPEDESCRIPTION m_SaveData[];
 	int ObjectCaps() override;
+	bool PublishesState() override { return true; } //LRC
 
 	bool m_fStayPushed; // button stays pushed in until touched again?
 	bool m_fRotating;	// a rotating button?  default is a sliding button.
@@ -941,7 +953,7 @@ public:
 	bool KeyValue(KeyValueData* pkvd) override;
 
 	CBaseAlias* m_pFirstAlias;
-	
+
 	static inline CWorld* Instance = nullptr;
 };
 
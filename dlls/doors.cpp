@@ -56,6 +56,7 @@ public:
 	static TYPEDESCRIPTION m_SaveData[];
 
 	void SetToggleState(int state) override;
+	bool PublishesState() override { return true; } //LRC
 
 	// used to selectivly override defaults
 	void EXPORT DoorTouch(CBaseEntity* pOther);
@@ -343,7 +344,7 @@ void CBaseDoor::Spawn( )
 		m_vecPosition1 = pev->origin;
 	}
 
-	m_toggle_state = TS_AT_BOTTOM;
+	ChangeToggleState(TS_AT_BOTTOM);
 	
 	// if the door is flagged for USE button activation only, use NULL touch function
 	// (unless it's overridden, of course- LRC)
@@ -383,7 +384,7 @@ void CBaseDoor::Spawn()
 	if (pev->speed == 0)
 		pev->speed = 100;
 
-	m_toggle_state = TS_AT_BOTTOM;
+	ChangeToggleState(TS_AT_BOTTOM);
 
 	// if the door is flagged for USE button activation only, use NULL touch function
 	// (unless it's overridden, of course- LRC)
@@ -769,7 +770,7 @@ void CBaseDoor::DoorGoUp()
 	}
 
 	//	ALERT(at_debug, "%s go up (was %d)\n", STRING(pev->targetname), m_toggle_state);
-	m_toggle_state = TS_GOING_UP;
+	ChangeToggleState(TS_GOING_UP);
 	SetMoveDone(&CBaseDoor::DoorHitTop);
 
 	// LRC- if synched, we fire as soon as we start to go up
@@ -823,7 +824,7 @@ void CBaseDoor::DoorHitTop()
 
 	//	ALERT(at_debug, "%s hit top\n", STRING(pev->targetname));
 	ASSERT(m_toggle_state == TS_GOING_UP);
-	m_toggle_state = TS_AT_TOP;
+	ChangeToggleState(TS_AT_TOP);
 
 	// toggle-doors don't come down automatically, they wait for refire.
 	if (FBitSet(pev->spawnflags, SF_DOOR_NO_AUTO_RETURN))
@@ -885,7 +886,7 @@ void CBaseDoor::DoorGoDown()
 #ifdef DOOR_ASSERT
 	ASSERT(m_toggle_state == TS_AT_TOP);
 #endif // DOOR_ASSERT
-	m_toggle_state = TS_GOING_DOWN;
+	ChangeToggleState(TS_GOING_DOWN);
 
 	SetMoveDone(&CBaseDoor::DoorHitBottom);
 	if (FClassnameIs(pev, "func_door_rotating")) //rotating door
@@ -924,7 +925,7 @@ void CBaseDoor::DoorHitBottom()
 
 	//	ALERT(at_debug, "%s hit bottom\n", STRING(pev->targetname));
 	ASSERT(m_toggle_state == TS_GOING_DOWN);
-	m_toggle_state = TS_AT_BOTTOM;
+	ChangeToggleState(TS_AT_BOTTOM);
 
 	// Re-instate touch method, cycle is complete
 	if (FBitSet(pev->spawnflags, SF_DOOR_USE_ONLY) &&
@@ -1129,7 +1130,7 @@ void CRotDoor::Spawn()
 		pev->movedir = pev->movedir * -1;
 	}
 
-	m_toggle_state = TS_AT_BOTTOM;
+	ChangeToggleState(TS_AT_BOTTOM);
 
 	if (FBitSet(pev->spawnflags, SF_DOOR_USE_ONLY) && !FBitSet(pev->spawnflags, SF_DOOR_FORCETOUCHABLE))
 	{
@@ -1332,12 +1332,12 @@ void CLaser::StrikeThink()
 	Vector startpos = pev->origin;
 	if (!FStringNull(m_iszStartPosition))
 	{
-		startpos = CalcLocus_Position(this, NULL, STRING(m_iszStartPosition));
+		startpos = CalcLocus_Position(this, NULL, m_iszStartPosition);
 	}
 
 	if (m_iTowardsMode != 0)
 	{
-		m_firePosition = startpos + CalcLocus_Velocity(this, NULL, STRING(pev->message));
+		m_firePosition = startpos + CalcLocus_Velocity(this, NULL, pev->message);
 	}
 	else
 	{
@@ -2052,13 +2052,13 @@ void CGibShooter::ShootThink()
 		Vector vecPos;
 		float flGibVelocity;
 		if (!FStringNull(m_iszVelFactor))
-			flGibVelocity = CalcLocus_Ratio(m_hActivator, STRING(m_iszVelFactor));
+			flGibVelocity = CalcLocus_Ratio(m_hActivator, m_iszVelFactor);
 		else
 			flGibVelocity = 1;
 
 		if (!FStringNull(m_iszVelocity))
 		{
-			vecShootDir = CalcLocus_Velocity(this, m_hActivator, STRING(m_iszVelocity));
+			vecShootDir = CalcLocus_Velocity(this, m_hActivator, m_iszVelocity);
 			flGibVelocity = flGibVelocity * vecShootDir.Length();
 			vecShootDir = vecShootDir.Normalize();
 		}
@@ -2072,14 +2072,14 @@ void CGibShooter::ShootThink()
 		vecShootDir = vecShootDir.Normalize();
 
 		if (!FStringNull(m_iszPosition))
-			vecPos = CalcLocus_Position(this, m_hActivator, STRING(m_iszPosition));
+			vecPos = CalcLocus_Position(this, m_hActivator, m_iszPosition);
 		else
 			vecPos = pev->origin;
 		CBaseEntity* pGib = CreateGib(vecPos, vecShootDir * flGibVelocity);
 
 		if (pGib)
 		{
-			pGib->pev->targetname = m_iszTargetname;
+			UTIL_SetTargetname(pGib, m_iszTargetname);
 
 			if (FBitSet(pev->spawnflags, SF_GIBSHOOTER_DEBUG))
 				ALERT(at_debug, "DEBUG: %s \"%s\" creates a shot at %f %f %f; vel %f %f %f; pos \"%s\"\n", STRING(pev->classname), STRING(pev->targetname), pGib->pev->origin.x, pGib->pev->origin.y, pGib->pev->origin.z, pGib->pev->velocity.x, pGib->pev->velocity.y, pGib->pev->velocity.z, STRING(m_iszPosition));
@@ -2523,7 +2523,7 @@ Vector CBlood::Direction(CBaseEntity* pActivator)
 	if ((pev->spawnflags & SF_BLOOD_RANDOM) != 0)
 		return UTIL_RandomBloodVector();
 	else if (!FStringNull(pev->netname))
-		return CalcLocus_Velocity(this, pActivator, STRING(pev->netname));
+		return CalcLocus_Velocity(this, pActivator, pev->netname);
 	else
 		return pev->movedir;
 }
@@ -2547,7 +2547,7 @@ Vector CBlood::BloodPosition(CBaseEntity* pActivator)
 	}
 	else if (!FStringNull(pev->target))
 	{
-		return CalcLocus_Position(this, pActivator, STRING(pev->target));
+		return CalcLocus_Position(this, pActivator, pev->target);
 	}
 
 	return pev->origin;
@@ -2896,7 +2896,7 @@ void CEnvFunnel::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE use
 	//LRC
 	Vector vecPos;
 	if (!FStringNull(pev->message))
-		vecPos = CalcLocus_Position(this, pActivator, STRING(pev->message));
+		vecPos = CalcLocus_Position(this, pActivator, pev->message);
 	else
 		vecPos = pev->origin;
 
@@ -2944,7 +2944,7 @@ void CEnvQuakeFx::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE us
 {
 	Vector vecPos;
 	if (!FStringNull(pev->message))
-		vecPos = CalcLocus_Position(this, pActivator, STRING(pev->message));
+		vecPos = CalcLocus_Position(this, pActivator, pev->message);
 	else
 		vecPos = pev->origin;
 
@@ -3262,6 +3262,16 @@ void CEnvFootsteps::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE
 #define EXTENT_OBSTRUCTED_REVERSE 3
 #define EXTENT_ARCING_REVERSE 4
 
+// m_iMode: how the drips are produced. Client-side modes send one "Weather"
+// message per state change and let the client simulate the drips itself.
+// (These values must match cl_dll/weather.h.)
+#define RAIN_MODE_BEAMS 0 // one TE_BEAMPOINTS per drip, sent to everyone
+#define RAIN_MODE_CLIENT_RAIN 1
+#define RAIN_MODE_CLIENT_SNOW 2
+#define RAIN_MSG_MOVE 3 // not a mode; tells the clients an emitter has moved
+
+#define RAIN_MOVE_POLL 0.1 // how often a client-side emitter checks whether it's been moved
+
 class CEnvRain : public CBaseEntity
 {
 public:
@@ -3271,11 +3281,17 @@ public:
 	void Precache() override;
 	bool KeyValue(KeyValueData* pkvd) override;
 	int ObjectCaps() override { return CBaseEntity::ObjectCaps() & ~FCAP_ACROSS_TRANSITION; }
+	void UpdateOnRemove() override;
 
 	bool Save(CSave& save) override;
 	bool Restore(CRestore& restore) override;
 	static TYPEDESCRIPTION m_SaveData[];
 
+	bool IsClientSide() { return m_iMode != RAIN_MODE_BEAMS; }
+	void SendWeather(CBasePlayer* pPlayer); // NULL = all players
+	void SendWeatherOrigin();
+	float UpdateDelay();
+
 	STATE m_iState;
 	int m_spriteTexture;
 	int m_iszSpriteName; // have to saverestore this, the beams keep a link to it
@@ -3291,11 +3307,15 @@ public:
 	int m_iExtent;
 	float m_fLifeTime;
 	int m_iNoise;
+	int m_iMode;
+	float m_flNextFire;		// client modes: when to fire our target next, or 0
+	Vector m_vecSentOrigin; // client modes: where the clients think we are; don't saverestore this
 
 	STATE GetState() override { return m_iState; };
 };
 
 LINK_ENTITY_TO_CLASS(env_rain, CEnvRain);
+LINK_ENTITY_TO_CLASS(env_snow, CEnvRain);
 
 TYPEDESCRIPTION CEnvRain::m_SaveData[] =
 	{
@@ -3313,6 +3333,8 @@ TYPEDESCRIPTION CEnvRain::m_SaveData[] =
 		DEFINE_FIELD(CEnvRain, m_iExtent, FIELD_INTEGER),
 		DEFINE_FIELD(CEnvRain, m_fLifeTime, FIELD_FLOAT),
 		DEFINE_FIELD(CEnvRain, m_iNoise, FIELD_INTEGER),
+		DEFINE_FIELD(CEnvRain, m_iMode, FIELD_INTEGER),
+		DEFINE_FIELD(CEnvRain, m_flNextFire, FIELD_TIME),
 };
 
 IMPLEMENT_SAVERESTORE(CEnvRain, CBaseEntity);
@@ -3386,6 +3408,11 @@ bool CEnvRain::KeyValue(KeyValueData* pkvd)
 		m_iNoise = atoi(pkvd->szValue);
 		return true;
 	}
+	else if (FStrEq(pkvd->szKeyName, "m_iMode"))
+	{
+		m_iMode = atoi(pkvd->szValue);
+		return true;
+	}
 	return CBaseEntity::KeyValue(pkvd);
 }
 
@@ -3403,7 +3430,11 @@ void CEnvRain::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE useTy
 	{
 		m_iState = STATE_ON;
 		SetNextThink(0.1);
+		m_flNextFire = FStringNull(pev->target) ? 0 : gpGlobals->time + 0.1;
 	}
+
+	if (IsClientSide())
+		SendWeather(NULL);
 }
 
 #define SF_RAIN_START_OFF 1
@@ -3426,13 +3457,119 @@ void CEnvRain::Spawn()
 	if (m_burstSize == 0) // in case the level designer forgot to set it.
 		m_burstSize = 2;
 
+	// env_snow has never had a beam mode, so it's always simulated on the client.
+	if (m_iMode == RAIN_MODE_BEAMS && FClassnameIs(pev, "env_snow"))
+		m_iMode = RAIN_MODE_CLIENT_SNOW;
+
 	if (FBitSet(pev->spawnflags, SF_RAIN_START_OFF))
 		m_iState = STATE_OFF;
 	else
 	{
 		m_iState = STATE_ON;
 		SetNextThink(0.1);
+		m_flNextFire = FStringNull(pev->target) ? 0 : gpGlobals->time + 0.1;
+	}
+}
+
+// the time between updates, as used by the beam drips and the "fire on updating" target.
+float CEnvRain::UpdateDelay()
+{
+	if (m_flMaxUpdateTime != 0)
+		return RANDOM_FLOAT(m_flMaxUpdateTime, m_flUpdateTime);
+	return m_flUpdateTime;
+}
+
+// Tells the client(s) everything they need to simulate the drips themselves. This replaces
+// the stream of per-drip beam messages, so it's only sent when something actually changes.
+void CEnvRain::SendWeather(CBasePlayer* pPlayer)
+{
+	if (pPlayer)
+		MESSAGE_BEGIN(MSG_ONE, gmsgWeather, NULL, pPlayer->pev);
+	else
+		MESSAGE_BEGIN(MSG_ALL, gmsgWeather);
+
+	WRITE_SHORT(entindex());
+	if (m_iState != STATE_ON)
+	{
+		WRITE_BYTE(0); // switched off, the client can throw this one away
+		MESSAGE_END();
+		return;
+	}
+
+	UTIL_MakeVectors(pev->angles);
+	Vector vecDir = gpGlobals->v_forward;
+
+	// how many drips per second, averaged over the update times the mapper asked for
+	float fDelay = (m_flUpdateTime + (m_flMaxUpdateTime != 0 ? m_flMaxUpdateTime : m_flUpdateTime)) / 2;
+	int iRepeats = (m_fLifeTime == 0 && m_flUpdateTime == 0 && m_flMaxUpdateTime == 0) ? m_burstSize * 3 : m_burstSize;
+	float fDensity = (fDelay > 0) ? iRepeats / fDelay : iRepeats;
+
+	WRITE_BYTE(m_iMode);
+	WRITE_COORD(pev->mins.x); // relative to the origin, so a move only has to send that
+	WRITE_COORD(pev->mins.y);
+	WRITE_COORD(pev->mins.z);
+	WRITE_COORD(pev->maxs.x);
+	WRITE_COORD(pev->maxs.y);
+	WRITE_COORD(pev->maxs.z);
+	WRITE_COORD(pev->origin.x);
+	WRITE_COORD(pev->origin.y);
+	WRITE_COORD(pev->origin.z);
+	WRITE_SHORT(vecDir.x * 4096); // fall direction, 4.12 fixed point
+	WRITE_SHORT(vecDir.y * 4096);
+	WRITE_SHORT(vecDir.z * 4096);
+	WRITE_BYTE(m_axis);
+	WRITE_BYTE(m_iExtent);
+	WRITE_SHORT(V_min(fDensity, 32767.0f));
+	WRITE_SHORT(m_minDripSpeed);
+	WRITE_SHORT(m_maxDripSpeed);
+	WRITE_BYTE(m_dripSize);
+	WRITE_BYTE(m_brightness);
+	WRITE_BYTE((int)pev->rendercolor.x);
+	WRITE_BYTE((int)pev->rendercolor.y);
+	WRITE_BYTE((int)pev->rendercolor.z);
+	WRITE_STRING(STRING(m_iszSpriteName));
+	MESSAGE_END();
+
+	m_vecSentOrigin = pev->origin;
+}
+
+// a moving or parented emitter takes its volume with it; the clients move the drops they've got
+void CEnvRain::SendWeatherOrigin()
+{
+	MESSAGE_BEGIN(MSG_ALL, gmsgWeather);
+	WRITE_SHORT(entindex());
+	WRITE_BYTE(RAIN_MSG_MOVE);
+	WRITE_COORD(pev->origin.x);
+	WRITE_COORD(pev->origin.y);
+	WRITE_COORD(pev->origin.z);
+	MESSAGE_END();
+
+	m_vecSentOrigin = pev->origin;
+}
+
+// the clients would keep simulating a removed emitter forever, so tell them it's gone
+void CEnvRain::UpdateOnRemove()
+{
+	if (IsClientSide() && m_iState == STATE_ON)
+	{
+		m_iState = STATE_OFF;
+		SendWeather(NULL);
 	}
+
+	CBaseEntity::UpdateOnRemove();
+}
+
+void SendWeatherInitMessages(CBasePlayer* pPlayer)
+{
+	CBaseEntity* pEntity = NULL;
+	while ((pEntity = UTIL_FindEntityByClassname(pEntity, "env_rain")) != NULL)
+	{
+		CEnvRain* pRain = (CEnvRain*)pEntity;
+		if (pRain->IsClientSide())
+			pRain->SendWeather(pPlayer);
+	}
+	while ((pEntity = UTIL_FindEntityByClassname(pEntity, "env_snow")) != NULL)
+		((CEnvRain*)pEntity)->SendWeather(pPlayer);
 }
 
 void CEnvRain::Think()
@@ -3440,6 +3577,28 @@ void CEnvRain::Think()
 	Vector vecSrc;
 	Vector vecDest;
 
+	if (IsClientSide())
+	{
+		// the clients are making the drips, all we have to do is tell them where we are, and keep time.
+		if (pev->origin != m_vecSentOrigin)
+			SendWeatherOrigin();
+
+		if (m_flNextFire != 0 && gpGlobals->time >= m_flNextFire)
+		{
+			FireTargets(STRING(pev->target), this, this, USE_TOGGLE, 0);
+			if (m_flUpdateTime != 0 || m_flMaxUpdateTime != 0)
+				m_flNextFire = gpGlobals->time + UpdateDelay();
+			else
+				m_flNextFire = 0;
+		}
+
+		if (m_flNextFire != 0)
+			SetNextThink(V_min(RAIN_MOVE_POLL, m_flNextFire - gpGlobals->time));
+		else
+			SetNextThink(RAIN_MOVE_POLL);
+		return;
+	}
+
 	UTIL_MakeVectors(pev->angles);
 	Vector vecOffs = gpGlobals->v_forward;
 	switch (m_axis)
@@ -3543,10 +3702,8 @@ void CEnvRain::Think()
 	if (!FStringNull(pev->target) && drawn != 0)
 		FireTargets(STRING(pev->target), this, this, USE_TOGGLE, 0);
 
-	if (m_flMaxUpdateTime != 0)
-		SetNextThink(RANDOM_FLOAT(m_flMaxUpdateTime, m_flUpdateTime));
-	else if (m_flUpdateTime != 0)
-		SetNextThink(m_flUpdateTime);
+	if (m_flMaxUpdateTime != 0 || m_flUpdateTime != 0)
+		SetNextThink(UpdateDelay());
 }
 
 //==================================================================
@@ -3727,7 +3884,7 @@ void CEnvShockwave::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE
 {
 	Vector vecPos;
 	if (!FStringNull(m_iszPosition))
-		vecPos = CalcLocus_Position(this, pActivator, STRING(m_iszPosition));
+		vecPos = CalcLocus_Position(this, pActivator, m_iszPosition);
 	else
 		vecPos = pev->origin;
 
@@ -3842,7 +3999,7 @@ void CEnvDLight::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE use
 
 	if (!FStringNull(pev->message))
 	{
-		m_vecPos = CalcLocus_Position(this, pActivator, STRING(pev->message));
+		m_vecPos = CalcLocus_Position(this, pActivator, pev->message);
 	}
 	else
 	{
@@ -4018,13 +4175,13 @@ void CEnvDecal::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE useT
 
 	Vector vecPos;
 	if (!FStringNull(pev->target))
-		vecPos = CalcLocus_Position(this, pActivator, STRING(pev->target));
+		vecPos = CalcLocus_Position(this, pActivator, pev->target);
 	else
 		vecPos = pev->origin;
 
 	Vector vecOffs;
 	if (!FStringNull(pev->netname))
-		vecOffs = CalcLocus_Velocity(this, pActivator, STRING(pev->netname));
+		vecOffs = CalcLocus_Velocity(this, pActivator, pev->netname);
 	else
 	{
 		UTIL_MakeVectors(pev->angles);
@@ -4032,7 +4189,7 @@ void CEnvDecal::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE useT
 	}
 
 	if (!FStringNull(pev->message))
-		vecOffs = vecOffs * CalcLocus_Ratio(pActivator, STRING(pev->message));
+		vecOffs = vecOffs * CalcLocus_Ratio(pActivator, pev->message);
 	else
 		vecOffs = vecOffs.Normalize() * 4000;
 
@@ -4105,7 +4262,7 @@ void CEnvBeverage::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE u
 
 	Vector vecPos;
 	if (!FStringNull(pev->target))
-		vecPos = CalcLocus_Position(this, pActivator, STRING(pev->target));
+		vecPos = CalcLocus_Position(this, pActivator, pev->target);
 	else
 		vecPos = pev->origin;
 
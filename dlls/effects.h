@@ -233,3 +233,6 @@ public:
 	int m_iszStartPosition;
 	int m_iTowardsMode;
 };
+
+// env_rain/env_snow: tell a newly initialised client about any weather it should be simulating.
+void SendWeatherInitMessages(CBasePlayer* pPlayer);
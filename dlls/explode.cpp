@@ -165,7 +165,7 @@ void CEnvExplosion::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE
 	}
 	else
 	{
-		vecSpot = CalcLocus_Position(this, pActivator, STRING(pev->target));
+		vecSpot = CalcLocus_Position(this, pActivator, pev->target);
 	}
 
 	UTIL_TraceLine(vecSpot + Vector(0, 0, 8), vecSpot + Vector(0, 0, -32), ignore_monsters, ENT(pev), &tr);
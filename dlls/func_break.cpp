@@ -900,7 +900,7 @@ void CBreakable::Die()
 
 	// If I'm getting removed, don't fire something that could fire myself
 	if (m_iRespawnTime == 0)
-		pev->targetname = 0;
+		UTIL_SetTargetname(this, 0);
 
 	pev->solid = SOLID_NOT;
 	pev->effects |= EF_NODRAW;
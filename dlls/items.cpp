@@ -78,7 +78,7 @@ void CWorldItem::Spawn()
 	else
 	{
 		pEntity->pev->target = pev->target;
-		pEntity->pev->targetname = pev->targetname;
+		UTIL_SetTargetname(pEntity, pev->targetname);
 		pEntity->pev->spawnflags = pev->spawnflags;
 	}
 
@@ -68,6 +68,218 @@ float CalcLocus_Ratio(CBaseEntity* pLocus, const char* szText)
 	return 0; // we need some signal for "fail". NaN, maybe?
 }
 
+//=============================================
+// Compiled locus values
+//
+// Most calc values are fixed keyvalues, and entities like env_beam and
+// motion_manager evaluate them every think. So each value is parsed once,
+// the first time it's used, and references to calc_ entities are bound to
+// an EHANDLE. A chain of calc_ entities then becomes a walk through their own
+// compiled values.
+//=============================================
+
+int g_iLocusGeneration = 0;
+
+#define LOCUS_CONSTANT 0  // a number or a vector
+#define LOCUS_RANDOM 1	  // "x y z .. x y z"
+#define LOCUS_REFERENCE 2 // a plain targetname; bound to m_hEntity
+#define LOCUS_DYNAMIC 3	  // "*locus", aliases and group references; looked up every time
+
+struct locus_expr_t
+{
+	string_t iszSource;
+	int iType;
+	float fRatio;	// LOCUS_CONSTANT
+	Vector vecMin;	// LOCUS_CONSTANT, LOCUS_RANDOM
+	Vector vecMax;	// LOCUS_RANDOM
+	EHANDLE hEntity;	   // LOCUS_REFERENCE
+	string_t iszBoundName; // hEntity's targetname when it was found; if that changes, it's been renamed
+	int iGeneration;	   // value of g_iLocusGeneration when hEntity was found
+	locus_expr_t* pNext;
+};
+
+#define LOCUS_HASH_SIZE 256
+
+static locus_expr_t* g_pLocusHash[LOCUS_HASH_SIZE];
+
+// which names have been looked up, by UTIL_HashTargetname. Two names can share a slot; that only means
+// a few more lookups.
+#define LOCUS_NAME_HASH_SIZE 1024
+
+static bool g_fLocusBoundName[LOCUS_NAME_HASH_SIZE];
+
+// the same parse as UTIL_StringToRandomVector, but it keeps both ends of the range instead of picking a value.
+static bool ParseLocusVector(const char* szText, Vector& vecMin, Vector& vecMax)
+{
+	char* pstr;
+	char* pfront;
+	char tempString[128];
+	int j;
+
+	strncpy(tempString, szText, sizeof(tempString) - 1);
+	tempString[sizeof(tempString) - 1] = 0;
+	pstr = pfront = tempString;
+
+	for (j = 0; j < 3; j++)
+	{
+		vecMin[j] = atof(pfront);
+
+		while (*pstr != 0 && *pstr != ' ')
+			pstr++;
+		if (*pstr == 0)
+			break;
+		pstr++;
+		pfront = pstr;
+	}
+	if (j < 2)
+	{
+		for (j = j + 1; j < 3; j++)
+			vecMin[j] = 0;
+		return false;
+	}
+	if (pstr[0] != '.' || pstr[1] != '.' || pstr[2] != ' ')
+		return false;
+
+	UTIL_StringToVector((float*)vecMax, pstr + 2);
+	return true;
+}
+
+static locus_expr_t* CompileLocus(string_t iszText)
+{
+	unsigned int iHash = (iszText * 2654435761u) >> 24; // top 8 bits
+	locus_expr_t* pExpr;
+
+	for (pExpr = g_pLocusHash[iHash]; pExpr; pExpr = pExpr->pNext)
+	{
+		if (pExpr->iszSource == iszText)
+			return pExpr;
+	}
+
+	pExpr = new locus_expr_t;
+	pExpr->iszSource = iszText;
+	pExpr->fRatio = 0;
+	pExpr->vecMin = pExpr->vecMax = g_vecZero;
+	pExpr->iszBoundName = 0;
+	pExpr->iGeneration = -1;
+
+	const char* szText = STRING(iszText);
+	if ((*szText >= '0' && *szText <= '9') || *szText == '-')
+	{
+		pExpr->fRatio = atof(szText);
+		if (ParseLocusVector(szText, pExpr->vecMin, pExpr->vecMax))
+			pExpr->iType = LOCUS_RANDOM;
+		else
+			pExpr->iType = LOCUS_CONSTANT;
+	}
+	else if (*szText == '*' || strchr(szText, '.'))
+		pExpr->iType = LOCUS_DYNAMIC;
+	else
+		pExpr->iType = LOCUS_REFERENCE;
+
+	pExpr->pNext = g_pLocusHash[iHash];
+	g_pLocusHash[iHash] = pExpr;
+	return pExpr;
+}
+
+static CBaseEntity* FindLocusEntity(locus_expr_t* pExpr, CBaseEntity* pLocus)
+{
+	if (pExpr->iType == LOCUS_DYNAMIC)
+		return UTIL_FindEntityByTargetname(NULL, STRING(pExpr->iszSource), pLocus);
+
+	// still the same entity, with the same name, and nothing new has spawned that could come before it?
+	CBaseEntity* pEntity = pExpr->hEntity;
+	if (pEntity && pExpr->iGeneration == g_iLocusGeneration && pEntity->pev->targetname == pExpr->iszBoundName)
+		return pEntity;
+
+	if (pExpr->iGeneration == -1)
+		g_fLocusBoundName[UTIL_HashTargetname(STRING(pExpr->iszSource)) % LOCUS_NAME_HASH_SIZE] = true;
+
+	pEntity = UTIL_FindEntityByTargetname(NULL, STRING(pExpr->iszSource), pLocus);
+	pExpr->hEntity = pEntity;
+	pExpr->iszBoundName = pEntity ? pEntity->pev->targetname : 0;
+	pExpr->iGeneration = g_iLocusGeneration;
+	return pEntity;
+}
+
+static Vector EvalLocusVector(locus_expr_t* pExpr)
+{
+	if (pExpr->iType == LOCUS_RANDOM)
+	{
+		return Vector(
+			RANDOM_FLOAT(pExpr->vecMin.x, pExpr->vecMax.x),
+			RANDOM_FLOAT(pExpr->vecMin.y, pExpr->vecMax.y),
+			RANDOM_FLOAT(pExpr->vecMin.z, pExpr->vecMax.z));
+	}
+	return pExpr->vecMin;
+}
+
+Vector CalcLocus_Position(CBaseEntity* pEntity, CBaseEntity* pLocus, string_t iszText)
+{
+	locus_expr_t* pExpr = CompileLocus(iszText);
+	if (pExpr->iType <= LOCUS_RANDOM)
+		return EvalLocusVector(pExpr);
+
+	CBaseEntity* pCalc = FindLocusEntity(pExpr, pLocus);
+	if (pCalc != NULL)
+		return pCalc->CalcPosition(pLocus);
+
+	ALERT(at_error, "%s \"%s\" has bad or missing calc_position value \"%s\"\n", STRING(pEntity->pev->classname), STRING(pEntity->pev->targetname), STRING(iszText));
+	return g_vecZero;
+}
+
+Vector CalcLocus_Velocity(CBaseEntity* pEntity, CBaseEntity* pLocus, string_t iszText)
+{
+	locus_expr_t* pExpr = CompileLocus(iszText);
+	if (pExpr->iType <= LOCUS_RANDOM)
+		return EvalLocusVector(pExpr);
+
+	CBaseEntity* pCalc = FindLocusEntity(pExpr, pLocus);
+	if (pCalc != NULL)
+		return pCalc->CalcVelocity(pLocus);
+
+	ALERT(at_error, "%s \"%s\" has bad or missing calc_velocity value \"%s\"\n", STRING(pEntity->pev->classname), STRING(pEntity->pev->targetname), STRING(iszText));
+	return g_vecZero;
+}
+
+float CalcLocus_Ratio(CBaseEntity* pLocus, string_t iszText)
+{
+	locus_expr_t* pExpr = CompileLocus(iszText);
+	if (pExpr->iType <= LOCUS_RANDOM)
+		return pExpr->fRatio;
+
+	CBaseEntity* pCalc = FindLocusEntity(pExpr, pLocus);
+	if (pCalc != NULL)
+		return pCalc->CalcRatio(pLocus);
+
+	ALERT(at_error, "Bad or missing calc_ratio entity \"%s\"\n", STRING(iszText));
+	return 0;
+}
+
+// called when a new level starts
+void ClearCompiledLocus()
+{
+	for (int i = 0; i < LOCUS_HASH_SIZE; i++)
+	{
+		while (g_pLocusHash[i])
+		{
+			locus_expr_t* pExpr = g_pLocusHash[i];
+			g_pLocusHash[i] = pExpr->pNext;
+			delete pExpr;
+		}
+	}
+	memset(g_fLocusBoundName, 0, sizeof(g_fLocusBoundName));
+	g_iLocusGeneration = 0;
+}
+
+void LocusTargetnameChanged(string_t iszName)
+{
+	if (FStringNull(iszName))
+		return;
+
+	if (g_fLocusBoundName[UTIL_HashTargetname(STRING(iszName)) % LOCUS_NAME_HASH_SIZE])
+		g_iLocusGeneration++;
+}
+
 //=============================================
 //locus_x effects
 //=============================================
@@ -272,7 +484,7 @@ void CLocusBeam::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE use
 		break;
 
 	case 1: // pointent
-		vecStartPos = CalcLocus_Position(this, pActivator, STRING(m_iszStart));
+		vecStartPos = CalcLocus_Position(this, pActivator, m_iszStart);
 		pEndEnt = UTIL_FindEntityByTargetname(NULL, STRING(m_iszEnd), pActivator);
 
 		if (pEndEnt == NULL)
@@ -281,15 +493,15 @@ void CLocusBeam::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE use
 		pBeam->PointEntInit(vecStartPos, pEndEnt->entindex());
 		break;
 	case 2: // points
-		vecStartPos = CalcLocus_Position(this, pActivator, STRING(m_iszStart));
-		vecEndPos = CalcLocus_Position(this, pActivator, STRING(m_iszEnd));
+		vecStartPos = CalcLocus_Position(this, pActivator, m_iszStart);
+		vecEndPos = CalcLocus_Position(this, pActivator, m_iszEnd);
 
 		pBeam = CBeam::BeamCreate(STRING(m_iszSprite), m_iWidth);
 		pBeam->PointsInit(vecStartPos, vecEndPos);
 		break;
 	case 3: // point & offset
-		vecStartPos = CalcLocus_Position(this, pActivator, STRING(m_iszStart));
-		vecEndPos = CalcLocus_Velocity(this, pActivator, STRING(m_iszEnd));
+		vecStartPos = CalcLocus_Position(this, pActivator, m_iszStart);
+		vecEndPos = CalcLocus_Velocity(this, pActivator, m_iszEnd);
 
 		pBeam = CBeam::BeamCreate(STRING(m_iszSprite), m_iWidth);
 		pBeam->PointsInit(vecStartPos, vecStartPos + vecEndPos);
@@ -313,7 +525,7 @@ void CLocusBeam::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE use
 			pBeam->SetThink(&CBeam::SUB_Remove);
 			pBeam->SetNextThink(m_fDuration);
 		}
-		pBeam->pev->targetname = m_iszTargetName;
+		UTIL_SetTargetname(pBeam, m_iszTargetName);
 	}
 
 	if (!FStringNull(pev->target))
@@ -353,7 +565,7 @@ Vector CCalcPosition::CalcPosition(CBaseEntity* pLocus)
 {
 	CBaseEntity* pSubject = UTIL_FindEntityByTargetname(NULL, STRING(pev->netname), pLocus);
 
-	Vector vecOffset = CalcLocus_Velocity(this, pLocus, STRING(pev->message));
+	Vector vecOffset = CalcLocus_Velocity(this, pLocus, pev->message);
 
 	Vector vecPosition;
 	Vector vecJunk;
@@ -403,7 +615,7 @@ LINK_ENTITY_TO_CLASS(calc_ratio, CCalcRatio);
 
 float CCalcRatio::CalcRatio(CBaseEntity* pLocus)
 {
-	float fBasis = CalcLocus_Ratio(pLocus, STRING(pev->target));
+	float fBasis = CalcLocus_Ratio(pLocus, pev->target);
 
 	switch (pev->impulse)
 	{
@@ -418,16 +630,16 @@ float CCalcRatio::CalcRatio(CBaseEntity* pLocus)
 		break; //reciprocal
 	}
 
-	fBasis += CalcLocus_Ratio(pLocus, STRING(pev->netname));
-	fBasis = fBasis * CalcLocus_Ratio(pLocus, STRING(pev->message));
+	fBasis += CalcLocus_Ratio(pLocus, pev->netname);
+	fBasis = fBasis * CalcLocus_Ratio(pLocus, pev->message);
 
 	if (!FStringNull(pev->noise))
 	{
-		float fMin = CalcLocus_Ratio(pLocus, STRING(pev->noise));
+		float fMin = CalcLocus_Ratio(pLocus, pev->noise);
 
 		if (!FStringNull(pev->noise1))
 		{
-			float fMax = CalcLocus_Ratio(pLocus, STRING(pev->noise1));
+			float fMax = CalcLocus_Ratio(pLocus, pev->noise1);
 
 			if (fBasis >= fMin && fBasis <= fMax)
 				return fBasis;
@@ -463,7 +675,7 @@ float CCalcRatio::CalcRatio(CBaseEntity* pLocus)
 	}
 	else if (!FStringNull(pev->noise1))
 	{
-		float fMax = CalcLocus_Ratio(pLocus, STRING(pev->noise1));
+		float fMax = CalcLocus_Ratio(pLocus, pev->noise1);
 
 		if (fBasis < fMax)
 			return fBasis;
@@ -526,8 +738,8 @@ Vector CCalcSubVelocity::Convert(CBaseEntity* pLocus, Vector vecDir)
 	if (FBitSet(pev->spawnflags, SF_CALCVELOCITY_NORMALIZE))
 		vecDir = vecDir.Normalize();
 
-	float fRatio = CalcLocus_Ratio(pLocus, STRING(pev->noise));
-	Vector vecOffset = CalcLocus_Velocity(this, pLocus, STRING(pev->message));
+	float fRatio = CalcLocus_Ratio(pLocus, pev->noise);
+	Vector vecOffset = CalcLocus_Velocity(this, pLocus, pev->message);
 
 	Vector vecResult = vecOffset + (vecDir * fRatio);
 
@@ -555,17 +767,17 @@ LINK_ENTITY_TO_CLASS(calc_velocity_path, CCalcVelocityPath);
 
 Vector CCalcVelocityPath::CalcVelocity(CBaseEntity* pLocus)
 {
-	Vector vecStart = CalcLocus_Position(this, pLocus, STRING(pev->target));
+	Vector vecStart = CalcLocus_Position(this, pLocus, pev->target);
 	Vector vecOffs;
-	float fFactor = CalcLocus_Ratio(pLocus, STRING(pev->noise));
+	float fFactor = CalcLocus_Ratio(pLocus, pev->noise);
 
 	switch ((int)pev->armorvalue)
 	{
 	case 0:
-		vecOffs = CalcLocus_Position(this, pLocus, STRING(pev->netname)) - vecStart;
+		vecOffs = CalcLocus_Position(this, pLocus, pev->netname) - vecStart;
 		break;
 	case 1:
-		vecOffs = CalcLocus_Velocity(this, pLocus, STRING(pev->netname));
+		vecOffs = CalcLocus_Velocity(this, pLocus, pev->netname);
 		break;
 	}
 
@@ -629,11 +841,11 @@ LINK_ENTITY_TO_CLASS(calc_velocity_polar, CCalcVelocityPolar);
 
 Vector CCalcVelocityPolar::CalcVelocity(CBaseEntity* pLocus)
 {
-	Vector vecBasis = CalcLocus_Velocity(this, pLocus, STRING(pev->netname));
+	Vector vecBasis = CalcLocus_Velocity(this, pLocus, pev->netname);
 	Vector vecAngles = UTIL_VecToAngles(vecBasis) + pev->angles;
-	Vector vecOffset = CalcLocus_Velocity(this, pLocus, STRING(pev->message));
+	Vector vecOffset = CalcLocus_Velocity(this, pLocus, pev->message);
 
-	float fFactor = CalcLocus_Ratio(pLocus, STRING(pev->noise));
+	float fFactor = CalcLocus_Ratio(pLocus, pev->noise);
 
 	if (!FBitSet(pev->spawnflags, SF_CALCVELOCITY_NORMALIZE))
 		fFactor = fFactor * vecBasis.Length();
@@ -734,11 +946,11 @@ void CLocusVariable::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE
 	Vector vecDir = g_vecZero;
 	float fRatio = 0;
 	if (!FStringNull(m_iszPosition))
-		vecPos = CalcLocus_Position(this, pActivator, STRING(m_iszPosition));
+		vecPos = CalcLocus_Position(this, pActivator, m_iszPosition);
 	if (!FStringNull(m_iszVelocity))
-		vecDir = CalcLocus_Velocity(this, pActivator, STRING(m_iszVelocity));
+		vecDir = CalcLocus_Velocity(this, pActivator, m_iszVelocity);
 	if (!FStringNull(m_iszRatio))
-		fRatio = CalcLocus_Ratio(pActivator, STRING(m_iszRatio));
+		fRatio = CalcLocus_Ratio(pActivator, m_iszRatio);
 
 	if (!FStringNull(m_iszTargetName))
 	{
@@ -747,7 +959,7 @@ void CLocusVariable::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE
 		pMark->pev->origin = vecPos;
 		pMark->pev->movedir = vecDir;
 		pMark->pev->frags = fRatio;
-		pMark->pev->targetname = m_iszTargetName;
+		UTIL_SetTargetname(pMark, m_iszTargetName);
 		pMark->SetNextThink(m_fDuration);
 
 		FireTargets(STRING(m_iszFireOnSpawn), pMark, this, USE_TOGGLE, 0);
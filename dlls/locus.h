@@ -1,3 +1,14 @@
 Vector CalcLocus_Position(CBaseEntity* pEntity, CBaseEntity* pLocus, const char* szText);
 Vector CalcLocus_Velocity(CBaseEntity* pEntity, CBaseEntity* pLocus, const char* szText);
 float CalcLocus_Ratio(CBaseEntity* pLocus, const char* szText);
+
+// as above, but the value is only parsed (and any calc_ entity only looked up) the first time
+Vector CalcLocus_Position(CBaseEntity* pEntity, CBaseEntity* pLocus, string_t iszText);
+Vector CalcLocus_Velocity(CBaseEntity* pEntity, CBaseEntity* pLocus, string_t iszText);
+float CalcLocus_Ratio(CBaseEntity* pLocus, string_t iszText);
+void ClearCompiledLocus();
+
+// an entity has just gained or lost this targetname, so calc_ references to it need looking up again
+void LocusTargetnameChanged(string_t iszName);
+
+extern int g_iLocusGeneration; // incremented whenever an entity gains or loses a name that's been looked up
@@ -266,10 +266,10 @@ CBaseMonster* CMonsterMaker::MakeMonster()
 		pMonst->m_iPlayerReact = this->m_iPlayerReact;
 	}
 
-	if (!FStringNull(pev->netname))
+	if (pEntity && !FStringNull(pev->netname))
 	{
 		// if I have a netname (overloaded), give the child monster that name as a targetname
-		pevCreate->targetname = pev->netname;
+		UTIL_SetTargetname(pEntity, pev->netname);
 	}
 
 	m_cLiveChildren++; // count this monster
@@ -294,6 +294,8 @@ public:
 	virtual void GoDown();
 	virtual void HitTop();
 	virtual void HitBottom();
+
+	bool PublishesState() override { return true; } //LRC
 };
 LINK_ENTITY_TO_CLASS(func_plat, CFuncPlat);
 
@@ -387,7 +389,7 @@ void CFuncPlat::Spawn()
 			UTIL_AssignOrigin(this, m_vecPosition1 + m_pMoveWith->pev->origin);
 		else
 			UTIL_AssignOrigin(this, m_vecPosition1);
-		m_toggle_state = TS_AT_TOP;
+		ChangeToggleState(TS_AT_TOP);
 		SetUse(&CFuncPlat::PlatUse);
 	}
 	else
@@ -396,7 +398,7 @@ void CFuncPlat::Spawn()
 			UTIL_AssignOrigin(this, m_vecPosition2 + m_pMoveWith->pev->origin);
 		else
 			UTIL_AssignOrigin(this, m_vecPosition2);
-		m_toggle_state = TS_AT_BOTTOM;
+		ChangeToggleState(TS_AT_BOTTOM);
 	}
 }
 
@@ -515,7 +517,7 @@ void CFuncPlat::GoDown()
 		EMIT_SOUND(ENT(pev), CHAN_STATIC, (char*)STRING(pev->noiseMovement), m_volume, ATTN_NORM);
 
 	ASSERT(m_toggle_state == TS_AT_TOP || m_toggle_state == TS_GOING_UP);
-	m_toggle_state = TS_GOING_DOWN;
+	ChangeToggleState(TS_GOING_DOWN);
 	SetMoveDone(&CFuncPlat::CallHitBottom);
 	LinearMove(m_vecPosition2, pev->speed);
 }
@@ -533,7 +535,7 @@ void CFuncPlat::HitBottom()
 		EMIT_SOUND(ENT(pev), CHAN_WEAPON, (char*)STRING(pev->noiseStopMoving), m_volume, ATTN_NORM);
 
 	ASSERT(m_toggle_state == TS_GOING_DOWN);
-	m_toggle_state = TS_AT_BOTTOM;
+	ChangeToggleState(TS_AT_BOTTOM);
 }
 
 
@@ -546,7 +548,7 @@ void CFuncPlat::GoUp()
 		EMIT_SOUND(ENT(pev), CHAN_STATIC, (char*)STRING(pev->noiseMovement), m_volume, ATTN_NORM);
 
 	ASSERT(m_toggle_state == TS_AT_BOTTOM || m_toggle_state == TS_GOING_DOWN);
-	m_toggle_state = TS_GOING_UP;
+	ChangeToggleState(TS_GOING_UP);
 	SetMoveDone(&CFuncPlat::CallHitTop);
 	LinearMove(m_vecPosition1, pev->speed);
 }
@@ -564,7 +566,7 @@ void CFuncPlat::HitTop()
 		EMIT_SOUND(ENT(pev), CHAN_WEAPON, (char*)STRING(pev->noiseStopMoving), m_volume, ATTN_NORM);
 
 	ASSERT(m_toggle_state == TS_GOING_UP);
-	m_toggle_state = TS_AT_TOP;
+	ChangeToggleState(TS_AT_TOP);
 
 	if (!IsTogglePlat())
 	{
@@ -2171,14 +2173,14 @@ void CFuncTrackChange::Spawn()
 	if (FBitSet(pev->spawnflags, SF_TRACK_STARTBOTTOM))
 	{
 		UTIL_SetOrigin(this, m_vecPosition2);
-		m_toggle_state = TS_AT_BOTTOM;
+		ChangeToggleState(TS_AT_BOTTOM);
 		pev->angles = m_start;
 		m_targetState = TS_AT_TOP;
 	}
 	else
 	{
 		UTIL_SetOrigin(this, m_vecPosition1);
-		m_toggle_state = TS_AT_TOP;
+		ChangeToggleState(TS_AT_TOP);
 		pev->angles = m_end;
 		m_targetState = TS_AT_BOTTOM;
 	}
@@ -2345,7 +2347,7 @@ void CFuncTrackChange::GoDown()
 	if (FBitSet(pev->spawnflags, SF_TRACK_DONT_MOVE))
 	{
 		SetMoveDone(&CFuncTrackChange::CallHitBottom);
-		m_toggle_state = TS_GOING_DOWN;
+		ChangeToggleState(TS_GOING_DOWN);
 		AngularMove(m_start, pev->speed);
 	}
 	else
@@ -2390,7 +2392,7 @@ void CFuncTrackChange::GoUp()
 	UpdateAutoTargets(TS_GOING_UP);
 	if (FBitSet(pev->spawnflags, SF_TRACK_DONT_MOVE))
 	{
-		m_toggle_state = TS_GOING_UP;
+		ChangeToggleState(TS_GOING_UP);
 		SetMoveDone(&CFuncTrackChange::CallHitTop);
 		AngularMove(m_end, pev->speed);
 	}
@@ -4054,6 +4054,8 @@ void CBasePlayer::UpdateClientData()
 		FireTargets("game_playerspawn", this, this, USE_TOGGLE, 0);
 
 		InitStatusBar();
+
+		SendWeatherInitMessages(this);
 	}
 
 	if (m_iHideHUD != m_iClientHideHUD)
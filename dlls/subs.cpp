@@ -86,6 +86,15 @@ STATE CBaseDMStart::GetState(CBaseEntity* pEntity)
 		return STATE_OFF;
 }
 
+//LRC- tell the StateListeners (multi_watchers etc) that our state may have changed.
+void CBaseEntity::StateChanged()
+{
+	if (FStringNull(pev->targetname))
+		return; // nobody can be watching us
+
+	UTIL_NotifyStateListeners(this);
+}
+
 // This updates global tables that need to know about entities being removed
 void CBaseEntity::UpdateOnRemove()
 {
@@ -98,6 +107,10 @@ void CBaseEntity::UpdateOnRemove()
 		return;
 	}
 
+	//LRC - anything watching this entity will have to look for a new one.
+	StateChanged();
+	UTIL_RemoveFromStateListeners(this);
+
 	//LRC - remove this from the AssistList.
 	for (pTemp = g_pWorld; pTemp->m_pAssistLink != NULL; pTemp = pTemp->m_pAssistLink)
 	{
@@ -242,11 +255,36 @@ void CBaseEntity::SUB_UseTargets(CBaseEntity* pActivator, USE_TYPE useType, floa
 	//
 	if (!FStringNull(pev->target))
 	{
-		FireTargets(STRING(pev->target), pActivator, this, useType, value);
+		FireTargets(pev->target, pActivator, this, useType, value);
 	}
 }
 
 
+// fire a list of targets that's already been found: pTarget is the first of them.
+static void FireTargetList(CBaseEntity* pTarget, const char* targetName, CBaseEntity* pActivator, CBaseEntity* inputActivator, CBaseEntity* pCaller, USE_TYPE useType, float value)
+{
+	do // start firing targets
+	{
+		if ((pTarget->pev->flags & FL_KILLME) == 0) // Don't use dying ents
+		{
+			if (useType == USE_KILL)
+			{
+				ALERT(at_aiconsole, "Use_kill on %s\n", STRING(pTarget->pev->classname));
+				UTIL_Remove(pTarget);
+			}
+			else
+			{
+				ALERT(at_aiconsole, "Found: %s, firing (%s)\n", STRING(pTarget->pev->classname), targetName);
+				pTarget->Use(pActivator, pCaller, useType, value);
+			}
+		}
+		pTarget = UTIL_FindEntityByTargetname(pTarget, targetName, inputActivator);
+	} while (!FNullEnt(pTarget));
+
+	//LRC- Firing has finished, aliases can now reflect their new values.
+	UTIL_FlushAliases();
+}
+
 void FireTargets(const char* targetName, CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE useType, float value)
 {
 	const char* inputTargetName = targetName;
@@ -316,26 +354,130 @@ void FireTargets(const char* targetName, CBaseEntity* pActivator, CBaseEntity* p
 			return; // it's a locus specifier all right, but the target's invalid.
 	}
 
-	do // start firing targets
+	FireTargetList(pTarget, targetName, pActivator, inputActivator, pCaller, useType, value);
+}
+
+//LRC- a target value, parsed once and then kept for the rest of the level.
+// Strings in the engine's string table never change, so the string_t is enough to find it again.
+struct target_expr_t
+{
+	string_t iszSource;	  // the value this was compiled from
+	USE_TYPE useType;	  // from a '+' or '-' prefix; USE_SAME if there wasn't one
+	const char* szName;	  // the whole value, minus any prefix
+	char* szLocusTarget;  // for "target(locus)" values, the two halves. NULL otherwise.
+	char* szLocus;
+	target_expr_t* pNext; // next in this hash bucket
+};
+
+#define TARGET_HASH_SIZE 256
+
+static target_expr_t* g_pTargetHash[TARGET_HASH_SIZE];
+
+static char* CopySubString(const char* szStart, int iLength)
+{
+	char* szResult = new char[iLength + 1];
+	strncpy(szResult, szStart, iLength);
+	szResult[iLength] = 0;
+	return szResult;
+}
+
+static target_expr_t* CompileTarget(string_t iszTarget)
+{
+	unsigned int iHash = (iszTarget * 2654435761u) >> 24; // top 8 bits
+	target_expr_t* pExpr;
+
+	for (pExpr = g_pTargetHash[iHash]; pExpr; pExpr = pExpr->pNext)
 	{
-		if ((pTarget->pev->flags & FL_KILLME) == 0) // Don't use dying ents
+		if (pExpr->iszSource == iszTarget)
+			return pExpr;
+	}
+
+	pExpr = new target_expr_t;
+	pExpr->iszSource = iszTarget;
+	pExpr->useType = USE_SAME;
+	pExpr->szLocusTarget = NULL;
+	pExpr->szLocus = NULL;
+
+	const char* szName = STRING(iszTarget);
+	if (szName[0] == '+')
+	{
+		szName++;
+		pExpr->useType = USE_ON;
+	}
+	else if (szName[0] == '-')
+	{
+		szName++;
+		pExpr->useType = USE_OFF;
+	}
+	pExpr->szName = szName;
+
+	// check for a locus specifier, e.g: "fadein(mywall)"
+	const char* szOpen = strchr(szName, '(');
+	if (szOpen)
+	{
+		const char* szClose = strchr(szOpen, ')');
+		if (szClose)
 		{
-			if (useType == USE_KILL)
-			{
-				ALERT(at_aiconsole, "Use_kill on %s\n", STRING(pTarget->pev->classname));
-				UTIL_Remove(pTarget);
-			}
-			else
-			{
-				ALERT(at_aiconsole, "Found: %s, firing (%s)\n", STRING(pTarget->pev->classname), targetName);
-				pTarget->Use(pActivator, pCaller, useType, value);
-			}
+			pExpr->szLocusTarget = CopySubString(szName, szOpen - szName);
+			pExpr->szLocus = CopySubString(szOpen + 1, szClose - szOpen - 1);
 		}
-		pTarget = UTIL_FindEntityByTargetname(pTarget, targetName, inputActivator);
-	} while (!FNullEnt(pTarget));
+		else
+			ALERT(at_error, "Missing ')' in target value \"%s\"", STRING(iszTarget));
+	}
 
-	//LRC- Firing has finished, aliases can now reflect their new values.
-	UTIL_FlushAliases();
+	pExpr->pNext = g_pTargetHash[iHash];
+	g_pTargetHash[iHash] = pExpr;
+	return pExpr;
+}
+
+//LRC- called when a new level starts; the old string_ts don't mean anything any more.
+void ClearCompiledTargets()
+{
+	for (int i = 0; i < TARGET_HASH_SIZE; i++)
+	{
+		while (g_pTargetHash[i])
+		{
+			target_expr_t* pExpr = g_pTargetHash[i];
+			g_pTargetHash[i] = pExpr->pNext;
+			delete[] pExpr->szLocusTarget;
+			delete[] pExpr->szLocus;
+			delete pExpr;
+		}
+	}
+}
+
+//LRC- as above, but for a value in the string table, which only has to be parsed the first time it's fired.
+// (The const char* version is still there for strings that get built on the fly.)
+void FireTargets(string_t iszTarget, CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE useType, float value)
+{
+	if (useType == USE_NOT)
+		return;
+
+	const target_expr_t* pExpr = CompileTarget(iszTarget);
+	if (pExpr->useType != USE_SAME)
+		useType = pExpr->useType;
+
+	ALERT(at_aiconsole, "Firing: (%s)\n", pExpr->szName);
+
+	const char* targetName = pExpr->szName;
+	CBaseEntity* inputActivator = pActivator;
+	CBaseEntity* pTarget = UTIL_FindEntityByTargetname(NULL, targetName, pActivator);
+	if (!pTarget)
+	{
+		if (!pExpr->szLocus)
+			return; // no, it's not a locus specifier.
+
+		pActivator = UTIL_FindEntityByTargetname(NULL, pExpr->szLocus, inputActivator);
+		if (!pActivator)
+			return; // it's a locus specifier, but the locus is invalid.
+
+		targetName = pExpr->szLocusTarget;
+		pTarget = UTIL_FindEntityByTargetname(NULL, targetName, inputActivator);
+		if (!pTarget)
+			return; // it's a locus specifier all right, but the target's invalid.
+	}
+
+	FireTargetList(pTarget, targetName, pActivator, inputActivator, pCaller, useType, value);
 }
 
 LINK_ENTITY_TO_CLASS(DelayedUse, CBaseDelay);
@@ -386,7 +528,7 @@ void CBaseDelay::SUB_UseTargets(CBaseEntity* pActivator, USE_TYPE useType, float
 
 		ALERT(at_aiconsole, "KillTarget: %s\n", STRING(m_iszKillTarget));
 		//LRC- now just USE_KILLs its killtarget, for consistency.
-		FireTargets(STRING(m_iszKillTarget), pActivator, this, USE_KILL, 0);
+		FireTargets(m_iszKillTarget, pActivator, this, USE_KILL, 0);
 	}
 
 	//
@@ -394,7 +536,7 @@ void CBaseDelay::SUB_UseTargets(CBaseEntity* pActivator, USE_TYPE useType, float
 	//
 	if (!FStringNull(pev->target))
 	{
-		FireTargets(STRING(pev->target), pActivator, this, useType, value);
+		FireTargets(pev->target, pActivator, this, useType, value);
 	}
 }
 
@@ -660,6 +802,17 @@ STATE CBaseToggle::GetState()
 	}
 };
 
+//LRC- use this instead of setting m_toggle_state, so that watchers hear about the change.
+void CBaseToggle::ChangeToggleState(TOGGLE_STATE state)
+{
+	if (m_toggle_state == state)
+		return;
+
+	m_toggle_state = state;
+	if (PublishesState())
+		StateChanged();
+}
+
 /*
 =============
 AngularMove
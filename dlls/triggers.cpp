@@ -279,9 +279,9 @@ void CTriggerRelay::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE
 		{
 			//FIXME: the alternate target should really use m_flDelay.
 			if (FBitSet(pev->spawnflags, SF_RELAY_USESAME))
-				FireTargets(STRING(m_iszAltTarget), pActivator, this, useType, 0);
+				FireTargets(m_iszAltTarget, pActivator, this, useType, 0);
 			else
-				FireTargets(STRING(m_iszAltTarget), pActivator, this, m_triggerType, 0);
+				FireTargets(m_iszAltTarget, pActivator, this, m_triggerType, 0);
 			if (FBitSet(pev->spawnflags, SF_RELAY_DEBUG))
 				ALERT(at_debug, "DEBUG: trigger_relay \"%s\" locked by master %s - fired alternate target %s\n", STRING(pev->targetname), STRING(m_sMaster), STRING(m_iszAltTarget));
 			if (FBitSet(pev->spawnflags, SF_RELAY_FIREONCE))
@@ -317,7 +317,7 @@ void CTriggerRelay::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE
 	}
 
 	if (!FStringNull(pev->message))
-		value = CalcLocus_Ratio(pActivator, STRING(pev->message));
+		value = CalcLocus_Ratio(pActivator, pev->message);
 
 	if (m_triggerType == USE_SAME)
 	{
@@ -470,6 +470,17 @@ public:
 
 	STATE m_iState;
 	STATE GetState() override { return m_iState; };
+	bool PublishesState() override { return true; } //LRC
+
+	//LRC- tells any watchers when the state actually changes
+	void ChangeState(STATE iState)
+	{
+		if (m_iState != iState)
+		{
+			m_iState = iState;
+			StateChanged();
+		}
+	}
 
 	int m_cTargets;							  // the total number of targets in this manager's fire list.
 	int m_index;							  // Current target
@@ -696,7 +707,7 @@ void CMultiManager::ManagerThink()
 				ALERT(at_debug, "DEBUG: multi_manager \"%s\": restarting loop.\n", STRING(pev->targetname));
 			SetNextThink(m_startTime);
 			m_startTime = m_fNextThink;
-			m_iState = STATE_TURN_ON;
+			ChangeState(STATE_TURN_ON);
 		}
 		else if (IsClone() || FBitSet(pev->spawnflags, SF_MULTIMAN_ONLYONCE))
 		{
@@ -710,7 +721,7 @@ void CMultiManager::ManagerThink()
 		{
 			if (FBitSet(pev->spawnflags, SF_MULTIMAN_DEBUG))
 				ALERT(at_debug, "DEBUG: multi_manager \"%s\": last burst.\n", STRING(pev->targetname));
-			m_iState = STATE_OFF;
+			ChangeState(STATE_OFF);
 			SetThink(NULL);
 			SetUse(&CMultiManager::ManagerUse); // allow manager re-use
 		}
@@ -727,10 +738,10 @@ void CMultiManager::ManagerThink()
 			// no weightings given, so just pick one.
 			if (total == 0)
 			{
-				const char* sTarg = STRING(m_iTargetName[RANDOM_LONG(0, m_cTargets - 1)]);
+				int iTarg = m_iTargetName[RANDOM_LONG(0, m_cTargets - 1)];
 				if (FBitSet(pev->spawnflags, SF_MULTIMAN_DEBUG))
-					ALERT(at_debug, "DEBUG: multi_manager \"%s\": firing \"%s\" (random choice).\n", STRING(pev->targetname), sTarg);
-				FireTargets(sTarg, m_hActivator, this, m_triggerType, 0);
+					ALERT(at_debug, "DEBUG: multi_manager \"%s\": firing \"%s\" (random choice).\n", STRING(pev->targetname), STRING(iTarg));
+				FireTargets(iTarg, m_hActivator, this, m_triggerType, 0);
 			}
 			else // pick one by weighting
 			{
@@ -743,7 +754,7 @@ void CMultiManager::ManagerThink()
 					{
 						if (FBitSet(pev->spawnflags, SF_MULTIMAN_DEBUG))
 							ALERT(at_debug, "DEBUG: multi_manager \"%s\": firing \"%s\" (weighted random choice).\n", STRING(pev->targetname), STRING(m_iTargetName[i]));
-						FireTargets(STRING(m_iTargetName[i]), m_hActivator, this, m_triggerType, 0);
+						FireTargets(m_iTargetName[i], m_hActivator, this, m_triggerType, 0);
 						break;
 					}
 				}
@@ -757,7 +768,7 @@ void CMultiManager::ManagerThink()
 				{
 					if (FBitSet(pev->spawnflags, SF_MULTIMAN_DEBUG))
 						ALERT(at_debug, "DEBUG: multi_manager \"%s\": firing \"%s\" (%f%% chance).\n", STRING(pev->targetname), STRING(m_iTargetName[i]), m_flTargetDelay[i]);
-					FireTargets(STRING(m_iTargetName[i]), m_hActivator, this, m_triggerType, 0);
+					FireTargets(m_iTargetName[i], m_hActivator, this, m_triggerType, 0);
 				}
 			}
 		}
@@ -767,7 +778,7 @@ void CMultiManager::ManagerThink()
 			{
 				if (FBitSet(pev->spawnflags, SF_MULTIMAN_DEBUG))
 					ALERT(at_debug, "DEBUG: multi_manager \"%s\": firing \"%s\" (simultaneous).\n", STRING(pev->targetname), STRING(m_iTargetName[i]));
-				FireTargets(STRING(m_iTargetName[i]), m_hActivator, this, m_triggerType, 0);
+				FireTargets(m_iTargetName[i], m_hActivator, this, m_triggerType, 0);
 			}
 		}
 
@@ -796,17 +807,17 @@ void CMultiManager::ManagerThink()
 			if (m_flMaxWait != 0) //LRC- random time to wait?
 			{
 				m_startTime = RANDOM_FLOAT(m_flWait, m_flMaxWait);
-				m_iState = STATE_TURN_ON; // while we're waiting, we're in state TURN_ON
+				ChangeState(STATE_TURN_ON); // while we're waiting, we're in state TURN_ON
 			}
 			else if (m_flWait != 0) //LRC- constant time to wait?
 			{
 				m_startTime = m_flWait;
-				m_iState = STATE_TURN_ON;
+				ChangeState(STATE_TURN_ON);
 			}
 			else //LRC- just start immediately.
 			{
 				m_startTime = 0;
-				m_iState = STATE_ON;
+				ChangeState(STATE_ON);
 			}
 			if (FBitSet(pev->spawnflags, SF_MULTIMAN_DEBUG))
 				ALERT(at_debug, "DEBUG: multi_manager \"%s\": restarting loop.\n", STRING(pev->targetname));
@@ -815,7 +826,7 @@ void CMultiManager::ManagerThink()
 		}
 		else
 		{
-			m_iState = STATE_OFF; //LRC- STATE_OFF means "yes, we've finished".
+			ChangeState(STATE_OFF); //LRC- STATE_OFF means "yes, we've finished".
 			if (IsClone() || FBitSet(pev->spawnflags, SF_MULTIMAN_ONLYONCE))
 			{
 				SetThink(&CMultiManager::SUB_Remove);
@@ -836,7 +847,7 @@ void CMultiManager::ManagerThink()
 	else
 	{
 		m_index = finalidx;
-		m_iState = STATE_ON; //LRC- while we're in STATE_ON we're firing targets, and haven't finished yet.
+		ChangeState(STATE_ON); //LRC- while we're in STATE_ON we're firing targets, and haven't finished yet.
 		AbsoluteNextThink(m_startTime + m_flTargetDelay[m_index]);
 	}
 
@@ -844,7 +855,7 @@ void CMultiManager::ManagerThink()
 	{
 		if (FBitSet(pev->spawnflags, SF_MULTIMAN_DEBUG))
 			ALERT(at_debug, "DEBUG: multi_manager \"%s\": firing \"%s\".\n", STRING(pev->targetname), STRING(m_iTargetName[index]));
-		FireTargets(STRING(m_iTargetName[index]), m_hActivator, this, m_triggerType, 0);
+		FireTargets(m_iTargetName[index], m_hActivator, this, m_triggerType, 0);
 		index++;
 	}
 }
@@ -860,7 +871,7 @@ CMultiManager* CMultiManager::Clone()
 	pMulti->pev->spawnflags |= SF_MULTIMAN_CLONE;
 	pMulti->m_cTargets = m_cTargets;
 	if (!FStringNull(m_iszThreadName))
-		pMulti->pev->targetname = m_iszThreadName; //LRC
+		UTIL_SetTargetname(pMulti, m_iszThreadName); //LRC
 	pMulti->m_triggerType = m_triggerType;		   //LRC
 	pMulti->m_iMode = m_iMode;					   //LRC
 	pMulti->m_flWait = m_flWait;				   //LRC
@@ -883,7 +894,7 @@ void CMultiManager::ManagerUse(CBaseEntity* pActivator, CBaseEntity* pCaller, US
 			{
 				if (FBitSet(pev->spawnflags, SF_MULTIMAN_DEBUG))
 					ALERT(at_debug, "DEBUG: multi_manager \"%s\": Loop halted on request.\n", STRING(pev->targetname));
-				m_iState = STATE_OFF;
+				ChangeState(STATE_OFF);
 				if (IsClone() || FBitSet(pev->spawnflags, SF_MULTIMAN_ONLYONCE))
 				{
 					SetThink(&CMultiManager::SUB_Remove);
@@ -930,7 +941,7 @@ void CMultiManager::ManagerUse(CBaseEntity* pActivator, CBaseEntity* pCaller, US
 			ALERT(at_debug, "DEBUG: multi_manager \"%s\": Creating clone.\n", STRING(pev->targetname));
 		pClone->ManagerUse(pActivator, pCaller, useType, value);
 		if (!FStringNull(m_iszLocusThread))
-			FireTargets(STRING(m_iszLocusThread), pClone, this, USE_TOGGLE, 0);
+			FireTargets(m_iszLocusThread, pClone, this, USE_TOGGLE, 0);
 		return;
 	}
 
@@ -941,17 +952,17 @@ void CMultiManager::ManagerUse(CBaseEntity* pActivator, CBaseEntity* pCaller, US
 	if (m_flMaxWait != 0) //LRC- random time to wait?
 	{
 		timeOffset = RANDOM_FLOAT(m_flWait, m_flMaxWait);
-		m_iState = STATE_TURN_ON; // while we're waiting, we're in state TURN_ON
+		ChangeState(STATE_TURN_ON); // while we're waiting, we're in state TURN_ON
 	}
 	else if (m_flWait != 0) //LRC- constant time to wait?
 	{
 		timeOffset = m_flWait;
-		m_iState = STATE_TURN_ON;
+		ChangeState(STATE_TURN_ON);
 	}
 	else //LRC- just start immediately.
 	{
 		timeOffset = 0;
-		m_iState = STATE_ON;
+		ChangeState(STATE_ON);
 	}
 
 	m_startTime = timeOffset + gpGlobals->time;
@@ -1022,10 +1033,12 @@ class CStateWatcher : public CBaseToggle
 {
 public:
 	void Spawn() override;
+	void Activate() override;
 	void EXPORT Think() override;
 	bool KeyValue(KeyValueData* pkvd) override;
 	STATE GetState() override;
 	STATE GetState(CBaseEntity* pActivator) override;
+	void WatchedStateChanged(CBaseEntity* pChanged) override;
 	int ObjectCaps() override { return CBaseEntity::ObjectCaps() & ~FCAP_ACROSS_TRANSITION; }
 
 	bool Save(CSave& save) override;
@@ -1038,6 +1051,7 @@ public:
 	int m_iTargetName[MAX_MULTI_TARGETS]; // list of indexes into global string array
 
 	bool EvalLogic(CBaseEntity* pEntity);
+	bool NeedsPolling();
 };
 
 LINK_ENTITY_TO_CLASS(multi_watcher, CStateWatcher);
@@ -1099,6 +1113,40 @@ void CStateWatcher::Spawn()
 		SetNextThink(0.5);
 }
 
+//LRC- ask to be told when the entities we're watching change state, instead of checking them every 0.1 seconds.
+void CStateWatcher::Activate()
+{
+	if (!FStringNull(pev->target))
+	{
+		for (int i = 0; i < m_cTargets; i++)
+			UTIL_AddStateListener(this, m_iTargetName[i]);
+	}
+	CBaseToggle::Activate();
+}
+
+// only called for the names we're watching
+void CStateWatcher::WatchedStateChanged(CBaseEntity* pChanged)
+{
+	SetNextThink(0); // re-evaluate next frame
+}
+
+// returns true if any of our targets won't tell us when its state changes.
+bool CStateWatcher::NeedsPolling()
+{
+	for (int i = 0; i < m_cTargets; i++)
+	{
+		const char* szName = STRING(m_iTargetName[i]);
+		// locus and alias references can point at a different entity from one moment to the next
+		if (szName[0] == '*' || strchr(szName, '.'))
+			return true;
+
+		CBaseEntity* pEntity = UTIL_FindEntityByTargetname(NULL, szName);
+		if (pEntity == NULL || !pEntity->PublishesState())
+			return true;
+	}
+	return false;
+}
+
 STATE CStateWatcher::GetState()
 {
 	if (EvalLogic(NULL))
@@ -1117,7 +1165,9 @@ STATE CStateWatcher::GetState(CBaseEntity* pActivator)
 
 void CStateWatcher::Think()
 {
-	SetNextThink(0.1);
+	// entities that publish their state will wake us up when they change; anything else has to be polled.
+	if (NeedsPolling())
+		SetNextThink(0.1);
 	int oldflag = pev->spawnflags & SF_SWATCHER_VALID;
 
 	if (EvalLogic(NULL))
@@ -1248,7 +1298,9 @@ class CWatcherCount : public CBaseToggle
 {
 public:
 	void Spawn() override;
+	void Activate() override;
 	void EXPORT Think() override;
+	void WatchedStateChanged(CBaseEntity* pChanged) override;
 	STATE GetState() override { return FBitSet(pev->spawnflags, SF_SWATCHER_VALID) ? STATE_ON : STATE_OFF; };
 	int ObjectCaps() override { return CBaseEntity::ObjectCaps() & ~FCAP_ACROSS_TRANSITION; }
 };
@@ -1261,6 +1313,21 @@ void CWatcherCount::Spawn()
 	SetNextThink(0.5);
 }
 
+//LRC- entities being spawned or removed will tell us straight away. We still poll, to catch entities
+// whose targetname gets changed.
+void CWatcherCount::Activate()
+{
+	if (!FStringNull(pev->noise))
+		UTIL_AddStateListener(this, pev->noise);
+	CBaseToggle::Activate();
+}
+
+// only called for the name we're counting
+void CWatcherCount::WatchedStateChanged(CBaseEntity* pChanged)
+{
+	SetNextThink(0);
+}
+
 void CWatcherCount::Think()
 {
 	SetNextThink(0.1);
@@ -1462,7 +1529,7 @@ void CRenderFxManager::Affect(CBaseEntity* pTarget, bool bIsFirst, CBaseEntity*
 
 	float fAmtFactor = 1;
 	if (!FStringNull(pev->message) && !FBitSet(pev->spawnflags, SF_RENDER_MASKAMT))
-		fAmtFactor = CalcLocus_Ratio(pActivator, STRING(pev->message));
+		fAmtFactor = CalcLocus_Ratio(pActivator, pev->message);
 
 	if (!FBitSet(pev->spawnflags, SF_RENDER_MASKFX))
 		pevTarget->renderfx = pev->renderfx;
@@ -2947,7 +3014,7 @@ void CTriggerInOut::FireOnLeaving(CBaseEntity* pEnt)
 	if (UTIL_IsMasterTriggered(m_sMaster, pEnt))
 	{
 		FireTargets(STRING(m_iszBothTarget), pEnt, this, USE_OFF, 0);
-		FireTargets(STRING(m_iszAltTarget), pEnt, this, USE_TOGGLE, 0);
+		FireTargets(m_iszAltTarget, pEnt, this, USE_TOGGLE, 0);
 	}
 }
 
@@ -3629,12 +3696,12 @@ void CTriggerPush::Touch(CBaseEntity* pOther)
 
 	Vector vecPush;
 	if (!FStringNull(m_iszPushVel))
-		vecPush = CalcLocus_Velocity(this, pOther, STRING(m_iszPushVel));
+		vecPush = CalcLocus_Velocity(this, pOther, m_iszPushVel);
 	else
 		vecPush = pev->movedir;
 
 	if (!FStringNull(m_iszPushSpeed))
-		vecPush = vecPush * CalcLocus_Ratio(pOther, STRING(m_iszPushSpeed));
+		vecPush = vecPush * CalcLocus_Ratio(pOther, m_iszPushSpeed);
 
 	if (pev->speed != 0)
 		vecPush = vecPush * pev->speed;
@@ -4271,7 +4338,7 @@ void CTriggerMotion::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE
 		case 0:
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "DEBUG: Set origin from %f %f %f ", pTarget->pev->origin.x, pTarget->pev->origin.y, pTarget->pev->origin.z);
-			pTarget->pev->origin = CalcLocus_Position(this, pActivator, STRING(m_iszPosition));
+			pTarget->pev->origin = CalcLocus_Position(this, pActivator, m_iszPosition);
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "to %f %f %f\n", pTarget->pev->origin.x, pTarget->pev->origin.y, pTarget->pev->origin.z);
 			pTarget->pev->flags &= ~FL_ONGROUND;
@@ -4279,7 +4346,7 @@ void CTriggerMotion::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE
 		case 1:
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "DEBUG: Set origin from %f %f %f ", pTarget->pev->origin.x, pTarget->pev->origin.y, pTarget->pev->origin.z);
-			pTarget->pev->origin = pTarget->pev->origin + CalcLocus_Velocity(this, pActivator, STRING(m_iszPosition));
+			pTarget->pev->origin = pTarget->pev->origin + CalcLocus_Velocity(this, pActivator, m_iszPosition);
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "to %f %f %f\n", pTarget->pev->origin.x, pTarget->pev->origin.y, pTarget->pev->origin.z);
 			pTarget->pev->flags &= ~FL_ONGROUND;
@@ -4294,7 +4361,7 @@ void CTriggerMotion::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE
 		switch (m_iAngMode)
 		{
 		case 0:
-			vecTemp = CalcLocus_Velocity(this, pActivator, STRING(m_iszAngles));
+			vecTemp = CalcLocus_Velocity(this, pActivator, m_iszAngles);
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "DEBUG: Set angles from %f %f %f ", pTarget->pev->angles.x, pTarget->pev->angles.y, pTarget->pev->angles.z);
 			pTarget->pev->angles = UTIL_VecToAngles(vecTemp);
@@ -4302,7 +4369,7 @@ void CTriggerMotion::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE
 				ALERT(at_debug, "to %f %f %f\n", pTarget->pev->angles.x, pTarget->pev->angles.y, pTarget->pev->angles.z);
 			break;
 		case 1:
-			vecTemp = CalcLocus_Velocity(this, pActivator, STRING(m_iszVelocity));
+			vecTemp = CalcLocus_Velocity(this, pActivator, m_iszVelocity);
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "DEBUG: Rotate angles from %f %f %f ", pTarget->pev->angles.x, pTarget->pev->angles.y, pTarget->pev->angles.z);
 			pTarget->pev->angles = pTarget->pev->angles + UTIL_VecToAngles(vecTemp);
@@ -4327,19 +4394,19 @@ void CTriggerMotion::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE_TYPE
 		case 0:
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "DEBUG: Set velocity from %f %f %f ", pTarget->pev->velocity.x, pTarget->pev->velocity.y, pTarget->pev->velocity.z);
-			pTarget->pev->velocity = CalcLocus_Velocity(this, pActivator, STRING(m_iszVelocity));
+			pTarget->pev->velocity = CalcLocus_Velocity(this, pActivator, m_iszVelocity);
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "to %f %f %f\n", pTarget->pev->velocity.x, pTarget->pev->velocity.y, pTarget->pev->velocity.z);
 			break;
 		case 1:
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "DEBUG: Set velocity from %f %f %f ", pTarget->pev->velocity.x, pTarget->pev->velocity.y, pTarget->pev->velocity.z);
-			pTarget->pev->velocity = pTarget->pev->velocity + CalcLocus_Velocity(this, pActivator, STRING(m_iszVelocity));
+			pTarget->pev->velocity = pTarget->pev->velocity + CalcLocus_Velocity(this, pActivator, m_iszVelocity);
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "to %f %f %f\n", pTarget->pev->velocity.x, pTarget->pev->velocity.y, pTarget->pev->velocity.z);
 			break;
 		case 2:
-			vecTemp = CalcLocus_Velocity(this, pActivator, STRING(m_iszVelocity));
+			vecTemp = CalcLocus_Velocity(this, pActivator, m_iszVelocity);
 			vecVelAngles = UTIL_VecToAngles(vecTemp) + UTIL_VecToAngles(pTarget->pev->velocity);
 			UTIL_MakeVectors(vecVelAngles);
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
@@ -4445,7 +4512,7 @@ void CMotionThread::Think()
 		case 0: // set position
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "DEBUG: Set origin from %f %f %f ", m_hTarget->pev->origin.x, m_hTarget->pev->origin.y, m_hTarget->pev->origin.z);
-			UTIL_AssignOrigin(m_hTarget, CalcLocus_Position(this, m_hLocus, STRING(m_iszPosition)));
+			UTIL_AssignOrigin(m_hTarget, CalcLocus_Position(this, m_hLocus, m_iszPosition));
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "to %f %f %f\n", m_hTarget->pev->origin.x, m_hTarget->pev->origin.y, m_hTarget->pev->origin.z);
 			m_hTarget->pev->flags &= ~FL_ONGROUND;
@@ -4453,7 +4520,7 @@ void CMotionThread::Think()
 		case 1: // offset position (= fake velocity)
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "DEBUG: Offset origin from %f %f %f ", m_hTarget->pev->origin.x, m_hTarget->pev->origin.y, m_hTarget->pev->origin.z);
-			UTIL_AssignOrigin(m_hTarget, m_hTarget->pev->origin + gpGlobals->frametime * CalcLocus_Velocity(this, m_hLocus, STRING(m_iszPosition)));
+			UTIL_AssignOrigin(m_hTarget, m_hTarget->pev->origin + gpGlobals->frametime * CalcLocus_Velocity(this, m_hLocus, m_iszPosition));
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "to %f %f %f\n", m_hTarget->pev->origin.x, m_hTarget->pev->origin.y, m_hTarget->pev->origin.z);
 			m_hTarget->pev->flags &= ~FL_ONGROUND;
@@ -4461,21 +4528,21 @@ void CMotionThread::Think()
 		case 2: // set velocity
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "DEBUG: Set velocity from %f %f %f ", m_hTarget->pev->velocity.x, m_hTarget->pev->velocity.y, m_hTarget->pev->velocity.z);
-			UTIL_SetVelocity(m_hTarget, CalcLocus_Velocity(this, m_hLocus, STRING(m_iszPosition)));
+			UTIL_SetVelocity(m_hTarget, CalcLocus_Velocity(this, m_hLocus, m_iszPosition));
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "to %f %f %f\n", m_hTarget->pev->velocity.x, m_hTarget->pev->velocity.y, m_hTarget->pev->velocity.z);
 			break;
 		case 3: // accelerate
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "DEBUG: Accelerate from %f %f %f ", m_hTarget->pev->velocity.x, m_hTarget->pev->velocity.y, m_hTarget->pev->velocity.z);
-			UTIL_SetVelocity(m_hTarget, m_hTarget->pev->velocity + gpGlobals->frametime * CalcLocus_Velocity(this, m_hLocus, STRING(m_iszPosition)));
+			UTIL_SetVelocity(m_hTarget, m_hTarget->pev->velocity + gpGlobals->frametime * CalcLocus_Velocity(this, m_hLocus, m_iszPosition));
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "to %f %f %f\n", m_hTarget->pev->velocity.x, m_hTarget->pev->velocity.y, m_hTarget->pev->velocity.z);
 			break;
 		case 4: // follow position
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "DEBUG: Set velocity (path) from %f %f %f ", m_hTarget->pev->velocity.x, m_hTarget->pev->velocity.y, m_hTarget->pev->velocity.z);
-			UTIL_SetVelocity(m_hTarget, CalcLocus_Position(this, m_hLocus, STRING(m_iszPosition)) - m_hTarget->pev->origin);
+			UTIL_SetVelocity(m_hTarget, CalcLocus_Position(this, m_hLocus, m_iszPosition) - m_hTarget->pev->origin);
 			if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
 				ALERT(at_debug, "to %f %f %f\n", m_hTarget->pev->velocity.x, m_hTarget->pev->velocity.y, m_hTarget->pev->velocity.z);
 			break;
@@ -4489,7 +4556,7 @@ void CMotionThread::Think()
 		switch (m_iFaceMode)
 		{
 		case 0: // set angles
-			vecTemp = CalcLocus_Velocity(this, m_hLocus, STRING(m_iszFacing));
+			vecTemp = CalcLocus_Velocity(this, m_hLocus, m_iszFacing);
 			if (vecTemp != g_vecZero) // if the vector is 0 0 0, don't use it
 			{
 				if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
@@ -4504,7 +4571,7 @@ void CMotionThread::Think()
 			}
 			break;
 		case 1: // offset angles (= fake avelocity)
-			vecTemp = CalcLocus_Velocity(this, m_hLocus, STRING(m_iszFacing));
+			vecTemp = CalcLocus_Velocity(this, m_hLocus, m_iszFacing);
 			if (vecTemp != g_vecZero) // if the vector is 0 0 0, don't use it
 			{
 				if (FBitSet(pev->spawnflags, SF_MOTION_DEBUG))
@@ -4747,8 +4814,10 @@ void CTriggerChangeValue::Use(CBaseEntity* pActivator, CBaseEntity* pCaller, USE
 		KeyValueData mypkvd;
 		mypkvd.szKeyName = (char*)STRING(pev->netname);
 		mypkvd.szValue = (char*)STRING(m_iszNewValue);
+		mypkvd.szClassName = (char*)STRING(pTarget->pev->classname);
 		mypkvd.fHandled = 0;
-		pTarget->KeyValue(&mypkvd);
+		// the way the map loader does it, so entvars like targetname can be changed too
+		DispatchKeyValue(pTarget->edict(), &mypkvd);
 		//Error if not handled?
 	}
 }
@@ -671,6 +671,107 @@ void UTIL_AddToAliasList(CBaseAlias* pAlias)
 	}
 }
 
+//LRC- the same name can be allocated as several different string_ts, so anything that wants to look
+// entities up by name has to hash the text.
+unsigned int UTIL_HashTargetname(const char* szName)
+{
+	// FNV-1a
+	unsigned int iHash = 2166136261u;
+	for (; *szName; szName++)
+		iHash = (iHash ^ (unsigned char)*szName) * 16777619u;
+	return iHash;
+}
+
+//LRC- StateListeners get told whenever an entity with a name they're watching changes state. They're
+// kept in a table by that name, so an entity only has to look at the ones that might be watching it.
+#define STATE_LISTENER_HASH_SIZE 64
+
+struct state_listener_t
+{
+	CBaseEntity* pListener;
+	string_t iszName;
+	unsigned int iHash;
+	state_listener_t* pNext;
+};
+
+static state_listener_t* g_pStateListeners[STATE_LISTENER_HASH_SIZE];
+
+void UTIL_AddStateListener(CBaseEntity* pListener, string_t iszName)
+{
+	const unsigned int iHash = UTIL_HashTargetname(STRING(iszName));
+	state_listener_t** ppBucket = &g_pStateListeners[iHash % STATE_LISTENER_HASH_SIZE];
+
+	for (state_listener_t* pCurrent = *ppBucket; pCurrent != NULL; pCurrent = pCurrent->pNext)
+	{
+		if (pCurrent->pListener == pListener && pCurrent->iHash == iHash && FStrEq(STRING(pCurrent->iszName), STRING(iszName)))
+			return; // already listening for this name
+	}
+
+	state_listener_t* pNew = new state_listener_t;
+	pNew->pListener = pListener;
+	pNew->iszName = iszName;
+	pNew->iHash = iHash;
+	pNew->pNext = *ppBucket;
+	*ppBucket = pNew;
+	pListener->m_fStateListener = true;
+}
+
+void UTIL_RemoveFromStateListeners(CBaseEntity* pListener)
+{
+	if (!pListener->m_fStateListener)
+		return;
+	pListener->m_fStateListener = false;
+
+	for (int i = 0; i < STATE_LISTENER_HASH_SIZE; i++)
+	{
+		state_listener_t** ppLink = &g_pStateListeners[i];
+		while (*ppLink != NULL)
+		{
+			state_listener_t* pCurrent = *ppLink;
+			if (pCurrent->pListener == pListener)
+			{
+				*ppLink = pCurrent->pNext;
+				delete pCurrent;
+			}
+			else
+			{
+				ppLink = &pCurrent->pNext;
+			}
+		}
+	}
+}
+
+// tells everything watching pChanged's name that its state may have changed
+void UTIL_NotifyStateListeners(CBaseEntity* pChanged)
+{
+	const char* szName = STRING(pChanged->pev->targetname);
+	const unsigned int iHash = UTIL_HashTargetname(szName);
+
+	state_listener_t* pCurrent = g_pStateListeners[iHash % STATE_LISTENER_HASH_SIZE];
+	while (pCurrent != NULL)
+	{
+		// cache this, in case the listener takes itself out of the table.
+		state_listener_t* pNext = pCurrent->pNext;
+		if (pCurrent->iHash == iHash && FStrEq(STRING(pCurrent->iszName), szName))
+			pCurrent->pListener->WatchedStateChanged(pChanged);
+		pCurrent = pNext;
+	}
+}
+
+// called when a new level starts; the old level's listeners have all gone
+void UTIL_ClearStateListeners()
+{
+	for (int i = 0; i < STATE_LISTENER_HASH_SIZE; i++)
+	{
+		while (g_pStateListeners[i])
+		{
+			state_listener_t* pCurrent = g_pStateListeners[i];
+			g_pStateListeners[i] = pCurrent->pNext;
+			delete pCurrent;
+		}
+	}
+}
+
 // for every alias which has the given name, find the earliest entity which any of them refers to
 // and which is later than pStartEntity.
 CBaseEntity* UTIL_FollowAliasReference(CBaseEntity* pStartEntity, const char* szValue)
@@ -1961,7 +2062,15 @@ void UTIL_Remove(CBaseEntity* pEntity)
 
 	pEntity->UpdateOnRemove();
 	pEntity->pev->flags |= FL_KILLME;
-	pEntity->pev->targetname = 0;
+	UTIL_SetTargetname(pEntity, 0);
+}
+
+//LRC- renames an entity that's already spawned, so anything that's looked it up by name knows to look again
+void UTIL_SetTargetname(CBaseEntity* pEntity, string_t iszName)
+{
+	LocusTargetnameChanged(pEntity->pev->targetname);
+	LocusTargetnameChanged(iszName);
+	pEntity->pev->targetname = iszName;
 }
 
 
@@ -2423,6 +2532,15 @@ void EntvarsKeyvalue(entvars_t* pev, KeyValueData* pkvd)
 			case FIELD_MODELNAME:
 			case FIELD_SOUNDNAME:
 			case FIELD_STRING:
+				//LRC- a rename (e.g. from trigger_changevalue) has to drop calc_ bindings to either name
+				if (pField->fieldOffset == offsetof(entvars_t, targetname))
+				{
+					string_t iszName = ALLOC_STRING(pkvd->szValue);
+					LocusTargetnameChanged(pev->targetname);
+					LocusTargetnameChanged(iszName);
+					pev->targetname = iszName;
+					break;
+				}
 				(*(int*)((char*)pev + pField->fieldOffset)) = ALLOC_STRING(pkvd->szValue);
 				break;
 
@@ -243,6 +243,11 @@ extern Vector UTIL_AxisRotationToVec(const Vector& vec, float angle);	 //LRC
 class CBaseAlias;
 extern void UTIL_AddToAliasList(CBaseAlias* pAlias);
 extern void UTIL_FlushAliases();
+extern unsigned int UTIL_HashTargetname(const char* szName);
+extern void UTIL_AddStateListener(CBaseEntity* pListener, string_t iszName);
+extern void UTIL_RemoveFromStateListeners(CBaseEntity* pListener);
+extern void UTIL_NotifyStateListeners(CBaseEntity* pChanged);
+extern void UTIL_ClearStateListeners();
 
 extern CBaseEntity* UTIL_FindEntityInSphere(CBaseEntity* pStartEntity, const Vector& vecCenter, float flRadius);
 extern CBaseEntity* UTIL_FindEntityByString(CBaseEntity* pStartEntity, const char* szKeyword, const char* szValue);
@@ -330,6 +335,7 @@ extern float UTIL_AngleDistance(float next, float cur);
 
 extern char* UTIL_VarArgs(const char* format, ...);
 extern void UTIL_Remove(CBaseEntity* pEntity);
+extern void UTIL_SetTargetname(CBaseEntity* pEntity, string_t iszName);
 extern bool UTIL_IsValidEntity(edict_t* pent);
 extern bool UTIL_TeamsMatch(const char* pTeamName1, const char* pTeamName2);
 extern bool UTIL_IsFacing(entvars_t* pevTest, const Vector& reference); //LRC
@@ -34,6 +34,8 @@
 #include "gamerules.h"
 #include "teamplay_gamerules.h"
 #include "movewith.h" //LRC
+#include "locus.h"	  //LRC
+#include "animation.h"
 
 CGlobalState gGlobalState;
 
@@ -516,6 +518,10 @@ void CWorld::Precache()
 	g_pWorld = this;
 	m_pAssistLink = NULL;
 	m_pFirstAlias = NULL;
+	UTIL_ClearStateListeners();
+	ClearCompiledTargets();
+	ClearCompiledLocus();
+	ClearAnimationCache();
 	//	ALERT(at_console, "Clearing AssistList\n");
 
 	g_pLastSpawn = NULL;
@@ -26,6 +26,7 @@
 	#endif
 	#define MAX_PATH PATH_MAX
 	#include <sys/time.h>
+	#include <time.h>
 #endif
 
 #include <assert.h>
@@ -158,18 +159,19 @@ inline double CPerformanceCounter::GetCurTime()
 	return m_flCurrentTime;
 
 #else
-	struct timeval	tp;
-	static int	secbase = 0;
-    
-	gettimeofday( &tp, NULL );
- 
+	// monotonic, and fine enough to time things that take microseconds
+	struct timespec	tp;
+	static time_t	secbase = 0;
+
+	clock_gettime( CLOCK_MONOTONIC, &tp );
+
 	if ( !secbase )
 	{
 		secbase = tp.tv_sec;
-		return ( tp.tv_usec / 1000000.0 );
+		return ( tp.tv_nsec / 1000000000.0 );
 	}
- 
-	return ( ( tp.tv_sec - secbase ) + tp.tv_usec / 1000000.0 );
+
+	return ( ( tp.tv_sec - secbase ) + tp.tv_nsec / 1000000000.0 );
 #endif /* _WIN32 */
 }
 
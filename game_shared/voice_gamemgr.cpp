@@ -31,6 +31,22 @@ CPlayerBitVec g_SentGameRulesMasks[MAX_PLAYERS]; // These store the masks we las
 CPlayerBitVec g_SentBanMasks[MAX_PLAYERS];		 // we need to resend them.
 CPlayerBitVec g_bWantModEnable;
 
+CPlayerBitVec g_SentListening[MAX_PLAYERS]; // What we last told the engine about who each client can hear.
+CPlayerBitVec g_bResendListening;			// Clients that have just connected, so everything about them has to be worked out and sent again.
+
+// The things about a client the game rules might base who hears who on. The game rules masks are only
+// rebuilt for the rows and columns of clients where one of these has changed since the last update.
+struct voice_client_state_t
+{
+	bool bPlayer;
+	bool bAlive;
+	bool bModEnable;
+	int iTeam;
+	char szTeam[TEAM_NAME_LENGTH];
+};
+
+voice_client_state_t g_ClientStates[MAX_PLAYERS];
+
 cvar_t voice_serverdebug = {"voice_serverdebug", "0"};
 
 // Set game rules to allow all clients to talk to each other.
@@ -85,6 +101,10 @@ CVoiceGameMgr::CVoiceGameMgr()
 {
 	m_UpdateInterval = 0;
 	m_nMaxPlayers = 0;
+	m_bRecheckAll = true;
+	m_bAllTalk = false;
+	m_nCallsMade = 0;
+	m_nCallsSaved = 0;
 }
 
 
@@ -99,6 +119,9 @@ bool CVoiceGameMgr::Init(
 {
 	m_pHelper = pHelper;
 	m_nMaxPlayers = MAX_PLAYERS < maxClients ? MAX_PLAYERS : maxClients;
+	m_bRecheckAll = true;
+	memset(g_ClientStates, 0, sizeof(g_ClientStates));
+	g_bResendListening.Init(1);
 	g_engfuncs.pfnPrecacheModel("sprites/voiceicon.spr");
 
 	m_msgPlayerVoiceMask = REG_USER_MSG("VoiceMask", VOICE_MAX_PLAYERS_DW * 4 * 2);
@@ -118,6 +141,7 @@ bool CVoiceGameMgr::Init(
 void CVoiceGameMgr::SetHelper(IVoiceGameMgrHelper* pHelper)
 {
 	m_pHelper = pHelper;
+	m_bRecheckAll = true;
 }
 
 
@@ -140,6 +164,9 @@ void CVoiceGameMgr::ClientConnected(edict_t* pEdict)
 	g_bWantModEnable[index] = true;
 	g_SentGameRulesMasks[index].Init(0);
 	g_SentBanMasks[index].Init(0);
+
+	// The engine's forgotten whatever we told it about this slot.
+	g_bResendListening[index] = true;
 }
 
 // Called to determine if the Receiver has muted (blocked) the Sender
@@ -213,33 +240,93 @@ void CVoiceGameMgr::UpdateMasks()
 	m_UpdateInterval = 0;
 
 	bool bAllTalk = 0 != sv_alltalk.value;
+	if (bAllTalk != m_bAllTalk)
+	{
+		m_bAllTalk = bAllTalk;
+		m_bRecheckAll = true;
+	}
+
+	int nPlayers = 0;
+	int nModEnabled = 0;
+	int nHearChecks = 0;
+	int nListenCalls = 0;
 
-	for (int iClient = 0; iClient < m_nMaxPlayers; iClient++)
+	// Find out whose state has changed.
+	CPlayerBitVec changed;
+	CBasePlayer* pPlayers[MAX_PLAYERS];
+	int iClient;
+	for (iClient = 0; iClient < m_nMaxPlayers; iClient++)
 	{
 		CBaseEntity* pEnt = UTIL_PlayerByIndex(iClient + 1);
-		if (!pEnt || !pEnt->IsPlayer())
+		if (pEnt && !pEnt->IsPlayer())
+			pEnt = NULL;
+		pPlayers[iClient] = (CBasePlayer*)pEnt;
+
+		voice_client_state_t state;
+		memset(&state, 0, sizeof(state));
+		if (pEnt)
+		{
+			state.bPlayer = true;
+			state.bAlive = pEnt->IsAlive();
+			state.bModEnable = g_PlayerModEnable[iClient];
+			state.iTeam = pEnt->pev->team;
+			strncpy(state.szTeam, pEnt->TeamID(), TEAM_NAME_LENGTH - 1);
+		}
+
+		if (m_bRecheckAll || g_bResendListening[iClient] || 0 != memcmp(&state, &g_ClientStates[iClient], sizeof(state)))
+		{
+			g_ClientStates[iClient] = state;
+			changed[iClient] = true;
+		}
+	}
+
+	// Who needs everything resending, as it was before this update. The flags are only cleared
+	// once every row's been sent, or the pairs in the columns of later rows would be missed.
+	const CPlayerBitVec resendListening = g_bResendListening;
+
+	for (iClient = 0; iClient < m_nMaxPlayers; iClient++)
+	{
+		CBasePlayer* pPlayer = pPlayers[iClient];
+		if (!pPlayer)
 			continue;
 
+		nPlayers++;
+		if (g_PlayerModEnable[iClient])
+			nModEnabled++;
+
 		// Request the state of their "VModEnable" cvar.
 		if (g_bWantModEnable[iClient])
 		{
-			MESSAGE_BEGIN(MSG_ONE, m_msgRequestState, NULL, pEnt->pev);
+			MESSAGE_BEGIN(MSG_ONE, m_msgRequestState, NULL, pPlayer->pev);
 			MESSAGE_END();
 		}
 
-		CBasePlayer* pPlayer = (CBasePlayer*)pEnt;
-
-		CPlayerBitVec gameRulesMask;
-		if (g_PlayerModEnable[iClient])
+		// Bring the mask of who they can hear based on the game rules up to date. Only their
+		// row needs rebuilding if they've changed, and only the columns of those who have if not.
+		CPlayerBitVec gameRulesMask = g_SentGameRulesMasks[iClient];
+		if (!g_PlayerModEnable[iClient])
+		{
+			gameRulesMask.Init(0);
+		}
+		else
 		{
-			// Build a mask of who they can hear based on the game rules.
+			const bool bRow = changed[iClient];
 			for (int iOtherClient = 0; iOtherClient < m_nMaxPlayers; iOtherClient++)
 			{
-				CBaseEntity* pEnt = UTIL_PlayerByIndex(iOtherClient + 1);
-				if (pEnt && (bAllTalk || m_pHelper->CanPlayerHearPlayer(pPlayer, (CBasePlayer*)pEnt)))
+				if (!bRow && !changed[iOtherClient])
+					continue;
+
+				CBasePlayer* pOther = pPlayers[iOtherClient];
+				if (!pOther)
 				{
-					gameRulesMask[iOtherClient] = true;
+					gameRulesMask[iOtherClient] = false;
+					continue;
 				}
+
+				if (!bAllTalk)
+					nHearChecks++;
+
+				gameRulesMask[iOtherClient] = bAllTalk || m_pHelper->CanPlayerHearPlayer(pPlayer, pOther);
 			}
 		}
 
@@ -260,11 +347,32 @@ void CVoiceGameMgr::UpdateMasks()
 			MESSAGE_END();
 		}
 
-		// Tell the engine.
+		// Tell the engine about any pairs that have changed.
+		const bool bResendRow = resendListening[iClient];
 		for (int iOtherClient = 0; iOtherClient < m_nMaxPlayers; iOtherClient++)
 		{
 			bool bCanHear = gameRulesMask[iOtherClient] && !g_BanMasks[iClient][iOtherClient];
+			if (!bResendRow && !resendListening[iOtherClient] && bCanHear == g_SentListening[iClient][iOtherClient])
+				continue;
+
+			g_SentListening[iClient][iOtherClient] = bCanHear;
 			g_engfuncs.pfnVoice_SetClientListening(iClient + 1, iOtherClient + 1, bCanHear ? 1 : 0);
+			nListenCalls++;
 		}
 	}
+
+	// A slot that's connected but isn't a player yet hasn't had its row sent, so it keeps its flag.
+	for (iClient = 0; iClient < m_nMaxPlayers; iClient++)
+	{
+		if (pPlayers[iClient])
+			g_bResendListening[iClient] = false;
+	}
+	m_bRecheckAll = false;
+
+	// Checking every pair would have been a game rules call for each player against each other
+	// player (unless it's alltalk) and an engine call for each player against each slot.
+	m_nCallsMade = nHearChecks + nListenCalls;
+	m_nCallsSaved = (bAllTalk ? 0 : nModEnabled * nPlayers) + nPlayers * m_nMaxPlayers - m_nCallsMade;
+	if (0 != m_nCallsMade)
+		VoiceServerDebug("CVoiceGameMgr::UpdateMasks: %d calls, %d saved\n", m_nCallsMade, m_nCallsSaved);
 }
@@ -70,4 +70,9 @@ private:
 	IVoiceGameMgrHelper	*m_pHelper;
 	int					m_nMaxPlayers;
 	double				m_UpdateInterval;						// How long since the last update.
+
+	bool				m_bRecheckAll;							// Ask the game rules about every pair next update (new helper, sv_alltalk changed..)
+	bool				m_bAllTalk;								// sv_alltalk as of the last update.
+	int					m_nCallsMade;							// Game rules and engine calls in the last update,
+	int					m_nCallsSaved;							// and how many fewer that was than checking every pair.
 };